@@ -1,4 +1,5 @@
 #include "animesh.hpp"
+#include "animesh_host.hpp"
 
 #include "animesh_kers.hpp"
 #include "macros.hpp"
@@ -17,11 +18,61 @@
 
 using namespace Cuda_utils;
 
-AnimeshBase *AnimeshBase::create(const Mesh *mesh, std::shared_ptr<const Skeleton> skel)
+AnimeshBase *AnimeshBase::create(const Mesh *mesh,
+                                 std::shared_ptr<const Skeleton> skel,
+                                 EAnimesh::Backend backend)
 {
+    if(backend == EAnimesh::CPU)
+        return new Animesh_host(mesh, skel);
     return new Animesh(mesh, skel);
 }
 
+// -----------------------------------------------------------------------------
+
+void AnimeshBase::transform_frames(const std::vector<Frame>& frames, Point_cu* out)
+{
+    // Remember the matrices of every bone we move to set them back at the end
+    std::map<Bone*, std::pair<std::shared_ptr<Bone>, Transfo> > saved;
+    for(const Frame& frame: frames)
+    {
+        for(const auto& it: frame.bones)
+        {
+            if(saved.find(it.first.get()) == saved.end())
+                saved[it.first.get()] = std::make_pair(it.first, it.first->get_world_space_matrix());
+        }
+    }
+
+    auto restore = [&saved]() {
+        for(auto& it: saved)
+        {
+            std::shared_ptr<Bone> bone = it.second.first;
+            if(!bone->get_world_space_matrix().equal(it.second.second))
+                bone->set_world_space_matrix(it.second.second);
+        }
+    };
+
+    const int nb_vert = get_nb_vertices();
+    try {
+        for(int f = 0; f < (int)frames.size(); f++)
+        {
+            // Unchanged bones don't trigger an update of the skeleton
+            for(const auto& it: frames[f].bones)
+            {
+                if(!it.first->get_world_space_matrix().equal(it.second))
+                    it.first->set_world_space_matrix(it.second);
+            }
+
+            transform_frame(frames[f].vertices, out + (size_t)f * nb_vert);
+        }
+    } catch(...) {
+        // Don't leave the caller's skeleton in the pose of some frame
+        restore();
+        throw;
+    }
+
+    restore();
+}
+
 Animesh::Animesh(const Mesh *m_, std::shared_ptr<const Skeleton> s_) :
     _mesh(m_), _skel(s_),
     mesh_smoothing(EAnimesh::LAPLACIAN),
@@ -33,6 +84,8 @@ Animesh::Animesh(const Mesh *m_, std::shared_ptr<const Skeleton> s_) :
     diffuse_smooth_weights_iter(6),
     smooth_force_a(0.5f),
     smooth_force_b(0.5f),
+    do_warm_start(false),
+    warm_start_threshold(0.1f),
     d_input_smooth_factors(_mesh->get_nb_vertices()),
     d_smooth_factors_conservative(_mesh->get_nb_vertices(), 0.f),
     d_smooth_factors_laplacian(_mesh->get_nb_vertices()),
@@ -94,13 +147,15 @@ Animesh::~Animesh()
 void Animesh::init_vert_to_fit()
 {
     int nb_vert = _mesh->get_nb_vertices();
-    std::vector<int> h_vert_to_fit_base;
-    h_vert_to_fit_base.reserve(nb_vert);
+    std::vector<int> vert_to_fit_base;
+    std::vector<bool> fitted(nb_vert, false);
+    vert_to_fit_base.reserve(nb_vert);
     int acc = 0;
     for (int i = 0; i < nb_vert; ++i)
     {
-        if( !_mesh->is_disconnect(i) ){
-            h_vert_to_fit_base.push_back( i );
+        if( !_mesh->is_disconnect(i) && (vert_mask.empty() || vert_mask[i]) ){
+            vert_to_fit_base.push_back( i );
+            fitted[i] = true;
             acc++;
         }
     }
@@ -108,13 +163,35 @@ void Animesh::init_vert_to_fit()
     d_vert_to_fit.     malloc(acc);
     d_vert_to_fit_base.malloc(acc);
 
-    d_vert_to_fit_buff_scan.malloc(acc+1);
-    d_vert_to_fit_buff_scan.set(0, 0);
-    d_vert_to_fit_buff.malloc(acc);
+    h_vert_to_fit_base.malloc(acc);
     h_vert_to_fit_buff.malloc(acc);
 
-    d_vert_to_fit_base.copy_from(h_vert_to_fit_base);
-    d_vert_to_fit.     copy_from(h_vert_to_fit_base);
+    h_vert_to_fit_base.copy_from(vert_to_fit_base);
+
+    d_vert_to_fit_base.copy_from(vert_to_fit_base);
+    d_vert_to_fit.     copy_from(vert_to_fit_base);
+
+    // Vertices left out by the mask follow their fitted neighbors
+    lod_layer_offsets.clear();
+    if( !vert_mask.empty() )
+    {
+        std::vector<int> vert_level, layer_verts;
+        Animesh_kers::compute_lod_layers(*_mesh, fitted, vert_level, layer_verts, lod_layer_offsets);
+
+        d_vert_level.malloc(nb_vert);
+        d_vert_level.copy_from(vert_level);
+        d_lod_layer_verts.malloc(layer_verts.size());
+        d_lod_layer_verts.copy_from(layer_verts);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh::set_vert_mask(const std::vector<bool>& mask)
+{
+    assert(mask.empty() || (int)mask.size() == _mesh->get_nb_vertices());
+    vert_mask = mask;
+    init_vert_to_fit();
 }
 
 // -----------------------------------------------------------------------------
@@ -140,6 +217,18 @@ void Animesh::set_vertices(const std::vector<Vec3_cu> &vertices)
     d_input_vertices.copy_from(input_vertices);
 }
 
+// -----------------------------------------------------------------------------
+
+void Animesh::transform_frame(const Vec3_cu* vertices, Point_cu* out)
+{
+    const int nb_vert = d_input_vertices.size();
+
+    // Point_cu and Vec3_cu have the same layout
+    Cuda_utils::mem_cpy_htd((Vec3_cu*)d_input_vertices.ptr(), vertices, nb_vert);
+    transform_vertices();
+    Cuda_utils::mem_cpy_dth(out, d_output_vertices.ptr(), nb_vert);
+}
+
 void Animesh::copy_mesh_data(const Mesh& a_mesh)
 {
     const int nb_vert = a_mesh.get_nb_vertices();
@@ -181,80 +270,9 @@ void Animesh::copy_mesh_data(const Mesh& a_mesh)
 
 void Animesh::compute_mvc()
 {
-    //Device::Array<Vec3_cu> d_grad( d_input_vertices.size() );
-    Host::Array<float> edge_lengths(_mesh->get_nb_edges());
-    Host::Array<float> edge_mvc    (_mesh->get_nb_edges());
-    for(int i = 0; i < _mesh->get_nb_vertices(); i++)
-    {
-        Point_cu pos = _mesh->get_vertex(i).to_point();
-        Vec3_cu  nor = _mesh->get_mean_normal(i).to_point(); // FIXME : should be the gradient
-
-        Mat3_cu frame = Mat3_cu::coordinate_system( nor ).transpose();
-        float sum = 0.f;
-        bool  out = false;
-        // Look up neighborhood
-        int dep      = _mesh->get_edge_offset(i*2    );
-        int nb_neigh = _mesh->get_edge_offset(i*2 + 1);
-        int end      = (dep+nb_neigh);
-
-        if( nor.norm() < 0.00001f || _mesh->is_vert_on_side(i) ) {
-            for(int n = dep; n < end; n++) edge_mvc[n] = 0.f;
-        }
-        else
-        {
-            for(int n = dep; n < end; n++)
-            {
-                int id_curr = _mesh->get_edge( n );
-                int id_next = _mesh->get_edge( (n+1) >= end  ? dep   : n+1 );
-                int id_prev = _mesh->get_edge( (n-1) <  dep  ? end-1 : n-1 );
-
-                // compute edge length
-                Point_cu  curr = _mesh->get_vertex(id_curr).to_point();
-                Vec3_cu e_curr = (curr - pos);
-                edge_lengths[n] = e_curr.norm();
-
-                // compute mean value coordinates
-                // coordinates are computed by projecting the neighborhood to the
-                // tangent plane
-                {
-                    // Project on tangent plane
-                    Vec3_cu e_next = _mesh->get_vertex(id_next).to_point() - pos;
-                    Vec3_cu e_prev = _mesh->get_vertex(id_prev).to_point() - pos;
-
-                    e_curr = frame * e_curr;
-                    e_next = frame * e_next;
-                    e_prev = frame * e_prev;
-
-                    e_curr.x = 0.f;
-                    e_next.x = 0.f;
-                    e_prev.x = 0.f;
-
-                    float norm_curr_2D = e_curr.norm();
-
-                    e_curr.normalize();
-                    e_next.normalize();
-                    e_prev.normalize();
-
-                    // Computing mvc
-                    float anext = std::atan2( -e_prev.z * e_curr.y + e_prev.y * e_curr.z, e_prev.dot(e_curr) );
-                    float aprev = std::atan2( -e_curr.z * e_next.y + e_curr.y * e_next.z, e_curr.dot(e_next) );
-
-                    float mvc = 0.f;
-                    if(norm_curr_2D > 0.0001f)
-                        mvc = (std::tan(anext*0.5f) + std::tan(aprev*0.5f)) / norm_curr_2D;
-
-                    sum += mvc;
-                    edge_mvc[n] = mvc;
-                    out = out || mvc < 0.f;
-                }
-            }
-            // we ignore points outside the convex hull
-            if( sum  <= 0.f || out || isnan(sum) ) {
-                for(int n = dep; n < end; n++) edge_mvc[n] = 0.f;
-            }
-        }
-
-    }
+    std::vector<float> edge_lengths;
+    std::vector<float> edge_mvc;
+    Animesh_kers::compute_mvc(*_mesh, edge_lengths, edge_mvc);
     d_edge_lengths.copy_from( edge_lengths );
     d_edge_mvc.    copy_from( edge_mvc     );
 }
@@ -281,51 +299,3 @@ void Animesh::diffuse_attr(int nb_iter, float strength, float *attr)
                             strength,
                             nb_iter);
 }
-
-#include "cuda_utils_thrust.hpp"
-
-__global__ static
-void transform_vert_to_fit(const int* src, int* dst, const int nb_vert)
-{
-    const int p = blockIdx.x * blockDim.x + threadIdx.x;
-    if(p < nb_vert) dst[p] = src[p] < 0 ? 0 : 1;
-}
-
-/// here src must be different from dst
-__global__ static
-void pack(const int* prefix_sum, const int* src, int* dst, const int nb_vert)
-{
-    const int p = blockIdx.x * blockDim.x + threadIdx.x;
-    if(p < nb_vert){
-        const int elt = src[p];
-        if(elt >= 0) dst[ prefix_sum[p] ] = elt;
-    }
-}
-
-// The first element of buff must be 0.
-int Animesh::pack_vert_to_fit_gpu(
-        const Cuda_utils::Device::Array<int>& d_vert_to_fit,
-        Cuda_utils::Device::Array<int>& buff,
-        Cuda_utils::Device::Array<int>& packed_array,
-        int nb_vert_to_fit)
-{
-    if(nb_vert_to_fit == 0) return 0;
-    assert(d_vert_to_fit.size() >= nb_vert_to_fit           );
-    assert(buff.size()          >= d_vert_to_fit.size() + 1 );
-    assert(packed_array.size()  >= d_vert_to_fit.size()     );
-
-    // Set buff[n] to true if d_vert_to_fit[n] is valid, or false if it's -1.
-    const int block_s = 16;
-    const int grid_s  = (nb_vert_to_fit + block_s) / block_s;
-    transform_vert_to_fit<<<grid_s, block_s >>>(d_vert_to_fit.ptr(), buff.ptr()+1, nb_vert_to_fit);
-    CUDA_CHECK_ERRORS();
-
-    // Compute prefix sum in buff between [1 nb_vert_to_fit]
-    Cuda_utils::inclusive_scan(0, nb_vert_to_fit-1, buff.ptr()+1);
-
-    pack<<<grid_s, block_s >>>(buff.ptr(), d_vert_to_fit.ptr(), packed_array.ptr(), nb_vert_to_fit);
-    CUDA_CHECK_ERRORS();
-
-    // This causes a flush, so do this last.
-    return buff.fetch(nb_vert_to_fit);
-}
@@ -64,6 +64,13 @@ public:
     void set_smooth_force_a (float alpha ) { smooth_force_a = alpha;     }
     void set_smooth_force_b (float beta  ) { smooth_force_b = beta;      }
     void set_smoothing_type (EAnimesh::Smooth_type type ) { mesh_smoothing = type; }
+    void set_warm_start(bool state);
+    void set_warm_start_threshold(float threshold) { warm_start_threshold = threshold; }
+    void set_fitting_schedule(const Vert_active_set::Settings& s) { active_set.set_settings(s); }
+    void set_vert_mask(const std::vector<bool>& mask);
+
+protected:
+    void transform_frame(const Vec3_cu* vertices, Point_cu* out);
 
 private:
     // -------------------------------------------------------------------------
@@ -109,18 +116,6 @@ private:
     /// diffuse values over the mesh on GPU
     void diffuse_attr(int nb_iter, float strength, float* attr);
 
-    // Given an array [2,5,-1,-1,3,4] and nb_vert_to_fit == 6, set packed_vert_to_fit
-    // to a packed list removing negative indexes, resulting in [2,5,3,4].  Return the
-    // number of indexes in the result.
-    //
-    // buff_prefix_sum is a scratch buffer that must be at least one element larger
-    // than d_vert_to_fit.
-    int pack_vert_to_fit_gpu(
-            const Cuda_utils::Device::Array<int>& d_vert_to_fit,
-            Cuda_utils::Device::Array<int>& buff_prefix_sum,
-            Cuda_utils::Device::Array<int>& packed_vert_to_fit,
-            int nb_vert_to_fit);
-
     /// Copy the attributes of 'a_mesh' into the attributes of the animated
     /// mesh in device memory
     void copy_mesh_data(const Mesh& a_mesh);
@@ -137,11 +132,26 @@ private:
     void compute_mvc();
 
     /// Allocate and initialize 'd_vert_to_fit' and 'd_vert_to_fit_base'.
-    /// For instance lonely vertices are not fitted with the implicit skinning.
+    /// For instance lonely vertices or vertices outside 'vert_mask' are not
+    /// fitted with the implicit skinning.
     void init_vert_to_fit();
 
+    /// Move the vertices outside 'vert_mask' with their fitted neighbors
+    /// @see Animesh_kers::reconstruct_layer()
+    void reconstruct_unfitted(Vec3_cu* d_vertices);
+
     void init_smooth_factors(Cuda_utils::DA_float& d_smooth_factors);
 
+    /// Add to 'd_vertices' the offsets of the previous frame when warm start
+    /// is enabled @see set_warm_start()
+    void warm_start(Vec3_cu* d_vertices);
+
+    /// Save the offsets between the skinned and the fitted vertices for the
+    /// warm start of the next frame. Called right after the fitting passes,
+    /// before the final Laplacian smoothing, so that re-evaluating the same
+    /// pose doesn't smooth the mesh a bit more each time.
+    void save_warm_start(const Vec3_cu* d_vertices);
+
     // -------------------------------------------------------------------------
     /// @name Attributes
     // -------------------------------------------------------------------------
@@ -167,6 +177,9 @@ private:
     float smooth_force_a; ///< must be between [0 1]
     float smooth_force_b; ///< must be between [0 1] only for humphrey smoothing
 
+    bool do_warm_start;
+    float warm_start_threshold; ///< in bone lengths
+
     /// Smoothing weights associated to each vertex
     Cuda_utils::Device::Array<float> d_input_smooth_factors;
     /// Animated smoothing weights associated to each vertex
@@ -227,6 +240,26 @@ private:
     /// ?
     Cuda_utils::Device::Array<Mesh::PrimIdxVertices> d_piv;
 
+    // -------------------------------------------------------------------------
+    /// @name Warm start
+    /// @see Animesh_kers::compute_warm_start_transfos()
+    // -------------------------------------------------------------------------
+    /// @{
+    /// Bones used to warm start the vertices, set on the first warm started
+    /// frame
+    std::vector<Bone::Id> warm_bone_ids;
+    /// Pose of the bones at the previous frame, empty to cold start every
+    /// vertex
+    std::vector<Bone_cu> warm_prev_bones;
+    std::vector<Transfo> warm_prev_frames;
+    std::vector<Transfo> h_warm_transfos;
+    Cuda_utils::Device::Array<Transfo> d_warm_transfos;
+    /// Index in 'warm_bone_ids' of the closest bone to each vertex
+    Cuda_utils::Device::Array<int> d_vert_bone;
+    /// Fitted minus skinned position of each vertex at the previous frame
+    Cuda_utils::Device::Array<Vec3_cu> d_warm_offsets;
+    /// @}
+
     // -------------------------------------------------------------------------
     /// @name CLUSTER
     // -------------------------------------------------------------------------
@@ -247,11 +280,25 @@ private:
 
     Cuda_utils::Device::Array<int>      d_vert_to_fit;
     Cuda_utils::Device::Array<int>      d_vert_to_fit_base;
-    Cuda_utils::Device::Array<int>      d_vert_to_fit_buff_scan;
-    Cuda_utils::Device::Array<int>      d_vert_to_fit_buff;
 
+    Cuda_utils::Host::Array<int>        h_vert_to_fit_base;
     Cuda_utils::Host::Array<int>        h_vert_to_fit_buff;
     /// @}
+
+    /// Vertices still fitted by the interleaved fitting and smoothing
+    Vert_active_set active_set;
+
+    // -------------------------------------------------------------------------
+    /// @name Level of detail
+    /// @see set_vert_mask() Animesh_kers::compute_lod_layers()
+    // -------------------------------------------------------------------------
+    /// @{
+    /// Vertices to fit, empty to fit every vertex
+    std::vector<bool> vert_mask;
+    std::vector<int> lod_layer_offsets;
+    Cuda_utils::Device::Array<int> d_lod_layer_verts;
+    Cuda_utils::Device::Array<int> d_vert_level;
+    /// @}
 };
 // END ANIMATEDMESH CLASS ======================================================
 
@@ -4,6 +4,7 @@
 #include "animesh_enum.hpp"
 #include "skeleton.hpp"
 #include "mesh.hpp"
+#include "vert_active_set.hpp"
 
 #include <vector>
 
@@ -15,7 +16,11 @@
 struct Animesh;
 class AnimeshBase {
 public:
-    static AnimeshBase *create(const Mesh *mesh, std::shared_ptr<const Skeleton> skel);
+    /// @param backend : whether vertices are deformed with the cuda kernels or
+    /// with host threads (the latter does not need a GPU to fit the mesh).
+    static AnimeshBase *create(const Mesh *mesh,
+                               std::shared_ptr<const Skeleton> skel,
+                               EAnimesh::Backend backend = EAnimesh::GPU);
     virtual ~AnimeshBase() { }
 
     // Get the loaded skeleton.
@@ -49,6 +54,29 @@ public:
     // Copy the given vertices into the mesh.
     virtual void set_vertices(const std::vector<Vec3_cu> &vertices) = 0;
 
+    /// Input of one frame of transform_frames()
+    struct Frame {
+        Frame() : vertices(0) { }
+
+        /// World space matrices of the bones for this frame.  Bones which are
+        /// not listed keep their matrix from the previous frame.
+        std::vector<std::pair<std::shared_ptr<Bone>, Transfo> > bones;
+
+        /// Skinned vertices of the frame (get_nb_vertices() elements), as
+        /// given to set_vertices()
+        const Vec3_cu* vertices;
+    };
+
+    /// Deform the mesh for a sequence of frames.  This gives the same result
+    /// as calling set_vertices(), transform_vertices() and get_vertices() for
+    /// each frame, but the topology, base potential and buffers are reused and
+    /// vertices are copied straight from and to the given buffers.  Frames
+    /// are processed in order (warm start applies across frames).
+    /// The bones get back their current matrices when done.
+    /// @param out : frames.size() * get_nb_vertices() vertices, frame after
+    /// frame
+    void transform_frames(const std::vector<Frame>& frames, Point_cu* out);
+
     virtual inline void set_smooth_factor(int i, float val) = 0;
 
     virtual void set_nb_transform_steps(int nb_iter) = 0;
@@ -60,6 +88,34 @@ public:
     virtual void set_smooth_force_a (float alpha ) = 0;
     virtual void set_smooth_force_b (float beta  ) = 0;
     virtual void set_smoothing_type (EAnimesh::Smooth_type type ) = 0;
+
+    /// Start the fitting of each vertex from its offset to the iso-surface at
+    /// the previous call to transform_vertices() instead of the skinned
+    /// position. During playback vertices barely move between frames and
+    /// converge in a few steps. Vertices fall back to a cold start when their
+    /// bone moved more than set_warm_start_threshold() times its length.
+    /// The offset kept is the one of the last fitting pass (the final fitting
+    /// when enabled), before the Laplacian smoothing. With set_smooth_mesh()
+    /// the first pass interleaves the conservative smoothing, which is then
+    /// part of the offset carried over to the next frame.
+    virtual void set_warm_start(bool state) = 0;
+    virtual void set_warm_start_threshold(float threshold) = 0;
+
+    /// Convergence criteria of the interleaved fitting and smoothing
+    /// (set_smooth_mesh(true)), the iteration budget is set with
+    /// set_nb_transform_steps()
+    virtual void set_fitting_schedule(const Vert_active_set::Settings& s) = 0;
+
+    /// Only fit the vertices where 'mask' is true, the others follow the
+    /// correction of their fitted neighbors (weighted by their mean value
+    /// coordinates). An empty mask fits every vertex.
+    /// @see Mesh::compute_lod_mask() to fit a decimated subset of the mesh
+    virtual void set_vert_mask(const std::vector<bool>& mask) = 0;
+
+protected:
+    /// Load the skinned 'vertices', transform_vertices() and write the
+    /// result in 'out' (a frame of transform_frames())
+    virtual void transform_frame(const Vec3_cu* vertices, Point_cu* out) = 0;
 };
 
 #endif
@@ -49,6 +49,14 @@ enum Smooth_type {
     HUMPHREY       ///< Laplacian corrected with original points position
 };
 
+// -----------------------------------------------------------------------------
+
+/// Where the mesh deformation is computed @see AnimeshBase::create()
+enum Backend {
+    GPU,  ///< Cuda kernels, buffers lives in device memory (Animesh)
+    CPU   ///< Host threads, buffers lives in host memory (Animesh_host)
+};
+
 }
 // END EAnimesh NAMESPACE ======================================================
 
@@ -0,0 +1,407 @@
+#include "animesh_host.hpp"
+
+/**
+ * @file animesh_host.cu
+ * @brief implemention of the Animesh_host class (deformation on host)
+ *
+ */
+
+#include "animesh_kers.hpp"
+#include "cuda_ctrl.hpp"
+#include "skeleton_env.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// -----------------------------------------------------------------------------
+
+Animesh_host::Animesh_host(const Mesh *m_, std::shared_ptr<const Skeleton> s_) :
+    _mesh(m_), _skel(s_),
+    mesh_smoothing(EAnimesh::LAPLACIAN),
+    do_smooth_mesh(false),
+    do_local_smoothing(true),
+    nb_transform_steps(250),
+    final_fitting(true),
+    smoothing_iter(7),
+    diffuse_smooth_weights_iter(6),
+    smooth_force_a(0.5f),
+    smooth_force_b(0.5f),
+    do_warm_start(false),
+    warm_start_threshold(0.1f),
+    input_smooth_factors(_mesh->get_nb_vertices(), 0.f),
+    smooth_factors_conservative(_mesh->get_nb_vertices(), 0.f),
+    smooth_factors_laplacian(_mesh->get_nb_vertices()),
+    vertices_state(_mesh->get_nb_vertices(), EAnimesh::NOT_DISPLACED),
+    output_vertices(_mesh->get_nb_vertices()),
+    gradient(_mesh->get_nb_vertices()),
+    base_potential(_mesh->get_nb_vertices()),
+    vert_buffer(_mesh->get_nb_vertices()),
+    vals_buffer(_mesh->get_nb_vertices())
+{
+    copy_mesh_data(*_mesh);
+    init_vert_to_fit();
+    Animesh_kers::compute_mvc(*_mesh, edge_lengths, edge_mvc);
+
+    // Every evaluation is done on host: look the bones up with the BVH. This
+    // doesn't change the device grid used by other users of the skeleton.
+    Skeleton_env::set_acceleration(_skel->get_skel_id(), Skeleton_env::BVH);
+}
+
+// -----------------------------------------------------------------------------
+
+Animesh_host::~Animesh_host()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::copy_mesh_data(const Mesh& a_mesh)
+{
+    const int nb_vert = a_mesh.get_nb_vertices();
+
+    input_vertices.resize(nb_vert);
+    for(int i = 0; i < nb_vert; i++)
+        input_vertices[i] = a_mesh.get_vertex(i).to_point();
+
+    edge_list.resize(a_mesh.get_nb_edges());
+    for(int i = 0; i < a_mesh.get_nb_edges(); i++)
+        edge_list[i] = a_mesh.get_edge(i);
+
+    edge_list_offsets.resize(2*nb_vert);
+    for(int i = 0; i < nb_vert; i++){
+        edge_list_offsets[2*i  ] = a_mesh.get_edge_offset(2*i  );
+        edge_list_offsets[2*i+1] = a_mesh.get_edge_offset(2*i+1);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::init_vert_to_fit()
+{
+    const int nb_vert = _mesh->get_nb_vertices();
+    std::vector<bool> fitted(nb_vert, false);
+    vert_to_fit_base.clear();
+    vert_to_fit_base.reserve(nb_vert);
+    for(int i = 0; i < nb_vert; ++i)
+    {
+        if( !_mesh->is_disconnect(i) && (vert_mask.empty() || vert_mask[i]) ){
+            vert_to_fit_base.push_back( i );
+            fitted[i] = true;
+        }
+    }
+    vert_to_fit = vert_to_fit_base;
+
+    // Vertices left out by the mask follow their fitted neighbors
+    lod_layer_offsets.clear();
+    if( !vert_mask.empty() )
+        Animesh_kers::compute_lod_layers(*_mesh, fitted, vert_level, lod_layer_verts, lod_layer_offsets);
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::set_vert_mask(const std::vector<bool>& mask)
+{
+    assert(mask.empty() || (int)mask.size() == _mesh->get_nb_vertices());
+    vert_mask = mask;
+    init_vert_to_fit();
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::reconstruct_unfitted(Vec3_cu* vertices)
+{
+    const int nb_layers = (int)lod_layer_offsets.size() - 1;
+    if(nb_layers <= 0)
+        return;
+
+    Animesh_kers::reconstruct_host((const Vec3_cu*)input_vertices.data(),
+                                   vertices,
+                                   lod_layer_verts.data(),
+                                   lod_layer_offsets.data(),
+                                   nb_layers,
+                                   vert_level.data(),
+                                   edge_list.data(),
+                                   edge_list_offsets.data(),
+                                   edge_mvc.data());
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::calculate_base_potential(std::vector<float> &out) const
+{
+    Timer time;
+    time.start();
+    out.resize(input_vertices.size());
+    Animesh_kers::compute_base_potential_host(_skel->get_skel_id(),
+                                              input_vertices.data(),
+                                              (int)input_vertices.size(),
+                                              out.data());
+
+    std::cout << "Update base potential (host) in " << time.stop() << " sec" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::set_base_potential(const std::vector<float> &pot)
+{
+    assert(pot.size() == input_vertices.size());
+    base_potential = pot;
+    // Offsets were fitted to the old potential
+    warm_prev_bones.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::get_vertices(std::vector<Point_cu>& anim_vert) const
+{
+    anim_vert.insert(anim_vert.end(), output_vertices.begin(), output_vertices.end());
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::set_vertices(const std::vector<Vec3_cu> &vertices)
+{
+    assert(vertices.size() == input_vertices.size());
+    for(unsigned i = 0; i < vertices.size(); i++)
+        input_vertices[i] = vertices[i].to_point();
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::transform_frame(const Vec3_cu* vertices, Point_cu* out)
+{
+    const int nb_vert = get_nb_vertices();
+    for(int i = 0; i < nb_vert; i++)
+        input_vertices[i] = vertices[i].to_point();
+
+    transform_vertices();
+    std::copy(output_vertices.begin(), output_vertices.end(), out);
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::set_smoothing_type(EAnimesh::Smooth_type type)
+{
+    if(type == EAnimesh::TANGENTIAL || type == EAnimesh::HUMPHREY)
+    {
+        std::cerr << "WARNING: smoothing type not available on host, ";
+        std::cerr << "laplacian smoothing is used instead" << std::endl;
+        type = EAnimesh::LAPLACIAN;
+    }
+    mesh_smoothing = type;
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::smooth_mesh(Vec3_cu* vertices,
+                               const float* factors,
+                               int nb_iter,
+                               bool local_smoothing)
+{
+    if(nb_iter == 0) return;
+
+    switch(mesh_smoothing)
+    {
+    case EAnimesh::NONE:
+        break;
+    case EAnimesh::CONSERVATIVE:
+        Animesh_kers::conservative_smooth_host(vertices,
+                                               vert_buffer.data(),
+                                               gradient.data(),
+                                               edge_list.data(),
+                                               edge_list_offsets.data(),
+                                               edge_mvc.data(),
+                                               get_nb_vertices(),
+                                               vert_to_fit_base.data(),
+                                               (int)vert_to_fit_base.size(),
+                                               smooth_force_a,
+                                               nb_iter,
+                                               factors,
+                                               local_smoothing);
+        break;
+    default: // EAnimesh::LAPLACIAN @see set_smoothing_type()
+        Animesh_kers::laplacian_smooth_host(vertices,
+                                            vert_buffer.data(),
+                                            edge_list.data(),
+                                            edge_list_offsets.data(),
+                                            get_nb_vertices(),
+                                            factors,
+                                            local_smoothing,
+                                            smooth_force_a,
+                                            nb_iter,
+                                            3);
+        break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::conservative_smooth(Vec3_cu* vertices,
+                                       const int* to_fit,
+                                       int nb_vert_to_fit,
+                                       int nb_iter)
+{
+    Animesh_kers::conservative_smooth_host(vertices,
+                                           vert_buffer.data(),
+                                           gradient.data(),
+                                           edge_list.data(),
+                                           edge_list_offsets.data(),
+                                           edge_mvc.data(),
+                                           get_nb_vertices(),
+                                           to_fit,
+                                           nb_vert_to_fit,
+                                           smooth_force_a,
+                                           nb_iter,
+                                           smooth_factors_conservative.data(),
+                                           true);
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::fit_mesh(int nb_vert_to_fit,
+                            int* to_fit,
+                            bool smooth_fac_from_iso,
+                            Vec3_cu* vertices,
+                            int nb_steps,
+                            float smooth_strength)
+{
+    if(nb_vert_to_fit == 0) return;
+
+    Animesh_kers::match_base_potential_host(_skel->get_skel_id(),
+                                            smooth_fac_from_iso,
+                                            vertices,
+                                            base_potential.data(),
+                                            gradient.data(),
+                                            smooth_factors_conservative.data(),
+                                            smooth_factors_laplacian.data(),
+                                            to_fit,
+                                            nb_vert_to_fit,
+                                            (unsigned short)nb_steps,
+                                            Cuda_ctrl::_debug._collision_threshold,
+                                            Cuda_ctrl::_debug._step_length,
+                                            Cuda_ctrl::_debug._potential_pit,
+                                            vertices_state.data(),
+                                            smooth_strength,
+                                            Cuda_ctrl::_debug._slope_smooth_weight,
+                                            Cuda_ctrl::_debug._raphson);
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::set_warm_start(bool state)
+{
+    if(state != do_warm_start)
+        warm_prev_bones.clear();
+    do_warm_start = state;
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::warm_start(Vec3_cu* vertices)
+{
+    const int nb_vert = get_nb_vertices();
+    if((int)vert_bone.size() != nb_vert)
+    {
+        // Input vertices and bones are in the same pose
+        Animesh_kers::compute_vert_bones(*_skel, input_vertices.data(), nb_vert, warm_bone_ids, vert_bone);
+        warm_offsets.resize(nb_vert);
+        warm_prev_bones.clear();
+    }
+
+    const int nb_warm = Animesh_kers::compute_warm_start_transfos(*_skel,
+                                                                  warm_bone_ids,
+                                                                  warm_start_threshold,
+                                                                  warm_prev_bones,
+                                                                  warm_prev_frames,
+                                                                  warm_transfos);
+    if(nb_warm > 0)
+        Animesh_kers::warm_start_host(vertices, warm_offsets.data(), vert_bone.data(), warm_transfos.data(), nb_vert);
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::save_warm_start(const Vec3_cu* vertices)
+{
+    Animesh_kers::compute_offsets_host((const Vec3_cu*)input_vertices.data(), vertices,
+                                       warm_offsets.data(), get_nb_vertices());
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh_host::transform_vertices()
+{
+    // If the bone data needs to be updated, do it now.
+    this->_skel->update_bones_data();
+
+    const int nb_vert = get_nb_vertices();
+
+    // Same as the GPU version: Point_cu are processed as Vec3_cu
+    output_vertices = input_vertices;
+    Vec3_cu* out_verts = (Vec3_cu*)output_vertices.data();
+    if(do_warm_start)
+        warm_start(out_verts);
+
+    smooth_factors_laplacian = input_smooth_factors;
+    vert_to_fit = vert_to_fit_base;
+    int nb_vert_to_fit = (int)vert_to_fit.size();
+    const int nb_steps = nb_transform_steps;
+
+    if(do_smooth_mesh)
+    {
+        // Interleaved fitting
+        active_set.reset(vert_to_fit.data(), nb_vert_to_fit, nb_steps);
+        while( !active_set.done() )
+        {
+            nb_vert_to_fit = active_set.size();
+
+            // Fitted vertices are set to -1 in 'vert_to_fit'
+            fit_mesh(nb_vert_to_fit, vert_to_fit.data(), true/*smooth from iso*/, out_verts, 2, smooth_force_a);
+
+            conservative_smooth(out_verts, vert_to_fit.data(), nb_vert_to_fit, smoothing_iter);
+
+            if( active_set.next_iter() )
+            {
+                active_set.update(vert_to_fit.data(), out_verts);
+                std::copy(active_set.verts(), active_set.verts() + active_set.size(), vert_to_fit.begin());
+            }
+        }
+    }
+    else
+    {
+        // First fitting
+        if(nb_vert_to_fit > 0)
+            fit_mesh(nb_vert_to_fit, vert_to_fit.data(), false/*smooth from iso*/, out_verts, nb_steps, Cuda_ctrl::_debug._smooth1_force);
+    }
+
+    reconstruct_unfitted(out_verts);
+
+    // Fitted offsets, before the Laplacian smoothing (see Animesh)
+    if(do_warm_start)
+        save_warm_start(out_verts);
+
+    // Smooth the initial guess
+    Animesh_kers::diffuse_values_host(smooth_factors_laplacian.data(), vals_buffer.data(),
+                                      edge_list.data(), edge_list_offsets.data(),
+                                      nb_vert, 1.f, diffuse_smooth_weights_iter);
+    smooth_mesh(out_verts, smooth_factors_laplacian.data(), Cuda_ctrl::_debug._smooth1_iter);
+
+    // Final fitting (global evaluation of the skeleton)
+    if(final_fitting)
+    {
+        vert_to_fit = vert_to_fit_base;
+        fit_mesh((int)vert_to_fit.size(), vert_to_fit.data(), false/*smooth from iso*/, out_verts, nb_steps, Cuda_ctrl::_debug._smooth2_force);
+        reconstruct_unfitted(out_verts);
+
+        if(do_warm_start)
+            save_warm_start(out_verts);
+    }
+
+    // Final smoothing
+    Animesh_kers::diffuse_values_host(smooth_factors_laplacian.data(), vals_buffer.data(),
+                                      edge_list.data(), edge_list_offsets.data(),
+                                      nb_vert, 1.f, diffuse_smooth_weights_iter);
+    smooth_mesh(out_verts, smooth_factors_laplacian.data(), 2 /*Cuda_ctrl::_debug._smooth2_iter*/);
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,171 @@
+#ifndef ANIMESH_HOST_HPP__
+#define ANIMESH_HOST_HPP__
+
+#include "animesh_enum.hpp"
+#include "animesh_base.hpp"
+#include "mesh.hpp"
+#include "skeleton.hpp"
+
+#include <vector>
+
+/** @class Animesh_host
+    @brief Host implementation of the implicit skinning deformation
+
+    Same pipeline as Animesh::transform_vertices() (fitting with
+    match_base_potential, binary search, conservative and laplacian smoothing)
+    but every buffer lives in host memory and vertices are processed by the
+    threads of Thread_pool::get(). The skeleton is evaluated with the host
+    version of Skeleton_env::compute_potential().
+
+    @note Tangential and Humphrey smoothing are not available, laplacian
+    smoothing is used instead.
+    @see AnimeshBase::create() Animesh_kers
+*/
+struct Animesh_host: public AnimeshBase {
+public:
+    // The Mesh must exist for the lifetime of this object.
+    Animesh_host(const Mesh *m_, std::shared_ptr<const Skeleton> s_);
+    ~Animesh_host();
+
+    const Skeleton *get_skel() const { return _skel.get(); }
+
+    const Mesh*     get_mesh() const { return _mesh; }
+
+    void calculate_base_potential(std::vector<float> &out) const;
+
+    void get_base_potential(std::vector<float> &pot) const { pot = base_potential; }
+    void set_base_potential(const std::vector<float> &pot);
+
+    void transform_vertices();
+
+    // -------------------------------------------------------------------------
+    /// @name Getter & Setters
+    // -------------------------------------------------------------------------
+
+    int get_nb_vertices() const { return (int)input_vertices.size(); }
+
+    void get_vertices(std::vector<Point_cu>& anim_vert) const;
+
+    void set_vertices(const std::vector<Vec3_cu> &vertices);
+
+    inline void set_smooth_factor(int i, float val) { input_smooth_factors[i] = val; }
+
+    void set_nb_transform_steps(int nb_iter) { nb_transform_steps = nb_iter; }
+    void set_final_fitting(bool value) { final_fitting = value; }
+    void set_smoothing_weights_diffusion_iter(int nb_iter) { diffuse_smooth_weights_iter = nb_iter; }
+    void set_smoothing_iter (int nb_iter ) { smoothing_iter = nb_iter;   }
+    void set_smooth_mesh    (bool state  ) { do_smooth_mesh = state;     }
+    void set_local_smoothing(bool state  ) { do_local_smoothing = state; }
+    void set_smooth_force_a (float alpha ) { smooth_force_a = alpha;     }
+    void set_smooth_force_b (float beta  ) { smooth_force_b = beta;      }
+    void set_smoothing_type (EAnimesh::Smooth_type type );
+    void set_warm_start(bool state);
+    void set_warm_start_threshold(float threshold) { warm_start_threshold = threshold; }
+    void set_fitting_schedule(const Vert_active_set::Settings& s) { active_set.set_settings(s); }
+    void set_vert_mask(const std::vector<bool>& mask);
+
+protected:
+    void transform_frame(const Vec3_cu* vertices, Point_cu* out);
+
+private:
+    // -------------------------------------------------------------------------
+    /// @name Tools
+    // -------------------------------------------------------------------------
+
+    /// @see Animesh::smooth_mesh()
+    void smooth_mesh(Vec3_cu* vertices,
+                     const float* factors,
+                     int nb_iter,
+                     bool local_smoothing = true);
+
+    /// @see Animesh::conservative_smooth()
+    void conservative_smooth(Vec3_cu* vertices,
+                             const int* to_fit,
+                             int nb_vert_to_fit,
+                             int nb_iter);
+
+    /// @see Animesh::fit_mesh()
+    void fit_mesh(int nb_vert_to_fit,
+                  int* to_fit,
+                  bool smooth_fac_from_iso,
+                  Vec3_cu* vertices,
+                  int nb_steps,
+                  float smooth_strength);
+
+    /// Copy the attributes of 'a_mesh' in host buffers
+    void copy_mesh_data(const Mesh& a_mesh);
+
+    /// Initialize 'vert_to_fit_base' (lonely vertices and vertices outside
+    /// 'vert_mask' are not fitted)
+    void init_vert_to_fit();
+
+    /// @see Animesh::reconstruct_unfitted()
+    void reconstruct_unfitted(Vec3_cu* vertices);
+
+    /// @see Animesh::warm_start()
+    void warm_start(Vec3_cu* vertices);
+
+    /// @see Animesh::save_warm_start()
+    void save_warm_start(const Vec3_cu* vertices);
+
+    // -------------------------------------------------------------------------
+    /// @name Attributes
+    // -------------------------------------------------------------------------
+
+    const Mesh *_mesh;
+    std::shared_ptr<const Skeleton> _skel;
+
+    EAnimesh::Smooth_type mesh_smoothing;
+
+    bool do_smooth_mesh;
+    bool do_local_smoothing;
+    int nb_transform_steps;
+    bool final_fitting;
+
+    int smoothing_iter;
+    int diffuse_smooth_weights_iter;
+    float smooth_force_a; ///< must be between [0 1]
+    float smooth_force_b; ///< must be between [0 1] only for humphrey smoothing
+
+    bool do_warm_start;
+    float warm_start_threshold; ///< in bone lengths
+
+    /// @name Same as their device counterparts in Animesh
+    /// @{
+    std::vector<float>    input_smooth_factors;
+    std::vector<float>    smooth_factors_conservative;
+    std::vector<float>    smooth_factors_laplacian;
+    std::vector<Point_cu> input_vertices;
+    std::vector<float>    edge_lengths;
+    std::vector<float>    edge_mvc;
+    std::vector<EAnimesh::Vert_state> vertices_state;
+    std::vector<Point_cu> output_vertices;
+    std::vector<Vec3_cu>  gradient;
+    std::vector<int>      edge_list;
+    std::vector<int>      edge_list_offsets;
+    std::vector<float>    base_potential;
+    std::vector<Bone::Id> warm_bone_ids;
+    std::vector<Bone_cu>  warm_prev_bones;
+    std::vector<Transfo>  warm_prev_frames;
+    std::vector<Transfo>  warm_transfos;
+    std::vector<int>      vert_bone;
+    std::vector<Vec3_cu>  warm_offsets;
+    std::vector<bool>     vert_mask;
+    std::vector<int>      lod_layer_verts;
+    std::vector<int>      lod_layer_offsets;
+    std::vector<int>      vert_level;
+    /// @}
+
+    /// @name Pre allocated buffers
+    /// @{
+    std::vector<Vec3_cu> vert_buffer;
+    std::vector<float>   vals_buffer;
+    std::vector<int>     vert_to_fit;
+    std::vector<int>     vert_to_fit_base;
+    /// @}
+
+    /// @see Animesh::active_set
+    Vert_active_set active_set;
+};
+
+#endif // ANIMESH_HOST_HPP__
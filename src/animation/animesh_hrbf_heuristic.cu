@@ -4,9 +4,12 @@
 #include "utils_sampling.hpp"
 #include "skeleton.hpp"
 #include "hrbf_env.hpp"
+#include "bbox.hpp"
+#include "thread_pool.hpp"
 
 #include <iostream>
-#include <limits>
+#include <algorithm>
+#include <stdint.h>
 #include <cuda.h>
 
 using namespace Cuda_utils;
@@ -104,6 +107,90 @@ void HRBF_sampling::clamp_samples(std::vector<int>& vert_ids_,
 
 // -----------------------------------------------------------------------------
 
+namespace {
+
+/// @brief Vertices hashed in a regular grid to look up their neighbours
+/// Cells are at least 'cell_size' wide, so every vertex closer than
+/// 'cell_size' to a point lies in one of the 27 cells around it.
+class Vert_grid {
+public:
+    Vert_grid(const std::vector<Vec3_cu>& verts, float cell_size) :
+        _verts(verts)
+    {
+        BBox_cu bbox;
+        for(const Vec3_cu& v: verts)
+            bbox.add_point(v.to_point());
+
+        // 2^20 cells per axis at most, so cell keys fit in 64 bits
+        const Vec3_cu lengths = bbox.lengths();
+        const float max_length = std::max(lengths.x, std::max(lengths.y, lengths.z));
+        _cell_size = std::max(cell_size, max_length / (float)((1 << 20) - 1));
+        if( !(_cell_size > 0.f) )
+            _cell_size = 1.f;
+
+        _org = bbox.pmin.to_vector();
+        for(int i = 0; i < 3; i++)
+            _res[i] = (int)(lengths[i] / _cell_size) + 1;
+
+        // Vertices sorted by cell then index
+        _cells.resize( verts.size() );
+        for(int i = 0; i < (int)verts.size(); i++)
+        {
+            int c[3];
+            cell_of(verts[i], c);
+            _cells[i] = std::make_pair(key(c[0], c[1], c[2]), i);
+        }
+        std::sort(_cells.begin(), _cells.end());
+    }
+
+    /// @return if a vertex of index greater than 'id' lies at a distance lower
+    /// or equal to 'dist' from verts[id] ('dist' must not exceed the cell size)
+    bool has_close_successor(int id, float dist) const
+    {
+        const Vec3_cu& p = _verts[id];
+        int c[3];
+        cell_of(p, c);
+        for(int z = c[2]-1; z <= c[2]+1; z++)
+        for(int y = c[1]-1; y <= c[1]+1; y++)
+        for(int x = c[0]-1; x <= c[0]+1; x++)
+        {
+            if( x < 0 || y < 0 || z < 0 || x >= _res[0] || y >= _res[1] || z >= _res[2] )
+                continue;
+
+            const int64_t k = key(x, y, z);
+            std::vector<std::pair<int64_t, int> >::const_iterator it;
+            it = std::upper_bound(_cells.begin(), _cells.end(), std::make_pair(k, id));
+            for(; it != _cells.end() && it->first == k; ++it)
+                if( (p - _verts[it->second]).norm() <= dist )
+                    return true;
+        }
+        return false;
+    }
+
+private:
+    void cell_of(const Vec3_cu& p, int c[3]) const
+    {
+        const Vec3_cu lcl = p - _org;
+        for(int i = 0; i < 3; i++)
+            c[i] = std::min(std::max((int)floorf(lcl[i] / _cell_size), 0), _res[i] - 1);
+    }
+
+    static int64_t key(int x, int y, int z) {
+        return (int64_t)x | ((int64_t)y << 20) | ((int64_t)z << 40);
+    }
+
+    const std::vector<Vec3_cu>& _verts;
+    Vec3_cu _org;
+    float   _cell_size;
+    int     _res[3];
+    /// (cell key, vertex index) sorted
+    std::vector<std::pair<int64_t, int> > _cells;
+};
+
+}// END NAMESPACE ==============================================================
+
+// -----------------------------------------------------------------------------
+
 void Adhoc_sampling::sample(std::vector<Vec3_cu>& out_verts,
                         std::vector<Vec3_cu>& out_normals) const
 {
@@ -112,41 +199,41 @@ void Adhoc_sampling::sample(std::vector<Vec3_cu>& out_verts,
     std::vector<Vec3_cu> in_normals;
     factor_samples(in_vert_ids, in_verts, in_normals);
 
-    std::vector<bool> done;
-    done.resize(in_verts.size(), false);
+    const int nb_verts = (int)in_verts.size();
+    if( nb_verts == 0 ) return;
 
     const Bone* b = skel->get_bone(_bone_id).get();
     float length = b->length();
     float jlength = length * _jmax;
     float plength = length * _pmax;
 
-    for(unsigned id = 0; id < in_verts.size(); id++)
+    // A vertex is rejected when one of the vertices after it is too close
+    const Vert_grid grid(in_verts, _mind);
+    std::vector<char> accepted(nb_verts, 0);
+    Thread_pool::get().parallel_for(nb_verts, 256, [&](int begin, int end)
     {
-        Point_cu vert = in_verts[id].to_point();
-        float dist_proj = b->dist_proj_to(vert);
-
-        Vec3_cu dir_proj = vert - (b->org() + b->dir().normalized() * dist_proj);
-
-        Vec3_cu normal = in_normals[id];
-        if(dist_proj >= -jlength && dist_proj < (length + plength) &&
-                dir_proj.dot(normal) >= _fold )
+        for(int id = begin; id < end; id++)
         {
-            // Check for to close samples
-            float dist = std::numeric_limits<float>::infinity();
-            for(unsigned j = 0; j < in_verts.size(); j++)
-            {
-                float norm = (vert.to_vector() - in_verts[j]).norm();
-                if( (unsigned)id != j && !done[j] && norm < dist)
-                    dist = norm;
-            }
+            Point_cu vert = in_verts[id].to_point();
+            float dist_proj = b->dist_proj_to(vert);
 
-            if(dist > _mind)
+            Vec3_cu dir_proj = vert - (b->org() + b->dir().normalized() * dist_proj);
+
+            Vec3_cu normal = in_normals[id];
+            if(dist_proj >= -jlength && dist_proj < (length + plength) &&
+                    dir_proj.dot(normal) >= _fold )
             {
-                out_verts.  push_back( in_verts[id] );
-                out_normals.push_back( normal       );
+                // Check for to close samples
+                accepted[id] = !grid.has_close_successor(id, _mind);
             }
         }
-        done[id] = true;
+    });
+
+    for(int id = 0; id < nb_verts; id++)
+    {
+        if( !accepted[id] ) continue;
+        out_verts.  push_back( in_verts  [id] );
+        out_normals.push_back( in_normals[id] );
     }
 }
 
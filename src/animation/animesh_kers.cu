@@ -7,8 +7,13 @@
 #include "cuda_utils.hpp"
 #include "ray_cu.hpp"
 #include "bone.hpp"
+#include "thread_pool.hpp"
+#include "hrbf_env.hpp"
 
 #include <math_constants.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
 
 // Max number of binary search steps
 #define BINARY_SEARCH_STEPS (20)
@@ -188,6 +193,64 @@ compute_tangent_tri(const Mesh::PrimIdx& pi,
 
 // -----------------------------------------------------------------------------
 
+/// Conservative smoothing of the vertex vert_to_fit[thread_idx]
+/// (shared by the kernel and the host version)
+IF_CUDA_DEVICE_HOST static inline
+void conservative_smooth_vert(int thread_idx,
+                              const Vec3_cu* in_vertices,
+                              Vec3_cu* out_verts,
+                              const Vec3_cu* normals,
+                              const int* edge_list,
+                              const int* edge_list_offsets,
+                              const float* edge_mvc,
+                              const int* vert_to_fit,
+                              float force,
+                              const float* smooth_fac,
+                              bool use_smooth_fac)
+{
+    const int p = vert_to_fit[thread_idx];
+    if(p == -1)
+        return;
+
+    const Vec3_cu n       = normals[p].normalized();
+    const Vec3_cu in_vert = in_vertices[p];
+
+    if(n.norm() < 0.00001f){
+        out_verts[p] = in_vert;
+        return;
+    }
+
+    Vec3_cu cog(0.f, 0.f, 0.f);
+
+    const int offset = edge_list_offsets[2*p  ];
+    const int nb_ngb = edge_list_offsets[2*p+1];
+
+    float sum = 0.f;
+    for(int i = offset; i < offset + nb_ngb; i++){
+        const int j = edge_list[i];
+        const float mvc = edge_mvc[i];
+        sum += mvc;
+        cog =  cog + in_vertices[j] * mvc;
+    }
+
+    if( fabs(sum) < 0.00001f ){
+        out_verts[p] = in_vert;
+        return;
+    }
+
+    cog = cog * (1.f/sum);
+
+    // this force the smoothing to be only tangential :
+    const Vec3_cu cog_proj = n.proj_on_plane(in_vert.to_point(), cog.to_point());
+    // this is more like a conservative laplacian smoothing
+    //const Vec3_cu cog_proj = cog;
+
+    const float u = use_smooth_fac ? smooth_fac[p] : force;
+    out_verts[p]  = cog_proj * u + in_vert * (1.f - u);
+}
+
+// -----------------------------------------------------------------------------
+
 __global__
 void conservative_smooth_kernel(const Vec3_cu* in_vertices,
                                 Vec3_cu* out_verts,
@@ -204,45 +267,17 @@ void conservative_smooth_kernel(const Vec3_cu* in_vertices,
     int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
     if(thread_idx < nb_verts)
     {
-        const int p = vert_to_fit[thread_idx];
-        if(p == -1)
-            return;
-
-        const Vec3_cu n       = normals[p].normalized();
-        const Vec3_cu in_vert = in_vertices[p];
-
-        if(n.norm() < 0.00001f){
-            out_verts[p] = in_vert;
-            return;
-        }
-
-        Vec3_cu cog(0.f, 0.f, 0.f);
-
-        const int offset = edge_list_offsets[2*p  ];
-        const int nb_ngb = edge_list_offsets[2*p+1];
-
-        float sum = 0.f;
-        for(int i = offset; i < offset + nb_ngb; i++){
-            const int j = edge_list[i];
-            const float mvc = edge_mvc[i];
-            sum += mvc;
-            cog =  cog + in_vertices[j] * mvc;
-        }
-
-        if( fabs(sum) < 0.00001f ){
-            out_verts[p] = in_vert;
-            return;
-        }
-
-        cog = cog * (1.f/sum);
-
-        // this force the smoothing to be only tangential :
-        const Vec3_cu cog_proj = n.proj_on_plane(in_vert.to_point(), cog.to_point());
-        // this is more like a conservative laplacian smoothing
-        //const Vec3_cu cog_proj = cog;
-
-        const float u = use_smooth_fac ? smooth_fac[p] : force;
-        out_verts[p]  = cog_proj * u + in_vert * (1.f - u);
+        conservative_smooth_vert(thread_idx,
+                                 in_vertices,
+                                 out_verts,
+                                 normals,
+                                 edge_list,
+                                 edge_list_offsets,
+                                 edge_mvc,
+                                 vert_to_fit,
+                                 force,
+                                 smooth_fac,
+                                 use_smooth_fac);
     }
 }
 
@@ -327,6 +362,98 @@ void conservative_smooth(Vec3_cu* d_verts,
 
 // -----------------------------------------------------------------------------
 
+void conservative_smooth_host(Vec3_cu* verts,
+                              Vec3_cu* buff_verts,
+                              const Vec3_cu* normals,
+                              const int* edge_list,
+                              const int* edge_list_offsets,
+                              const float* edge_mvc,
+                              int nb_verts,
+                              const int* vert_to_fit,
+                              int nb_vert_to_fit,
+                              float strength,
+                              int nb_iter,
+                              const float* smooth_fac,
+                              bool use_smooth_fac)
+{
+    if(nb_vert_to_fit == 0) return;
+
+    Vec3_cu* verts_a = verts;
+    Vec3_cu* verts_b = buff_verts;
+
+    // Same double buffering as the GPU version
+    if(nb_iter > 1)
+        std::copy(verts, verts + nb_verts, buff_verts);
+
+    for(int i = 0; i < nb_iter; i++)
+    {
+        Thread_pool::get().parallel_for(nb_vert_to_fit, 1024, [&](int begin, int end){
+            for(int t = begin; t < end; t++)
+                conservative_smooth_vert(t,
+                                         verts_a,
+                                         verts_b,
+                                         normals,
+                                         edge_list,
+                                         edge_list_offsets,
+                                         edge_mvc,
+                                         vert_to_fit,
+                                         strength,
+                                         smooth_fac,
+                                         use_smooth_fac);
+        });
+
+        std::swap(verts_a, verts_b);
+    }
+
+    if(nb_iter % 2 == 1){
+        for(int t = 0; t < nb_vert_to_fit; t++){
+            const int p = vert_to_fit[t];
+            if(p != -1) verts[p] = buff_verts[p];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// Laplacian smoothing of the vertex p
+/// (shared by the kernel and the host version)
+IF_CUDA_DEVICE_HOST static inline
+void laplacian_smooth_vert(int p,
+                           const Vec3_cu* in_vertices,
+                           Vec3_cu* output_vertices,
+                           const int* edge_list,
+                           const int* edge_list_offsets,
+                           const float* factors,
+                           bool use_smooth_factors,
+                           float strength,
+                           int nb_min_neighbours)
+{
+    Vec3_cu in_vertex = in_vertices[p];
+    Vec3_cu centroid  = Vec3_cu(0.f, 0.f, 0.f);
+    float   factor    = factors[p];
+
+    int offset = edge_list_offsets[2*p  ];
+    int nb_ngb = edge_list_offsets[2*p+1];
+    if(nb_ngb > nb_min_neighbours)
+    {
+        for(int i = offset; i < offset + nb_ngb; i++){
+            int j = edge_list[i];
+            centroid += in_vertices[j];
+        }
+
+        centroid = centroid * (1.f/nb_ngb);
+
+        if(use_smooth_factors)
+            output_vertices[p] = centroid * factor + in_vertex * (1.f-factor);
+        else
+            output_vertices[p] = centroid * strength + in_vertex * (1.f-strength);
+    }
+    else
+        output_vertices[p] = in_vertex;
+}
+
+// -----------------------------------------------------------------------------
+
 __global__
 void laplacian_smooth_kernel(const Vec3_cu* in_vertices,
                              Vec3_cu* output_vertices,
@@ -341,28 +468,15 @@ void laplacian_smooth_kernel(const Vec3_cu* in_vertices,
         int p = blockIdx.x * blockDim.x + threadIdx.x;
         if(p < n)
         {
-            Vec3_cu in_vertex = in_vertices[p];
-            Vec3_cu centroid  = Vec3_cu(0.f, 0.f, 0.f);
-            float   factor    = factors[p];
-
-            int offset = edge_list_offsets[2*p  ];
-            int nb_ngb = edge_list_offsets[2*p+1];
-            if(nb_ngb > nb_min_neighbours)
-            {
-                for(int i = offset; i < offset + nb_ngb; i++){
-                    int j = edge_list[i];
-                    centroid += in_vertices[j];
-                }
-
-                centroid = centroid * (1.f/nb_ngb);
-
-                if(use_smooth_factors)
-                    output_vertices[p] = centroid * factor + in_vertex * (1.f-factor);
-                else
-                    output_vertices[p] = centroid * strength + in_vertex * (1.f-strength);
-            }
-            else
-                output_vertices[p] = in_vertex;
+            laplacian_smooth_vert(p,
+                                  in_vertices,
+                                  output_vertices,
+                                  edge_list,
+                                  edge_list_offsets,
+                                  factors,
+                                  use_smooth_factors,
+                                  strength,
+                                  nb_min_neighbours);
         }
 
 }
@@ -409,6 +523,42 @@ void laplacian_smooth(Vec3_cu* d_vertices,
 
 // -----------------------------------------------------------------------------
 
+void laplacian_smooth_host(Vec3_cu* vertices,
+                           Vec3_cu* tmp_vertices,
+                           const int* edge_list,
+                           const int* edge_list_offsets,
+                           int nb_verts,
+                           const float* factors,
+                           bool use_smooth_factors,
+                           float strength,
+                           int nb_iter,
+                           int nb_min_neighbours)
+{
+    Vec3_cu* vertices_a = vertices;
+    Vec3_cu* vertices_b = tmp_vertices;
+    for(int i = 0; i < nb_iter; i++)
+    {
+        Thread_pool::get().parallel_for(nb_verts, 1024, [&](int begin, int end){
+            for(int p = begin; p < end; p++)
+                laplacian_smooth_vert(p,
+                                      vertices_a,
+                                      vertices_b,
+                                      edge_list,
+                                      edge_list_offsets,
+                                      factors,
+                                      use_smooth_factors,
+                                      strength,
+                                      nb_min_neighbours);
+        });
+        std::swap(vertices_a, vertices_b);
+    }
+
+    if(nb_iter % 2 == 1)
+        std::copy(tmp_vertices, tmp_vertices + nb_verts, vertices);
+}
+
+// -----------------------------------------------------------------------------
+
 __global__
 void tangential_smooth_kernel_first_pass(const Vec3_cu* in_vertices,
                                          const Vec3_cu* in_normals,
@@ -618,6 +768,35 @@ void hc_laplacian_smooth(const DA_Vec3_cu& d_original_vertices,
 
 // -----------------------------------------------------------------------------
 
+/// Diffusion of the value at vertex p
+/// (shared by the kernel and the host version)
+IF_CUDA_DEVICE_HOST static inline
+void diffusion_vert(int p,
+                    const float* in_values,
+                    float* out_values,
+                    const int* edge_list,
+                    const int* edge_list_offsets,
+                    float strength)
+{
+    const float in_val   = in_values[p];
+    float centroid = 0.f;
+
+    const int offset = edge_list_offsets[2*p  ];
+    const int nb_ngb = edge_list_offsets[2*p+1];
+
+    for(int i = offset; i < (offset + nb_ngb); i++)
+    {
+        const int j = edge_list[i];
+        centroid += in_values[j];
+    }
+
+    centroid = centroid * (1.f/nb_ngb);
+
+    out_values[p] = centroid * strength + in_val * (1.f-strength);
+}
+
+// -----------------------------------------------------------------------------
+
 __global__
 void diffusion_kernel(const float* in_values,
                       float* out_values,
@@ -628,23 +807,7 @@ void diffusion_kernel(const float* in_values,
 {
     int p = blockIdx.x * blockDim.x + threadIdx.x;
     if(p < nb_vert)
-    {
-        const float in_val   = in_values[p];
-        float centroid = 0.f;
-
-        const int offset = edge_list_offsets[2*p  ];
-        const int nb_ngb = edge_list_offsets[2*p+1];
-
-        for(int i = offset; i < (offset + nb_ngb); i++)
-        {
-            const int j = edge_list[i];
-            centroid += in_values[j];
-        }
-
-        centroid = centroid * (1.f/nb_ngb);
-
-        out_values[p] = centroid * strength + in_val * (1.f-strength);
-    }
+        diffusion_vert(p, in_values, out_values, edge_list, edge_list_offsets, strength);
 }
 
 // -----------------------------------------------------------------------------
@@ -681,6 +844,326 @@ void diffuse_values(float* d_values,
 
 // -----------------------------------------------------------------------------
 
+void diffuse_values_host(float* values,
+                         float* values_buffer,
+                         const int* edge_list,
+                         const int* edge_list_offsets,
+                         int nb_verts,
+                         float strength,
+                         int nb_iter)
+{
+    float* values_a = values;
+    float* values_b = values_buffer;
+    strength = std::max( 0.f, std::min(1.f, strength));
+    for(int i = 0; i < nb_iter; i++)
+    {
+        Thread_pool::get().parallel_for(nb_verts, 1024, [&](int begin, int end){
+            for(int p = begin; p < end; p++)
+                diffusion_vert(p, values_a, values_b, edge_list, edge_list_offsets, strength);
+        });
+        std::swap(values_a, values_b);
+    }
+
+    if(nb_iter % 2 == 1)
+        std::copy(values_buffer, values_buffer + nb_verts, values);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Reconstruction of the vertex layer_verts[thread_idx] from its neighbors
+/// of lower levels (shared by the kernel and the host version)
+IF_CUDA_DEVICE_HOST static inline
+void reconstruct_vert(int thread_idx,
+                      const Vec3_cu* in_vertices,
+                      Vec3_cu* vertices,
+                      const int* layer_verts,
+                      const int* vert_level,
+                      const int* edge_list,
+                      const int* edge_list_offsets,
+                      const float* edge_mvc)
+{
+    const int p     = layer_verts[thread_idx];
+    const int level = vert_level[p];
+
+    const int offset = edge_list_offsets[2*p  ];
+    const int nb_ngb = edge_list_offsets[2*p+1];
+
+    // Negative mvc are discarded: only part of the ring is used, the
+    // remaining weights are not guaranteed to sum up to something sensible
+    Vec3_cu disp(0.f, 0.f, 0.f);
+    Vec3_cu disp_mean(0.f, 0.f, 0.f);
+    float sum = 0.f;
+    int nb = 0;
+    for(int i = offset; i < offset + nb_ngb; i++)
+    {
+        const int j = edge_list[i];
+        const int l = vert_level[j];
+        if(l < 0 || l >= level)
+            continue;
+
+        const Vec3_cu d = vertices[j] - in_vertices[j];
+        const float w = fmaxf(edge_mvc[i], 0.f);
+        disp      = disp + d * w;
+        disp_mean = disp_mean + d;
+        sum += w;
+        nb++;
+    }
+
+    if(nb == 0)
+        return;
+
+    if(sum > 0.00001f)
+        vertices[p] = in_vertices[p] + disp * (1.f/sum);
+    else
+        vertices[p] = in_vertices[p] + disp_mean * (1.f/nb);
+}
+
+// -----------------------------------------------------------------------------
+
+__global__
+void reconstruct_layer(const Vec3_cu* in_vertices,
+                       Vec3_cu* vertices,
+                       const int* layer_verts,
+                       const int* vert_level,
+                       const int* edge_list,
+                       const int* edge_list_offsets,
+                       const float* edge_mvc,
+                       int n)
+{
+    int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(thread_idx < n)
+        reconstruct_vert(thread_idx, in_vertices, vertices, layer_verts, vert_level,
+                         edge_list, edge_list_offsets, edge_mvc);
+}
+
+// -----------------------------------------------------------------------------
+
+void reconstruct_host(const Vec3_cu* in_vertices,
+                      Vec3_cu* vertices,
+                      const int* layer_verts,
+                      const int* layer_offsets,
+                      int nb_layers,
+                      const int* vert_level,
+                      const int* edge_list,
+                      const int* edge_list_offsets,
+                      const float* edge_mvc)
+{
+    for(int l = 0; l < nb_layers; l++)
+    {
+        const int* verts = layer_verts + layer_offsets[l];
+        const int n = layer_offsets[l+1] - layer_offsets[l];
+        Thread_pool::get().parallel_for(n, 1024, [&](int begin, int end){
+            for(int thread_idx = begin; thread_idx < end; thread_idx++)
+                reconstruct_vert(thread_idx, in_vertices, vertices, verts, vert_level,
+                                 edge_list, edge_list_offsets, edge_mvc);
+        });
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_lod_layers(const Mesh& mesh,
+                        const std::vector<bool>& fitted,
+                        std::vector<int>& vert_level,
+                        std::vector<int>& layer_verts,
+                        std::vector<int>& layer_offsets)
+{
+    const int nb_verts = mesh.get_nb_vertices();
+    vert_level.assign(nb_verts, -1);
+    layer_verts.clear();
+    layer_offsets.assign(1, 0);
+
+    std::vector<int> front, next;
+    for(int i = 0; i < nb_verts; i++)
+    {
+        if(fitted[i]){
+            vert_level[i] = 0;
+            front.push_back(i);
+        }
+    }
+
+    for(int level = 1; !front.empty(); level++)
+    {
+        next.clear();
+        for(int p : front)
+        {
+            const int dep = mesh.get_first_neighbor(p);
+            const int end = dep + mesh.get_num_neighbors(p);
+            for(int n = dep; n < end; n++)
+            {
+                const int j = mesh.get_edge(n);
+                if(vert_level[j] != -1)
+                    continue;
+                vert_level[j] = level;
+                next.push_back(j);
+            }
+        }
+
+        if(next.empty())
+            break;
+
+        // Neighbors in memory for the kernels
+        std::sort(next.begin(), next.end());
+        layer_verts.insert(layer_verts.end(), next.begin(), next.end());
+        layer_offsets.push_back((int)layer_verts.size());
+        front.swap(next);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// Warm start of the vertex p
+/// (shared by the kernel and the host version)
+IF_CUDA_DEVICE_HOST static inline
+void warm_start_vert(int p,
+                     Vec3_cu* vertices,
+                     const Vec3_cu* offsets,
+                     const int* vert_bone,
+                     const Transfo* bone_transfos)
+{
+    const int b = vert_bone[p];
+    if(b < 0) return;
+    // Transfo * Vec3_cu only applies the linear part
+    vertices[p] = vertices[p] + bone_transfos[b] * offsets[p];
+}
+
+// -----------------------------------------------------------------------------
+
+__global__
+void warm_start(Vec3_cu* vertices,
+                const Vec3_cu* offsets,
+                const int* vert_bone,
+                const Transfo* bone_transfos,
+                int n)
+{
+    int p = blockIdx.x * blockDim.x + threadIdx.x;
+    if(p < n)
+        warm_start_vert(p, vertices, offsets, vert_bone, bone_transfos);
+}
+
+// -----------------------------------------------------------------------------
+
+void warm_start_host(Vec3_cu* vertices,
+                     const Vec3_cu* offsets,
+                     const int* vert_bone,
+                     const Transfo* bone_transfos,
+                     int nb_verts)
+{
+    Thread_pool::get().parallel_for(nb_verts, 4096, [&](int begin, int end){
+        for(int p = begin; p < end; p++)
+            warm_start_vert(p, vertices, offsets, vert_bone, bone_transfos);
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+__global__
+void compute_offsets(const Vec3_cu* in_vertices,
+                     const Vec3_cu* out_vertices,
+                     Vec3_cu* offsets,
+                     int n)
+{
+    int p = blockIdx.x * blockDim.x + threadIdx.x;
+    if(p < n)
+        offsets[p] = out_vertices[p] - in_vertices[p];
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_offsets_host(const Vec3_cu* in_vertices,
+                          const Vec3_cu* out_vertices,
+                          Vec3_cu* offsets,
+                          int nb_verts)
+{
+    Thread_pool::get().parallel_for(nb_verts, 4096, [&](int begin, int end){
+        for(int p = begin; p < end; p++)
+            offsets[p] = out_vertices[p] - in_vertices[p];
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_vert_bones(const Skeleton& skel,
+                        const Point_cu* verts,
+                        int nb_verts,
+                        std::vector<Bone::Id>& bone_ids,
+                        std::vector<int>& vert_bone)
+{
+    bone_ids.clear();
+    std::vector<Bone_cu> bones;
+    for(Bone::Id id: skel.get_bone_ids())
+    {
+        if( !skel.is_bone(id) )
+            continue;
+        bone_ids.push_back(id);
+        bones.push_back(*skel.get_bone(id));
+    }
+
+    vert_bone.assign(nb_verts, -1);
+    if(bones.empty())
+        return;
+
+    const int nb_bones = (int)bones.size();
+    Thread_pool::get().parallel_for(nb_verts, 1024, [&](int begin, int end){
+        for(int p = begin; p < end; p++)
+        {
+            float best = bones[0].dist_sq_to(verts[p]);
+            int best_bone = 0;
+            for(int b = 1; b < nb_bones; b++)
+            {
+                const float d = bones[b].dist_sq_to(verts[p]);
+                if(d < best){
+                    best = d;
+                    best_bone = b;
+                }
+            }
+            vert_bone[p] = best_bone;
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+int compute_warm_start_transfos(const Skeleton& skel,
+                                const std::vector<Bone::Id>& bone_ids,
+                                float threshold,
+                                std::vector<Bone_cu>& prev_bones,
+                                std::vector<Transfo>& prev_frames,
+                                std::vector<Transfo>& bone_transfos)
+{
+    const int nb_bones = (int)bone_ids.size();
+    const bool has_prev = (int)prev_bones.size() == nb_bones;
+    prev_bones.resize(nb_bones);
+    prev_frames.resize(nb_bones);
+    bone_transfos.resize(nb_bones);
+
+    int nb_warm = 0;
+    for(int b = 0; b < nb_bones; b++)
+    {
+        std::shared_ptr<const Bone> bone = skel.get_bone(bone_ids[b]);
+        const Transfo frame = bone->get_world_space_matrix();
+
+        bone_transfos[b] = Transfo::empty();
+        if(has_prev)
+        {
+            const Bone_cu& prev = prev_bones[b];
+            const float move = std::max((bone->org() - prev.org()).norm(),
+                                        (bone->end() - prev.end()).norm());
+            if(move <= threshold * bone->length())
+            {
+                bone_transfos[b] = frame * prev_frames[b].full_invert();
+                nb_warm++;
+            }
+        }
+
+        prev_bones [b] = *bone;
+        prev_frames[b] = frame;
+    }
+    return nb_warm;
+}
+
+// -----------------------------------------------------------------------------
+
 __global__
 void fill_index(DA_int array)
 {
@@ -689,7 +1172,7 @@ void fill_index(DA_int array)
 }
 
 /// Evaluate skeleton potential
-__device__
+IF_CUDA_DEVICE_HOST
 float eval_potential(Skeleton_env::Skel_id skel_id, const Point_cu& p, Vec3_cu& grad)
 {
     return Skeleton_env::compute_potential(skel_id, p, grad);
@@ -717,7 +1200,18 @@ void compute_base_potential(Skeleton_env::Skel_id skel_id,
 
 // -----------------------------------------------------------------------------
 
-__device__
+void compute_base_potential_host(Skeleton_env::Skel_id skel_id,
+                                 const Point_cu* in_verts,
+                                 const int nb_verts,
+                                 float* base_potential)
+{
+    std::vector<Vec3_cu> grad(nb_verts);
+    Skeleton_env::compute_potential(skel_id, in_verts, nb_verts, base_potential, grad.data());
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST
 float binary_search(Skeleton_env::Skel_id skel_id,
                         const Ray_cu&r,
                         float t0, float t1,
@@ -797,7 +1291,7 @@ float binary_search_div(Skeleton_env::Skel_id skel_id,
 // -----------------------------------------------------------------------------
 
 /// transform iso to sfactor
-__device__
+IF_CUDA_DEVICE_HOST
 inline static float iso_to_sfactor(float x, int s)
 {
      #if 0
@@ -824,47 +1318,28 @@ inline static float iso_to_sfactor(float x, int s)
     #endif
 }
 
-/*
-    Ajustement standard avec gradient
-*/
-
-/// Move the vertices along a mix between their normals and the joint rotation
-/// direction in order to match their base potential at rest position
-/// @param d_output_vertices  vertices array to be moved in place.
-/// @param d_ssd_interpolation_factor  interpolation weights for each vertices
-/// which defines interpolation between ssd animation and implicit skinning
-/// 1 is full ssd and 0 full implicit skinning
-/// @param do_tune_direction if false use the normal to displace vertices
-/// @param gradient_threshold when the mesh's points are fitted they march along
-/// the gradient of the implicit primitive. this parameter specify when the vertex
-/// stops the march i.e when gradient_threshold < to the scalar product of the
-/// gradient between two steps
-/// @param full_eval tells is we evaluate the skeleton entirely or if we just
-/// use the potential of the two nearest clusters, in full eval we don't update
-/// d_vert_to_fit has it is suppossed to be the last pass
-__global__
-void match_base_potential(Skeleton_env::Skel_id skel_id, 
-                          const bool smooth_fac_from_iso,
-                          Vec3_cu* out_verts,
-                          const float* base_potential,
-                          Vec3_cu* out_gradient,
-                          float* smooth_factors_iso,
-                          float* smooth_factors,
-                          int* vert_to_fit,
-                          const int nb_vert_to_fit,
-                          const unsigned short nb_iter,
-                          const float gradient_threshold,
-                          const float step_length,
-                          const bool potential_pit, // TODO: this condition should not be necessary
-                          EAnimesh::Vert_state *d_vert_state,
-                          const float smooth_strength,
-                          const int slope,
-                          const bool raphson)
+/// Fit the vertex vert_to_fit[thread_idx]
+/// (shared by the kernel and the host version)
+IF_CUDA_DEVICE_HOST static
+void match_base_potential_vert(int thread_idx,
+                               Skeleton_env::Skel_id skel_id,
+                               const bool smooth_fac_from_iso,
+                               Vec3_cu* out_verts,
+                               const float* base_potential,
+                               Vec3_cu* out_gradient,
+                               float* smooth_factors_iso,
+                               float* smooth_factors,
+                               int* vert_to_fit,
+                               const int nb_vert_to_fit,
+                               const unsigned short nb_iter,
+                               const float gradient_threshold,
+                               const float step_length,
+                               const bool potential_pit, // TODO: this condition should not be necessary
+                               EAnimesh::Vert_state *d_vert_state,
+                               const float smooth_strength,
+                               const int slope,
+                               const bool raphson)
 {
-    const int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
-    if(thread_idx >= nb_vert_to_fit)
-        return;
-
     const int p = vert_to_fit[thread_idx];
 
     // STOP CASE : Vertex already fitted
@@ -958,6 +1433,210 @@ void match_base_potential(Skeleton_env::Skel_id skel_id,
     out_verts[p] = v0;
 }
 
+// -----------------------------------------------------------------------------
+
+/*
+    Ajustement standard avec gradient
+*/
+
+/// Move the vertices along a mix between their normals and the joint rotation
+/// direction in order to match their base potential at rest position
+/// @param d_output_vertices  vertices array to be moved in place.
+/// @param d_ssd_interpolation_factor  interpolation weights for each vertices
+/// which defines interpolation between ssd animation and implicit skinning
+/// 1 is full ssd and 0 full implicit skinning
+/// @param do_tune_direction if false use the normal to displace vertices
+/// @param gradient_threshold when the mesh's points are fitted they march along
+/// the gradient of the implicit primitive. this parameter specify when the vertex
+/// stops the march i.e when gradient_threshold < to the scalar product of the
+/// gradient between two steps
+/// @param full_eval tells is we evaluate the skeleton entirely or if we just
+/// use the potential of the two nearest clusters, in full eval we don't update
+/// d_vert_to_fit has it is suppossed to be the last pass
+__global__
+void match_base_potential(Skeleton_env::Skel_id skel_id,
+                          const bool smooth_fac_from_iso,
+                          Vec3_cu* out_verts,
+                          const float* base_potential,
+                          Vec3_cu* out_gradient,
+                          float* smooth_factors_iso,
+                          float* smooth_factors,
+                          int* vert_to_fit,
+                          const int nb_vert_to_fit,
+                          const unsigned short nb_iter,
+                          const float gradient_threshold,
+                          const float step_length,
+                          const bool potential_pit, // TODO: this condition should not be necessary
+                          EAnimesh::Vert_state *d_vert_state,
+                          const float smooth_strength,
+                          const int slope,
+                          const bool raphson)
+{
+    const int thread_idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(thread_idx >= nb_vert_to_fit)
+        return;
+
+    match_base_potential_vert(thread_idx,
+                              skel_id,
+                              smooth_fac_from_iso,
+                              out_verts,
+                              base_potential,
+                              out_gradient,
+                              smooth_factors_iso,
+                              smooth_factors,
+                              vert_to_fit,
+                              nb_vert_to_fit,
+                              nb_iter,
+                              gradient_threshold,
+                              step_length,
+                              potential_pit,
+                              d_vert_state,
+                              smooth_strength,
+                              slope,
+                              raphson);
+}
+
+// -----------------------------------------------------------------------------
+
+void match_base_potential_host(Skeleton_env::Skel_id skel_id,
+                               const bool smooth_fac_from_iso,
+                               Vec3_cu* out_verts,
+                               const float* base_potential,
+                               Vec3_cu* out_gradient,
+                               float* smooth_factors_iso,
+                               float* smooth_factors,
+                               int* vert_to_fit,
+                               const int nb_vert_to_fit,
+                               const unsigned short nb_iter,
+                               const float gradient_threshold,
+                               const float step_length,
+                               const bool potential_pit, // TODO: this condition should not be necessary
+                               EAnimesh::Vert_state *d_vert_state,
+                               const float smooth_strength,
+                               const int slope,
+                               const bool raphson)
+{
+    HRBF_env::sync_host_mem();
+
+    // Vertices may stop after a few steps while others march until nb_iter:
+    // small chunks keep the threads busy
+    Thread_pool::get().parallel_for(nb_vert_to_fit, 32, [&](int begin, int end){
+        for(int thread_idx = begin; thread_idx < end; thread_idx++)
+            match_base_potential_vert(thread_idx,
+                                      skel_id,
+                                      smooth_fac_from_iso,
+                                      out_verts,
+                                      base_potential,
+                                      out_gradient,
+                                      smooth_factors_iso,
+                                      smooth_factors,
+                                      vert_to_fit,
+                                      nb_vert_to_fit,
+                                      nb_iter,
+                                      gradient_threshold,
+                                      step_length,
+                                      potential_pit,
+                                      d_vert_state,
+                                      smooth_strength,
+                                      slope,
+                                      raphson);
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_mvc(const Mesh& mesh,
+                 const Point_cu* verts,
+                 const Vec3_cu* normals,
+                 std::vector<float>& edge_lengths,
+                 std::vector<float>& edge_mvc)
+{
+    edge_lengths.assign(mesh.get_nb_edges(), 0.f);
+    edge_mvc.    assign(mesh.get_nb_edges(), 0.f);
+    Thread_pool::get().parallel_for(mesh.get_nb_vertices(), 256, [&](int begin, int end_vert)
+    {
+        // Neighbours of the current vertex projected on its tangent plane and
+        // normalized. Index 0 repeats the last neighbour and index nb_neigh+1
+        // the first one so the ring can be walked without wrapping around.
+        std::vector<float> ys, zs, norms_2D;
+        for(int i = begin; i < end_vert; i++)
+        {
+            Point_cu pos = verts[i];
+            Vec3_cu  nor = normals[i];
+
+            // Look up neighborhood
+            int dep      = mesh.get_edge_offset(i*2    );
+            int nb_neigh = mesh.get_edge_offset(i*2 + 1);
+
+            // mvc are left null on the side of the mesh
+            if( nb_neigh == 0 || nor.norm() < 0.00001f || mesh.is_vert_on_side(i) )
+                continue;
+
+            Mat3_cu frame = Mat3_cu::coordinate_system( nor ).transpose();
+            ys.      resize(nb_neigh + 2);
+            zs.      resize(nb_neigh + 2);
+            norms_2D.resize(nb_neigh + 2);
+            for(int n = 0; n < nb_neigh; n++)
+            {
+                // compute edge length
+                Vec3_cu e = verts[mesh.get_edge(dep + n)] - pos;
+                edge_lengths[dep + n] = e.norm();
+
+                // coordinates are computed by projecting the neighborhood to the
+                // tangent plane
+                e = frame * e;
+                float norm_2D = std::sqrt(e.y*e.y + e.z*e.z);
+                float f       = 1.f / norm_2D;
+                ys      [n+1] = e.y * f;
+                zs      [n+1] = e.z * f;
+                norms_2D[n+1] = norm_2D;
+            }
+            ys[0] = ys[nb_neigh];  ys[nb_neigh+1] = ys[1];
+            zs[0] = zs[nb_neigh];  zs[nb_neigh+1] = zs[1];
+
+            // Computing mvc: for two unit vectors separated by the angle 'a'
+            // tan(a/2) = sin(a) / (1 + cos(a)) which avoids atan2() and tan()
+            // and keeps the loop free of branches
+            float* mvcs = &edge_mvc[dep];
+            float sum = 0.f;
+            bool  out = false;
+            for(int n = 1; n <= nb_neigh; n++)
+            {
+                float tnext = (ys[n-1] * zs[n] - zs[n-1] * ys[n]) / (1.f + ys[n-1] * ys[n] + zs[n-1] * zs[n]);
+                float tprev = (ys[n] * zs[n+1] - zs[n] * ys[n+1]) / (1.f + ys[n] * ys[n+1] + zs[n] * zs[n+1]);
+
+                float mvc = norms_2D[n] > 0.0001f ? (tnext + tprev) / norms_2D[n] : 0.f;
+                sum += mvc;
+                mvcs[n-1] = mvc;
+                out |= mvc < 0.f;
+            }
+
+            // we ignore points outside the convex hull
+            if( sum  <= 0.f || out || isnan(sum) ) {
+                for(int n = 0; n < nb_neigh; n++) mvcs[n] = 0.f;
+            }
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_mvc(const Mesh& mesh,
+                 std::vector<float>& edge_lengths,
+                 std::vector<float>& edge_mvc)
+{
+    const int nb_vert = mesh.get_nb_vertices();
+    std::vector<Point_cu> verts  (nb_vert);
+    std::vector<Vec3_cu>  normals(nb_vert);
+    for(int i = 0; i < nb_vert; i++)
+    {
+        verts  [i] = mesh.get_vertex(i).to_point();
+        normals[i] = mesh.get_mean_normal(i); // FIXME : should be the gradient
+    }
+
+    compute_mvc(mesh, verts.data(), normals.data(), edge_lengths, edge_mvc);
+}
+
 }
 // END KERNELS NAMESPACE =======================================================
 
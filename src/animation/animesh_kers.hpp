@@ -7,6 +7,8 @@
 #include "skeleton.hpp"
 #include "animesh_enum.hpp"
 
+#include <vector>
+
 /** @namespace Kernels
     @brief The cuda kernels used to animate the mesh
 
@@ -173,7 +175,204 @@ void tangential_smooth_kernel_final_pass(const Vec3_cu* in_vertices,
                                          Vec3_cu* out_vertices,
                                          int n);
 
+/// Seed the fitting with the offsets found at the previous frame:
+/// vertices[p] += bone_transfos[vert_bone[p]] * offsets[p]
+/// (only the linear part of the transformation is applied).
+/// @param vert_bone : index in 'bone_transfos' of the bone driving each vertex
+/// or -1 to leave the vertex as is
+/// @param bone_transfos : rotation of each bone since the previous frame, a
+/// null transformation (Transfo::empty()) disables the warm start of the
+/// vertices of the bone.
+/// @see compute_warm_start_transfos()
+__global__
+void warm_start(Vec3_cu* vertices,
+                const Vec3_cu* offsets,
+                const int* vert_bone,
+                const Transfo* bone_transfos,
+                int n);
+
+/// offsets[p] = out_vertices[p] - in_vertices[p]
+__global__
+void compute_offsets(const Vec3_cu* in_vertices,
+                     const Vec3_cu* out_vertices,
+                     Vec3_cu* offsets,
+                     int n);
+
+/// Move the vertices which are not fitted with the correction of their
+/// fitted neighbors: vertices[p] = in_vertices[p] + sum_j w_j * (vertices[j] -
+/// in_vertices[j]) / sum_j w_j, over the neighbors j of a lower level than p
+/// with w_j the (positive part of the) mean value coordinates of the edge.
+/// Each call processes a single level, levels must be processed in
+/// increasing order.
+/// @param layer_verts : the 'n' vertices of the level to process
+/// @param vert_level : @see compute_lod_layers()
+__global__
+void reconstruct_layer(const Vec3_cu* in_vertices,
+                       Vec3_cu* vertices,
+                       const int* layer_verts,
+                       const int* vert_level,
+                       const int* edge_list,
+                       const int* edge_list_offsets,
+                       const float* edge_mvc,
+                       int n);
+
+
+// -----------------------------------------------------------------------------
+/// @name Host versions
+/// Same computations as the kernels above on host memory, split across the
+/// threads of Thread_pool::get(). 'nb_verts' is the number of vertices of the
+/// mesh.
+// -----------------------------------------------------------------------------
+
+/// @see compute_base_potential()
+void compute_base_potential_host(Skeleton_env::Skel_id skel_id,
+                                 const Point_cu* input_vertices,
+                                 const int nb_verts,
+                                 float* base_potential);
+
+/// @see match_base_potential()
+void match_base_potential_host(Skeleton_env::Skel_id skel_id,
+                               const bool smooth_fac_from_iso,
+                               Vec3_cu* output_vertices,
+                               const float* base_potential,
+                               Vec3_cu* gradient,
+                               float* smooth_factors_iso,
+                               float* smooth_factors,
+                               int* vert_to_fit,
+                               const int nb_vert_to_fit,
+                               const unsigned short nb_iter,
+                               const float gradient_threshold,
+                               const float step_length,
+                               const bool potential_pit,
+                               EAnimesh::Vert_state *vert_state,
+                               const float smooth_strength,
+                               const int slope,
+                               const bool raphson);
+
+/// @see conservative_smooth()
+void conservative_smooth_host(Vec3_cu* vertices,
+                              Vec3_cu* tmp_vertices,
+                              const Vec3_cu* normals,
+                              const int* edge_list,
+                              const int* edge_list_offsets,
+                              const float* edge_mvc,
+                              int nb_verts,
+                              const int* vert_to_fit,
+                              int nb_vert_to_fit,
+                              float strength,
+                              int nb_iter,
+                              const float* smooth_fac,
+                              bool use_smooth_fac);
+
+/// @see laplacian_smooth()
+void laplacian_smooth_host(Vec3_cu* vertices,
+                           Vec3_cu* tmp_vertices,
+                           const int* edge_list,
+                           const int* edge_list_offsets,
+                           int nb_verts,
+                           const float* factors,
+                           bool use_smooth_factors,
+                           float strength,
+                           int nb_iter,
+                           int nb_min_neighbours);
+
+/// @see diffuse_values()
+void diffuse_values_host(float* values,
+                         float* values_buffer,
+                         const int* edge_list,
+                         const int* edge_list_offsets,
+                         int nb_verts,
+                         float strength,
+                         int nb_iter);
+
+/// @see warm_start()
+void warm_start_host(Vec3_cu* vertices,
+                     const Vec3_cu* offsets,
+                     const int* vert_bone,
+                     const Transfo* bone_transfos,
+                     int nb_verts);
+
+/// @see compute_offsets()
+void compute_offsets_host(const Vec3_cu* in_vertices,
+                          const Vec3_cu* out_vertices,
+                          Vec3_cu* offsets,
+                          int nb_verts);
+
+/// @see reconstruct_layer(), every level is processed
+/// @param layer_offsets : nb_layers + 1 offsets in 'layer_verts'
+void reconstruct_host(const Vec3_cu* in_vertices,
+                      Vec3_cu* vertices,
+                      const int* layer_verts,
+                      const int* layer_offsets,
+                      int nb_layers,
+                      const int* vert_level,
+                      const int* edge_list,
+                      const int* edge_list_offsets,
+                      const float* edge_mvc);
+
+/// Sort the vertices which are not fitted by their distance (in edges) to
+/// the fitted vertices. Used to fit a subset of the mesh and reconstruct the
+/// other vertices with reconstruct_layer().
+/// @param fitted : true for the fitted vertices
+/// @param vert_level : 0 for fitted vertices, the distance to the closest
+/// fitted vertex for the others and -1 when there is none (for instance
+/// disconnected vertices)
+/// @param layer_verts : vertices with a level > 0 sorted by level
+/// @param layer_offsets : layer_verts[layer_offsets[l] ... layer_offsets[l+1]-1]
+/// are the vertices of level l+1
+void compute_lod_layers(const Mesh& mesh,
+                        const std::vector<bool>& fitted,
+                        std::vector<int>& vert_level,
+                        std::vector<int>& layer_verts,
+                        std::vector<int>& layer_offsets);
+
+// -----------------------------------------------------------------------------
+/// @name Warm start
+/// Skeleton side of warm_start(): during playback vertices are fitted
+/// starting from their offset to the iso-surface at the previous frame,
+/// unless their bone moved too much since then.
+// -----------------------------------------------------------------------------
+
+/// Find the closest bone to each vertex (root joints are ignored).
+/// @param bone_ids : the bones of 'skel' in the order used by 'vert_bone'
+/// @param vert_bone : index in 'bone_ids' of the closest bone of each vertex,
+/// or -1 if the skeleton has no bones
+void compute_vert_bones(const Skeleton& skel,
+                        const Point_cu* verts,
+                        int nb_verts,
+                        std::vector<Bone::Id>& bone_ids,
+                        std::vector<int>& vert_bone);
+
+/// Compute the transformations to feed warm_start() for the current pose of
+/// 'bone_ids' and save the pose in 'prev_bones' and 'prev_frames'.
+/// A bone is warm started when its origin and tip moved less than
+/// 'threshold' times its length since the previous pose, else its
+/// transformation is null. Every bone is cold when 'prev_bones' is empty
+/// (first frame), clear it to reset the history.
+/// @return the number of warm bones
+int compute_warm_start_transfos(const Skeleton& skel,
+                                const std::vector<Bone::Id>& bone_ids,
+                                float threshold,
+                                std::vector<Bone_cu>& prev_bones,
+                                std::vector<Transfo>& prev_frames,
+                                std::vector<Transfo>& bone_transfos);
+
+/// Compute the length and the mean value coordinates (mvc) of every edges of
+/// 'mesh' in rest pose. Arrays are indexed like the mesh's edge list.
+/// @see Animesh::compute_mvc()
+void compute_mvc(const Mesh& mesh,
+                 std::vector<float>& edge_lengths,
+                 std::vector<float>& edge_mvc);
 
+/// Same as above with the vertex positions and normals given separately, only
+/// the topology of 'mesh' is used. Use it to update the mvc when the vertices
+/// move but the topology doesn't.
+/// @param verts, normals : mesh.get_nb_vertices() elements each
+void compute_mvc(const Mesh& mesh,
+                 const Point_cu* verts,
+                 const Vec3_cu* normals,
+                 std::vector<float>& edge_lengths,
+                 std::vector<float>& edge_mvc);
 
 }// END Animesh_kers NAMESPACE =================================================
 
@@ -45,6 +45,8 @@ void Animesh::set_base_potential(const std::vector<float> &pot)
 {
     d_base_potential.malloc(get_nb_vertices());
     d_base_potential.copy_from(pot);
+    // Offsets were fitted to the old potential
+    warm_prev_bones.clear();
 }
 
 void Animesh::compute_normals(const Vec3_cu* vertices, Vec3_cu* normals)
@@ -238,6 +240,86 @@ void Animesh::fit_mesh(int nb_vert_to_fit,
     CUDA_CHECK_ERRORS();
 }
 
+void Animesh::set_warm_start(bool state)
+{
+    if(state != do_warm_start)
+        warm_prev_bones.clear();
+    do_warm_start = state;
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh::warm_start(Vec3_cu* d_vertices)
+{
+    const int nb_vert = d_input_vertices.size();
+    if(d_vert_bone.size() != nb_vert)
+    {
+        // Input vertices and bones are in the same pose
+        std::vector<int> vert_bone;
+        std::vector<Point_cu> verts = d_input_vertices.to_host_vector();
+        Animesh_kers::compute_vert_bones(*_skel, verts.data(), nb_vert, warm_bone_ids, vert_bone);
+        d_vert_bone.malloc(nb_vert);
+        d_vert_bone.copy_from(vert_bone);
+        d_warm_offsets.malloc(nb_vert);
+        warm_prev_bones.clear();
+    }
+
+    const int nb_warm = Animesh_kers::compute_warm_start_transfos(*_skel,
+                                                                  warm_bone_ids,
+                                                                  warm_start_threshold,
+                                                                  warm_prev_bones,
+                                                                  warm_prev_frames,
+                                                                  h_warm_transfos);
+    if(nb_warm == 0)
+        return;
+
+    d_warm_transfos.malloc(h_warm_transfos.size());
+    d_warm_transfos.copy_from(h_warm_transfos);
+
+    const int block_size = 256;
+    const int grid_size = (nb_vert + block_size - 1) / block_size;
+    Animesh_kers::warm_start<<<grid_size, block_size>>>
+        (d_vertices, d_warm_offsets.ptr(), d_vert_bone.ptr(), d_warm_transfos.ptr(), nb_vert);
+    CUDA_CHECK_ERRORS();
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh::save_warm_start(const Vec3_cu* d_vertices)
+{
+    const int nb_vert = d_input_vertices.size();
+    const int block_size = 256;
+    const int grid_size = (nb_vert + block_size - 1) / block_size;
+    Animesh_kers::compute_offsets<<<grid_size, block_size>>>
+        ((const Vec3_cu*)d_input_vertices.ptr(), d_vertices, d_warm_offsets.ptr(), nb_vert);
+    CUDA_CHECK_ERRORS();
+}
+
+// -----------------------------------------------------------------------------
+
+void Animesh::reconstruct_unfitted(Vec3_cu* d_vertices)
+{
+    const int block_size = 256;
+    const int nb_layers = (int)lod_layer_offsets.size() - 1;
+    for(int l = 0; l < nb_layers; l++)
+    {
+        const int n = lod_layer_offsets[l+1] - lod_layer_offsets[l];
+        const int grid_size = (n + block_size - 1) / block_size;
+        Animesh_kers::reconstruct_layer<<<grid_size, block_size>>>
+            ((const Vec3_cu*)d_input_vertices.ptr(),
+             d_vertices,
+             d_lod_layer_verts.ptr() + lod_layer_offsets[l],
+             d_vert_level.ptr(),
+             d_edge_list.ptr(),
+             d_edge_list_offsets.ptr(),
+             d_edge_mvc.ptr(),
+             n);
+        CUDA_CHECK_ERRORS();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 void Animesh::transform_vertices()
 {
     // If the bone data needs to be updated, do it now.
@@ -249,33 +331,34 @@ void Animesh::transform_vertices()
     // that type, instead of casting Vec3_cu to Point_cu.
     Vec3_cu* out_verts    = (Vec3_cu*)d_output_vertices.ptr();
     d_output_vertices.copy_from(d_input_vertices);
+    if(do_warm_start)
+        warm_start(out_verts);
 
     d_smooth_factors_laplacian.copy_from( d_input_smooth_factors );
     // d_vert_to_fit_base: a list of vertices that fit_mesh should be applied to;
     // doesn't depend on the results of skinning
     d_vert_to_fit.copy_from(d_vert_to_fit_base);
-    int nb_vert_to_fit = d_vert_to_fit.size();
     const int nb_steps = nb_transform_steps;
 
-    Cuda_utils::DA_int* curr = &d_vert_to_fit;
-
     if(do_smooth_mesh)
     {
-        Cuda_utils::DA_int* prev = &d_vert_to_fit_buff;
-
         cudaEvent_t event;
         cudaEventCreate(&event);
 
-        // Interleaved fitting
+        // Interleaved fitting.  The list of vertices still fitted is packed on the host every
+        // few iterations, see Vert_active_set.
         // Should we be doing nb_steps/2 steps here, since we're doing two steps per iteration?
-        for( int i = 0; i < nb_steps && nb_vert_to_fit != 0; i++)
+        active_set.reset(h_vert_to_fit_base.ptr(), h_vert_to_fit_base.size(), nb_steps);
+        while( !active_set.done() )
         {
-            // Make a fitting pass over all vertices in curr that aren't -1.  curr will be updated
-            // in-place, setting finished vertex indices to -1.
-            fit_mesh(nb_vert_to_fit, curr->ptr(), true/*smooth from iso*/, out_verts, 2, smooth_force_a);
+            const int nb_vert_to_fit = active_set.size();
+
+            // Make a fitting pass over all vertices in d_vert_to_fit that aren't -1.  d_vert_to_fit
+            // will be updated in-place, setting finished vertex indices to -1.
+            fit_mesh(nb_vert_to_fit, d_vert_to_fit.ptr(), true/*smooth from iso*/, out_verts, 2, smooth_force_a);
 
             // Querying an event causes CUDA to flush the kernel queue to the GPU.  If we don't do this,
-            // fit_mesh won't actually start until we do our readback in pack_vert_to_fit_gpu down below.
+            // fit_mesh won't actually start until we do our readback of d_vert_to_fit down below.
             // This allows the expensive fit_mesh kernel to start, while we queue the rest of the kernels
             // in parallel, which takes some time on Windows.
             cudaEventRecord(event);
@@ -283,14 +366,24 @@ void Animesh::transform_vertices()
 
             // user smoothing
             //smooth_mesh(output_vertices, d_smooth_factors.ptr(), smoothing_iter, false/*local smoothing*/);
-            conservative_smooth(out_verts, d_vert_buffer.ptr(), *curr, nb_vert_to_fit, smoothing_iter);
-
-            // Copy values from curr to prev that don't have a value of -1, to remove indices that are
-            // finished.  Update nb_vert_to_fit with the new number of remaining vertices.
-            nb_vert_to_fit = pack_vert_to_fit_gpu(*curr, d_vert_to_fit_buff_scan, *prev, nb_vert_to_fit );
-
-            // Switch curr and prev, so we use the new pruned index list for the next pass.
-            std::swap(curr, prev);
+            conservative_smooth(out_verts, d_vert_buffer.ptr(), d_vert_to_fit, nb_vert_to_fit, smoothing_iter);
+
+            if( !active_set.next_iter() )
+                continue;
+
+            // Read back the list to remove the indices that are finished and test convergence.
+            // Only the remaining vertices are uploaded back.
+            Cuda_utils::mem_cpy_dth(h_vert_to_fit_buff.ptr(), d_vert_to_fit.ptr(), nb_vert_to_fit);
+            const Vec3_cu* verts = 0;
+            if( active_set.tracks_displacement() )
+            {
+                Cuda_utils::mem_cpy_dth(h_vert_buffer.ptr(), out_verts, nb_vert);
+                verts = h_vert_buffer.ptr();
+            }
+            active_set.update(h_vert_to_fit_buff.ptr(), verts);
+
+            if( active_set.size() > 0 )
+                Cuda_utils::mem_cpy_htd(d_vert_to_fit.ptr(), active_set.verts(), active_set.size());
         }
 
         cudaEventDestroy(event);
@@ -298,13 +391,17 @@ void Animesh::transform_vertices()
     else
     {
         // First fitting
-        if(nb_vert_to_fit > 0)
-        {
-            d_vert_to_fit.copy_from(d_vert_to_fit_base);
-            fit_mesh(nb_vert_to_fit, curr->ptr(), false/*smooth from iso*/, out_verts, nb_steps, Cuda_ctrl::_debug._smooth1_force);
-        }
+        if(d_vert_to_fit.size() > 0)
+            fit_mesh(d_vert_to_fit.size(), d_vert_to_fit.ptr(), false/*smooth from iso*/, out_verts, nb_steps, Cuda_ctrl::_debug._smooth1_force);
     }
 
+    reconstruct_unfitted(out_verts);
+
+    // Save the fitted offsets before the Laplacian smoothing: the fitting only
+    // moves vertices along the gradient and would not undo it next frame
+    if(do_warm_start)
+        save_warm_start(out_verts);
+
 #if 1
     // Smooth the initial guess
     this->diffuse_attr(diffuse_smooth_weights_iter, 1.f, d_smooth_factors_laplacian.ptr());
@@ -314,8 +411,12 @@ void Animesh::transform_vertices()
     if(final_fitting)
     {
         // Reset d_vert_to_fit, so we always re-fit all vertices on this pass.
-        curr->copy_from(d_vert_to_fit_base);
-        fit_mesh(curr->size(), curr->ptr(), false/*smooth from iso*/, out_verts, nb_steps, Cuda_ctrl::_debug._smooth2_force);
+        d_vert_to_fit.copy_from(d_vert_to_fit_base);
+        fit_mesh(d_vert_to_fit.size(), d_vert_to_fit.ptr(), false/*smooth from iso*/, out_verts, nb_steps, Cuda_ctrl::_debug._smooth2_force);
+        reconstruct_unfitted(out_verts);
+
+        if(do_warm_start)
+            save_warm_start(out_verts);
     }
 
     // Final smoothing
@@ -12,6 +12,8 @@
 #include "hermiteRBF.hpp"
 #include "hermiteRBF.inl"
 
+#include <iostream>
+
 float binary_search(const Ray_cu& r,
                         float t0, float t1,
                         float iso,
@@ -215,6 +217,7 @@ Bone::Bone():
     _enabled = false;
     _precomputed = false;
     _obbox_surface_cached = false;
+    _grid_cache_key = 0;
     _hrbf.initialize();
     _primitive.initialize();
     _world_space_transform = Transfo::identity();
@@ -394,8 +397,13 @@ void Bone::precompute(const Skeleton *skeleton)
     Transfo world_space = this->get_world_space_matrix();
     set_world_space_matrix(Transfo::identity());
 
-    // Fill in the precomputed grid.
-    _primitive.fill_grid_with( skeleton->get_skel_id(), this );
+    // Fill in the precomputed grid, unless the cache has it.
+    if(_grid_cache_path.empty() || !_primitive.load_grid(_grid_cache_path, _grid_cache_key))
+    {
+        _primitive.fill_grid_with( skeleton->get_skel_id(), this );
+        if(!_grid_cache_path.empty() && !_primitive.save_grid(_grid_cache_path, _grid_cache_key))
+            std::cerr << "Couldn't write the grid cache " << _grid_cache_path << std::endl;
+    }
 
     // Set back any world space transformation.
     set_world_space_matrix(world_space);
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <memory>
+#include <string>
 #include "cuda_compiler_interop.hpp"
 #include "point_cu.hpp"
 #include "bbox.hpp"
@@ -199,6 +200,11 @@ public:
     void discard_precompute();
     bool is_precomputed() const { return _precomputed; }
 
+    // Read the precomputed grid from path if it was saved with the same key, otherwise fill
+    // it and save it there.  key identifies what the grid is filled with.  An empty path
+    // disables the cache.
+    void set_grid_cache(const std::string &path, int64_t key) { _grid_cache_path = path; _grid_cache_key = key; }
+
     // Set the object space direction and length.  (In object space, the origin is always
     // 0,0,0.)
     //
@@ -228,6 +234,10 @@ private:
     bool _precomputed;
     Precomputed_prim _primitive;
 
+    // Set by set_grid_cache().
+    std::string _grid_cache_path;
+    int64_t _grid_cache_key;
+
     // A cache of the bounding box (with surface=false), set when _precomputed is true,
     // in object space (ignores _world_space_transform).
     OBBox_cu         _obbox;
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <exception>
 
 #include "std_utils.hpp"
 #include "blending_env.hpp"
@@ -34,7 +35,9 @@ void Skeleton::init_skel_env(bool single_bone)
     Skeleton_env::update_joints_data(_skel_id, get_joints_data());
 }
 
-Skeleton::Skeleton(std::vector<std::shared_ptr<const Bone> > bones, std::vector<Bone::Id> parents, bool single_bone)
+Skeleton::Skeleton(std::vector<std::shared_ptr<const Bone> > bones, std::vector<Bone::Id> parents, bool single_bone) :
+    _update_depth(0),
+    _joints_data_dirty(false)
 {
     std::map<int,Bone::Id> loaderIdxToBoneId;
     std::map<Bone::Id,int> boneIdToLoaderIdx;
@@ -50,6 +53,7 @@ Skeleton::Skeleton(std::vector<std::shared_ptr<const Bone> > bones, std::vector<
         boneIdToLoaderIdx[bone->get_bone_id()] = bid;
     }
 
+    std::map<Blending_env::Ctrl_id, IBL::Ctrl_setup> controllers;
     for(auto &it: _joints)
     {
         SkeletonJoint &joint = it.second;
@@ -60,8 +64,9 @@ Skeleton::Skeleton(std::vector<std::shared_ptr<const Bone> > bones, std::vector<
         joint._joint_data = d;
 
         joint._controller = IBL::Shape::caml();
-        Blending_env::update_controller(d._ctrl_id, joint._controller);
+        controllers[d._ctrl_id] = joint._controller;
     }
+    Blending_env::update_controllers( controllers );
 
     for(auto &it: _joints)
     {
@@ -95,6 +100,67 @@ Skeleton::~Skeleton()
     Skeleton_env::delete_skel_instance( _skel_id );
 }
 
+void Skeleton::begin_update()
+{
+    _update_depth++;
+}
+
+// -----------------------------------------------------------------------------
+
+void Skeleton::commit_update()
+{
+    assert(_update_depth > 0);
+    if(--_update_depth > 0)
+        return;
+
+    if( !_dirty_ctrls.empty() )
+    {
+        std::map<Blending_env::Ctrl_id, IBL::Ctrl_setup> controllers;
+        for(Bone::Id i: _dirty_ctrls)
+            controllers[_joints.at(i)._joint_data._ctrl_id] = _joints.at(i)._controller;
+        Blending_env::update_controllers( controllers );
+        _dirty_ctrls.clear();
+    }
+
+    if( _joints_data_dirty )
+    {
+        _joints_data_dirty = false;
+        Skeleton_env::update_joints_data(_skel_id, get_joints_data());
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+Skeleton::Update_scope::~Update_scope()
+{
+    if(_committed)
+        return;
+
+    // Throwing from a destructor terminates, possibly while unwinding
+    try {
+        _skel.commit_update();
+    } catch(const std::exception& e) {
+        std::cerr << "ERROR: skeleton update failed: " << e.what() << std::endl;
+    } catch(...) {
+        std::cerr << "ERROR: skeleton update failed" << std::endl;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Skeleton::Update_scope::commit()
+{
+    if(_committed)
+        return;
+
+    // commit_update() decrements the depth before it can throw, so don't
+    // commit again from the destructor either way
+    _committed = true;
+    _skel.commit_update();
+}
+
+// -----------------------------------------------------------------------------
+
 void Skeleton::set_joint_controller(int i,
                                     const IBL::Ctrl_setup& shape)
 {
@@ -102,7 +168,10 @@ void Skeleton::set_joint_controller(int i,
         return;
 
     _joints.at(i)._controller = shape;
-    Blending_env::update_controller(_joints.at(i)._joint_data._ctrl_id, shape);
+    if(_update_depth > 0)
+        _dirty_ctrls.insert(i);
+    else
+        Blending_env::update_controller(_joints.at(i)._joint_data._ctrl_id, shape);
 }
 
 // -----------------------------------------------------------------------------
@@ -115,6 +184,16 @@ std::map<Bone::Id, Skeleton_env::Joint_data> Skeleton::get_joints_data() const
     return joints_data;
 }
 
+// -----------------------------------------------------------------------------
+
+void Skeleton::update_joints_data()
+{
+    if(_update_depth > 0)
+        _joints_data_dirty = true;
+    else
+        Skeleton_env::update_joints_data(_skel_id, get_joints_data());
+}
+
 void Skeleton::set_joint_blending(int i, EJoint::Joint_t type)
 {
     Skeleton_env::Joint_data &data = _joints.at(i)._joint_data;
@@ -123,7 +202,7 @@ void Skeleton::set_joint_blending(int i, EJoint::Joint_t type)
 
     data._blend_type = type;
 
-    Skeleton_env::update_joints_data(_skel_id, get_joints_data());
+    update_joints_data();
 }
 
 // -----------------------------------------------------------------------------
@@ -136,7 +215,7 @@ void Skeleton::set_joint_bulge_mag(int i, float m)
         return;
 
     data._bulge_strength = m;
-    Skeleton_env::update_joints_data(_skel_id, get_joints_data());
+    update_joints_data();
 }
 
 IBL::Ctrl_setup Skeleton::get_joint_controller(Bone::Id bone_id) const
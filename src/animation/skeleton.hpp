@@ -101,8 +101,41 @@ struct Skeleton {
 
   //----------------------------------------------------------------------------
   /// @name Setters
+  /// Each setter uploads its change to the device unless it's called between
+  /// begin_update() and commit_update().
   //----------------------------------------------------------------------------
 
+  /// Start collecting joint changes (type, controller, bulge magnitude)
+  /// instead of uploading them one by one. Calls can be nested, the changes
+  /// are sent to the device by the outermost commit_update().
+  /// @code
+  /// skel.begin_update();
+  /// for(Bone::Id id: skel.get_bone_ids())
+  ///     skel.set_joint_blending(id, EJoint::MAX);
+  /// skel.commit_update(); // Single update of Skeleton_env
+  /// @endcode
+  void begin_update();
+
+  /// Upload the changes made since begin_update()
+  void commit_update();
+
+  /// Calls begin_update() and commit_update() at the end of the scope, even
+  /// when an exception is thrown. A destructor can't throw: errors raised by
+  /// commit_update() are reported on std::cerr and swallowed, call commit()
+  /// before the end of the scope to get them.
+  struct Update_scope {
+      Update_scope(Skeleton& skel) : _skel(skel), _committed(false) { _skel.begin_update(); }
+      ~Update_scope();
+
+      /// Commit now, errors are thrown. The destructor won't commit again.
+      void commit();
+  private:
+      Update_scope(const Update_scope&);
+      Update_scope& operator=(const Update_scope&);
+      Skeleton& _skel;
+      bool _committed;
+  };
+
   void set_joint_controller(int i,
                             const IBL::Ctrl_setup& shape);
 
@@ -181,6 +214,9 @@ private:
 
   std::map<Bone::Id, Skeleton_env::Joint_data> get_joints_data() const;
 
+  /// Upload joints data now or at commit_update() time
+  void update_joints_data();
+
   //----------------------------------------------------------------------------
   /// @name Attributes
   //----------------------------------------------------------------------------
@@ -190,6 +226,13 @@ private:
 
   // Maps from bone IDs to joints:
   std::map<Bone::Id, SkeletonJoint> _joints;
+
+  /// @name Pending changes between begin_update() and commit_update()
+  /// @{
+  int _update_depth;                ///< number of nested begin_update()
+  bool _joints_data_dirty;          ///< Skeleton_env must be updated
+  std::set<Bone::Id> _dirty_ctrls;  ///< controllers to upload
+  /// @}
 };
 
 #endif // SKELETON_HPP__
@@ -0,0 +1,63 @@
+#include "vert_active_set.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// -----------------------------------------------------------------------------
+
+void Vert_active_set::reset(const int* verts, int nb_verts, int nb_iter_max)
+{
+    _verts.assign(verts, verts + nb_verts);
+    _pos.clear();
+    _has_pos     = false;
+    _converged   = false;
+    _iter        = 0;
+    _nb_iter_max = nb_iter_max;
+
+    const int min_ratio = (int)std::ceil(_settings.min_active_ratio * nb_verts);
+    _min_size = std::max(_settings.min_active, min_ratio);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Vert_active_set::next_iter()
+{
+    _iter++;
+    const int interval = std::max(_settings.check_interval, 1);
+    return !done() && (_iter % interval) == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void Vert_active_set::update(const int* to_fit, const Vec3_cu* vertices)
+{
+    const bool track = tracks_displacement() && vertices != 0;
+    if( track )
+        _pos.resize(_verts.size());
+
+    // '_pos[i]' belongs to '_verts[i]' so the packing is done in place
+    float max_disp = 0.f;
+    int n = 0;
+    for(int i = 0; i < size(); i++)
+    {
+        const int p = to_fit[i];
+        if(p < 0)
+            continue;
+
+        if( track )
+        {
+            if( _has_pos )
+                max_disp = std::max(max_disp, (vertices[p] - _pos[i]).norm());
+            _pos[n] = vertices[p];
+        }
+        _verts[n++] = p;
+    }
+    _verts.resize(n);
+
+    if( track )
+    {
+        _pos.resize(n);
+        _converged = _has_pos && max_disp < _settings.min_displacement;
+    }
+    _has_pos = track;
+}
@@ -0,0 +1,110 @@
+#ifndef VERT_ACTIVE_SET_HPP__
+#define VERT_ACTIVE_SET_HPP__
+
+#include "vec3_cu.hpp"
+
+#include <vector>
+
+/** @class Vert_active_set
+    @brief Host side schedule of the interleaved fitting and smoothing passes
+
+    The active set is the list of vertices still fitted by the iterations of
+    Animesh::transform_vertices() when the mesh is smoothed during the fitting.
+    The fitting kernels set to -1 the entries of the vertices which stopped.
+    Every 'check_interval' iterations the list is read back, packed on host and
+    the convergence criteria are tested:
+    - iteration budget
+    - number or fraction of vertices still active
+    - largest displacement of an active vertex since the previous check
+
+    Stopped vertices are skipped by the kernels, so checking every few
+    iterations instead of every iteration only saves synchronizations, it
+    doesn't change the result.
+
+    @code
+    Vert_active_set set;
+    set.reset(vert_to_fit, nb_vert_to_fit, nb_iter_max);
+    while( !set.done() )
+    {
+        fitting_and_smoothing(to_fit, set.size());
+        if( set.next_iter() ){
+            set.update(to_fit, set.tracks_displacement() ? vertices : 0);
+            copy(set.verts(), to_fit, set.size());
+        }
+    }
+    @endcode
+*/
+class Vert_active_set {
+public:
+
+    struct Settings {
+        Settings() :
+            min_active(0),
+            min_active_ratio(0.f),
+            min_displacement(0.f),
+            check_interval(8)
+        { }
+
+        /// Stop when this number of vertices or less are still active
+        int min_active;
+        /// Stop when this fraction of the initial vertices or less are still
+        /// active
+        float min_active_ratio;
+        /// Stop when no active vertex moved more than this distance between
+        /// two checks (0 to disable)
+        float min_displacement;
+        /// Number of iterations between two checks
+        int check_interval;
+    };
+
+    Vert_active_set() : _nb_iter_max(0), _iter(0), _min_size(0), _converged(true), _has_pos(false) { }
+
+    void set_settings(const Settings& s) { _settings = s; }
+    const Settings& get_settings() const { return _settings; }
+
+    /// Start a new loop over the 'nb_verts' indices in 'verts'
+    /// @param nb_iter_max : iteration budget
+    void reset(const int* verts, int nb_verts, int nb_iter_max);
+
+    /// Count an iteration
+    /// @return true if update() must be called before the next iteration
+    bool next_iter();
+
+    /// Remove the vertices stopped since the last update() and test the
+    /// convergence criteria.
+    /// @param to_fit : the first size() elements are the indices of verts()
+    /// with the stopped vertices set to -1
+    /// @param vertices : positions of the mesh's vertices, used when
+    /// tracks_displacement(), can be null otherwise.
+    void update(const int* to_fit, const Vec3_cu* vertices);
+
+    /// Whether update() needs the positions of the vertices
+    bool tracks_displacement() const { return _settings.min_displacement > 0.f; }
+
+    /// @return true when the loop must stop
+    bool done() const {
+        return _iter >= _nb_iter_max || size() <= _min_size || _converged;
+    }
+
+    /// Number of iterations since reset()
+    int nb_iter() const { return _iter; }
+
+    /// Indices of the active vertices
+    const int* verts() const { return _verts.data(); }
+    int size() const { return (int)_verts.size(); }
+
+private:
+    Settings _settings;
+
+    int  _nb_iter_max;
+    int  _iter;
+    int  _min_size;   ///< size of the set under which we stop
+    bool _converged;  ///< no vertex moved enough since the last check
+    bool _has_pos;    ///< '_pos' was filled by the last update()
+
+    std::vector<int>     _verts;
+    /// Position of the active vertices at the last update()
+    std::vector<Vec3_cu> _pos;
+};
+
+#endif // VERT_ACTIVE_SET_HPP__
@@ -1,5 +1,4 @@
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <cstdio>
 #include <cstdlib>
@@ -9,7 +8,7 @@
 #include "blending_env.hpp"
 #include "blending_lib/controller.hpp"
 #include "blending_lib/generator.hpp"
-#include "class_saver.hpp"
+#include "cache_file.hpp"
 #include "timer.hpp"
 #include "std_utils.hpp"
 
@@ -99,6 +98,8 @@ Cuda_utils::Device::CuArray<float2>  d_block_3D_ricci_gradient;
 //@}
 
 cudaArray* d_global_controller = 0;
+/// Host copy of d_global_controller
+std::vector<float2> h_global_controller;
 IBL::Ctrl_setup globale_ctrl_shape;
 const int nb_samples = NB_SAMPLES;
 
@@ -158,6 +159,53 @@ std::string get_cache_dir() {
     return dir;
 }
 
+// -----------------------------------------------------------------------------
+
+/// @return a writer for a cache file holding the sampling resolutions the
+/// tables are computed with. @see open_cache()
+static Cache_file::Writer cache_writer()
+{
+    Cache_file::Writer w;
+    w.set_param("NB_SAMPLES"             , NB_SAMPLES             );
+    w.set_param("NB_SAMPLES_OCU"         , NB_SAMPLES_OCU         );
+    w.set_param("NB_SAMPLES_ALPHA"       , NB_SAMPLES_ALPHA       );
+    w.set_param("NB_SAMPLES_4D_BULGE"    , NB_SAMPLES_4D_BULGE    );
+    w.set_param("NB_SAMPLES_MAG_4D_BULGE", NB_SAMPLES_MAG_4D_BULGE);
+    w.set_param("PAN_HF_NB_SAMPLES"      , IBL::Opening::Pan_hf::_nb_samples);
+    return w;
+}
+
+// -----------------------------------------------------------------------------
+
+static std::string cache_path(const std::string& name)
+{
+    return get_cache_dir()+"/"+name+".opc";
+}
+
+// -----------------------------------------------------------------------------
+
+/// Map the cache file 'name' of the cache directory
+/// @return false if the file doesn't exist or if it was computed with other
+/// sampling resolutions than the current ones
+static bool open_cache(Cache_file& file, const std::string& name)
+{
+    if( !file.open( cache_path(name) ) )
+        return false;
+
+    bool s = file.check_param("NB_SAMPLES"             , NB_SAMPLES             );
+    s = s && file.check_param("NB_SAMPLES_OCU"         , NB_SAMPLES_OCU         );
+    s = s && file.check_param("NB_SAMPLES_ALPHA"       , NB_SAMPLES_ALPHA       );
+    s = s && file.check_param("NB_SAMPLES_4D_BULGE"    , NB_SAMPLES_4D_BULGE    );
+    s = s && file.check_param("NB_SAMPLES_MAG_4D_BULGE", NB_SAMPLES_MAG_4D_BULGE);
+    s = s && file.check_param("PAN_HF_NB_SAMPLES"      , IBL::Opening::Pan_hf::_nb_samples);
+
+    if( !s ){
+        std::cerr << "Cache " << name << " is outdated and will be recomputed" << std::endl;
+        file.close();
+    }
+    return s;
+}
+
 /// @param src_vals host array to be copied. 3D values are stored linearly
 /// src_vals[x + y*width + z*width*height] = [x][y][z];
 /// @param d_dst_values device array to stores and allocate the values from host
@@ -388,7 +436,8 @@ void unbind()
 
 // -----------------------------------------------------------------------------
 
-void init_3D_operator(const IBL::Profile_polar::Base& profile,
+void init_3D_operator(Op_t op_t,
+                      const IBL::Profile_polar::Base& profile,
                       const IBL::Opening::Base& opening,
                       float range,
                       const std::string filename,
@@ -398,7 +447,8 @@ void init_3D_operator(const IBL::Profile_polar::Base& profile,
 
 void init_3D_barths_circle_arc(bool use_cache)
 {
-    init_3D_operator(IBL::Profile_polar::Circle(),
+    init_3D_operator(C_L,
+                     IBL::Profile_polar::Circle(),
                      IBL::Opening::Line(),
                      1.f,
                      "barths_circle",
@@ -409,7 +459,8 @@ void init_3D_barths_circle_arc(bool use_cache)
 
 void init_3D_barths_circle_diamond(bool use_cache)
 {
-    init_3D_operator(IBL::Profile_polar::Circle(),
+    init_3D_operator(C_D,
+                     IBL::Profile_polar::Circle(),
                      IBL::Opening::Diamond(),
                      2.f,
                      "barths_circle_diamond",
@@ -428,7 +479,8 @@ void init_3D_clean_union(bool use_cache)
     typedef IBL::Opening::Discreet_hyperbola Dh;
     IBL::Opening::Discreet_hyperbola opening(Dh::OPEN_TANH);
 
-    init_3D_operator(hyperbola_curve,
+    init_3D_operator(U_OH,
+                     hyperbola_curve,
                      opening,
                      1.f,
                      "3D_clean_union",
@@ -446,7 +498,8 @@ void init_3D_bulge_in_contact(bool use_cache)
     typedef IBL::Opening::Discreet_hyperbola Dh;
     IBL::Opening::Discreet_hyperbola opening(Dh::OPEN_TANH);
 
-    init_3D_operator(bulge_curve,
+    init_3D_operator(B_OH,
+                     bulge_curve,
                      opening,
                      1.f,
                      "3D_bulge_in_contact",
@@ -460,7 +513,8 @@ void init_circle_hyperbola_open(bool use_cache)
     typedef IBL::Opening::Discreet_hyperbola Dh;
     IBL::Opening::Discreet_hyperbola opening(Dh::OPEN_TANH);
 
-    init_3D_operator(IBL::Profile_polar::Circle(),
+    init_3D_operator(C_OH,
+                     IBL::Profile_polar::Circle(),
                      opening,
                      2.f,
                      "circle_hyperbola_open",
@@ -473,7 +527,8 @@ void init_circle_hyperbola_closed_h(bool use_cache)
 {
     typedef IBL::Opening::Discreet_hyperbola Dh;
 
-    init_3D_operator(IBL::Profile_polar::Circle(),
+    init_3D_operator(C_HCH,
+                     IBL::Profile_polar::Circle(),
                      Dh(Dh::CLOSED_HERMITE),
                      2.f,
                      "circle_hyperbola_closed_h",
@@ -486,7 +541,8 @@ void init_circle_hyperbola_closed_t(bool use_cache)
 {
     typedef IBL::Opening::Discreet_hyperbola Dh;
 
-    init_3D_operator(IBL::Profile_polar::Circle(),
+    init_3D_operator(C_TCH,
+                     IBL::Profile_polar::Circle(),
                      Dh(Dh::CLOSED_TANH),
                      2.f,
                      "circle_hyperbola_closed_t",
@@ -499,7 +555,8 @@ void init_ultimate_hyperbola_closed_h(bool use_cache)
 {
     typedef IBL::Opening::Discreet_hyperbola Dh;
 
-    init_3D_operator(IBL::Profile_polar::Discreet(h_hyperbola_profile,
+    init_3D_operator(U_HCH,
+                     IBL::Profile_polar::Discreet(h_hyperbola_profile,
                                                   (IBL::float2*)h_hyperbola_normals_profile,
                                                   NB_SAMPLES),
                      Dh(Dh::CLOSED_HERMITE),
@@ -514,7 +571,8 @@ void init_ultimate_hyperbola_closed_t(bool use_cache)
 {
     typedef IBL::Opening::Discreet_hyperbola Dh;
 
-    init_3D_operator(IBL::Profile_polar::Discreet(h_hyperbola_profile,
+    init_3D_operator(U_TCH,
+                     IBL::Profile_polar::Discreet(h_hyperbola_profile,
                                                   (IBL::float2*)h_hyperbola_normals_profile,
                                                   NB_SAMPLES),
                      Dh(Dh::CLOSED_TANH),
@@ -529,7 +587,8 @@ void init_bulge_hyperbola_closed_h(bool use_cache)
 {
     typedef IBL::Opening::Discreet_hyperbola Dh;
 
-    init_3D_operator(IBL::Profile_polar::Discreet(h_bulge_profile,
+    init_3D_operator(B_HCH,
+                     IBL::Profile_polar::Discreet(h_bulge_profile,
                                                   (IBL::float2*)h_bulge_normals_profile,
                                                   NB_SAMPLES),
                      Dh(Dh::CLOSED_HERMITE),
@@ -544,7 +603,8 @@ void init_bulge_hyperbola_closed_t(bool use_cache)
 {
     typedef IBL::Opening::Discreet_hyperbola Dh;
 
-    init_3D_operator(IBL::Profile_polar::Discreet(h_bulge_profile,
+    init_3D_operator(B_TCH,
+                     IBL::Profile_polar::Discreet(h_bulge_profile,
                                                   (IBL::float2*)h_bulge_normals_profile,
                                                   NB_SAMPLES),
                      Dh(Dh::CLOSED_TANH),
@@ -559,7 +619,8 @@ void init_bulge_skinning_closed_t(bool use_cache)
 {
     typedef IBL::Opening::Diamond Dia;
 
-    init_3D_operator(IBL::Profile_polar::Discreet(h_bulge_profile,
+    init_3D_operator(B_D,
+                     IBL::Profile_polar::Discreet(h_bulge_profile,
                                                   (IBL::float2*)h_bulge_normals_profile,
                                                   NB_SAMPLES),
                      Dia(0.55f),
@@ -705,8 +766,10 @@ void init_4D_ricci(bool use_cache)
 
     if(use_cache)
     {
-        s = s && read_array(h_block_vals.ptr() , block_len, get_cache_dir()+"/4D_ricci_vals.opc"  );
-        s = s && read_array(h_block_grads.ptr(), block_len, get_cache_dir()+"/4D_ricci_grads.opc" );
+        Cache_file cache;
+        s = s && open_cache(cache, "4D_ricci");
+        s = s && cache.read_table("vals" , h_block_vals.ptr() , block_len);
+        s = s && cache.read_table("grads", h_block_grads.ptr(), block_len);
     }
 
     HA_float  h_ricci_profiles      ((NB_SAMPLES+2)*nb_grids, 0.f);
@@ -767,8 +830,10 @@ void init_4D_ricci(bool use_cache)
 
     if(!s)
     {
-        write_array(h_block_vals.ptr() , block_len, get_cache_dir()+"/4D_ricci_vals.opc"  );
-        write_array(h_block_grads.ptr(), block_len, get_cache_dir()+"/4D_ricci_grads.opc" );
+        Cache_file::Writer w = cache_writer();
+        w.add_table("vals" , h_block_vals.ptr() , block_len);
+        w.add_table("grads", h_block_grads.ptr(), block_len);
+        w.save( cache_path("4D_ricci") );
     }
 
     d_block_3D_ricci.malloc(block_size.x, block_size.y, block_size.z);
@@ -824,8 +889,10 @@ void init_4D_bulge_in_contact(bool use_cache)
 
     if(use_cache)
     {
-        s = s && read_array(h_block_vals.ptr() , block_len, get_cache_dir()+"/4D_bulge_vals.opc"  );
-        s = s && read_array(h_block_grads.ptr(), block_len, get_cache_dir()+"/4D_bulge_grads.opc" );
+        Cache_file cache;
+        s = s && open_cache(cache, "4D_bulge");
+        s = s && cache.read_table("vals" , h_block_vals.ptr() , block_len);
+        s = s && cache.read_table("grads", h_block_grads.ptr(), block_len);
     }
 
     HA_float  h_bulge_profiles      ((NB_SAMPLES+2)*nb_grids, 0.f);
@@ -885,8 +952,10 @@ void init_4D_bulge_in_contact(bool use_cache)
 
     if(!s)
     {
-        write_array(h_block_vals.ptr() , block_len, get_cache_dir()+"/4D_bulge_vals.opc"  );
-        write_array(h_block_grads.ptr(), block_len, get_cache_dir()+"/4D_bulge_grads.opc" );
+        Cache_file::Writer w = cache_writer();
+        w.add_table("vals" , h_block_vals.ptr() , block_len);
+        w.add_table("grads", h_block_grads.ptr(), block_len);
+        w.save( cache_path("4D_bulge") );
     }
 
     d_block_3D_bulge.malloc(block_size.x, block_size.y, block_size.z);
@@ -918,8 +987,10 @@ void init_profile_hyperbola(bool use_cache)
     {
         h_vals  = new float      [len];
         h_grads = new IBL::float2[len];
-        s = s && read_array(h_vals , len, get_cache_dir()+"/profile_hyperbola_vals.opc"  );
-        s = s && read_array(h_grads, len, get_cache_dir()+"/profile_hyperbola_grads.opc" );
+        Cache_file cache;
+        s = s && open_cache(cache, "profile_hyperbola");
+        s = s && cache.read_table("vals" , h_vals , len);
+        s = s && cache.read_table("grads", h_grads, len);
     }
 
     if(!s)
@@ -934,8 +1005,10 @@ void init_profile_hyperbola(bool use_cache)
         h_vals  = hyperbola_curve.get_vals();
         h_grads = hyperbola_curve.get_grads();
         // And save it
-        write_array(h_vals , len, get_cache_dir()+"/profile_hyperbola_vals.opc"  );
-        write_array(h_grads, len, get_cache_dir()+"/profile_hyperbola_grads.opc" );
+        Cache_file::Writer w = cache_writer();
+        w.add_table("vals" , h_vals , len);
+        w.add_table("grads", h_grads, len);
+        w.save( cache_path("profile_hyperbola") );
 
     }
 
@@ -965,8 +1038,10 @@ void init_profile_bulge(bool use_cache)
     {
         h_vals  = new float      [len];
         h_grads = new IBL::float2[len];
-        s = s && read_array(h_vals , len, get_cache_dir()+"/profile_bulge_vals.opc"  );
-        s = s && read_array(h_grads, len, get_cache_dir()+"/profile_bulge_grads.opc" );
+        Cache_file cache;
+        s = s && open_cache(cache, "profile_bulge");
+        s = s && cache.read_table("vals" , h_vals , len);
+        s = s && cache.read_table("grads", h_grads, len);
     }
 
     if(!s)
@@ -980,8 +1055,10 @@ void init_profile_bulge(bool use_cache)
         h_vals  = bulge_curve.get_vals();
         h_grads = bulge_curve.get_grads();
         // And save it
-        write_array(h_vals , len, get_cache_dir()+"/profile_bulge_vals.opc"  );
-        write_array(h_grads, len, get_cache_dir()+"/profile_bulge_grads.opc" );
+        Cache_file::Writer w = cache_writer();
+        w.add_table("vals" , h_vals , len);
+        w.add_table("grads", h_grads, len);
+        w.save( cache_path("profile_bulge") );
 
     }
 
@@ -1005,7 +1082,9 @@ void init_opening_hyperbola(bool use_cache)
 
     if(use_cache){
         pan_hyperbola = new float[len];
-        s = s && read_array(pan_hyperbola, len, get_cache_dir()+"/opening_hyperbola_vals.opc");
+        Cache_file cache;
+        s = s && open_cache(cache, "opening_hyperbola");
+        s = s && cache.read_table("vals", pan_hyperbola, len);
     }
 
 
@@ -1022,7 +1101,9 @@ void init_opening_hyperbola(bool use_cache)
             pan_hyperbola[i] = IBL::Opening::Pan_hf::_vals[i];
 
         // And save it
-        write_array(pan_hyperbola, len, get_cache_dir()+"/opening_hyperbola_vals.opc");
+        Cache_file::Writer w = cache_writer();
+        w.add_table("vals", pan_hyperbola, len);
+        w.save( cache_path("opening_hyperbola") );
     }
 
     allocate_and_copy_1D_array(len, pan_hyperbola, d_pan_hyperbola);
@@ -1037,6 +1118,7 @@ void init_global_controller()
     globale_ctrl_shape = IBL::Shape::elbow();
     IBL::gen_controller(NB_SAMPLES, globale_ctrl_shape, controller);
     allocate_and_copy_1D_array(NB_SAMPLES, (float2*)controller, d_global_controller);
+    h_global_controller.assign((float2*)controller, (float2*)controller + NB_SAMPLES);
     delete[] controller;
 }
 
@@ -1255,13 +1337,13 @@ void delete_ctrl_instance(Ctrl_id inst_id)
 
 // -----------------------------------------------------------------------------
 
-void update_controller(Ctrl_id inst_id, const IBL::Ctrl_setup& shape)
+/// Sample the controller 'shape' into h_controllers (host mem only)
+static void write_controller(Ctrl_id inst_id, const IBL::Ctrl_setup& shape)
 {
     assert(inst_id < (int)h_ctrl_active.size());
     assert(inst_id >= 0);
     assert(h_ctrl_active[inst_id]);
     assert(nb_instances > 0);
-    Blending_env::unbind();
 
     int2 bidx_2D = {inst_id % BLOCK_CTRL_LX , inst_id / BLOCK_CTRL_LX  };
     int2 gidx_2D = {bidx_2D.x * GRID_CTRL_LX, bidx_2D.y * GRID_CTRL_LY };
@@ -1293,8 +1375,28 @@ void update_controller(Ctrl_id inst_id, const IBL::Ctrl_setup& shape)
         h_controllers[row0_idx] = val;
         h_controllers[row2_idx] = val;
     }
+}
 
-    d_controllers_copy_from(h_controllers, gsize2D);
+// -----------------------------------------------------------------------------
+
+void update_controller(Ctrl_id inst_id, const IBL::Ctrl_setup& shape)
+{
+    Blending_env::unbind();
+    write_controller(inst_id, shape);
+    d_controllers_copy_from(h_controllers, ctrl_max_size_2D());
+    Blending_env::bind();
+}
+
+// -----------------------------------------------------------------------------
+
+void update_controllers(const std::map<Ctrl_id, IBL::Ctrl_setup>& shapes)
+{
+    if( shapes.empty() ) return;
+
+    Blending_env::unbind();
+    for(const auto& it: shapes)
+        write_controller(it.first, it.second);
+    d_controllers_copy_from(h_controllers, ctrl_max_size_2D());
     Blending_env::bind();
 }
 
@@ -1334,12 +1436,16 @@ Grid3_cu<float2>* grid_operators_grads  = 0;
 /// @{
 std::vector<Idx3_cu> h_operators_idx_offsets;
 Cuda_utils::Device::Array<int4> d_operators_idx_offsets; // GPU mem
+/// Host copy of d_operators_idx_offsets (indexed with Op_id)
+std::vector<int4> h_operators_tex_offsets;
 /// @}
 
 /// maps operators types to their identifier.
 // TODO this maps only a sub part of operators type it should map everything
 // and with id=-1 for operators types which doesn't exists.
 Cuda_utils::Device::Array<Op_id> d_operators_id;
+/// Host copy of d_operators_id
+std::vector<Op_id> h_operators_id;
 
 /// predefined operators grids
 std::vector< Grid3_cu<float>*  > h_operators_values;
@@ -1366,7 +1472,22 @@ void allocate_and_copy_3D_array(Grid3_cu<T>* grid_data,
 
 // -----------------------------------------------------------------------------
 
-void init_3D_operator(const IBL::Profile_polar::Base& profile,
+/// Predefined operators slots are allocated once: h_operators_xxx[i] is
+/// null when the ith operator is not generated yet.
+static void alloc_predefined_slots()
+{
+    if( h_operators_values.size() == (unsigned)NB_PRED_OPS )
+        return;
+
+    assert( h_operators_values.size() == 0 );
+    h_operators_values.resize(NB_PRED_OPS, 0);
+    h_operators_grads. resize(NB_PRED_OPS, 0);
+}
+
+// -----------------------------------------------------------------------------
+
+void init_3D_operator(Op_t op_t,
+                      const IBL::Profile_polar::Base& profile,
                       const IBL::Opening::Base& opening,
                       float range,
                       const std::string filename,
@@ -1376,17 +1497,20 @@ void init_3D_operator(const IBL::Profile_polar::Base& profile,
     IBL::float2* h_grads = 0;
 
     int len = (NB_SAMPLES_OCU+2)*(NB_SAMPLES_OCU+2)*(NB_SAMPLES_ALPHA+2);
-    bool s = use_cache;
     Vec3i_cu size(NB_SAMPLES_OCU, NB_SAMPLES_OCU, NB_SAMPLES_ALPHA);
     Vec3i_cu pad_off(0, 0, 0);
-    if(use_cache)
+
+    // Operator must be cached => read it in place from the mapped file
+    // (already padded)
+    Cache_file cache;
+    const float*  src_vals  = 0;
+    const float2* src_grads = 0;
+    if(use_cache && open_cache(cache, filename))
     {
-        // Operator must be cached => get it (already padded)
-        h_vals  = new float      [len];
-        h_grads = new IBL::float2[len];
-        s = s && read_array(h_vals , len, get_cache_dir()+"/"+filename+"_vals.opc"  );
-        s = s && read_array(h_grads, len, get_cache_dir()+"/"+filename+"_grads.opc" );
+        src_vals  = cache.table<float >("vals" , len);
+        src_grads = cache.table<float2>("grads", len);
     }
+    bool s = src_vals != 0 && src_grads != 0;
 
     if(!s)
     {
@@ -1396,6 +1520,8 @@ void init_3D_operator(const IBL::Profile_polar::Base& profile,
                                  range,
                                  NB_SAMPLES_OCU, NB_SAMPLES_ALPHA ,
                                  h_vals, h_grads);
+        src_vals  = h_vals;
+        src_grads = (const float2*)h_grads;
     }
     else {
         // as already padded
@@ -1404,8 +1530,8 @@ void init_3D_operator(const IBL::Profile_polar::Base& profile,
     }
 
     // store into new grids
-    Grid3_cu<float >* grid_vals  = new Grid3_cu<float >(size, h_vals          , pad_off);
-    Grid3_cu<float2>* grid_grads = new Grid3_cu<float2>(size, (float2*)h_grads, pad_off);
+    Grid3_cu<float >* grid_vals  = new Grid3_cu<float >(size, src_vals , pad_off);
+    Grid3_cu<float2>* grid_grads = new Grid3_cu<float2>(size, src_grads, pad_off);
 
     // if not cached : padd it as concatenation won't and save it padded
     if( !s)
@@ -1414,14 +1540,21 @@ void init_3D_operator(const IBL::Profile_polar::Base& profile,
         grid_vals-> padd( Vec3i_cu(PADDING, PADDING, PADDING) );
         grid_grads->padd( Vec3i_cu(PADDING, PADDING, PADDING) );
         if ( filename.size() > 0 ){
-            write_array(grid_vals->get_vals().data(), len, get_cache_dir()+"/"+filename+"_vals.opc"  );
-            write_array(grid_grads->get_vals().data(), len, get_cache_dir()+"/"+filename+"_grads.opc" );
+            Cache_file::Writer w = cache_writer();
+            w.add_table("vals" , grid_vals ->get_vals().data(), len);
+            w.add_table("grads", grid_grads->get_vals().data(), len);
+            w.save( cache_path(filename) );
         }
     }
 
-    // record the new operator
-    h_operators_values.push_back( grid_vals  );
-    h_operators_grads. push_back( grid_grads );
+    // record the new operator (replaces the previous one if any)
+    const int slot = op_t - BINARY_3D_OPERATOR_BEGIN - 1;
+    assert(slot >= 0 && slot < NB_PRED_OPS);
+    alloc_predefined_slots();
+    delete h_operators_values[slot];
+    delete h_operators_grads [slot];
+    h_operators_values[slot] = grid_vals;
+    h_operators_grads [slot] = grid_grads;
 
     delete[] h_vals;
     delete[] h_grads;
@@ -1429,79 +1562,39 @@ void init_3D_operator(const IBL::Profile_polar::Base& profile,
 
 // -----------------------------------------------------------------------------
 
+/// Generators of the predefined operators in the order of Op_t
+/// (i.e. indexed like h_operators_enabling[])
+static void (* const predefined_generators[NB_PRED_OPS])(bool) = {
+    init_3D_barths_circle_arc,        // C_L
+    init_3D_barths_circle_diamond,    // C_D
+    init_circle_hyperbola_open,       // C_OH
+    init_circle_hyperbola_closed_h,   // C_HCH
+    init_circle_hyperbola_closed_t,   // C_TCH
+    init_3D_clean_union,              // U_OH
+    init_ultimate_hyperbola_closed_h, // U_HCH
+    init_ultimate_hyperbola_closed_t, // U_TCH
+    init_3D_bulge_in_contact,         // B_OH
+    init_bulge_hyperbola_closed_h,    // B_HCH
+    init_bulge_hyperbola_closed_t,    // B_TCH
+    init_bulge_skinning_closed_t      // B_D
+};
+
+// -----------------------------------------------------------------------------
+
+/// Generate (or load from cache) the enabled predefined operators which are
+/// not generated yet. Disabled operators are left untouched.
 void load_3d_predefined(bool use_cache = true)
 {
-    if ( h_operators_enabling[0] ) {
-        init_3D_barths_circle_arc(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[1] ) {
-        init_3D_barths_circle_diamond(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[2] ) {
-        init_circle_hyperbola_open(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[3] ) {
-        init_circle_hyperbola_closed_h(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[4] ) {
-        init_circle_hyperbola_closed_t(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[5] ) {
-        init_3D_clean_union(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[6] ) {
-        init_ultimate_hyperbola_closed_h(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[7] ) {
-        init_ultimate_hyperbola_closed_t(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[8] ) {
-        init_3D_bulge_in_contact(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[9] ) {
-        init_bulge_hyperbola_closed_h(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[10] ) {
-        init_bulge_hyperbola_closed_t(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
-    }
-    if ( h_operators_enabling[11] ) {
-        init_bulge_skinning_closed_t(use_cache);
-    } else {
-        h_operators_values.push_back(0);
-        h_operators_grads.push_back(0);
+    alloc_predefined_slots();
+    for(int i = 0; i < NB_PRED_OPS; ++i)
+    {
+        if( h_operators_enabling[i] && h_operators_values[i] == 0 )
+        {
+            Timer t; t.start();
+            predefined_generators[i](use_cache);
+            std::cout << "predefined operator " << i << " generated in ";
+            std::cout << t.stop() << " sec" << std::endl;
+        }
     }
 }
 
@@ -1624,6 +1717,7 @@ static void update_map_operators_type_to_id()
 
     d_operators_id.malloc( pred_id.size() );
     d_operators_id.copy_from( pred_id );
+    h_operators_id = pred_id;
 }
 
 // -----------------------------------------------------------------------------
@@ -1644,6 +1738,9 @@ void update_operators()
 {
     unbind();
     assert( !binded );
+    // Operators enabled after init_env() or skipped by init_env_from_cache()
+    // are generated on first use
+    load_3d_predefined();
     // ensure vals and grads for all operators
     assert( h_operators_values.size() == h_operators_grads.size() );
     assert( h_custom_op_vals.  size() == h_custom_op_grads.size() );
@@ -1668,6 +1765,8 @@ void update_operators()
         Cuda_utils::free_d(d_operators_grads);
         d_operators_idx_offsets.erase();
         d_operators_id.erase();
+        h_operators_tex_offsets.clear();
+        h_operators_id.clear();
         return;
     }
 
@@ -1709,6 +1808,7 @@ void update_operators()
     // upload idx
     d_operators_idx_offsets.malloc( indices.size() );
     d_operators_idx_offsets.copy_from( indices );
+    h_operators_tex_offsets = indices;
 
     update_map_operators_type_to_id();
     bind();
@@ -1762,6 +1862,9 @@ void clean_env()
     grid_operators_grads = 0;
     d_operators_idx_offsets.erase();
     d_operators_id.erase();
+    h_operators_tex_offsets.clear();
+    h_operators_id.clear();
+    h_global_controller.clear();
 
     // free gpu memory -----------------
     if(allocated){
@@ -1829,28 +1932,27 @@ Op_id new_op_instance(const IBL::Profile_polar::Base& profile,
 
 Op_id new_op_instance(const std::string &filename)
 {
-    float*       h_vals  = 0;
-    IBL::float2* h_grads = 0;
     int len = (NB_SAMPLES_OCU+2)*(NB_SAMPLES_OCU+2)*(NB_SAMPLES_ALPHA+2);
 
-    h_vals  = new float      [len];
-    h_grads = new IBL::float2[len];
-    bool s = read_array(h_vals , len, get_cache_dir()+"/"+filename+"_vals.opc"  );
-    s = s && read_array(h_grads, len, get_cache_dir()+"/"+filename+"_grads.opc" );
+    Cache_file cache;
+    const float*  h_vals  = 0;
+    const float2* h_grads = 0;
+    if( open_cache(cache, filename) )
+    {
+        h_vals  = cache.table<float >("vals" , len);
+        h_grads = cache.table<float2>("grads", len);
+    }
 
-    if (!s)  assert( false );
+    if (h_vals == 0 || h_grads == 0)  assert( false );
 
     // store the operator into new grids
     Vec3i_cu size(NB_SAMPLES_OCU+2, NB_SAMPLES_OCU+2, NB_SAMPLES_ALPHA+2);
-    Grid3_cu<float >* grid_vals  = new Grid3_cu<float >(size, h_vals          , PADDING_OFFSET);
-    Grid3_cu<float2>* grid_grads = new Grid3_cu<float2>(size, (float2*)h_grads, PADDING_OFFSET);
+    Grid3_cu<float >* grid_vals  = new Grid3_cu<float >(size, h_vals , PADDING_OFFSET);
+    Grid3_cu<float2>* grid_grads = new Grid3_cu<float2>(size, h_grads, PADDING_OFFSET);
 
     // record new operator grids
     h_custom_op_vals.push_back( grid_vals );
     h_custom_op_grads.push_back( grid_grads );
-    // clean function
-    delete[] h_vals;
-    delete[] h_grads;
     // return new op id
     updated = false;
     return h_custom_op_vals.size()-1 + NB_PRED_OPS;
@@ -1885,8 +1987,10 @@ void make_cache(Op_id op_id, const std::string &filename)
     assert( h_custom_op_grads[op_id - NB_PRED_OPS]->size().product() == len);
     if(filename.size() > 0)
     {
-        write_array(&(h_vals [0]), len, get_cache_dir()+"/"+filename+"_vals.opc"  );
-        write_array(&(h_grads[0]), len, get_cache_dir()+"/"+filename+"_grads.opc" );
+        Cache_file::Writer w = cache_writer();
+        w.add_table("vals" , h_vals .data(), len);
+        w.add_table("grads", h_grads.data(), len);
+        w.save( cache_path(filename) );
     }
 }
 
@@ -1894,7 +1998,12 @@ void make_cache(Op_id op_id, const std::string &filename)
 
 void enable_predefined_operator( Op_t op_t, bool on ){
     // TODO: assert() if wrong op types
-    h_operators_enabling[ op_t - BINARY_3D_OPERATOR_BEGIN - 1 ] = on;
+    bool& state = h_operators_enabling[ op_t - BINARY_3D_OPERATOR_BEGIN - 1 ];
+    // Once the environment is allocated the operator will be generated and
+    // uploaded by the next update_operators()
+    if( state != on && allocated )
+        updated = false;
+    state = on;
 }
 
 // -----------------------------------------------------------------------------
@@ -1920,41 +2029,35 @@ void make_cache_env(const std::string &filename)
     if(filename.size() == 0)
         return;
 
-    std::string base_name = get_cache_dir()+"/"+filename;
-
     // save concatenation
     const std::vector<float>&   conc_vals  = grid_operators_values->get_vals();
     const std::vector<float2>&  conc_grads = grid_operators_grads ->get_vals();
-    int conc_len = grid_operators_values->size().product();
+    const Vec3i_cu conc_size = grid_operators_values->size();
 
-    write_array(&(conc_vals [0]), conc_len, base_name+"_conc_vals.opc"  );
-    write_array(&(conc_grads[0]), conc_len, base_name+"_conc_grads.opc" );
+    Cache_file::Writer w = cache_writer();
+    w.set_param("NB_PRED_OPS", NB_PRED_OPS);
+    w.set_param("conc_size_x", conc_size.x);
+    w.set_param("conc_size_y", conc_size.y);
+    w.set_param("conc_size_z", conc_size.z);
+    w.set_param("nb_offsets" , h_operators_idx_offsets.size());
+    w.add_table("conc_vals" , conc_vals. data(), conc_vals. size());
+    w.add_table("conc_grads", conc_grads.data(), conc_grads.size());
 
     // save predefined => done through enabling
     // => cf load predifined comment in init_env_fom_cache method
     // save idx
-    int idx_len = h_operators_idx_offsets.size();
-    write_array(h_operators_idx_offsets.data(), idx_len, base_name+"_offset_idx.opc" );
+    w.add_table("offset_idx", h_operators_idx_offsets.data(), h_operators_idx_offsets.size());
     // save enabling
-    int enab_len = NB_PRED_OPS;
-    write_array(h_operators_enabling, enab_len, base_name+"_pred_state.opc" );
-    // save infos
-    std::ofstream file((base_name+"_infos.opc").c_str(), std::ios_base::out|std::ios_base::trunc);
-    if(!file.is_open()){
-        std::cerr << "Error exporting file " << filename << std::endl;
-        return;
-    }
+    w.add_table("pred_state", h_operators_enabling, NB_PRED_OPS);
 
-    Vec3i_cu s = grid_operators_values->size();
-    file << s.x << " " << s.y << " " << s.z << " " << enab_len << " " << idx_len;
-    file.close();
+    if( !w.save( cache_path(filename) ) )
+        std::cerr << "Error exporting file " << filename << std::endl;
 }
 
 // -----------------------------------------------------------------------------
 
 bool init_env_from_cache(const std::string &filename)
 {
-    std::string base_name = get_cache_dir()+"/"+filename;
     clean_env();
     assert(!binded);
 
@@ -1964,61 +2067,50 @@ bool init_env_from_cache(const std::string &filename)
     init_profile_hyperbola(use_cache);
     init_opening_hyperbola(use_cache);
     // get infos
-    int conc_s_x, conc_s_y, conc_s_z, enab_len, idx_len;
-    std::ifstream file((base_name+"_infos.opc").c_str(), std::ios_base::in);
-    if(!file.is_open()){
+    Cache_file cache;
+    if( !open_cache(cache, filename) ){
         std::cerr << "Cache doesn't exists: " << filename << std::endl;
         clean_env();
         return false;
     }
-    file >> conc_s_x  >> conc_s_y  >> conc_s_z  >>
-            enab_len >> idx_len;
-    file.close();
-    Vec3i_cu conc_size(conc_s_x, conc_s_y, conc_s_z);
-    // restore enabling
-    if(enab_len != NB_PRED_OPS){
+    int64_t conc_s_x, conc_s_y, conc_s_z, idx_len;
+    bool s = cache.check_param("NB_PRED_OPS", NB_PRED_OPS);
+    s = s && cache.get_param("conc_size_x", conc_s_x);
+    s = s && cache.get_param("conc_size_y", conc_s_y);
+    s = s && cache.get_param("conc_size_z", conc_s_z);
+    s = s && cache.get_param("nb_offsets" , idx_len );
+    if( !s ){
         clean_env();
         return false;
     }
+    Vec3i_cu conc_size((int)conc_s_x, (int)conc_s_y, (int)conc_s_z);
 
-    Cuda_utils::HA_bool enabled( NB_PRED_OPS );
-    if(!read_array(enabled.ptr(), NB_PRED_OPS, base_name+"_pred_state.opc")){
-        clean_env();
-        return false;
-    }
+    // restore enabling
+    const bool* enabled = cache.table<bool>("pred_state", NB_PRED_OPS);
     // test if same config, else return false
-    for(int i = 0; i < NB_PRED_OPS; ++i){
-        if (enabled[i] != h_operators_enabling[i]){
-            clean_env();
-            return false;
-        }
+    for(int i = 0; i < NB_PRED_OPS && enabled; ++i){
+        if (enabled[i] != h_operators_enabling[i])
+            enabled = 0;
     }
 
-    // then idx
-    h_operators_idx_offsets.resize( idx_len );
-    if (!read_array(h_operators_idx_offsets.data(), idx_len, base_name+"_offset_idx.opc" )){
-        clean_env();
-        return false;
-    }
-    // then concatenation
+    // then idx and concatenation, read in place from the mapped file
     int conc_len = conc_size.product();
-    std::vector<float>  conc_vals ( conc_len );
-    std::vector<float2> conc_grads( conc_len );
-    if (!read_array( &(conc_vals[0]), conc_len, base_name+"_conc_vals.opc" )){
+    const Idx3_cu* offsets    = cache.table<Idx3_cu>("offset_idx", (size_t)idx_len);
+    const float*   conc_vals  = cache.table<float  >("conc_vals" , conc_len);
+    const float2*  conc_grads = cache.table<float2 >("conc_grads", conc_len);
+    if( !enabled || !offsets || !conc_vals || !conc_grads ){
         clean_env();
         return false;
     }
 
-    if (!read_array( &(conc_grads[0]), conc_len, base_name+"_conc_grads.opc" )){
-        clean_env();
-        return false;
-    }
+    h_operators_idx_offsets.assign(offsets, offsets + idx_len);
     delete grid_operators_values;
-    grid_operators_values = new Grid3_cu<float>( conc_size, &(conc_vals[0]) );
+    grid_operators_values = new Grid3_cu<float>( conc_size, conc_vals );
     delete grid_operators_grads;
-    grid_operators_grads = new Grid3_cu<float2>( conc_size, &(conc_grads[0]) );
-    // then predefined
-    load_3d_predefined(); // quicker than conc pred when save and retrieve from conc_grids
+    grid_operators_grads = new Grid3_cu<float2>( conc_size, conc_grads );
+    // Predefined grids are only needed to build a new concatenation:
+    // update_operators() loads them when needed
+    alloc_predefined_slots();
 
     // todo with new env archi
     init_4D_bulge_in_contact(use_cache);
@@ -2043,6 +2135,7 @@ bool init_env_from_cache(const std::string &filename)
         indices[i] = h_operators_idx_offsets[i].to_int4();
     d_operators_idx_offsets.malloc( indices.size() );
     d_operators_idx_offsets.copy_from( indices );
+    h_operators_tex_offsets = indices;
     // upload pred ids
     std::vector<int> pred_id(NB_PRED_OPS, -1);
     int id = 0;
@@ -2054,6 +2147,7 @@ bool init_env_from_cache(const std::string &filename)
     }
     d_operators_id.malloc( pred_id.size() );
     d_operators_id.copy_from( pred_id );
+    h_operators_id = pred_id;
 
     bind();
     return true;
@@ -2071,6 +2165,7 @@ void set_global_ctrl_shape(const IBL::Ctrl_setup& shape)
 
     int data_size = NB_SAMPLES * sizeof(float2);
     CUDA_SAFE_CALL(cudaMemcpyToArray(d_global_controller, 0, 0, (float2*)controller, data_size, cudaMemcpyHostToDevice));
+    h_global_controller.assign((float2*)controller, (float2*)controller + NB_SAMPLES);
 
     delete[] controller;
 
@@ -2109,4 +2204,138 @@ void set_ricci_n(float N)
     CUDA_SAFE_CALL(cudaBindTexture(0, n_3D_ricci_tex, d_n_3D_ricci, sizeof(float)));
 }
 
+// =============================================================================
+// Host fetch
+// =============================================================================
+
+static inline float  lerp(float  a, float  b, float t){ return a + (b - a) * t; }
+
+static inline float2 lerp(float2 a, float2 b, float t){
+    return make_float2(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Split a texel coordinate into the two clamped texels to interpolate
+/// like cudaFilterModeLinear with cudaAddressModeClamp does
+static inline void tex_coord(float x, int len, int& i0, int& i1, float& t)
+{
+    x -= 0.5f;
+    float fl = floorf(x);
+    t  = x - fl;
+    i0 = (int)fl;
+    i1 = i0 + 1;
+    i0 = i0 < 0 ? 0 : (i0 >= len ? len-1 : i0);
+    i1 = i1 < 0 ? 0 : (i1 >= len ? len-1 : i1);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Host equivalent to tex1D() (unnormalized texel coordinates)
+template<class T>
+static T tex1D_host(const T* vals, int len, float x)
+{
+    int i0, i1; float t;
+    tex_coord(x, len, i0, i1, t);
+    return lerp(vals[i0], vals[i1], t);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Host equivalent to tex2D() (unnormalized texel coordinates)
+template<class T>
+static T tex2D_host(const T* vals, int2 size, float x, float y)
+{
+    int x0, x1, y0, y1; float tx, ty;
+    tex_coord(x, size.x, x0, x1, tx);
+    tex_coord(y, size.y, y0, y1, ty);
+    T a = lerp(vals[x0 + y0*size.x], vals[x1 + y0*size.x], tx);
+    T b = lerp(vals[x0 + y1*size.x], vals[x1 + y1*size.x], tx);
+    return lerp(a, b, ty);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Host equivalent to tex3D() (unnormalized texel coordinates)
+template<class T>
+static T tex3D_host(const Grid3_cu<T>* grid, float x, float y, float z)
+{
+    const Vec3i_cu s = grid->size();
+    const T* vals = &(grid->get_vals()[0]);
+    int x0, x1, y0, y1, z0, z1; float tx, ty, tz;
+    tex_coord(x, s.x, x0, x1, tx);
+    tex_coord(y, s.y, y0, y1, ty);
+    tex_coord(z, s.z, z0, z1, tz);
+    const int sxy = s.x * s.y;
+    T a = lerp(vals[x0 + y0*s.x + z0*sxy], vals[x1 + y0*s.x + z0*sxy], tx);
+    T b = lerp(vals[x0 + y1*s.x + z0*sxy], vals[x1 + y1*s.x + z0*sxy], tx);
+    T c = lerp(vals[x0 + y0*s.x + z1*sxy], vals[x1 + y0*s.x + z1*sxy], tx);
+    T d = lerp(vals[x0 + y1*s.x + z1*sxy], vals[x1 + y1*s.x + z1*sxy], tx);
+    return lerp(lerp(a, b, ty), lerp(c, d, ty), tz);
+}
+
+// -----------------------------------------------------------------------------
+
+float hyperbola_fetch_host(float x){
+    return tex1D_host(h_hyperbola_profile, NB_SAMPLES, x);
+}
+
+float2 hyperbola_normal_fetch_host(float x){
+    return tex1D_host(h_hyperbola_normals_profile, NB_SAMPLES, x);
+}
+
+float skin_fetch_host(float x){
+    return tex1D_host(h_bulge_profile, NB_SAMPLES, x);
+}
+
+float2 skin_normal_fetch_host(float x){
+    return tex1D_host(h_bulge_normals_profile, NB_SAMPLES, x);
+}
+
+// -----------------------------------------------------------------------------
+
+float2 global_controller_fetch_host(float x)
+{
+    const int len = (int)h_global_controller.size();
+    return tex1D_host(&(h_global_controller[0]), len, x * len);
+}
+
+// -----------------------------------------------------------------------------
+
+float2 controller_fetch_host(float x, float y)
+{
+    return tex2D_host(h_controllers.ptr(), ctrl_max_size_2D(), x, y);
+}
+
+// -----------------------------------------------------------------------------
+
+int4 operator_idx_offset_fetch_host(Op_id op_id)
+{
+    assert(op_id >= 0 && op_id < (int)h_operators_tex_offsets.size());
+    return h_operators_tex_offsets[op_id];
+}
+
+// -----------------------------------------------------------------------------
+
+float operator_fetch_host(float x, float y, float z)
+{
+    return tex3D_host(grid_operators_values, x, y, z);
+}
+
+// -----------------------------------------------------------------------------
+
+float2 operator_grad_fetch_host(float x, float y, float z)
+{
+    return tex3D_host(grid_operators_grads, x, y, z);
+}
+
+// -----------------------------------------------------------------------------
+
+Op_id predefined_op_id_fetch_host(int id_opt)
+{
+    if(id_opt < 0 || id_opt >= (int)h_operators_id.size())
+        return -1;
+    return h_operators_id[id_opt];
+}
+
 }// END PRECOMPUTED FUNCTIONS ==================================================
@@ -17,6 +17,7 @@
  */
 
 #include <cstdio>
+#include <map>
 #include "cuda_utils.hpp"
 #include "idx3_cu.hpp"
 
@@ -149,6 +150,10 @@ void delete_ctrl_instance(Ctrl_id inst_id);
 
 void update_controller(Ctrl_id inst_id, const IBL::Ctrl_setup& shape);
 
+/// Same as update_controller() for several instances with a single upload
+/// @param shapes : map of controller instance ids to their new shapes
+void update_controllers(const std::map<Ctrl_id, IBL::Ctrl_setup>& shapes);
+
 IBL::Ctrl_setup get_global_ctrl_shape();
 
 float eval_global_ctrl(float dot);
@@ -200,7 +205,8 @@ extern Cuda_utils::Device::Array<Op_id> d_operators_id;
 /// enabled predefined operators and activates custom operators
 void init_env();
 
-/// upload operators to gpu memory
+/// upload operators to gpu memory. Enabled predefined operators not yet
+/// generated are computed (or read from their cache) beforehand.
 void update_operators();
 
 /// clean all operators (enabled predefined and custom)
@@ -242,7 +248,8 @@ void make_cache(Op_id op_id, const std::string &filename);
 // -----------------------------------------------------------------------------
 
 /// Enables or disables the specified predefined operator according to 'on'
-/// @warning Acts only when init_env() or reset_env() are called
+/// Only enabled operators are generated. When called after init_env() the
+/// operator is generated on first use i.e. by the next update_operators()
 void enable_predefined_operator( Op_t op_t, bool on );
 
 /// @return number of predefined operators enabled through
@@ -263,6 +270,31 @@ void make_cache_env(const std::string &filename);
 /// successfull, @see Blending_env is left cleaned.
 bool init_env_from_cache(const std::string &filename);
 
+// -----------------------------------------------------------------------------
+/// @name Host fetch
+/// Host counterparts of the texture fetches. They read the host copies of the
+/// profiles, controllers and concatenated operators with the same linear
+/// interpolation and clamping as the textures. The fetch functions of
+/// 'blending_env.inl' call them when compiled for the host.
+// -----------------------------------------------------------------------------
+
+float  hyperbola_fetch_host       (float x);
+float2 hyperbola_normal_fetch_host(float x);
+float  skin_fetch_host            (float x);
+float2 skin_normal_fetch_host     (float x);
+
+/// @param x texture coordinate in [0 1] (normalized texture)
+float2 global_controller_fetch_host(float x);
+/// @param x, y texture coordinates (texels) in the controllers grid
+float2 controller_fetch_host(float x, float y);
+
+int4   operator_idx_offset_fetch_host(Op_id op_id);
+/// @param x, y, z texture coordinates (texels) in the concatenated operators
+float  operator_fetch_host     (float x, float y, float z);
+float2 operator_grad_fetch_host(float x, float y, float z);
+
+Op_id predefined_op_id_fetch_host(int id_opt);
+
 
 
 
@@ -319,16 +351,16 @@ bool init_env_from_cache(const std::string &filename);
     // -------------------------------------------------------------------------
 
     // profile functions fetch -------------------------------------------------
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float hyperbola_fetch(float tan_t);
 
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 hyperbola_normal_fetch(float tan_t);
 
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float skin_fetch(float tan_t);
 
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 skin_normal_fetch(float tan_t);
 
     __device__
@@ -346,17 +378,17 @@ bool init_env_from_cache(const std::string &filename);
 
     // operator fetch for OH ---------------------------------------------------
     // used for U_OH
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float openable_clean_union_fetch(float f1, float f2, float tan_alpha);
 
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 openable_clean_union_gradient_fetch(float f1, float f2, float tan_alpha);
 
     // used for B_OH
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float openable_clean_skin_fetch(float f1, float f2, float tan_alpha);
 
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 openable_clean_skin_gradient_fetch(float f1, float f2, float tan_alpha);
     // -------------------------------------------------------------------------
 
@@ -385,12 +417,12 @@ bool init_env_from_cache(const std::string &filename);
 
     /// @param dot Is the angle between two gradient given by the dot product
     /// i.e cos(teta)
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 global_controller_fetch(float dot);
 
     /// @param dot Is the angle between two gradient given by the dot product
     /// i.e cos(teta)
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 controller_fetch(int inst_id, float dot);
 
     // =========================================================================
@@ -415,15 +447,15 @@ bool init_env_from_cache(const std::string &filename);
     extern texture<float , 3, cudaReadModeElementType> tex_operators_values;
     extern texture<float2, 3, cudaReadModeElementType> tex_operators_grads;
 
-    __device__
+    IF_CUDA_DEVICE_HOST
     static Idx3_cu operator_idx_offset_fetch(Op_id op_id);
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float operator_fetch(Idx3_cu tex_idx, float f1, float f2 ,float tan_alpha);
-    __device__
+    IF_CUDA_DEVICE_HOST
     static float2 operator_grad_fetch(Idx3_cu tex_idx, float f1, float f2, float tan_alpha);
 
     /// @returns the identifier attached to the op_t predefined operator
-    __device__
+    IF_CUDA_DEVICE_HOST
     static Op_id predefined_op_id_fetch( Op_t op_t );
     // -----------------------------------------------------------------------------
 
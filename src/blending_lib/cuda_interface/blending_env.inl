@@ -22,24 +22,40 @@ static float pan_hyperbola_fetch(float t){
 // -----------------------------------------------------------------------------
 
 // profile functions fetch -------------------------------------------------
-__device__ static float
+IF_CUDA_DEVICE_HOST static float
 hyperbola_fetch(float tan_t){
+    #ifdef __CUDA_ARCH__
     return TL1D(profile_hyperbola_tex,tan_t,NB_SAMPLES);
+    #else
+    return hyperbola_fetch_host((NB_SAMPLES-1)*tan_t+0.5f);
+    #endif
 }
 
-__device__ static float2
+IF_CUDA_DEVICE_HOST static float2
 hyperbola_normal_fetch(float tan_t){
+    #ifdef __CUDA_ARCH__
     return TL1D(profile_hyperbola_normals_tex,tan_t,NB_SAMPLES);
+    #else
+    return hyperbola_normal_fetch_host((NB_SAMPLES-1)*tan_t+0.5f);
+    #endif
 }
 
-__device__ static float
+IF_CUDA_DEVICE_HOST static float
 skin_fetch(float tan_t){
+    #ifdef __CUDA_ARCH__
     return TL1D(profile_bulge_tex,tan_t,NB_SAMPLES);
+    #else
+    return skin_fetch_host((NB_SAMPLES-1)*tan_t+0.5f);
+    #endif
 }
 
-__device__ static float2
+IF_CUDA_DEVICE_HOST static float2
 skin_normal_fetch(float tan_t){
+    #ifdef __CUDA_ARCH__
     return TL1D(profile_bulge_normals_tex,tan_t,NB_SAMPLES);
+    #else
+    return skin_normal_fetch_host((NB_SAMPLES-1)*tan_t+0.5f);
+    #endif
 }
 
 __device__
@@ -76,7 +92,7 @@ static float2 profile_ricci_4D_normal_fetch(float tan_t, float N)
 
 // operator fetch for *_OH -----------------------------------------------------
 // used for U_OH
-__device__ static float
+IF_CUDA_DEVICE_HOST static float
 openable_clean_union_fetch(float f1, float f2, float tan_alpha){
     Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::U_OH );
     if (id < 0)
@@ -85,7 +101,7 @@ openable_clean_union_fetch(float f1, float f2, float tan_alpha){
     return operator_fetch(idx, f1*2.f, f2*2.f, tan_alpha);
 }
 
-__device__ static float2
+IF_CUDA_DEVICE_HOST static float2
 openable_clean_union_gradient_fetch(float f1, float f2, float tan_alpha){
     Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::U_OH );
     if (id < 0)
@@ -94,7 +110,7 @@ openable_clean_union_gradient_fetch(float f1, float f2, float tan_alpha){
     return operator_grad_fetch(idx, f1*2.f, f2*2.f, tan_alpha);
 }
 // used for B_OH
-__device__ static float
+IF_CUDA_DEVICE_HOST static float
 openable_clean_skin_fetch(float f1, float f2, float tan_alpha){
     Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::B_OH );
     if (id < 0)
@@ -103,7 +119,7 @@ openable_clean_skin_fetch(float f1, float f2, float tan_alpha){
     return operator_fetch(idx, f1*2.f, f2*2.f, tan_alpha);
 }
 
-__device__ static float2
+IF_CUDA_DEVICE_HOST static float2
 openable_clean_skin_gradient_fetch(float f1, float f2, float tan_alpha){
     Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::B_OH );
     if (id < 0)
@@ -218,12 +234,16 @@ openable_ricci_4D_gradient_fetch(float f1, float f2, float tan_alpha, float N)
 
 
 
-__device__ static float2
+IF_CUDA_DEVICE_HOST static float2
 global_controller_fetch(float dot){
+    #ifdef __CUDA_ARCH__
     return tex1D(global_controller_tex, dot * 0.5f + 0.5f);
+    #else
+    return global_controller_fetch_host(dot * 0.5f + 0.5f);
+    #endif
 }
 
-__device__
+IF_CUDA_DEVICE_HOST
 static float2 controller_fetch(int inst_id, float dot){
 
     int2 bidx_2D = {inst_id  %  BLOCK_CTRL_LX, inst_id   / BLOCK_CTRL_LX  };
@@ -231,9 +251,14 @@ static float2 controller_fetch(int inst_id, float dot){
 
     const float off = 1/*padding*/ + 0.5f/*linear interpolation*/ + (dot * 0.5f + 0.5f) * (NB_SAMPLES-1);
 
+    #ifdef __CUDA_ARCH__
     return tex2D(tex_controllers,
                  (float)gidx_2D.x + off,
                  (float)gidx_2D.y + 1.f/*middle column*/ + 0.5f /*linear interpolation*/);
+    #else
+    return controller_fetch_host((float)gidx_2D.x + off,
+                                 (float)gidx_2D.y + 1.f + 0.5f);
+    #endif
 }
 
 // =============================================================================
@@ -241,36 +266,56 @@ static float2 controller_fetch(int inst_id, float dot){
 // =============================================================================
 // ======================  TEST with new env archi  ============================
 // =============================================================================
-__device__ static Idx3_cu operator_idx_offset_fetch(Op_id op_id){
+IF_CUDA_DEVICE_HOST static Idx3_cu operator_idx_offset_fetch(Op_id op_id){
 
+    #ifdef __CUDA_ARCH__
     const int4 i = tex1Dfetch( tex_pred_operators_idx_offsets, op_id );
+    #else
+    const int4 i = operator_idx_offset_fetch_host( op_id );
+    #endif
     return Idx3_cu(Vec3i_cu(i.x, i.y, i.z), i.w);
 }
 
-__device__ static float
+IF_CUDA_DEVICE_HOST static float
 operator_fetch(Idx3_cu tex_idx, float f1, float f2 ,float tan_alpha){
     int a, b, c;
     tex_idx.to_3d(a, b, c);
+    #ifdef __CUDA_ARCH__
     return tex3D(tex_operators_values, a+f1*(NB_SAMPLES_OCU-1)+0.5f,
                                        b+f2*(NB_SAMPLES_OCU-1)+0.5f,
                                        c+tan_alpha*(NB_SAMPLES_ALPHA-1)+0.5f)*0.5f;
+    #else
+    return operator_fetch_host(a+f1*(NB_SAMPLES_OCU-1)+0.5f,
+                               b+f2*(NB_SAMPLES_OCU-1)+0.5f,
+                               c+tan_alpha*(NB_SAMPLES_ALPHA-1)+0.5f)*0.5f;
+    #endif
 }
 
-__device__ static float2
+IF_CUDA_DEVICE_HOST static float2
 operator_grad_fetch(Idx3_cu tex_idx, float f1, float f2, float tan_alpha){
     int a, b, c;
     tex_idx.to_3d(a, b, c);
+    #ifdef __CUDA_ARCH__
     return tex3D(tex_operators_grads, a+f1*(NB_SAMPLES_OCU-1)+0.5f,
                                       b+f2*(NB_SAMPLES_OCU-1)+0.5f,
                                       c+tan_alpha*(NB_SAMPLES_ALPHA-1)+0.5f);
+    #else
+    return operator_grad_fetch_host(a+f1*(NB_SAMPLES_OCU-1)+0.5f,
+                                    b+f2*(NB_SAMPLES_OCU-1)+0.5f,
+                                    c+tan_alpha*(NB_SAMPLES_ALPHA-1)+0.5f);
+    #endif
 }
 
-__device__ static Op_id
+IF_CUDA_DEVICE_HOST static Op_id
 predefined_op_id_fetch(Op_t op_t)
 {
     // TODO: assert if wrong type of operators
     int id_opt = op_t - BINARY_3D_OPERATOR_BEGIN - 1;
+    #ifdef __CUDA_ARCH__
     return tex1Dfetch(tex_pred_operators_id, id_opt);
+    #else
+    return predefined_op_id_fetch_host(id_opt);
+    #endif
 }
 // -----------------------------------------------------------------------------
 
@@ -29,7 +29,7 @@ public:
     __device__ __host__ inline
     Dyn_circle_anim(int ctrl_id) : _ctrl_id(ctrl_id) {}
 
-    __device__ inline
+    IF_CUDA_DEVICE_HOST inline
     float f(float f1, float f2, const Vec3_cu& gf1, const Vec3_cu& gf2) const
     {
         Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::C_D );
@@ -38,7 +38,7 @@ public:
         return Dyn_Operator3D_cu(id, _ctrl_id).f(f1, f2, gf1, gf2);
     }
 
-    __device__ inline
+    IF_CUDA_DEVICE_HOST inline
     Vec3_cu gf(float f1, float f2, const Vec3_cu& gf1, const Vec3_cu& gf2)  const
     {
         Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::C_D );
@@ -47,7 +47,7 @@ public:
         return Dyn_Operator3D_cu(id, _ctrl_id).gf(f1, f2, gf1, gf2);
     }
 
-    __device__ inline
+    IF_CUDA_DEVICE_HOST inline
     float fngf(Vec3_cu& gf, float f1, float f2, const Vec3_cu& gf1, const Vec3_cu& gf2) const
     {
         Blending_env::Op_id id = Blending_env::predefined_op_id_fetch( Blending_env::C_D );
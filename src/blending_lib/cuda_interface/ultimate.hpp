@@ -41,7 +41,7 @@ typedef UltimateOperator<E_OCU::BULGE> BulgeInContact;
 template <E_OCU::Union_t type>
 struct OCU {
 
-    __device__ static inline
+    IF_CUDA_DEVICE_HOST static inline
     float f(float f1, float f2, float tan_alpha)
     {
         if(type == E_OCU::BLEND && Blending_env::predefined_op_id_fetch(Blending_env::U_OH) == -1){
@@ -74,7 +74,7 @@ struct OCU {
         return fmaxf(f1, f2);
     }
 
-    __device__ static inline
+    IF_CUDA_DEVICE_HOST static inline
     float2 gf(float f1, float f2, float tan_alpha)
     {
         if(type == E_OCU::BLEND && Blending_env::predefined_op_id_fetch(Blending_env::U_OH) == -1){
@@ -112,7 +112,7 @@ struct OCU {
     }
 
 
-    __device__ static inline
+    IF_CUDA_DEVICE_HOST static inline
     float fngf(float2& gf, float f1, float f2, float tan_alpha)
     {
         if(type == E_OCU::BLEND && Blending_env::predefined_op_id_fetch(Blending_env::U_OH) == -1){
@@ -176,7 +176,7 @@ struct OCU {
 template <E_OCU::Union_t type>
 struct UltimateOperator{
 
-    __device__ static inline
+    IF_CUDA_DEVICE_HOST static inline
     float f(float f1, float f2, const Vec3_cu& gf1, const Vec3_cu& gf2){
         Vec3_cu gf1n = gf1.normalized();
         Vec3_cu gf2n = gf2.normalized();
@@ -187,7 +187,7 @@ struct UltimateOperator{
     }
 
 
-    __device__ static inline
+    IF_CUDA_DEVICE_HOST static inline
     Vec3_cu gf(float f1, float f2, const Vec3_cu& gf1, const Vec3_cu& gf2){
         Vec3_cu gf1n = gf1.normalized();
         Vec3_cu gf2n = gf2.normalized();
@@ -197,7 +197,7 @@ struct UltimateOperator{
         return gf1 * gd.x + gf2 * gd.y;
     }
 
-    __device__ static inline
+    IF_CUDA_DEVICE_HOST static inline
     float fngf(Vec3_cu& gf, float f1, float f2, const Vec3_cu& gf1, const Vec3_cu& gf2){
         Vec3_cu gf1n = gf1.normalized();
         Vec3_cu gf2n = gf2.normalized();
@@ -3,6 +3,7 @@
 #include "controller_tools.hpp"
 #include "controller.hpp"
 #include "funcs.hpp"
+#include "thread_pool.hpp"
 
 #include <iostream>
 #include <cassert>
@@ -349,13 +350,17 @@ void gen_custom_operator(const Profile_polar::Base& profile,
     IBL::double2* gradient = new IBL::double2[size];
 
     // Init arrays
-    for(int i = 0; i < size; i++){
-        values  [i] = -1.;
-        gradient[i] = IBL::make_double2(0., 0.);
-    }
+    Thread_pool::get().parallel_for(size, 1 << 16, [&](int begin, int end){
+        for(int i = begin; i < end; i++){
+            values  [i] = -1.;
+            gradient[i] = IBL::make_double2(0., 0.);
+        }
+    });
 
     //float step_i = range / (float)(nb_samples_ocu-1);
-    for(int alpha = 0; alpha < nb_samples_alpha; alpha++) // Fill values by opening angles
+    // Opening angles are independent: slices are filled in parallel
+    Thread_pool::get().parallel_for(nb_samples_alpha, 1, [&](int alpha_begin, int alpha_end){
+    for(int alpha = alpha_begin; alpha < alpha_end; alpha++) // Fill values by opening angles
     {
         int offset = alpha * nb_samples_ocu*nb_samples_ocu;
         values[offset] = 0.;
@@ -435,6 +440,16 @@ void gen_custom_operator(const Profile_polar::Base& profile,
                 }
             }
         }
+    }
+    });
+
+    // Smoothing reads the neighbor slices so slices are processed in order.
+    // Next slices are not filled yet in the sequential version (i.e. -1)
+    for(int alpha = 0; alpha < nb_samples_alpha; alpha++)
+    {
+        const int offset = alpha * nb_samples_ocu*nb_samples_ocu;
+        const int next_slice = offset + nb_samples_ocu*nb_samples_ocu;
+        auto fetch = [&](int idx) { return idx < next_slice ? values[idx] : -1.; };
 
         // Smoothing values
 #if 1
@@ -448,25 +463,25 @@ void gen_custom_operator(const Profile_polar::Base& profile,
                     double acc = 0.;
                     int nb = 0;
                     assert(((i-1) + j*nb_samples_ocu + offset) < size);
-                    double v0 = values[i-1 + j *nb_samples_ocu + offset];
+                    double v0 = fetch(i-1 + j *nb_samples_ocu + offset);
                     if(v0 > -1.){
                         acc += v0;
                         nb++;
                     }
                     assert(((i+1) + j*nb_samples_ocu + offset) < size);
-                    v0 = values[i+1 + j *nb_samples_ocu + offset];
+                    v0 = fetch(i+1 + j *nb_samples_ocu + offset);
                     if(v0 > -1.){
                         acc += v0;
                         nb++;
                     }
                     assert((i + (j-1)*nb_samples_ocu + offset) < size);
-                    v0 = values[i + (j-1)*nb_samples_ocu + offset];
+                    v0 = fetch(i + (j-1)*nb_samples_ocu + offset);
                     if(v0 > -1.){
                         acc += v0;
                         nb++;
                     }
                     assert((i + (j+1)*nb_samples_ocu + offset) < size);
-                    v0 = values[i + (j+1)*nb_samples_ocu + offset];
+                    v0 = fetch(i + (j+1)*nb_samples_ocu + offset);
                     if(v0 > -1.){
                         acc += v0;
                         nb++;
@@ -476,7 +491,12 @@ void gen_custom_operator(const Profile_polar::Base& profile,
             }
         }
 #endif
+    }
 
+    Thread_pool::get().parallel_for(nb_samples_alpha, 1, [&](int alpha_begin, int alpha_end){
+    for(int alpha = alpha_begin; alpha < alpha_end; alpha++)
+    {
+        const int offset = alpha * nb_samples_ocu*nb_samples_ocu;
 
         //compute gradient with finite differences
         for(int i = 1; i < nb_samples_ocu-1; i++)
@@ -527,18 +547,20 @@ void gen_custom_operator(const Profile_polar::Base& profile,
         gradient[nb_samples_ocu*nb_samples_ocu-1   + offset] = IBL::make_double2(0.620133, 0.620133);
 
         //printf("\r %f per cents done",(alpha+1)*100.f/NB_SAMPLES_ALPHA);fflush(stdout);//-------------
-
     } // END FOR( NB_SAMPLES_ALPHA )
+    });
 
     out_values    = new float      [size];
     out_gradients = new IBL::float2[size];
 
     // Init arrays
-    for(int i = 0; i < size; i++){
-        out_values   [i]   = (float)values  [i];
-        out_gradients[i].x = (float)gradient[i].x;
-        out_gradients[i].y = (float)gradient[i].y;
-    }
+    Thread_pool::get().parallel_for(size, 1 << 16, [&](int begin, int end){
+        for(int i = begin; i < end; i++){
+            out_values   [i]   = (float)values  [i];
+            out_gradients[i].x = (float)gradient[i].x;
+            out_gradients[i].y = (float)gradient[i].y;
+        }
+    });
     delete [] values;
     delete [] gradient;
 }
@@ -1,6 +1,7 @@
 #include "sample_set.hpp"
 #include "skeleton.hpp"
 #include "animesh_hrbf_heuristic.hpp"
+#include "thread_pool.hpp"
 
 #include <sstream>
 
@@ -9,6 +10,33 @@ void SampleSet::SampleSet::choose_hrbf_samples(const Mesh *mesh, const Skeleton
     if(!skel->is_bone(bone_id))
         return;
 
+    sample_bone(mesh, skel, vertToBoneInfo, settings, bone_id, _samples[bone_id]);
+}
+
+void SampleSet::SampleSet::choose_hrbf_samples(const Mesh *mesh, const Skeleton *skel, const VertToBoneInfo &vertToBoneInfo, const SampleSetSettings &settings)
+{
+    // Create every entry first, so the bones can be sampled concurrently.
+    std::vector<Bone::Id> bone_ids;
+    std::vector<InputSample *> outputs;
+    for(Bone::Id bone_id: skel->get_bone_ids())
+    {
+        // Same as the per bone overload, joints without a bone get no samples
+        if(!skel->is_bone(bone_id))
+            continue;
+
+        bone_ids.push_back(bone_id);
+        outputs.push_back(&_samples[bone_id]);
+    }
+
+    const int nb_bones = (int) bone_ids.size();
+    Thread_pool::get().parallel_for(nb_bones, 1, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i)
+            sample_bone(mesh, skel, vertToBoneInfo, settings, bone_ids[i], *outputs[i]);
+    });
+}
+
+void SampleSet::SampleSet::sample_bone(const Mesh *mesh, const Skeleton *skel, const VertToBoneInfo &vertToBoneInfo, const SampleSetSettings &settings, int bone_id, InputSample &out) const
+{
     if(settings.mode == SampleSetSettings::AdHoc)
     {
         Adhoc_sampling heur(mesh, skel, vertToBoneInfo);
@@ -19,11 +47,10 @@ void SampleSet::SampleSet::choose_hrbf_samples(const Mesh *mesh, const Skeleton
         heur._fold = settings.fold;
         heur._factor_siblings = false;
 
-        _samples[bone_id].nodes.  clear();
-        _samples[bone_id].n_nodes.clear();
+        out.nodes.  clear();
+        out.n_nodes.clear();
 
-        heur.sample(_samples[bone_id].nodes,
-                    _samples[bone_id].n_nodes);
+        heur.sample(out.nodes, out.n_nodes);
     }
     else
     {
@@ -36,21 +63,21 @@ void SampleSet::SampleSet::choose_hrbf_samples(const Mesh *mesh, const Skeleton
         heur._fold = settings.fold;
         heur._factor_siblings = false;
 
-        _samples[bone_id].nodes.  clear();
-        _samples[bone_id].n_nodes.clear();
+        out.nodes.  clear();
+        out.n_nodes.clear();
 
-        heur.sample(_samples[bone_id].nodes, _samples[bone_id].n_nodes);
+        heur.sample(out.nodes, out.n_nodes);
     }
 
     // Don't add caps if we don't have any actual samples.
-    if(_samples[bone_id].nodes.empty())
+    if(out.nodes.empty())
         return;
 
     if(settings.jcap)
-        compute_jcaps(*skel, settings, bone_id, _samples[bone_id]);
+        compute_jcaps(*skel, settings, bone_id, out);
 
     if(settings.pcap)
-        compute_pcaps(*skel, settings, bone_id, _samples[bone_id]);
+        compute_pcaps(*skel, settings, bone_id, out);
 }
 
 void SampleSet::SampleSet::compute_jcaps(const Skeleton &skel, const SampleSetSettings &settings, int bone_id, InputSample &out) const
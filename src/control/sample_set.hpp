@@ -89,9 +89,16 @@ struct SampleSet
     // Automatically choose samples for the given bone.
     void choose_hrbf_samples(const Mesh *mesh, const Skeleton *skel, const VertToBoneInfo &vertToBoneInfo, const SampleSetSettings &settings, int bone_id);
 
+    // Automatically choose samples for every bone of the skeleton.  Bones are sampled in
+    // parallel.
+    void choose_hrbf_samples(const Mesh *mesh, const Skeleton *skel, const VertToBoneInfo &vertToBoneInfo, const SampleSetSettings &settings);
+
     void get_all_bone_samples(Bone::Id bone_id, InputSample &out) const;
 
 private:
+    /// Choose the samples of a bone and store them in 'out', which is cleared first.
+    void sample_bone(const Mesh *mesh, const Skeleton *skel, const VertToBoneInfo &vertToBoneInfo, const SampleSetSettings &settings, int bone_id, InputSample &out) const;
+
     /// Compute caps at the tip of the bone to close the hrbf
     void compute_jcaps(const Skeleton &skel, const SampleSetSettings &settings, int bone_id, InputSample &out) const;
 
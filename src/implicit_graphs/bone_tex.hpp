@@ -40,6 +40,13 @@ struct Bone_tex {
         hd_bone_precomputed.update_device_mem();
     }
 
+    /// Upload the bones [start, start+nb_elt)
+    void update_device_mem(int start, int nb_elt){
+        hd_bone_types.      update_device_mem(start, nb_elt);
+        hd_bone_hrbf.       update_device_mem(start, nb_elt);
+        hd_bone_precomputed.update_device_mem(start, nb_elt);
+    }
+
 };
 
 }// END SKELETON_ENV NAMESPACE ================================================
@@ -0,0 +1,191 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// =============================================================================
+namespace Skeleton_env {
+// =============================================================================
+
+/// Maximum number of primitives in a leaf
+#define BVH_LEAF_SIZE 2
+
+// -----------------------------------------------------------------------------
+
+bool Bvh::has_prim(const Bone* bone)
+{
+    if( bone->get_type() == EBone::SSD)
+        return false;
+
+    if( bone->get_type() == EBone::HRBF && bone->get_hrbf().empty() )
+        return false;
+
+    return bone->get_bbox().is_valid();
+}
+
+// -----------------------------------------------------------------------------
+
+Bvh::Prim Bvh::make_prim(int idx, const Bone* bone)
+{
+    const OBBox_cu obb = bone->get_obbox();
+    Prim prim;
+    prim._bone  = idx;
+    prim._bb    = obb._bb;
+    // World transformation of the bones may hold scales
+    prim._to_bb = obb._tr.full_invert();
+    prim._world = obb.to_bbox();
+    return prim;
+}
+
+// -----------------------------------------------------------------------------
+
+void Bvh::build(const std::vector<const Bone*>& bones)
+{
+    _bones = bones;
+    _prims.clear();
+    _nodes.clear();
+
+    for(unsigned i = 0; i < _bones.size(); ++i)
+        if( has_prim(_bones[i]) )
+            _prims.push_back( make_prim(i, _bones[i]) );
+
+    if( _prims.size() == 0 )
+        return;
+
+    // A binary tree with n leaves has 2n-1 nodes
+    _nodes.reserve( 2 * _prims.size() );
+    _nodes.push_back( Node() );
+    build_node(0, 0, (int)_prims.size());
+}
+
+// -----------------------------------------------------------------------------
+
+void Bvh::build_node(int node_idx, int first, int nb)
+{
+    BBox_cu bb;
+    BBox_cu centers;
+    for(int i = first; i < first + nb; ++i)
+    {
+        const BBox_cu& w = _prims[i]._world;
+        bb = bb.bbox_union( w );
+        centers.add_point( w.pmin + (w.pmax - w.pmin) * 0.5f );
+    }
+
+    Node& node = _nodes[node_idx];
+    node._bbox  = bb;
+    node._left  = -1;
+    node._first = first;
+    node._nb    = nb;
+
+    if( nb <= BVH_LEAF_SIZE )
+        return;
+
+    // Median split along the largest extent of the bboxes centers
+    const Vec3_cu len = centers.lengths();
+    int axis = 0;
+    if( len.y > len.x ) axis = 1;
+    if( len.z > (axis == 0 ? len.x : len.y) ) axis = 2;
+
+    const int mid = first + nb / 2;
+    std::nth_element(_prims.begin() + first,
+                     _prims.begin() + mid,
+                     _prims.begin() + first + nb,
+                     [axis](const Prim& a, const Prim& b)
+    {
+        const float ca = (a._world.pmin + a._world.pmax)[axis];
+        const float cb = (b._world.pmin + b._world.pmax)[axis];
+        return ca < cb;
+    });
+
+    // 'node' may be invalidated by push_back()
+    const int left = (int)_nodes.size();
+    _nodes[node_idx]._left = left;
+    _nodes.push_back( Node() );
+    _nodes.push_back( Node() );
+
+    build_node(left    , first, mid - first);
+    build_node(left + 1, mid  , first + nb - mid);
+}
+
+// -----------------------------------------------------------------------------
+
+void Bvh::refit()
+{
+    // Check the set of primitives is the same
+    int nb_prims = 0;
+    for(unsigned i = 0; i < _bones.size(); ++i)
+        nb_prims += has_prim(_bones[i]) ? 1 : 0;
+
+    bool same = nb_prims == (int)_prims.size();
+    for(unsigned i = 0; i < _prims.size() && same; ++i)
+        same = has_prim( _bones[_prims[i]._bone] );
+
+    if( !same ){
+        build( _bones );
+        return;
+    }
+
+    for(unsigned i = 0; i < _prims.size(); ++i)
+        _prims[i] = make_prim(_prims[i]._bone, _bones[_prims[i]._bone]);
+
+    // Children are stored after their parent
+    for(int n = (int)_nodes.size() - 1; n >= 0; --n)
+    {
+        Node& node = _nodes[n];
+        BBox_cu bb;
+        if( node._left < 0 )
+        {
+            for(int i = node._first; i < node._first + node._nb; ++i)
+                bb = bb.bbox_union( _prims[i]._world );
+        }
+        else
+        {
+            bb = _nodes[node._left    ]._bbox.bbox_union(
+                 _nodes[node._left + 1]._bbox );
+        }
+        node._bbox = bb;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+int Bvh::query(const Point_cu& p, int* bones, int max_bones) const
+{
+    if( _nodes.size() == 0 )
+        return 0;
+
+    // Median splits keep the depth around log2(nb_bones)
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    int nb = 0;
+    while( top > 0 )
+    {
+        const Node& node = _nodes[ stack[--top] ];
+        if( !node._bbox.inside(p) )
+            continue;
+
+        if( node._left >= 0 )
+        {
+            assert(top + 2 <= 64);
+            stack[top++] = node._left + 1;
+            stack[top++] = node._left;
+            continue;
+        }
+
+        for(int i = node._first; i < node._first + node._nb; ++i)
+        {
+            const Prim& prim = _prims[i];
+            if( !prim._bb.inside( prim._to_bb * p ) )
+                continue;
+
+            if( nb >= max_bones )
+                return -1;
+            bones[nb++] = prim._bone;
+        }
+    }
+    return nb;
+}
+
+}// NAMESPACE END Skeleton_env  ================================================
@@ -0,0 +1,103 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "bbox.hpp"
+#include "transfo.hpp"
+#include "bone.hpp"
+#include <vector>
+
+// =============================================================================
+namespace Skeleton_env {
+// =============================================================================
+
+/** @struct Bvh
+    @brief Bounding volume hierarchy over the oriented bboxes of a skeleton's
+    bones.
+
+    Alternative to the uniform Grid for host evaluation: a point lookup returns
+    the bones whose oriented bbox (Bone::get_obbox()) contains the point.
+    Unlike grid cells, long bones only appear once and dense regions don't
+    need a finer resolution.
+
+    Internal nodes store world axis aligned bboxes, leaves test the actual
+    oriented bboxes. When bones move but the set of bones doesn't change
+    use refit() which only updates the bboxes bottom up and keeps the tree
+    topology.
+    @code
+    Bvh bvh;
+    bvh.build( bones );
+    ...
+    bvh.refit(); // bones moved
+    int hits[32];
+    int nb = bvh.query(p, hits, 32);
+    @endcode
+*/
+struct Bvh {
+
+    /// Build the hierarchy from scratch.
+    /// @param bones : bones of the skeleton. The indices returned by query()
+    /// are indices in this array. Bones are not copied and must stay alive
+    /// until the next build().
+    void build(const std::vector<const Bone*>& bones);
+
+    /// Update the bboxes of the nodes with the current bones positions.
+    /// If a bone appeared or vanished (type or hrbf changes) the hierarchy is
+    /// rebuilt.
+    void refit();
+
+    /// Find the bones whose oriented bbox contains 'p'.
+    /// @param bones : indices of the bones in the array given to build()
+    /// @param max_bones : size of 'bones'
+    /// @return number of bones found or -1 if there are more than 'max_bones'
+    int query(const Point_cu& p, int* bones, int max_bones) const;
+
+    /// bbox of the whole hierarchy
+    BBox_cu bbox() const { return _nodes.size() > 0 ? _nodes[0]._bbox : BBox_cu(); }
+
+    /// Number of bones with a primitive inserted in the hierarchy
+    int nb_prims() const { return (int)_prims.size(); }
+
+private:
+    //--------------------------------------------------------------------------
+    /// @name Class tools
+    //--------------------------------------------------------------------------
+
+    /// Node of the hierarchy. Children of a node are stored consecutively.
+    struct Node {
+        BBox_cu _bbox;
+        int _left;  ///< index of the left child, right is _left+1. -1 for leaves
+        int _first; ///< leaves only: first primitive in _prims
+        int _nb;    ///< leaves only: number of primitives
+    };
+
+    /// Oriented bbox of a bone ready for point tests
+    struct Prim {
+        int     _bone;   ///< index in _bones
+        BBox_cu _bb;     ///< bbox in the bone's frame
+        Transfo _to_bb;  ///< world to '_bb' frame
+        BBox_cu _world;  ///< world axis aligned bbox enclosing the obbox
+    };
+
+    /// Whether the bone has a primitive to evaluate (same rule as the Grid)
+    static bool has_prim(const Bone* bone);
+
+    /// Compute the primitive of 'bone'
+    static Prim make_prim(int idx, const Bone* bone);
+
+    /// Recursively split _prims[first, first+nb) in node 'node_idx'
+    void build_node(int node_idx, int first, int nb);
+
+    //--------------------------------------------------------------------------
+    /// @name Attributes
+    //--------------------------------------------------------------------------
+
+    std::vector<const Bone*> _bones;
+    std::vector<Prim>        _prims;
+    /// _nodes[0] is the root. Children indices are always greater than their
+    /// parent's index.
+    std::vector<Node>        _nodes;
+};
+
+}// NAMESPACE END Skeleton_env  ================================================
+
+#endif // BVH_HPP
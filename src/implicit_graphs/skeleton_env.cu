@@ -3,6 +3,7 @@
 
 #include "std_utils.hpp"
 #include "grid.hpp"
+#include "bvh.hpp"
 #include "tree_cu.hpp"
 #include "tree.hpp"
 #include <list>
@@ -61,7 +62,40 @@ public:
 
     Grid *h_grid;
 
+    /// Hierarchy of bones bboxes, only allocated when _accel == BVH
+    Bvh *h_bvh;
+
+    /// Acceleration structure used by host evaluation
+    Accel_t _accel;
+
     Tree_cu *h_tree_cu_instance;
+
+    /// Grid blending lists of this skeleton only, bone ids are local to the
+    /// skeleton @see compile_grid()
+    std::vector<Cluster_cu>   h_grid_list;
+    std::vector<Cluster_data> h_grid_data;
+    /// h_grid_cells[cell_idx] == offset in h_grid_list or -1 if empty cell
+    std::vector<int>          h_grid_cells;
+
+    /// @name Ranges of the skeleton in the concatenated arrays
+    /// Set by the last full update_device(). As long as the sizes don't
+    /// change the skeleton is updated in place @see update_device_skel()
+    /// @{
+    int _off_bone;  ///< first bone in hd_bone_arrays
+    int _nb_bones;
+    int _off_blist; ///< first cluster in hd_blending_list
+    int _nb_blist;
+    int _off_glist; ///< first cluster in hd_grid_blending_list
+    int _cap_glist; ///< room reserved in hd_grid_blending_list
+    int _off_grid;  ///< first cell in hd_grid
+    /// @}
+
+    /// @name What changed since the last upload
+    /// @{
+    bool _dirty_bones;  ///< bone types, hrbf or primitive ids
+    bool _dirty_joints; ///< joint data i.e the blending list
+    bool _dirty_grid;   ///< grid cells
+    /// @}
 };
 
 std::deque<SkeletonEnv *> h_envs;
@@ -95,6 +129,15 @@ SkeletonEnv::SkeletonEnv()
     h_tree = NULL;
     h_tree_cu_instance = NULL;
     h_grid = NULL;
+    h_bvh = NULL;
+    _accel = GRID;
+    _off_bone  = _nb_bones = 0;
+    _off_blist = _nb_blist = 0;
+    _off_glist = _cap_glist = 0;
+    _off_grid  = 0;
+    _dirty_bones  = true;
+    _dirty_joints = true;
+    _dirty_grid   = true;
 }
 
 SkeletonEnv::~SkeletonEnv()
@@ -102,6 +145,7 @@ SkeletonEnv::~SkeletonEnv()
     delete h_tree;
     delete h_tree_cu_instance;
     delete h_grid;
+    delete h_bvh;
 }
 
 
@@ -183,128 +227,169 @@ int cell_to_blending_list(SkeletonEnv *env,
 
 // -----------------------------------------------------------------------------
 
-/// Fill device array : hd_grid_blending_list; hd_offset (only grid_data field);
-/// hd_grid; hd_grid_data
-// XXX: This is fairly expensive, and we're updating every grid and not just the
-// one that was requested.  This is hard to fix right now, since all of the data
-// is put in the same array to allow putting it into a texture.  This doesn't really
-// need to be in a texture, and once that's changed this will be easier to fix.
-
-// This is only a temporary in update_device_grid.  Allocating this is a bit expensive
+// This is only a temporary in compile_grid.  Allocating this is a bit expensive
 // and this is a hot code path, so keep it around and reuse the allocation.  We aren't
 // reentrant, and we won't be called from multiple threads, so this is safe.
 static std::vector< std::vector< std::vector<Cluster> * > > blist_per_cell;
 
+/// Compute the blending list of every cells of the skeleton's grid.
+/// Fill env->h_grid_list; env->h_grid_data; env->h_grid_cells
+/// Bone ids are local to the skeleton.
+static void compile_grid(SkeletonEnv *env)
+{
+    const Grid* grid = env->h_grid;
+    const Tree_cu *tree = env->h_tree_cu_instance;
+
+    // Cache cluster IDs to blending lists.
+    std::vector<std::vector<Cluster> > blist_cache;
+
+    Cluster_id clus_id(0);
+    for(Cluster c: tree->_clusters) {
+        std::vector<Cluster> cluster;
+        tree->add_cluster(clus_id, cluster);
+        blist_cache.push_back(cluster);
+        clus_id += 1;
+    }
+
+    // Get the blending list for each cell, and the total number of resulting clusters.
+    // Each element of blist_per_cell is a list of blending lists, pointing into blist_cache.
+    // The list is concatenated down below.
+    //
+    // The grid has res^3 cells.  We'll only process cells that actually have surfaces affecting them,
+    // but preallocate the maximum for efficiency.
+    if(blist_per_cell.size() < grid->_filled_cells.size())
+        blist_per_cell.resize(grid->_filled_cells.size());
+
+    int total_size = 0;
+    for(int cell_idx = 0; cell_idx < grid->_filled_cells.size(); ++cell_idx) {
+        std::vector< std::vector<Cluster> * > &blists_list = blist_per_cell[cell_idx];
+        // XXX: It's important that we only clear the list and don't deallocate it, so we don't
+        // reallocate hundreds of these every frame.  This is what clear() does in MSVC.  What about
+        // gnuc++?
+        blists_list.clear();
+
+        if(!grid->_filled_cells[cell_idx])
+            continue;
+
+        // The number of clusters that the blending list can possibly have is the number of bones.
+        // Preallocate that amount, so we don't have to reallocate.
+        blists_list.reserve(grid->_grid_cells[cell_idx].size());
+
+        total_size += cell_to_blending_list(env, cell_idx, blists_list, blist_cache);
+    }
+
+    env->h_grid_list.resize(total_size);
+    env->h_grid_data.resize(total_size);
+    env->h_grid_cells.assign(grid->_filled_cells.size(), -1);
+
+    // Iterate over _filled_cells again, copying the results to h_grid_list and h_grid_data.
+    int offset = 0;
+    for(int cell_idx = 0; cell_idx < grid->_filled_cells.size(); ++cell_idx) {
+        if(!grid->_filled_cells[cell_idx])
+            continue;
+
+        const std::vector< std::vector<Cluster> *> &blists_list = blist_per_cell[cell_idx];
+
+        env->h_grid_cells[cell_idx] = offset;
+
+        int first_offset = offset;
+        int cell_size = 0;
+        for(const std::vector<Cluster> *blists: blists_list) {
+            for(const Cluster &c: *blists) {
+                env->h_grid_list[offset] = c;
+                env->h_grid_data[offset]._bulge_strength = c.datas._bulge_strength;
+                offset++;
+                cell_size++;
+            }
+        }
+
+        // Store the total number of bones (divided by two) in the first item's blend_type.  If first_offset and offset
+        // are the same then there were no clusters at all, so don't do anything.
+        if(first_offset != offset)
+            env->h_grid_list[first_offset].blend_type = (EJoint::Joint_t) (cell_size/2);
+    }
+
+    env->_dirty_grid = false;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Copy the compiled grid of a skeleton (@see compile_grid()) in its ranges of
+/// hd_grid; hd_grid_blending_list; hd_grid_data; hd_grid_bbox (host mem only)
+static void write_grid(Skel_id skel_id)
+{
+    const SkeletonEnv *env = h_envs[skel_id];
+    const Grid* grid = env->h_grid;
+
+    // Offset bones id to match the concateneted representation
+    for(unsigned i = 0; i < env->h_grid_list.size(); ++i)
+    {
+        hd_grid_blending_list[env->_off_glist + i] = env->h_grid_list[i];
+        hd_grid_blending_list[env->_off_glist + i].first_bone += env->_off_bone;
+        hd_grid_data         [env->_off_glist + i] = env->h_grid_data[i];
+    }
+
+    for(unsigned cell_idx = 0; cell_idx < env->h_grid_cells.size(); ++cell_idx)
+    {
+        const int off = env->h_grid_cells[cell_idx];
+        hd_grid[env->_off_grid + cell_idx] = off < 0 ? -1 : env->_off_glist + off;
+    }
+
+    // Update grid bbox and resolution
+    BBox_cu bb = grid->bbox();
+    hd_grid_bbox[skel_id*2 + 0] = bb.pmin.to_float4();
+    hd_grid_bbox[skel_id*2 + 1] = bb.pmax.to_float4();
+    hd_grid_bbox[skel_id*2 + 0].w = (float)grid->res();
+}
+
+// -----------------------------------------------------------------------------
+
+/// Fill device array : hd_grid_blending_list; hd_offset (only grid_data field);
+/// hd_grid; hd_grid_data
+/// Only dirty grids are recompiled, the others are copied from their cache.
 static void update_device_grid()
 {
-#if 1
     assert( !binded );
     hd_grid.fill( -1 );
 
-    // Look up every grids and compute the cells blending list.
-    // update offset to access blending list as well
+    // Layout every grids in the concatenated arrays and update offset to
+    // access the blending lists as well
     int offset = 0;
     int grid_offset = 0;
-    int off_bone = 0;
-
     for(unsigned grid_id = 0; grid_id < h_envs.size(); ++grid_id)
     {
         if(h_envs[grid_id] == NULL)
             continue;
 
         SkeletonEnv *env = h_envs[grid_id];
-        const Grid* grid = env->h_grid;
-        const Tree_cu *tree = env->h_tree_cu_instance;
-
-        // Cache cluster IDs to blending lists.
-        std::vector<std::vector<Cluster> > blist_cache;
-
-        Cluster_id clus_id(0);
-        for(Cluster c: tree->_clusters) {
-            std::vector<Cluster> cluster;
-            tree->add_cluster(clus_id, cluster);
-            blist_cache.push_back(cluster);
-            clus_id += 1;
-        }
+        if( env->_dirty_grid )
+            compile_grid(env);
 
-        // Get the blending list for each cell, and the total number of resulting clusters.
-        // Each element of blist_per_cell is a list of blending lists, pointing into blist_cache.
-        // The list is concatenated down below.
-        //
-        // The grid has res^3 cells.  We'll only process cells that actually have surfaces affecting them,
-        // but preallocate the maximum for efficiency.
-        if(blist_per_cell.size() < grid->_filled_cells.size())
-            blist_per_cell.resize(grid->_filled_cells.size());
-
-        int total_size = 0;
-        for(int cell_idx = 0; cell_idx < grid->_filled_cells.size(); ++cell_idx) {
-            std::vector< std::vector<Cluster> * > &blists_list = blist_per_cell[cell_idx];
-            // XXX: It's important that we only clear the list and don't deallocate it, so we don't
-            // reallocate hundreds of these every frame.  This is what clear() does in MSVC.  What about
-            // gnuc++?
-            blists_list.clear();
-
-            if(!grid->_filled_cells[cell_idx])
-                continue;
-
-            // The number of clusters that the blending list can possibly have is the number of bones.
-            // Preallocate that amount, so we don't have to reallocate.
-            blists_list.reserve(grid->_grid_cells[cell_idx].size());
-
-            total_size += cell_to_blending_list(env, cell_idx, blists_list, blist_cache);
-        }
-
-        // Allocate space for these clusters.
-        hd_grid_blending_list.realloc(offset + total_size);
-        hd_grid_data.realloc(offset + total_size);
-
-        // Iterate over _filled_cells again, copying the results to hd_grid_blending_list and hd_grid_data.
-        for(int cell_idx = 0; cell_idx < grid->_filled_cells.size(); ++cell_idx) {
-            if(!grid->_filled_cells[cell_idx])
-                continue;
-
-            const std::vector< std::vector<Cluster> *> &blists_list = blist_per_cell[cell_idx];
-
-            hd_grid[grid_offset + cell_idx] = offset;
-
-            int first_offset = offset;
-            int total_size = 0;
-            for(const std::vector<Cluster> *blists: blists_list) {
-                for(const Cluster &c: *blists) {
-                    // Convert cluster to cluster_cu and offset bones id to match the concateneted representation
-                    hd_grid_blending_list[offset] = c;
-                    hd_grid_blending_list[offset].first_bone += off_bone;
-                    hd_grid_data         [offset]._bulge_strength = c.datas._bulge_strength;
-                    offset++;
-                    total_size++;
-                }
-            }
-
-            // Store the total number of bones (divided by two) in the first item's blend_type.  If first_offset and offset
-            // are the same then there were no clusters at all, so don't do anything.
-            if(first_offset != offset)
-                hd_grid_blending_list[first_offset].blend_type = (EJoint::Joint_t) (total_size/2);
-        }
+        // Leave some room after the grid list so that small changes of the
+        // grid can be written in place
+        const int size = (int)env->h_grid_list.size();
+        env->_off_glist = offset;
+        env->_cap_glist = size + size / 4;
+        env->_off_grid  = grid_offset;
+        offset += env->_cap_glist;
 
         hd_offset[grid_id].grid_data = grid_offset;
-        const int res = grid->res();
+        const int res = env->h_grid->res();
         grid_offset += res*res*res;
+    }
 
-        // Update grid bbox and resolution
-        BBox_cu bb = grid->bbox();
-        hd_grid_bbox[grid_id*2 + 0] = bb.pmin.to_float4();
-        hd_grid_bbox[grid_id*2 + 1] = bb.pmax.to_float4();
-        hd_grid_bbox[grid_id*2 + 0].w = (float)res;
+    hd_grid_blending_list.malloc( offset );
+    hd_grid_data.malloc( offset );
 
-        off_bone += tree->_bone_aranged.size();
-    }
+    for(unsigned grid_id = 0; grid_id < h_envs.size(); ++grid_id)
+        if(h_envs[grid_id] != NULL)
+            write_grid( grid_id );
 
     hd_offset.update_device_mem(); // This is also done in update_device_tree maybe we can factorize
     hd_grid.update_device_mem();
     hd_grid_blending_list.update_device_mem();
     hd_grid_data.update_device_mem();
     hd_grid_bbox.update_device_mem();
-#endif
 }
 
 // -----------------------------------------------------------------------------
@@ -334,6 +419,64 @@ static void fill_separated_bone_types(const std::vector<const Bone*>& generic_bo
 
 // -----------------------------------------------------------------------------
 
+/// Fill the range of the skeleton in hd_bone_arrays (host mem only)
+static void write_bones(Skel_id skel_id)
+{
+    const SkeletonEnv *env = h_envs[skel_id];
+    const Tree_cu* tree_cu = env->h_tree_cu_instance;
+    for(int i = 0; i < env->_nb_bones; i++)
+    {
+        const Bone* b = tree_cu->_bone_aranged[i];
+        hd_bone_arrays->hd_bone_hrbf       [env->_off_bone + i] = b->get_hrbf();
+        hd_bone_arrays->hd_bone_precomputed[env->_off_bone + i] = b->get_primitive();
+        hd_bone_arrays->hd_bone_types      [env->_off_bone + i] = b->get_type();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// Fill the range of the skeleton in hd_blending_list and hd_cluster_data
+/// (host mem only)
+static void write_blending_list(Skel_id skel_id)
+{
+    const SkeletonEnv *env = h_envs[skel_id];
+    const Tree_cu* tree_cu = env->h_tree_cu_instance;
+    const int off_blist = env->_off_blist;
+
+    // Concatenate blending list and update bone index accordingly
+    auto it = tree_cu->_blending_list.begin();
+    for(int i = 0; it != tree_cu->_blending_list.end(); ++it, ++i)
+    {
+        Cluster c = *it;
+        c.first_bone += env->_off_bone;
+        // Convert in device representation
+        Cluster_cu new_c( c );
+        hd_blending_list[off_blist + i] = new_c;
+        hd_cluster_data [off_blist + i]._bulge_strength = c.datas._bulge_strength;
+    }
+    // We store nb_pairs in the first element of the list
+    assert(tree_cu->_blending_list.size() > 0); // unless we have no elements
+    hd_blending_list[off_blist].nb_pairs = tree_cu->_blending_list.size()/2;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Build or refit the skeleton's Bvh if any
+/// @param rebuild : the bones layout changed (new Tree_cu), otherwise only
+/// the bones positions did.
+static void update_bvh(SkeletonEnv* env, bool rebuild)
+{
+    if(env->h_bvh == NULL)
+        return;
+
+    if( rebuild )
+        env->h_bvh->build( env->h_tree_cu_instance->_bone_aranged );
+    else
+        env->h_bvh->refit();
+}
+
+// -----------------------------------------------------------------------------
+
 
 /// Fill device array : hd_blending_list; hd_offset (only list_data field);
 /// h_generic_bones; _hidx_to_didx; _didx_to_hidx;
@@ -346,13 +489,20 @@ static void update_device_tree(std::vector<const Bone*> &h_generic_bones)
     int s_blend_list = 0; // Total size of all blending lists
     for(unsigned i = 0; i < h_envs.size(); ++i)
     {
-        if(h_envs[i] == NULL)
+        SkeletonEnv* env = h_envs[i];
+        if(env == NULL)
             continue;
 
-        // Convert tree to GPU layout
-        delete h_envs[i]->h_tree_cu_instance;
-        h_envs[i]->h_tree_cu_instance = new Tree_cu( h_envs[i]->h_tree );
-        s_blend_list += h_envs[i]->h_tree_cu_instance->_blending_list.size();
+        // Convert tree to GPU layout (only needed when joints changed)
+        if(env->h_tree_cu_instance == NULL || env->_dirty_joints)
+        {
+            delete env->h_tree_cu_instance;
+            env->h_tree_cu_instance = new Tree_cu( env->h_tree );
+            env->_dirty_joints = false;
+            env->_dirty_grid   = true;
+            update_bvh(env, true);
+        }
+        s_blend_list += env->h_tree_cu_instance->_blending_list.size();
     }
 
     // Now we can allocate memory
@@ -375,7 +525,13 @@ static void update_device_tree(std::vector<const Bone*> &h_generic_bones)
         if(h_envs[t] == NULL)
             continue;
 
-        const Tree_cu* tree_cu = h_envs[t]->h_tree_cu_instance;
+        SkeletonEnv* env = h_envs[t];
+        const Tree_cu* tree_cu = env->h_tree_cu_instance;
+
+        env->_off_bone  = off_bone;
+        env->_nb_bones  = (int)tree_cu->_bone_aranged.size();
+        env->_off_blist = off_blist;
+        env->_nb_blist  = (int)tree_cu->_blending_list.size();
 
         for(unsigned i = 0; i < tree_cu->_bone_aranged.size(); ++i){
             DBone_id new_didx = DBone_id(i) + off_bone;
@@ -387,20 +543,7 @@ static void update_device_tree(std::vector<const Bone*> &h_generic_bones)
             _didx_to_hidx[ new_didx ] = hidx;
         }
 
-        // Concatenate blending list and update bone index accordingly
-        auto it = tree_cu->_blending_list.begin();
-        for(int i = 0; it != tree_cu->_blending_list.end(); ++it, ++i)
-        {
-            Cluster c = *it;
-            c.first_bone += off_bone;
-            // Convert in device representation
-            Cluster_cu new_c( c );
-            hd_blending_list[off_blist + i] = new_c;
-            hd_cluster_data [off_blist + i]._bulge_strength = c.datas._bulge_strength;
-        }
-        // We store nb_pairs in the first element of the list
-        assert(tree_cu->_blending_list.size() > 0); // unless we have no elements
-        hd_blending_list[off_blist].nb_pairs      = tree_cu->_blending_list.size()/2;
+        write_blending_list( t );
 
         hd_offset[t].list_data = off_blist;
 
@@ -429,11 +572,116 @@ void update_device()
 
     fill_separated_bone_types( h_generic_bones );
     update_device_grid();
+
+    for(unsigned i = 0; i < h_envs.size(); ++i)
+    {
+        if(h_envs[i] == NULL || !h_envs[i]->_dirty_bones)
+            continue;
+        update_bvh(h_envs[i], false);
+        h_envs[i]->_dirty_bones = false;
+    }
+
     bind();
 }
 
 // -----------------------------------------------------------------------------
 
+/// Upload a segment of 'a' if not empty
+template<class T>
+static void update_device_range(Cuda_utils::HD_Array<T>& a, int start, int nb_elt)
+{
+    if(nb_elt > 0)
+        a.update_device_mem(start, nb_elt);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Upload the dirty data of a single skeleton.
+/// Its ranges in the concatenated arrays are rewritten in place, other
+/// skeletons are left untouched and textures stay bound. When the size of a
+/// range changes we fall back to update_device() (or update_device_grid()
+/// when only the grid does not fit anymore).
+static void update_device_skel(Skel_id skel_id)
+{
+    SkeletonEnv* env = h_envs[skel_id];
+
+    if( env->_dirty_joints )
+    {
+        Tree_cu* tree_cu = new Tree_cu( env->h_tree );
+        const bool same_layout =
+                (int)tree_cu->_bone_aranged.size()  == env->_nb_bones &&
+                (int)tree_cu->_blending_list.size() == env->_nb_blist;
+
+        delete env->h_tree_cu_instance;
+        env->h_tree_cu_instance = tree_cu;
+        env->_dirty_joints = false;
+        env->_dirty_grid   = true;
+        update_bvh(env, true);
+
+        if( !same_layout ){
+            update_device();
+            return;
+        }
+
+        write_blending_list( skel_id );
+        update_device_range(hd_blending_list, env->_off_blist, env->_nb_blist);
+        update_device_range(hd_cluster_data , env->_off_blist, env->_nb_blist);
+    }
+
+    if( env->_dirty_bones )
+    {
+        // A bone may be shared by several skeletons: refresh them as well
+        const std::vector<const Bone*>& bones = env->h_tree_cu_instance->_bone_aranged;
+        const std::set<const Bone*> skel_bones(bones.begin(), bones.end());
+        for(unsigned i = 0; i < h_envs.size(); ++i)
+        {
+            SkeletonEnv* other = h_envs[i];
+            if(other == NULL)
+                continue;
+
+            if((int)i != skel_id)
+            {
+                const std::vector<const Bone*>& obones = other->h_tree_cu_instance->_bone_aranged;
+                bool shared = false;
+                for(unsigned b = 0; b < obones.size() && !shared; ++b)
+                    shared = skel_bones.find(obones[b]) != skel_bones.end();
+                if( !shared )
+                    continue;
+            }
+
+            update_bvh(other, false);
+            write_bones( i );
+            if(other->_nb_bones > 0)
+                hd_bone_arrays->update_device_mem(other->_off_bone, other->_nb_bones);
+        }
+        env->_dirty_bones = false;
+    }
+
+    if( env->_dirty_grid )
+    {
+        compile_grid( env );
+
+        // The resolution only changes through set_grid_res() which does a
+        // full update, only the grid list may not fit anymore
+        const int res = env->h_grid->res();
+        if( (int)env->h_grid_list.size() > env->_cap_glist )
+        {
+            unbind();
+            update_device_grid();
+            bind();
+            return;
+        }
+
+        write_grid( skel_id );
+        update_device_range(hd_grid_blending_list, env->_off_glist, (int)env->h_grid_list.size());
+        update_device_range(hd_grid_data         , env->_off_glist, (int)env->h_grid_list.size());
+        update_device_range(hd_grid              , env->_off_grid , res*res*res);
+        update_device_range(hd_grid_bbox         , skel_id*2, 2);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 void clean_env()
 {
     unbind();
@@ -545,7 +793,9 @@ void delete_skel_instance(Skel_id skel_id)
 void update_bones_data(Skel_id i)
 {
     h_envs[i]->h_grid->build_grid();
-    update_device();
+    h_envs[i]->_dirty_bones = true;
+    h_envs[i]->_dirty_grid  = true;
+    update_device_skel(i);
 }
 
 // -----------------------------------------------------------------------------
@@ -554,7 +804,9 @@ void update_joints_data(Skel_id i, const std::map<Bone::Id, Joint_data>& joints)
 {
     h_envs[i]->h_tree->set_joints_data( joints );
     h_envs[i]->h_grid->build_grid();
-    update_device();
+    h_envs[i]->_dirty_joints = true;
+    h_envs[i]->_dirty_grid   = true;
+    update_device_skel(i);
 }
 
 // -----------------------------------------------------------------------------
@@ -563,12 +815,57 @@ void set_grid_res(Skel_id i, int res)
 {
     assert( res > 0);
     h_envs[i]->h_grid->set_res( res );
+    h_envs[i]->_dirty_grid = true;
     alloc_hd_grid();
     update_device();
 }
 
 // -----------------------------------------------------------------------------
 
+void set_acceleration(Skel_id i, Accel_t type)
+{
+    SkeletonEnv* env = h_envs[i];
+    if(env->_accel == type)
+        return;
+
+    env->_accel = type;
+    if(type == BVH)
+    {
+        // The grid is left untouched, device evaluation still uses it
+        env->h_bvh = new Bvh();
+        // Otherwise built with the Tree_cu by the first update_device()
+        if(env->h_tree_cu_instance != NULL)
+            env->h_bvh->build( env->h_tree_cu_instance->_bone_aranged );
+    }
+    else
+    {
+        delete env->h_bvh;
+        env->h_bvh = NULL;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+Accel_t get_acceleration(Skel_id i)
+{
+    return h_envs[i]->_accel;
+}
+
+// -----------------------------------------------------------------------------
+
+int fetch_bvh_bones(Skel_id id, const Point_cu& pos, int* bones, int max_bones)
+{
+    const SkeletonEnv* env = h_envs[id];
+    assert(env->h_bvh != NULL);
+    const int nb = env->h_bvh->query(pos, bones, max_bones);
+    // Local to concatenated bone indices
+    for(int i = 0; i < nb; ++i)
+        bones[i] += env->_off_bone;
+    return nb;
+}
+
+// -----------------------------------------------------------------------------
+
 DBone_id bone_hidx_to_didx(Skel_id skel_id, Bone::Id bone_hidx)
 {
     // TODO: array of maps by skeleton ids would be more efficient
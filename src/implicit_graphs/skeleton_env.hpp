@@ -76,6 +76,15 @@ void init_env();
 /// Set resolution for the acceleration structure grid
 void set_grid_res(Skel_id id, int res);
 
+/// Choose the acceleration structure used by the host evaluation of the
+/// skeleton (default is GRID).
+/// Device evaluation always uses the grid, which is kept as is: BVH only
+/// replaces the grid lookups of the host evaluation.
+/// @see Bvh fetch_bvh_bones()
+void set_acceleration(Skel_id id, Accel_t type);
+
+Accel_t get_acceleration(Skel_id id);
+
 /// Create a new skeleton instance
 Skel_id new_skel_instance(const std::vector<const Bone*>& bones,
                           const std::map<Bone::Id, Bone::Id>& parents,
@@ -165,13 +174,20 @@ Cluster_id fetch_grid_blending_list_offset(Skel_id id, const Vec3_cu& pos);
 IF_CUDA_DEVICE_HOST static inline
 Cluster_cu fetch_grid_blending_list(Cluster_id i);
 
+/// Find with the skeleton's Bvh the bones whose oriented bbox contains 'pos'
+/// (host only, the skeleton must use the BVH acceleration)
+/// @param bones : device index (DBone_id::id()) of the bones found
+/// @param max_bones : size of 'bones'
+/// @return number of bones found or -1 if there are more than 'max_bones'
+int fetch_bvh_bones(Skel_id id, const Point_cu& pos, int* bones, int max_bones);
+
 // -----------------------------------------------------------------------------
 /// @name Blending list (no acceleration structure)
 // -----------------------------------------------------------------------------
 
 /// Fetch the offset needed to use fetch_blending_list() given a specific
 /// skeleton instance.
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Cluster_id fetch_blending_list_offset(Skel_id id);
 
 /// List of cluster pairs. The list is composed in two parts pairs to be blended
@@ -180,7 +196,7 @@ Cluster_id fetch_blending_list_offset(Skel_id id);
 /// The first element does not specify the blending type and controller id but :
 /// z == nb_pairs and w = nb_singletons after the pairs.
 /// @param i : identifier of the cluster plus fetch_blending_list_offset()
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Cluster_cu fetch_blending_list(Cluster_id i);
 
 // -----------------------------------------------------------------------------
@@ -190,25 +206,25 @@ Cluster_cu fetch_blending_list(Cluster_id i);
 /// Read data of a bone of type hrbf
 /// @warning User must ensure that the bone i is of the right type with
 /// fetch_bone_type() otherwise returned value is undefined
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 HermiteRBF fetch_bone_hrbf(DBone_id i);
 
 /// Read data of a bone of type precomputed
 /// @warning User must ensure that the bone i is of the right type with
 /// fetch_bone_type() otherwise returned value is undefined
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Precomputed_prim fetch_bone_precomputed(DBone_id i);
 
 /// @return the bone type defined in the enum of Bone_type namespace
 /// @see Bone_type
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 EBone::Bone_t fetch_bone_type(DBone_id bone_id);
 
 /// Fetch a bone and evaluate its potential.
 /// @param bone_id the bone id
 /// @param gf the gradient at point x
 /// @return Potential at point x
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 float fetch_and_eval_bone(DBone_id bone_id, Vec3_cu& gf, const Point_cu& x);
 
 /// Fetch a blending operator and blend the potential
@@ -220,7 +236,7 @@ float fetch_and_eval_bone(DBone_id bone_id, Vec3_cu& gf, const Point_cu& x);
 /// @param gf1 First gradient to blend
 /// @param gf2 Second gradient to blend
 /// @return the blended potential
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 float fetch_binop_and_blend(Vec3_cu& gf,
                             EJoint::Joint_t type,
                             Blending_env::Ctrl_id ctrl_id,
@@ -71,7 +71,7 @@ Cluster_id fetch_grid_blending_list_offset(Skel_id id, const Vec3_cu& pos)
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Cluster_cu fetch_grid_blending_list(Cluster_id cid)
 {
     #ifdef __CUDA_ARCH__
@@ -84,51 +84,71 @@ Cluster_cu fetch_grid_blending_list(Cluster_id cid)
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Cluster_id fetch_blending_list_offset(Skel_id id){
+    #ifdef __CUDA_ARCH__
     int2 s = tex1Dfetch(tex_offset, id);
     return Cluster_id( s.x );
+    #else
+    return Cluster_id( hd_offset[id].list_data );
+    #endif
 }
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Cluster_cu fetch_blending_list(Cluster_id cid)
 {
+    #ifdef __CUDA_ARCH__
     int4 s = tex1Dfetch(tex_blending_list, cid.id());
     return *reinterpret_cast<Cluster_cu*>(&s);
+    #else
+    return hd_blending_list[ cid.id() ];
+    #endif
 }
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 HermiteRBF fetch_bone_hrbf(DBone_id i)
 {
+    #ifdef __CUDA_ARCH__
     int internal = tex1Dfetch(tex_bone_hrbf, i.id());
     return *reinterpret_cast<HermiteRBF*>(&internal);
+    #else
+    return hd_bone_arrays->hd_bone_hrbf[i.id()];
+    #endif
 }
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Precomputed_prim fetch_bone_precomputed(DBone_id i)
 {
+    #ifdef __CUDA_ARCH__
     int internal = tex1Dfetch(tex_bone_precomputed, i.id());
     return *reinterpret_cast<Precomputed_prim*>(&internal);
+    #else
+    return hd_bone_arrays->hd_bone_precomputed[i.id()];
+    #endif
 }
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 EBone::Bone_t fetch_bone_type(DBone_id bone_id)
 {
+    #ifdef __CUDA_ARCH__
     return (EBone::Bone_t)tex1Dfetch(tex_bone_type, bone_id.id());
+    #else
+    return (EBone::Bone_t)hd_bone_arrays->hd_bone_types[bone_id.id()];
+    #endif
 }
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 float fetch_and_eval_bone(DBone_id bone_id, Vec3_cu& gf, const Point_cu& x)
 {
-    EBone::Bone_t bone_type = (EBone::Bone_t)tex1Dfetch(tex_bone_type, bone_id.id());
+    EBone::Bone_t bone_type = fetch_bone_type(bone_id);
 
     if( bone_type == EBone::HRBF)
     {
@@ -149,7 +169,7 @@ float fetch_and_eval_bone(DBone_id bone_id, Vec3_cu& gf, const Point_cu& x)
 
 // -----------------------------------------------------------------------------
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 float fetch_binop_and_blend(Vec3_cu& grad,
                             EJoint::Joint_t type,
                             Blending_env::Ctrl_id ctrl_id,
@@ -1,5 +1,10 @@
 #include "skeleton_env_evaluator.hpp"
 #include "blending_functions.hpp"
+#include "thread_pool.hpp"
+#include "hrbf_env.hpp"
+
+#include <vector>
+#include <algorithm>
 
 
 /**
@@ -35,7 +40,7 @@ typedef BulgeFreeBlending Cluster;
 
 #define USE_GRID_ // Not compatible with had_hoc hand !
 
-__device__ static
+IF_CUDA_DEVICE_HOST static
 float eval_cluster(Vec3_cu& gf_clus, const Point_cu& p, int size, Skeleton_env::DBone_id first_bone)
 {
     gf_clus = Vec3_cu(0.f, 0.f, 0.f);
@@ -52,7 +57,7 @@ float eval_cluster(Vec3_cu& gf_clus, const Point_cu& p, int size, Skeleton_env::
     return f_clus;
 }
 
-__device__ static inline
+IF_CUDA_DEVICE_HOST static inline
 Skeleton_env::Cluster_cu fetch_blending_list_int(Skeleton_env::Cluster_id cid)
 {
 #ifndef USE_GRID_
@@ -62,13 +67,91 @@ Skeleton_env::Cluster_cu fetch_blending_list_int(Skeleton_env::Cluster_id cid)
 #endif
 }
 
-__device__
+/// Maximum number of bones returned by a Bvh lookup. When more bones are
+/// found the whole blending list is evaluated.
+#define BVH_MAX_BONES 64
+
+/// Whether one of the bones of the cluster is in the 'nb_bones' first
+/// elements of 'bones'
+static inline
+bool cluster_hit(const Skeleton_env::Cluster_cu& clus, const int* bones, int nb_bones)
+{
+    const int first = clus.first_bone.id();
+    for(int i = 0; i < nb_bones; i++)
+        if(bones[i] >= first && bones[i] < first + clus.nb_bone)
+            return true;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Same as compute_potential() but the bones near 'p' are found with the
+/// skeleton's Bvh. The blending list of the whole skeleton is read and
+/// clusters without any of these bones are skipped, as if they were absent
+/// from a grid cell.
+static
+float compute_potential_bvh(Skeleton_env::Skel_id skel_id, const Point_cu& p, Vec3_cu& gf)
+{
+    using namespace Skeleton_env;
+    float f = 0.f;
+    gf = Vec3_cu(1.f, 0.f, 0.f);
+
+    int bones[BVH_MAX_BONES];
+    const int nb_bones = fetch_bvh_bones(skel_id, p, bones, BVH_MAX_BONES);
+    if( nb_bones == 0 /*Means no bone's bbox contains p*/)
+        return 0.f;
+
+    Cluster_id off_cid = fetch_blending_list_offset( skel_id );
+    Cluster_cu clus = fetch_blending_list( off_cid );
+    const int nb_pairs = clus.nb_pairs;
+
+    for(int i = 0; i < nb_pairs*2; i += 2)
+    {
+        bool first = true;
+        float fn = 0.f;
+        Vec3_cu gfn(0.f, 0.f, 0.f);
+        for(int j = 0; j < 2; j++){
+            clus = fetch_blending_list( off_cid + i + j );
+            if(clus.nb_bone == 0)
+                continue;
+            if(nb_bones > 0 && !cluster_hit(clus, bones, nb_bones))
+                continue;
+
+            Vec3_cu xgfn;
+            float xfn = eval_cluster(xgfn, p, clus.nb_bone, clus.first_bone);
+
+            if(first)
+            {
+                fn = xfn;
+                gfn = xgfn;
+                first = false;
+            } else {
+                fn = fetch_binop_and_blend(gfn, clus.blend_type, clus.ctrl_id,  off_cid + i,
+                        fn, xfn, gfn, xgfn);
+            }
+        }
+
+        if( first ) continue; // No cluster of the pair near p
+
+        f =  Blend_func::Pairs::fngf(gf, f, fn, gf, gfn);
+    }
+    return f;
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST
 float Skeleton_env::compute_potential(Skel_id skel_id, const Point_cu& p, Vec3_cu& gf)
 {
     typedef Cluster_cu Clus;
     float f = 0.f;
     gf = Vec3_cu(1.f, 0.f, 0.f);
 
+#ifndef __CUDA_ARCH__
+    if( get_acceleration(skel_id) == BVH )
+        return compute_potential_bvh(skel_id, p, gf);
+#endif
+
 #ifndef USE_GRID_
     // Without space acceleration structure
     Cluster_id off_cid = fetch_blending_list_offset( skel_id );
@@ -122,3 +205,154 @@ float Skeleton_env::compute_potential(Skel_id skel_id, const Point_cu& p, Vec3_c
 
     return f;
 }
+
+// -----------------------------------------------------------------------------
+
+/// Maximum number of points of a same grid cell evaluated together
+#define PACKET_SIZE 16
+
+/// Same as eval_cluster() for 'n' points
+static void eval_cluster_packet(float* f_clus,
+                                Vec3_cu* gf_clus,
+                                const Point_cu* p,
+                                int n,
+                                int size,
+                                Skeleton_env::DBone_id first_bone)
+{
+    using namespace Skeleton_env;
+    for(int k = 0; k < n; k++){
+        f_clus [k] = 0.f;
+        gf_clus[k] = Vec3_cu(0.f, 0.f, 0.f);
+    }
+
+    float   f [PACKET_SIZE];
+    Vec3_cu gf[PACKET_SIZE];
+    for(int i = 0; i < size; i++)
+    {
+        const DBone_id bone_id = first_bone + i;
+        if( fetch_bone_type(bone_id) == EBone::HRBF )
+            fetch_bone_hrbf(bone_id).fngf_packet(f, gf, p, n);
+        else
+            for(int k = 0; k < n; k++)
+                f[k] = fetch_and_eval_bone(bone_id, gf[k], p[k]);
+
+        for(int k = 0; k < n; k++)
+            f_clus[k] = Blend_func::Cluster::fngf(gf_clus[k], f_clus[k], f[k], gf_clus[k], gf[k]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// Same as compute_potential() for 'n' points lying in the grid cell
+/// 'off_cid'
+static void compute_potential_packet(Skeleton_env::Cluster_id off_cid,
+                                     const Point_cu* p,
+                                     int n,
+                                     float* f,
+                                     Vec3_cu* gf)
+{
+    using namespace Skeleton_env;
+    for(int k = 0; k < n; k++){
+        f [k] = 0.f;
+        gf[k] = Vec3_cu(1.f, 0.f, 0.f);
+    }
+
+    Cluster_cu clus = fetch_blending_list_int( off_cid );
+    const int nb_pairs = clus.nb_pairs;
+
+    float   fn [PACKET_SIZE], xfn [PACKET_SIZE];
+    Vec3_cu gfn[PACKET_SIZE], xgfn[PACKET_SIZE];
+    for(int i = 0; i < nb_pairs*2; i += 2)
+    {
+        for(int k = 0; k < n; k++){
+            fn [k] = 0.f;
+            gfn[k] = Vec3_cu(0.f, 0.f, 0.f);
+        }
+
+        bool first = true;
+        for(int j = 0; j < 2; j++)
+        {
+            clus = fetch_blending_list_int( off_cid + i + j );
+            if(clus.nb_bone == 0)
+                continue;
+
+            eval_cluster_packet(xfn, xgfn, p, n, clus.nb_bone, clus.first_bone);
+
+            if(first)
+            {
+                for(int k = 0; k < n; k++){
+                    fn [k] = xfn [k];
+                    gfn[k] = xgfn[k];
+                }
+                first = false;
+            } else {
+                for(int k = 0; k < n; k++)
+                    fn[k] = fetch_binop_and_blend(gfn[k], clus.blend_type, clus.ctrl_id, off_cid + i,
+                                                  fn[k], xfn[k], gfn[k], xgfn[k]);
+            }
+        }
+
+        for(int k = 0; k < n; k++)
+            f[k] = Blend_func::Pairs::fngf(gf[k], f[k], fn[k], gf[k], gfn[k]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Skeleton_env::compute_potential(Skel_id skel_id,
+                                     const Point_cu* points,
+                                     int nb_points,
+                                     float* f,
+                                     Vec3_cu* gf)
+{
+    // Host evaluation reads the host copy of the HRBF samples
+    HRBF_env::sync_host_mem();
+
+    if( get_acceleration(skel_id) == BVH )
+    {
+        Thread_pool::get().parallel_for(nb_points, 256, [&](int begin, int end){
+            for(int i = begin; i < end; i++)
+                f[i] = compute_potential_bvh(skel_id, points[i], gf[i]);
+        });
+        return;
+    }
+
+    Thread_pool::get().parallel_for(nb_points, 1024, [&](int begin, int end)
+    {
+        // (grid cell, point index) sorted to gather points by cell
+        std::vector< std::pair<int, int> > cells;
+        cells.reserve(end - begin);
+        for(int i = begin; i < end; i++)
+        {
+            Cluster_id off_cid = fetch_grid_blending_list_offset(skel_id, points[i].to_vector());
+            if( !off_cid.is_valid() ){
+                // Outside the skeleton bbox
+                f [i] = 0.f;
+                gf[i] = Vec3_cu(1.f, 0.f, 0.f);
+                continue;
+            }
+            cells.push_back( std::make_pair(off_cid.id(), i) );
+        }
+        std::sort(cells.begin(), cells.end());
+
+        Point_cu p [PACKET_SIZE];
+        float    pf[PACKET_SIZE];
+        Vec3_cu  pg[PACKET_SIZE];
+        for(unsigned c = 0; c < cells.size(); )
+        {
+            const int cell = cells[c].first;
+            int n = 0;
+            for(; c + n < cells.size() && n < PACKET_SIZE && cells[c + n].first == cell; n++)
+                p[n] = points[ cells[c + n].second ];
+
+            compute_potential_packet(Cluster_id(cell), p, n, pf, pg);
+
+            for(int k = 0; k < n; k++){
+                const int idx = cells[c + k].second;
+                f [idx] = pf[k];
+                gf[idx] = pg[k];
+            }
+            c += n;
+        }
+    });
+}
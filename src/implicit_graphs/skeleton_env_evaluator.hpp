@@ -11,9 +11,25 @@ namespace Skeleton_env {
 // =============================================================================
 
 /// @brief compute the potential of the whole skeleton
-__device__
+/// @note on host call HRBF_env::sync_host_mem() once before evaluating.
+IF_CUDA_DEVICE_HOST
 float compute_potential(Skel_id skel_id, const Point_cu& p, Vec3_cu& gf);
 
+/// @brief compute on host the potential of the whole skeleton at several
+/// points.
+/// Points are split across the threads of Thread_pool::get() and gathered by
+/// grid cell, so that HRBF bones of a cell are evaluated for packets of points
+/// (@see HermiteRBF::fngf_packet()). Only host copies of the environment are
+/// read. When the skeleton uses the BVH acceleration (@see set_acceleration())
+/// points are evaluated one by one with the bones found in the Bvh.
+/// @param f : potential at each point
+/// @param gf : gradient at each point
+void compute_potential(Skel_id skel_id,
+                       const Point_cu* points,
+                       int nb_points,
+                       float* f,
+                       Vec3_cu* gf);
+
 }// END Skeleton_env ===========================================================
 
 
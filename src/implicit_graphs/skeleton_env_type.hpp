@@ -14,6 +14,12 @@ namespace Skeleton_env {
 /// Skeleton identifier for skeleton env
 typedef int Skel_id;
 
+/// Acceleration structure used to find the bones near a point
+enum Accel_t {
+    GRID, ///< Uniform grid with a blending list per cell (host and device)
+    BVH   ///< Hierarchy over the bones oriented bboxes (host evaluation)
+};
+
 /// Integer data linked to clusters
 struct Cluster_cu {
 
@@ -0,0 +1,1012 @@
+#include "dual_contouring.hpp"
+#include "skeleton_env_evaluator.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+
+namespace
+{
+    // Evaluate the potential and gradient at count points.
+    typedef std::function<void(const Point_cu *points, int count, float *f, Vec3_cu *gf)> Evaluator;
+
+    // A cell with no sign change at its corners is still refined if the surface may pass
+    // through it: if the potential at its center is closer to the ISO than the gradient
+    // allows over half a diagonal.  The gradient in the cell is over estimated by this factor.
+    const float gradSafety = 1.5f;
+
+    // Nodes of the first levels are always refined: the gradient can vanish at all of the
+    // samples of a large node (at the center of a bone and far from it), which would prune
+    // the whole surface.
+    const int minDepth = 2;
+
+    // Singular values of the QEF smaller than this fraction of the largest one are
+    // ignored, so flat and thin regions don't move vertices too far away.
+    const double svdThreshold = 0.1;
+
+    // Corner i of a cell is at (i&1, (i>>1)&1, (i>>2)&1) times the size of the cell.  The
+    // children of an octree node are numbered the same way.
+    int cornerBit(int corner, int axis) { return (corner >> axis) & 1; }
+
+    // The two corners of each edge of a cell.
+    const int edgeCorners[12][2] = {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7},
+        {0, 2}, {1, 3}, {4, 6}, {5, 7},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    };
+
+    // The four cells around an edge along an axis, counter-clockwise seen from the end of
+    // the edge.  Each entry is the side of the cell along the two other axes, in a
+    // right-handed order: 0 if the cell is before the edge, 1 if after.
+    const int aroundEdge[4][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+
+    // Grid points are identified by their coordinates at the finest level, 21 bits each.
+    uint64_t pointKey(int x, int y, int z) { return (uint64_t) x | ((uint64_t) y << 21) | ((uint64_t) z << 42); }
+
+    struct Sample {
+        float f;
+        Vec3_cu grad;
+    };
+
+    // Potential of a bone's bounding box, sampled on the points of a grid of res^3 cells.
+    // Samples are evaluated on demand and kept, so octree levels share their corners.
+    class Sampler
+    {
+    public:
+        Sampler(const OBBox_cu &box_, int res_, const Evaluator &eval_):
+            box(box_), res(res_), eval(eval_)
+        {
+            Vec3_cu lengths = box._bb.lengths();
+            step = Vec3_cu(lengths.x / res, lengths.y / res, lengths.z / res);
+        }
+
+        // (x,y,z) is the grid position, eg. [0,res].  Fractional positions are inside cells.
+        Point_cu position(float x, float y, float z) const {
+            return box._tr * (box._bb.pmin + Vec3_cu(x*step.x, y*step.y, z*step.z));
+        }
+
+        // Evaluate the points of keys that haven't been evaluated yet.
+        void evaluate(std::vector<uint64_t> &keys)
+        {
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+            std::vector<uint64_t> missing;
+            for(uint64_t key: keys)
+                if(samples.find(key) == samples.end())
+                    missing.push_back(key);
+
+            const int count = (int) missing.size();
+            if(count == 0)
+                return;
+
+            std::vector<Point_cu> points(count);
+            for(int i = 0; i < count; ++i)
+            {
+                const uint64_t key = missing[i];
+                points[i] = position(
+                    (float) (key & 0x1fffff),
+                    (float) ((key >> 21) & 0x1fffff),
+                    (float) (key >> 42));
+            }
+
+            std::vector<float> f(count);
+            std::vector<Vec3_cu> gf(count);
+            eval(&points[0], count, &f[0], &gf[0]);
+
+            for(int i = 0; i < count; ++i)
+            {
+                Sample &s = samples[missing[i]];
+                s.f = f[i];
+                s.grad = gf[i];
+            }
+        }
+
+        // The point must have been evaluated.
+        const Sample &get(int x, int y, int z) const { return samples.find(pointKey(x, y, z))->second; }
+
+        // Length of a cell of the finest level, along each axis.
+        Vec3_cu step;
+
+    private:
+        const OBBox_cu box;
+        const int res;
+        const Evaluator &eval;
+
+        std::unordered_map<uint64_t, Sample> samples;
+    };
+
+    // Diagonalize the symmetric matrix a with Jacobi rotations.  On return the diagonal of a
+    // holds the eigenvalues and the columns of v the eigenvectors.
+    void eigenSym3(double a[3][3], double v[3][3])
+    {
+        for(int i = 0; i < 3; ++i)
+            for(int j = 0; j < 3; ++j)
+                v[i][j] = i == j? 1: 0;
+
+        const int pairs[3][2] = { {0, 1}, {0, 2}, {1, 2} };
+        for(int sweep = 0; sweep < 16; ++sweep)
+        {
+            const double off = a[0][1]*a[0][1] + a[0][2]*a[0][2] + a[1][2]*a[1][2];
+            if(off < 1e-24)
+                break;
+
+            for(int n = 0; n < 3; ++n)
+            {
+                const int p = pairs[n][0], q = pairs[n][1];
+                if(fabs(a[p][q]) < 1e-30)
+                    continue;
+
+                const double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                const double t = (theta >= 0? 1: -1) / (fabs(theta) + sqrt(theta*theta + 1));
+                const double c = 1 / sqrt(t*t + 1);
+                const double s = t * c;
+
+                for(int k = 0; k < 3; ++k)
+                {
+                    const double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c*akp - s*akq;
+                    a[k][q] = s*akp + c*akq;
+                }
+                for(int k = 0; k < 3; ++k)
+                {
+                    const double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c*apk - s*aqk;
+                    a[q][k] = s*apk + c*aqk;
+                }
+                for(int k = 0; k < 3; ++k)
+                {
+                    const double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c*vkp - s*vkq;
+                    v[k][q] = s*vkp + c*vkq;
+                }
+            }
+        }
+    }
+
+    // Quadratic error function: the sum of the squared distances to the tangent planes at
+    // the points where the surface crosses the edges of a cell.  Coordinates are in cells of
+    // the finest level.  The QEF of a group of cells is the sum of their QEFs.
+    struct Qef {
+        Qef(): btb(0), count(0)
+        {
+            for(int i = 0; i < 3; ++i)
+            {
+                for(int j = 0; j < 3; ++j)
+                    ata[i][j] = 0;
+                atb[i] = 0;
+                mass[i] = 0;
+            }
+        }
+
+        // Add the plane through p of unit normal n.  A null normal only adds p to the mass
+        // point.
+        void add(const double p[3], const double n[3])
+        {
+            mass[0] += p[0]; mass[1] += p[1]; mass[2] += p[2];
+            count++;
+
+            const double d = n[0]*p[0] + n[1]*p[1] + n[2]*p[2];
+            for(int i = 0; i < 3; ++i)
+            {
+                for(int j = 0; j < 3; ++j)
+                    ata[i][j] += n[i] * n[j];
+                atb[i] += n[i] * d;
+            }
+            btb += d * d;
+        }
+
+        void add(const Qef &q)
+        {
+            for(int i = 0; i < 3; ++i)
+            {
+                for(int j = 0; j < 3; ++j)
+                    ata[i][j] += q.ata[i][j];
+                atb[i] += q.atb[i];
+                mass[i] += q.mass[i];
+            }
+            btb += q.btb;
+            count += q.count;
+        }
+
+        // Find the point minimizing the QEF in the cube [lo, lo+size], and return the error
+        // at that point.
+        //
+        // The minimum is searched around the mass point of the crossings, with a truncated
+        // pseudo-inverse.  If it falls outside of the cube, the mass point is used instead.
+        double solve(const int lo[3], int size, double x[3]) const
+        {
+            if(count == 0)
+            {
+                for(int i = 0; i < 3; ++i)
+                    x[i] = lo[i] + size * 0.5;
+                return 0;
+            }
+
+            double m[3];
+            for(int i = 0; i < 3; ++i)
+                m[i] = mass[i] / count;
+
+            // Solve ata * (x - m) = atb - ata * m
+            double r[3];
+            for(int i = 0; i < 3; ++i)
+                r[i] = atb[i] - (ata[i][0]*m[0] + ata[i][1]*m[1] + ata[i][2]*m[2]);
+
+            double a[3][3], v[3][3];
+            for(int i = 0; i < 3; ++i)
+                for(int j = 0; j < 3; ++j)
+                    a[i][j] = ata[i][j];
+            eigenSym3(a, v);
+
+            const double maxEigen = std::max(a[0][0], std::max(a[1][1], a[2][2]));
+            for(int i = 0; i < 3; ++i)
+                x[i] = m[i];
+            for(int k = 0; k < 3; ++k)
+            {
+                // Eigenvalues of ata are the squared singular values of the QEF.
+                const double eigen = a[k][k];
+                if(eigen <= 0 || eigen < svdThreshold*svdThreshold * maxEigen)
+                    continue;
+
+                const double proj = (v[0][k]*r[0] + v[1][k]*r[1] + v[2][k]*r[2]) / eigen;
+                for(int i = 0; i < 3; ++i)
+                    x[i] += v[i][k] * proj;
+            }
+
+            // Keep the vertex in its cell, or the mesh may fold over itself.
+            const double margin = 1e-3 * size;
+            for(int i = 0; i < 3; ++i)
+            {
+                if(x[i] < lo[i] - margin || x[i] > lo[i] + size + margin)
+                {
+                    for(int j = 0; j < 3; ++j)
+                        x[j] = m[j];
+                    break;
+                }
+            }
+
+            return error(x);
+        }
+
+        double error(const double x[3]) const
+        {
+            double e = btb;
+            for(int i = 0; i < 3; ++i)
+            {
+                e -= 2 * x[i] * atb[i];
+                for(int j = 0; j < 3; ++j)
+                    e += x[i] * ata[i][j] * x[j];
+            }
+            return std::max(e, 0.0);
+        }
+
+        double ata[3][3];
+        double atb[3];
+        double btb;
+        double mass[3];
+        int count;
+    };
+
+    // Return true if the corners of a cell with the given signs are split in one connected
+    // group inside and one outside, along the cell's edges.  The surface then crosses the
+    // cell as a single sheet, and a single vertex is enough to represent it.
+    bool isManifold(unsigned char signs)
+    {
+        for(int side = 0; side < 2; ++side)
+        {
+            const unsigned char group = side? signs: (unsigned char) ~signs;
+            if(group == 0)
+                continue;
+
+            // Flood the group from its first corner.
+            int first = 0;
+            while(!(group & (1 << first)))
+                first++;
+
+            unsigned char reached = (unsigned char) (1 << first);
+            int stack[8], top = 0;
+            stack[top++] = first;
+            while(top > 0)
+            {
+                const int c = stack[--top];
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    const int n = c ^ (1 << axis);
+                    if((group & (1 << n)) && !(reached & (1 << n)))
+                    {
+                        reached |= (unsigned char) (1 << n);
+                        stack[top++] = n;
+                    }
+                }
+            }
+
+            if(reached != group)
+                return false;
+        }
+        return true;
+    }
+
+    struct Node {
+        enum Type {
+            EMPTY,    // The surface doesn't cross the node, or we didn't refine it.
+            INTERNAL, // The node has 8 children.
+            LEAF,     // The surface crosses the node, which has a vertex.
+        };
+
+        Node(int x_, int y_, int z_, int size_):
+            type(EMPTY), children(-1), signs(0), vertex(-1)
+        {
+            pos[0] = x_; pos[1] = y_; pos[2] = z_;
+            size = size_;
+        }
+
+        // Position of the lowest corner and size, in cells of the finest level.
+        int pos[3];
+        int size;
+
+        Type type;
+
+        // Index of the first of the 8 children, for internal nodes.
+        int children;
+
+        // Bit i is set if the corner i is inside the surface.
+        unsigned char signs;
+
+        // Leaves only: the QEF of the crossings in the node, the point minimizing it and the
+        // index of this point in the mesh.
+        Qef qef;
+        double x[3];
+        int vertex;
+    };
+
+    // An octree over the grid of a Sampler.
+    //
+    // The octree is first refined from the top, down to the finest level in the cells that
+    // may cross the surface.  Since that test can miss thin parts of the surface, the cells
+    // around each edge of the finest level crossing the surface are then refined as well,
+    // so the surface is followed where the refinement lost track of it.
+    //
+    // Leaves are then collapsed from the bottom up into larger leaves, while the error of
+    // their vertex stays small and this doesn't change the topology of the surface [Ju et
+    // al. 2002, "Dual Contouring of Hermite Data"].  Quads are created across the minimal
+    // edges of the adaptive octree, between leaves of different sizes.
+    class Octree
+    {
+    public:
+        Octree(Sampler &sampler_, int res_, const Transfo &toBox_, float isoLevel_):
+            sampler(sampler_), res(res_), toBox(toBox_), isoLevel(isoLevel_)
+        {
+        }
+
+        void build();
+        void simplify(float qefThreshold);
+
+        // Append the surface to geom.
+        void contour(MeshGeom &geom, const Evaluator &eval);
+
+    private:
+        bool inside(int x, int y, int z) const { return sampler.get(x, y, z).f >= isoLevel; }
+
+        // Add the corners of the node to keys, and its center if asked.
+        void nodePoints(const Node &node, bool center, std::vector<uint64_t> &keys) const;
+
+        // Set the signs of the node from its corners, which must have been evaluated.
+        void setSigns(Node &node) const;
+
+        // Return true if the surface may cross the node.
+        bool mayCross(const Node &node) const;
+
+        // Create the children of a node.
+        void subdivide(int idx);
+
+        // Make the cell of the finest level at (x,y,z) a leaf if it crosses the surface,
+        // refining the octree down to it if needed.  Return its index if it is a new leaf,
+        // -1 otherwise.
+        int addFinestLeaf(int x, int y, int z);
+
+        // Compute the QEF and the vertex of a leaf of the finest level.
+        void initLeaf(Node &node) const;
+
+        // Try to replace the children of an internal node with a single leaf.
+        void collapse(int idx, float qefThreshold);
+
+        int child(int idx, const int bits[3]) const { return nodes[idx].children + (bits[0] | (bits[1] << 1) | (bits[2] << 2)); }
+
+        // Gather the leaves in the subtree of idx.
+        void gatherLeaves(int idx, std::vector<int> &leaves) const;
+
+        // Recursive contouring over the cells, faces and edges of the octree.
+        void cellProc(int idx, std::vector<unsigned int> &indices) const;
+        void faceProc(const int n[2], int axis, std::vector<unsigned int> &indices) const;
+        void edgeProc(const int n[4], int axis, std::vector<unsigned int> &indices) const;
+        void processEdge(const int n[4], int axis, std::vector<unsigned int> &indices) const;
+
+        Sampler &sampler;
+        const int res;
+        const Transfo toBox;
+        const float isoLevel;
+
+        std::vector<Node> nodes;
+    };
+
+    void Octree::nodePoints(const Node &node, bool center, std::vector<uint64_t> &keys) const
+    {
+        for(int i = 0; i < 8; ++i)
+        {
+            keys.push_back(pointKey(
+                node.pos[0] + cornerBit(i, 0)*node.size,
+                node.pos[1] + cornerBit(i, 1)*node.size,
+                node.pos[2] + cornerBit(i, 2)*node.size));
+        }
+        if(center && node.size > 1)
+        {
+            const int half = node.size / 2;
+            keys.push_back(pointKey(node.pos[0] + half, node.pos[1] + half, node.pos[2] + half));
+        }
+    }
+
+    void Octree::setSigns(Node &node) const
+    {
+        node.signs = 0;
+        for(int i = 0; i < 8; ++i)
+        {
+            if(inside(node.pos[0] + cornerBit(i, 0)*node.size,
+                      node.pos[1] + cornerBit(i, 1)*node.size,
+                      node.pos[2] + cornerBit(i, 2)*node.size))
+                node.signs |= (unsigned char) (1 << i);
+        }
+    }
+
+    bool Octree::mayCross(const Node &node) const
+    {
+        if(node.signs != 0 && node.signs != 0xff)
+            return true;
+
+        const int size = node.size;
+        float maxGrad = 0;
+        for(int i = 0; i < 8; ++i)
+        {
+            const Sample &s = sampler.get(
+                node.pos[0] + cornerBit(i, 0)*size,
+                node.pos[1] + cornerBit(i, 1)*size,
+                node.pos[2] + cornerBit(i, 2)*size);
+            maxGrad = std::max(maxGrad, s.grad.norm());
+        }
+
+        const Sample &center = sampler.get(node.pos[0] + size/2, node.pos[1] + size/2, node.pos[2] + size/2);
+        maxGrad = std::max(maxGrad, center.grad.norm());
+
+        const float halfDiag = sampler.step.norm() * size * 0.5f;
+        return fabsf(center.f - isoLevel) <= gradSafety * maxGrad * halfDiag;
+    }
+
+    void Octree::subdivide(int idx)
+    {
+        const int first = (int) nodes.size();
+        const Node parent = nodes[idx];
+        const int half = parent.size / 2;
+        for(int i = 0; i < 8; ++i)
+        {
+            nodes.push_back(Node(
+                parent.pos[0] + cornerBit(i, 0)*half,
+                parent.pos[1] + cornerBit(i, 1)*half,
+                parent.pos[2] + cornerBit(i, 2)*half,
+                half));
+        }
+        nodes[idx].type = Node::INTERNAL;
+        nodes[idx].children = first;
+    }
+
+    void Octree::build()
+    {
+        nodes.clear();
+        nodes.push_back(Node(0, 0, 0, res));
+
+        // Refine the nodes that may cross the surface, one level at a time so the potential
+        // is evaluated in large batches.
+        std::vector<int> finest;
+        std::vector<int> level(1, 0);
+        while(!level.empty())
+        {
+            const int size = nodes[level[0]].size;
+
+            std::vector<uint64_t> keys;
+            for(int idx: level)
+                nodePoints(nodes[idx], true, keys);
+            sampler.evaluate(keys);
+
+            std::vector<int> next;
+            for(int idx: level)
+            {
+                Node &node = nodes[idx];
+                setSigns(node);
+                if(size == 1)
+                {
+                    if(node.signs != 0 && node.signs != 0xff)
+                    {
+                        node.type = Node::LEAF;
+                        finest.push_back(idx);
+                    }
+                    continue;
+                }
+
+                if(size * (1 << minDepth) <= res && !mayCross(node))
+                    continue;
+
+                subdivide(idx);
+                for(int i = 0; i < 8; ++i)
+                    next.push_back(nodes[idx].children + i);
+            }
+            level.swap(next);
+        }
+
+        // Make sure that the four cells around each edge of the finest level crossing the
+        // surface are leaves.  New leaves are checked in turn, so this follows the surface
+        // into the nodes that weren't refined.
+        std::vector<int> work = finest;
+        while(!work.empty())
+        {
+            const Node cell = nodes[work.back()];
+            work.pop_back();
+
+            for(int e = 0; e < 12; ++e)
+            {
+                const int c0 = edgeCorners[e][0], c1 = edgeCorners[e][1];
+                if(((cell.signs >> c0) & 1) == ((cell.signs >> c1) & 1))
+                    continue;
+
+                const int axis = e / 4;
+                const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                const int p[3] = {
+                    cell.pos[0] + cornerBit(c0, 0),
+                    cell.pos[1] + cornerBit(c0, 1),
+                    cell.pos[2] + cornerBit(c0, 2),
+                };
+                for(int k = 0; k < 4; ++k)
+                {
+                    int c[3] = { p[0], p[1], p[2] };
+                    c[u] -= 1 - aroundEdge[k][0];
+                    c[v] -= 1 - aroundEdge[k][1];
+                    if(c[u] < 0 || c[v] < 0 || c[u] >= res || c[v] >= res)
+                        continue;
+
+                    const int idx = addFinestLeaf(c[0], c[1], c[2]);
+                    if(idx >= 0)
+                    {
+                        work.push_back(idx);
+                        finest.push_back(idx);
+                    }
+                }
+            }
+        }
+
+        Thread_pool::get().parallel_for((int) finest.size(), 64, [&](int begin, int end) {
+            for(int i = begin; i < end; ++i)
+                initLeaf(nodes[finest[i]]);
+        });
+    }
+
+    int Octree::addFinestLeaf(int x, int y, int z)
+    {
+        int idx = 0;
+        while(nodes[idx].size > 1)
+        {
+            if(nodes[idx].type != Node::INTERNAL)
+            {
+                // A node we didn't refine: create its children with their signs.
+                subdivide(idx);
+                std::vector<uint64_t> keys;
+                for(int i = 0; i < 8; ++i)
+                    nodePoints(nodes[nodes[idx].children + i], false, keys);
+                sampler.evaluate(keys);
+                for(int i = 0; i < 8; ++i)
+                    setSigns(nodes[nodes[idx].children + i]);
+            }
+
+            const int half = nodes[idx].size / 2;
+            const int bits[3] = {
+                x >= nodes[idx].pos[0] + half,
+                y >= nodes[idx].pos[1] + half,
+                z >= nodes[idx].pos[2] + half,
+            };
+            idx = child(idx, bits);
+        }
+
+        Node &node = nodes[idx];
+        if(node.type == Node::LEAF || node.signs == 0 || node.signs == 0xff)
+            return -1;
+
+        node.type = Node::LEAF;
+        return idx;
+    }
+
+    void Octree::initLeaf(Node &node) const
+    {
+        const Vec3_cu &step = sampler.step;
+        for(int e = 0; e < 12; ++e)
+        {
+            const int c0 = edgeCorners[e][0], c1 = edgeCorners[e][1];
+            if(((node.signs >> c0) & 1) == ((node.signs >> c1) & 1))
+                continue;
+
+            const Sample &s1 = sampler.get(node.pos[0] + cornerBit(c0, 0), node.pos[1] + cornerBit(c0, 1), node.pos[2] + cornerBit(c0, 2));
+            const Sample &s2 = sampler.get(node.pos[0] + cornerBit(c1, 0), node.pos[1] + cornerBit(c1, 1), node.pos[2] + cornerBit(c1, 2));
+
+            const float t = std::min(std::max((isoLevel - s1.f) / (s2.f - s1.f), 0.f), 1.f);
+            double p[3];
+            for(int i = 0; i < 3; ++i)
+                p[i] = node.pos[i] + cornerBit(c0, i) + (cornerBit(c1, i) - cornerBit(c0, i)) * t;
+
+            // The gradient in grid coordinates: world gradient brought back to the box's
+            // axes, scaled by the size of a cell.
+            Vec3_cu g = toBox * (s1.grad + (s2.grad - s1.grad) * t);
+            g = Vec3_cu(g.x * step.x, g.y * step.y, g.z * step.z);
+            const float len = g.norm();
+
+            double n[3] = { 0, 0, 0 };
+            if(len >= 1e-12f)
+            {
+                n[0] = g.x / len;
+                n[1] = g.y / len;
+                n[2] = g.z / len;
+            }
+            node.qef.add(p, n);
+        }
+
+        node.qef.solve(node.pos, node.size, node.x);
+    }
+
+    void Octree::collapse(int idx, float qefThreshold)
+    {
+        Node &node = nodes[idx];
+
+        bool hasLeaf = false;
+        bool manifold = true;
+        Qef qef;
+        for(int i = 0; i < 8; ++i)
+        {
+            const Node &c = nodes[node.children + i];
+            if(c.type == Node::INTERNAL)
+                return;
+            if(c.type != Node::LEAF)
+                continue;
+
+            hasLeaf = true;
+            manifold = manifold && isManifold(c.signs);
+            qef.add(c.qef);
+        }
+
+        if(!hasLeaf)
+        {
+            node.type = Node::EMPTY;
+            return;
+        }
+
+        if(!manifold || !isManifold(node.signs))
+            return;
+
+        // The sign in the middle of each edge and face of the node, and at its center, must
+        // be the sign of one of the corners of that edge, face or cell.  Otherwise the
+        // surface crosses the node in a way its corners don't show.
+        const int half = node.size / 2;
+        for(int i = 0; i < 27; ++i)
+        {
+            const int q[3] = { i % 3, (i / 3) % 3, i / 9 };
+            if(q[0] != 1 && q[1] != 1 && q[2] != 1)
+                continue;
+
+            const int in = inside(node.pos[0] + q[0]*half, node.pos[1] + q[1]*half, node.pos[2] + q[2]*half)? 1: 0;
+            bool agrees = false;
+            for(int c = 0; c < 8 && !agrees; ++c)
+            {
+                bool onCorner = true;
+                for(int axis = 0; axis < 3; ++axis)
+                    if(q[axis] != 1 && cornerBit(c, axis) != q[axis] / 2)
+                        onCorner = false;
+                agrees = onCorner && ((node.signs >> c) & 1) == in;
+            }
+            if(!agrees)
+                return;
+        }
+
+        double x[3];
+        if(!(qef.solve(node.pos, node.size, x) < qefThreshold))
+            return;
+
+        node.type = Node::LEAF;
+        node.qef = qef;
+        for(int i = 0; i < 3; ++i)
+            node.x[i] = x[i];
+    }
+
+    void Octree::simplify(float qefThreshold)
+    {
+        // Children are always created after their parent, so going backward visits them first.
+        for(int idx = (int) nodes.size() - 1; idx >= 0; --idx)
+            if(nodes[idx].type == Node::INTERNAL)
+                collapse(idx, qefThreshold);
+    }
+
+    void Octree::gatherLeaves(int idx, std::vector<int> &leaves) const
+    {
+        const Node &node = nodes[idx];
+        if(node.type == Node::LEAF)
+            leaves.push_back(idx);
+        else if(node.type == Node::INTERNAL)
+            for(int i = 0; i < 8; ++i)
+                gatherLeaves(node.children + i, leaves);
+    }
+
+    void Octree::cellProc(int idx, std::vector<unsigned int> &indices) const
+    {
+        if(nodes[idx].type != Node::INTERNAL)
+            return;
+
+        for(int i = 0; i < 8; ++i)
+            cellProc(nodes[idx].children + i, indices);
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+            // The four faces between children along axis.
+            for(int i = 0; i < 4; ++i)
+            {
+                int bits[3];
+                bits[u] = i & 1;
+                bits[v] = i >> 1;
+                int n[2];
+                bits[axis] = 0; n[0] = child(idx, bits);
+                bits[axis] = 1; n[1] = child(idx, bits);
+                faceProc(n, axis, indices);
+            }
+
+            // The two halves of the edge along axis through the center.
+            for(int h = 0; h < 2; ++h)
+            {
+                int n[4];
+                for(int k = 0; k < 4; ++k)
+                {
+                    int bits[3];
+                    bits[axis] = h;
+                    bits[u] = aroundEdge[k][0];
+                    bits[v] = aroundEdge[k][1];
+                    n[k] = child(idx, bits);
+                }
+                edgeProc(n, axis, indices);
+            }
+        }
+    }
+
+    // n[0] is before the face along axis, n[1] after.
+    void Octree::faceProc(const int n[2], int axis, std::vector<unsigned int> &indices) const
+    {
+        const Node::Type t0 = nodes[n[0]].type, t1 = nodes[n[1]].type;
+        if(t0 == Node::EMPTY || t1 == Node::EMPTY)
+            return;
+        if(t0 == Node::LEAF && t1 == Node::LEAF)
+            return;
+
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+        // The four quarters of the face.
+        for(int i = 0; i < 4; ++i)
+        {
+            int sub[2];
+            for(int s = 0; s < 2; ++s)
+            {
+                if(nodes[n[s]].type == Node::LEAF)
+                {
+                    sub[s] = n[s];
+                    continue;
+                }
+
+                int bits[3];
+                bits[axis] = 1 - s;
+                bits[u] = i & 1;
+                bits[v] = i >> 1;
+                sub[s] = child(n[s], bits);
+            }
+            faceProc(sub, axis, indices);
+        }
+
+        // The four edges in the face: two halves of the edges along u and v through the
+        // center of the face.
+        const int faceAxes[2] = { u, v };
+        for(int a = 0; a < 2; ++a)
+        {
+            const int e = faceAxes[a], other = faceAxes[1 - a];
+            const int p = (e + 1) % 3, q = (e + 2) % 3;
+            for(int h = 0; h < 2; ++h)
+            {
+                int sub[4];
+                for(int k = 0; k < 4; ++k)
+                {
+                    int side[3];
+                    side[p] = aroundEdge[k][0];
+                    side[q] = aroundEdge[k][1];
+
+                    const int s = side[axis];
+                    if(nodes[n[s]].type == Node::LEAF)
+                    {
+                        sub[k] = n[s];
+                        continue;
+                    }
+
+                    int bits[3];
+                    bits[axis] = 1 - s;
+                    bits[other] = side[other];
+                    bits[e] = h;
+                    sub[k] = child(n[s], bits);
+                }
+                edgeProc(sub, e, indices);
+            }
+        }
+    }
+
+    // n are the nodes around an edge along axis, in the order of aroundEdge.
+    void Octree::edgeProc(const int n[4], int axis, std::vector<unsigned int> &indices) const
+    {
+        bool leaves = true;
+        for(int k = 0; k < 4; ++k)
+        {
+            if(nodes[n[k]].type == Node::EMPTY)
+                return;
+            leaves = leaves && nodes[n[k]].type == Node::LEAF;
+        }
+
+        if(leaves)
+        {
+            processEdge(n, axis, indices);
+            return;
+        }
+
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for(int h = 0; h < 2; ++h)
+        {
+            int sub[4];
+            for(int k = 0; k < 4; ++k)
+            {
+                if(nodes[n[k]].type == Node::LEAF)
+                {
+                    sub[k] = n[k];
+                    continue;
+                }
+
+                // The child of n[k] along the edge.
+                int bits[3];
+                bits[axis] = h;
+                bits[u] = 1 - aroundEdge[k][0];
+                bits[v] = 1 - aroundEdge[k][1];
+                sub[k] = child(n[k], bits);
+            }
+            edgeProc(sub, axis, indices);
+        }
+    }
+
+    void Octree::processEdge(const int n[4], int axis, std::vector<unsigned int> &indices) const
+    {
+        // The edge is a whole edge of the smallest leaf around it: use its signs.
+        int smallest = 0;
+        for(int k = 1; k < 4; ++k)
+            if(nodes[n[k]].size < nodes[n[smallest]].size)
+                smallest = k;
+
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        int bits[3];
+        bits[u] = 1 - aroundEdge[smallest][0];
+        bits[v] = 1 - aroundEdge[smallest][1];
+        bits[axis] = 0;
+        const int c0 = bits[0] | (bits[1] << 1) | (bits[2] << 2);
+        const int c1 = c0 | (1 << axis);
+
+        const int signs = nodes[n[smallest]].signs;
+        const int s0 = (signs >> c0) & 1, s1 = (signs >> c1) & 1;
+        if(s0 == s1)
+            return;
+        const bool inside = s0 != 0;
+
+        unsigned int quad[4];
+        for(int k = 0; k < 4; ++k)
+            quad[k] = (unsigned) nodes[n[k]].vertex;
+
+        // The quad faces along the edge.  Flip it if the surface faces the other way.
+        if(!inside)
+            std::swap(quad[1], quad[3]);
+
+        // Leaves larger than the edge can appear twice around it: drop the degenerate triangle.
+        const unsigned int tris[2][3] = {
+            { quad[0], quad[1], quad[2] },
+            { quad[0], quad[2], quad[3] },
+        };
+        for(int i = 0; i < 2; ++i)
+        {
+            const unsigned int *tri = tris[i];
+            if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+                continue;
+            indices.insert(indices.end(), tri, tri + 3);
+        }
+    }
+
+    void Octree::contour(MeshGeom &geom, const Evaluator &eval)
+    {
+        std::vector<int> leaves;
+        gatherLeaves(0, leaves);
+        if(leaves.empty())
+            return;
+
+        const int firstVertex = (int) geom.vertices.size();
+        const int nbLeaves = (int) leaves.size();
+        std::vector<Point_cu> positions(nbLeaves);
+        for(int i = 0; i < nbLeaves; ++i)
+        {
+            Node &node = nodes[leaves[i]];
+            node.vertex = firstVertex + i;
+            positions[i] = sampler.position((float) node.x[0], (float) node.x[1], (float) node.x[2]);
+        }
+
+        // Gradients point in towards the surface.  Multiply by -1 to get a normal pointing
+        // away from the surface.
+        std::vector<float> f(nbLeaves);
+        std::vector<Vec3_cu> grads(nbLeaves);
+        eval(&positions[0], nbLeaves, &f[0], &grads[0]);
+
+        geom.vertices.resize(firstVertex + nbLeaves);
+        for(int i = 0; i < nbLeaves; ++i)
+        {
+            MeshGeomVertex &vertex = geom.vertices[firstVertex + i];
+            vertex.pos = positions[i];
+            vertex.normal = grads[i] * -1;
+            vertex.col = Point_cu(0, 0, 0);
+        }
+
+        cellProc(0, geom.indices);
+    }
+
+    // Append the surface of the ISO level in box to geom.  The box is subdivided maxDepth
+    // times.
+    void polygonize(const OBBox_cu &box, const Evaluator &eval, MeshGeom &geom, float isoLevel, int maxDepth, float qefThreshold)
+    {
+        const int res = 1 << maxDepth;
+        Sampler sampler(box, res, eval);
+
+        Octree octree(sampler, res, box._tr.fast_invert(), isoLevel);
+        octree.build();
+        octree.simplify(qefThreshold);
+        octree.contour(geom, eval);
+    }
+}
+
+// As with marching cubes, we draw in world space.  Surface nodes set the bone's world space
+// matrix to identity to draw in object space.
+void DualContouring::compute_surface(MeshGeom &geom, const Skeleton *skel, float isoLevel, int maxDepth, float qefThreshold)
+{
+    maxDepth = std::min(std::max(maxDepth, 1), 10);
+
+    const Skeleton_env::Skel_id skel_id = skel->get_skel_id();
+    Evaluator eval = [&](const Point_cu *points, int count, float *f, Vec3_cu *gf) {
+        Skeleton_env::compute_potential(skel_id, points, count, f, gf);
+    };
+
+    for(Bone::Id bone_id: skel->get_bone_ids())
+    {
+        const Bone *bone = skel->get_bone(bone_id).get();
+
+        // Use the same region as marching cubes: the ISO 0.5 bounding box when we can, extended
+        // to reach beyond the surface and any blending.
+        bool use_surface_bbox = isoLevel >= 0.5 - 1e-6;
+        OBBox_cu worldObbox = bone->get_obbox(use_surface_bbox, true);
+
+        BBox_cu &bb = worldObbox._bb;
+        if(!bb.is_valid())
+            continue;
+
+        Vec3_cu box_size = bb.pmax - bb.pmin;
+        bb.pmin = bb.pmin - box_size * 0.2f;
+        bb.pmax = bb.pmax + box_size * 0.2f;
+
+        polygonize(worldObbox, eval, geom, isoLevel, maxDepth, qefThreshold);
+    }
+}
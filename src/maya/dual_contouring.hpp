@@ -0,0 +1,26 @@
+#ifndef DUAL_CONTOURING_H
+#define DUAL_CONTOURING_H
+
+#include "marching_cubes.hpp"
+
+namespace DualContouring
+{
+    // Compute the geometry to preview the given skeleton, and append it to meshGeom.
+    //
+    // Each bone's bounding box is subdivided as an octree, only refining cells that may
+    // cross the surface, down to cells 1/2^maxDepth the size of the box.  One vertex is
+    // placed in each crossing cell by minimizing the distance to the tangent planes given by
+    // the potential gradient (QEF), which keeps sharp features that marching cubes rounds off
+    // at the same resolution.
+    //
+    // The octree is then simplified bottom-up: the children of a node are replaced by a
+    // single vertex when the QEF error of that vertex is below qefThreshold and the surface
+    // stays manifold, so flat regions get large polygons.  qefThreshold is a sum of squared
+    // distances measured in finest cells; 0 keeps every cell.  Quads are created across each
+    // edge crossing the surface, between leaves of any size.
+    //
+    // The potential is evaluated on the host (@see Skeleton_env::compute_potential()).
+    void compute_surface(MeshGeom &geom, const Skeleton *skel, float isoLevel = 0.5f, int maxDepth = 4, float qefThreshold = 0.05f);
+}
+
+#endif
@@ -37,6 +37,7 @@ MObject ImplicitBlend::implicit;
 MObject ImplicitBlend::meshGeometryUpdateAttr;
 MObject ImplicitBlend::worldImplicit;
 MObject ImplicitBlend::previewIso;
+MObject ImplicitBlend::previewResolution;
 
 namespace {
     MStatus setImplicitSurfaceData(MDataBlock &dataBlock, MObject attr, shared_ptr<const Skeleton> skel)
@@ -80,6 +81,12 @@ MStatus ImplicitBlend::initialize()
         addAttribute(previewIso);
         dependencies.add(previewIso, meshGeometryUpdateAttr);
 
+        previewResolution = numAttr.create("previewResolution", "previewResolution", MFnNumericData::Type::kInt, 16, &status);
+        numAttr.setMin(2);
+        numAttr.setSoftMax(64);
+        addAttribute(previewResolution);
+        dependencies.add(previewResolution, meshGeometryUpdateAttr);
+
         // Note that this attribute isn't set to worldSpace.  The input surfaces are world space, and the
         // output combined surfaces are world space, but we ignore the position of this actual node.
         worldImplicit = typedAttr.create("worldImplicit", "worldImplicit", ImplicitSurfaceData::id, MObject::kNullObj, &status);
@@ -190,6 +197,7 @@ void ImplicitBlend::load_mesh_geometry(MDataBlock &dataBlock)
     dataBlock.inputValue(ImplicitBlend::worldImplicit, &status); merr("inputValue(worldImplicit)");
 
     float iso = DagHelpers::readHandle<float>(dataBlock, ImplicitBlend::previewIso, &status); merr("readHandle(previewIso)")
+    int resolution = DagHelpers::readHandle<int>(dataBlock, ImplicitBlend::previewResolution, &status); merr("readHandle(previewResolution)")
 
     meshGeometry = MeshGeom();
 
@@ -198,7 +206,7 @@ void ImplicitBlend::load_mesh_geometry(MDataBlock &dataBlock)
         return;
 
     skeleton->update_bones_data();
-    MarchingCubes::compute_surface(meshGeometry, skeleton.get(), iso);
+    MarchingCubes::compute_surface(meshGeometry, skeleton.get(), iso, resolution);
 }
 
 // Retrieve the list of input bones and their parents from our attributes.
@@ -338,7 +346,9 @@ void ImplicitBlend::update_skeleton_params(MDataBlock &dataBlock)
     MArrayDataHandle surfacesHandle = dataBlock.inputArrayValue(ImplicitBlend::surfaces, &status); merr("inputArrayValue(surfaces)");
 
     // Propagate each source bone's blending properties to our skeleton.  These are set
-    // per-bone, but are stored on the skeleton.
+    // per-bone, but are stored on the skeleton.  Collect the changes so the skeleton
+    // environment is only updated once.
+    Skeleton::Update_scope update_scope(*skeleton);
     for(int i = 0; i < (int) surfacesHandle.elementCount(); ++i)
     {
         status = surfacesHandle.jumpToElement(i); merr("surfacesHandle.jumpToElement");
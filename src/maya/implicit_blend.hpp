@@ -47,6 +47,10 @@ public:
     // The ISO used for the preview display (default 0.5).
     static MObject previewIso;
 
+    // The number of marching cubes grid points along each axis of a bone for the preview
+    // display (default 16).
+    static MObject previewResolution;
+
 private:
     // compute() implementations:
     void load_world_implicit(const MPlug &plug, MDataBlock &dataBlock);
@@ -71,6 +71,10 @@ MObject ImplicitDeformer::deformerIterations;
 MObject ImplicitDeformer::iterativeSmoothing;
 MObject ImplicitDeformer::finalFitting;
 MObject ImplicitDeformer::finalSmoothingMode;
+MObject ImplicitDeformer::warmStart;
+MObject ImplicitDeformer::warmStartThreshold;
+MObject ImplicitDeformer::minActiveVertices;
+MObject ImplicitDeformer::lodRings;
 
 DagHelpers::MayaDependencies ImplicitDeformer::dependencies;
 
@@ -120,6 +124,25 @@ MStatus ImplicitDeformer::initialize()
         addAttribute(finalSmoothingMode);
         dependencies.add(ImplicitDeformer::finalSmoothingMode, ImplicitDeformer::outputGeom);
 
+        warmStart = numAttr.create("warmStart", "warmStart", MFnNumericData::Type::kBoolean, false, &status);
+        addAttribute(warmStart);
+        dependencies.add(ImplicitDeformer::warmStart, ImplicitDeformer::outputGeom);
+
+        warmStartThreshold = numAttr.create("warmStartThreshold", "warmStartThreshold", MFnNumericData::Type::kFloat, 0.1, &status);
+        numAttr.setMin(0);
+        addAttribute(warmStartThreshold);
+        dependencies.add(ImplicitDeformer::warmStartThreshold, ImplicitDeformer::outputGeom);
+
+        minActiveVertices = numAttr.create("minActiveVertices", "minActiveVertices", MFnNumericData::Type::kInt, 0, &status);
+        numAttr.setMin(0);
+        addAttribute(minActiveVertices);
+        dependencies.add(ImplicitDeformer::minActiveVertices, ImplicitDeformer::outputGeom);
+
+        lodRings = numAttr.create("lodRings", "lodRings", MFnNumericData::Type::kInt, 0, &status);
+        numAttr.setMin(0);
+        addAttribute(lodRings);
+        dependencies.add(ImplicitDeformer::lodRings, ImplicitDeformer::outputGeom);
+
         // The base potential of the mesh.
         basePotential = numAttr.create("basePotential", "bp", MFnNumericData::Type::kFloat, 0, &status);
         numAttr.setArray(true);
@@ -140,6 +163,7 @@ void ImplicitDeformer::postConstructor()
 {
     implicitIsConnected = false;
     basePotentialIsDirty = false;
+    animeshLodRings = 0;
 }
 
 MStatus ImplicitDeformer::setDependentsDirty(const MPlug &plug, MPlugArray &plugArray)
@@ -219,6 +243,21 @@ MStatus ImplicitDeformer::deform(MDataBlock &dataBlock, MItGeometry &geomIter, c
     bool iterativeSmoothing = DagHelpers::readHandle<bool>(dataBlock, ImplicitDeformer::iterativeSmoothing, &status); merr("iterativeSmoothing");
     animesh->set_smooth_mesh(iterativeSmoothing);
 
+    // Only recompute the vertex mask when the level of detail changes.
+    int lod = DagHelpers::readHandle<int>(dataBlock, ImplicitDeformer::lodRings, &status); merr("lodRings");
+    if(lod != animeshLodRings)
+    {
+        vector<bool> mask;
+        if(lod > 0)
+            mesh->compute_lod_mask(lod, mask);
+        animesh->set_vert_mask(mask);
+        animeshLodRings = lod;
+    }
+
+    Vert_active_set::Settings schedule;
+    schedule.min_active = DagHelpers::readHandle<int>(dataBlock, ImplicitDeformer::minActiveVertices, &status); merr("minActiveVertices");
+    animesh->set_fitting_schedule(schedule);
+
     bool finalFitting = DagHelpers::readHandle<bool>(dataBlock, ImplicitDeformer::finalFitting, &status); merr("finalFitting");
     animesh->set_final_fitting(finalFitting);
 
@@ -236,6 +275,12 @@ MStatus ImplicitDeformer::deform(MDataBlock &dataBlock, MItGeometry &geomIter, c
     }
     animesh->set_smoothing_type(smoothType);
 
+    bool warmStart = DagHelpers::readHandle<bool>(dataBlock, ImplicitDeformer::warmStart, &status); merr("warmStart");
+    animesh->set_warm_start(warmStart);
+
+    float warmStartThreshold = DagHelpers::readHandle<float>(dataBlock, ImplicitDeformer::warmStartThreshold, &status); merr("warmStartThreshold");
+    animesh->set_warm_start_threshold(warmStartThreshold);
+
     animesh->transform_vertices();
 
     vector<Point_cu> result_verts;
@@ -339,6 +384,7 @@ void ImplicitDeformer::load_mesh(MDataBlock &dataBlock)
 
     // Create a new animMesh with the current mesh and skeleton.
     animesh.reset(AnimeshBase::create(mesh.get(), skel));
+    animeshLodRings = 0;
 
     // Load base potential.
     load_base_potential(dataBlock);
@@ -46,6 +46,18 @@ public:
 
     // The final smoothing method.  Note that this is independent of iterativeSmoothing.
     static MObject finalSmoothingMode;
+
+    // Start fitting from the result of the previous evaluation, unless a bone moved more than
+    // warmStartThreshold times its length since then.
+    static MObject warmStart;
+    static MObject warmStartThreshold;
+
+    // Stop the iterative smoothing when this number of vertices or less are still being fitted.
+    static MObject minActiveVertices;
+
+    // Only fit a subset of vertices spaced by this number of edges, the other vertices follow
+    // their fitted neighbors.  0 fits every vertex.
+    static MObject lodRings;
     
 private:
     static DagHelpers::MayaDependencies dependencies;
@@ -64,6 +76,9 @@ private:
 
     // The main deformer implementation.
     std::unique_ptr<AnimeshBase> animesh;
+
+    // The lodRings value the vertex mask of animesh was computed with.
+    int animeshLodRings;
 };
 
 #endif
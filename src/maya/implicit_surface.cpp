@@ -33,6 +33,8 @@
 #include "skeleton.hpp"
 
 #include "implicit_surface_data.hpp"
+#include "dual_contouring.hpp"
+#include "precomputed_prim_constants.hpp"
 
 #include <algorithm>
 #include <map>
@@ -53,6 +55,31 @@ namespace {
         int logicalIndex = plug.logicalIndex(&status); merr("logicalIndex()");
         status = DagHelpers::addObjectToArray(dataBlock, plug.attribute(), logicalIndex, data); merr("addObjectToArray");
     }
+
+    // Hash everything the precomputed grid depends on (FNV-1a), so a grid cache file saved
+    // with other samples or settings isn't used.
+    int64_t gridCacheKey(const SampleSet::InputSample &inputSample, float hrbfRadius, int gridRes, bool gridHalf)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](const void *data, size_t size) {
+            const unsigned char *bytes = (const unsigned char *) data;
+            for(size_t i = 0; i < size; ++i)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+        };
+
+        for(int i = 0; i < (int) inputSample.nodes.size(); ++i)
+        {
+            const float values[6] = {
+                inputSample.nodes[i].x, inputSample.nodes[i].y, inputSample.nodes[i].z,
+                inputSample.n_nodes[i].x, inputSample.n_nodes[i].y, inputSample.n_nodes[i].z,
+            };
+            add(values, sizeof(values));
+        }
+        add(&hrbfRadius, sizeof(hrbfRadius));
+        add(&gridRes, sizeof(gridRes));
+        add(&gridHalf, sizeof(gridHalf));
+        return (int64_t) hash;
+    }
 }
 
 
@@ -72,6 +99,9 @@ namespace {
 MTypeId ImplicitSurface::id(0xEA117);
 
 MObject ImplicitSurface::hrbfRadiusAttr;
+MObject ImplicitSurface::gridResolution;
+MObject ImplicitSurface::gridHalfPrecision;
+MObject ImplicitSurface::gridCacheFile;
 MObject ImplicitSurface::samplePointAttr;
 MObject ImplicitSurface::sampleNormalAttr;
 MObject ImplicitSurface::initialDir;
@@ -80,6 +110,9 @@ MObject ImplicitSurface::meshGeometryUpdateAttr;
 MObject ImplicitSurface::worldImplicit;
 MObject ImplicitSurface::blendMode;
 MObject ImplicitSurface::bulgeStrength;
+MObject ImplicitSurface::previewResolution;
+MObject ImplicitSurface::previewMode;
+MObject ImplicitSurface::previewSimplification;
 
 DagHelpers::MayaDependencies ImplicitSurface::dependencies;
 
@@ -105,6 +138,17 @@ MStatus ImplicitSurface::initialize()
         hrbfRadiusAttr = numAttr.create("hrbfRadius", "hrbfRadius", MFnNumericData::Type::kFloat, 0, &status);
         addAttribute(hrbfRadiusAttr);
 
+        gridResolution = numAttr.create("gridResolution", "gridResolution", MFnNumericData::Type::kInt, GRID_RES, &status);
+        numAttr.setMin(8);
+        numAttr.setSoftMax(128);
+        addAttribute(gridResolution);
+
+        gridHalfPrecision = numAttr.create("gridHalfPrecision", "gridHalfPrecision", MFnNumericData::Type::kBoolean, false, &status);
+        addAttribute(gridHalfPrecision);
+
+        gridCacheFile = typedAttr.create("gridCacheFile", "gridCacheFile", MFnData::kString, MObject::kNullObj, &status);
+        addAttribute(gridCacheFile);
+
         sampleSetUpdateAttr = numAttr.create("sampleSetUpdate", "sampleSetUpdate", MFnNumericData::Type::kInt, 0, &status);
         numAttr.setStorable(false);
         numAttr.setHidden(true);
@@ -113,6 +157,9 @@ MStatus ImplicitSurface::initialize()
         dependencies.add(ImplicitSurface::samplePointAttr, ImplicitSurface::sampleSetUpdateAttr);
         dependencies.add(ImplicitSurface::sampleNormalAttr, ImplicitSurface::sampleSetUpdateAttr);
         dependencies.add(ImplicitSurface::hrbfRadiusAttr, ImplicitSurface::sampleSetUpdateAttr);
+        dependencies.add(ImplicitSurface::gridResolution, ImplicitSurface::sampleSetUpdateAttr);
+        dependencies.add(ImplicitSurface::gridHalfPrecision, ImplicitSurface::sampleSetUpdateAttr);
+        dependencies.add(ImplicitSurface::gridCacheFile, ImplicitSurface::sampleSetUpdateAttr);
 
         meshGeometryUpdateAttr = numAttr.create("meshGeometryUpdate", "meshGeometryUpdate", MFnNumericData::Type::kInt, 0, &status);
         numAttr.setStorable(false);
@@ -120,6 +167,24 @@ MStatus ImplicitSurface::initialize()
         addAttribute(meshGeometryUpdateAttr);
         dependencies.add(ImplicitSurface::sampleSetUpdateAttr, ImplicitSurface::meshGeometryUpdateAttr);
 
+        previewResolution = numAttr.create("previewResolution", "previewResolution", MFnNumericData::Type::kInt, 16, &status);
+        numAttr.setMin(2);
+        numAttr.setSoftMax(64);
+        addAttribute(previewResolution);
+        dependencies.add(ImplicitSurface::previewResolution, ImplicitSurface::meshGeometryUpdateAttr);
+
+        previewMode = enumAttr.create("previewMode", "previewMode", 0, &status);
+        enumAttr.addField("Marching cubes", 0);
+        enumAttr.addField("Dual contouring", 1);
+        addAttribute(previewMode);
+        dependencies.add(ImplicitSurface::previewMode, ImplicitSurface::meshGeometryUpdateAttr);
+
+        previewSimplification = numAttr.create("previewSimplification", "previewSimplification", MFnNumericData::Type::kFloat, 0.05, &status);
+        numAttr.setMin(0);
+        numAttr.setSoftMax(1);
+        addAttribute(previewSimplification);
+        dependencies.add(ImplicitSurface::previewSimplification, ImplicitSurface::meshGeometryUpdateAttr);
+
         blendMode = enumAttr.create("blendMode", "blendMode", 0, &status);
         enumAttr.addField("Max", 0);
         enumAttr.addField("Bulge", 1);
@@ -252,11 +317,15 @@ void ImplicitSurface::load_sampleset(MDataBlock &dataBlock)
     MArrayDataHandle sampleNormalHandle = dataBlock.inputArrayValue(ImplicitSurface::sampleNormalAttr, &status); merr("inputArrayValue(samplePointAttr)");
 
     // Load the HRBF radius.  This isn't really part of the sample set.
-    {
-        MDataHandle hrbfRadiusHandle = dataBlock.inputValue(ImplicitSurface::hrbfRadiusAttr, &status); merr("inputValue(hrbfRadiusAttr)");
-        float hrbfRadius = hrbfRadiusHandle.asFloat();
-        bone->set_hrbf_radius(hrbfRadius, boneSkeleton.get());
-    }
+    MDataHandle hrbfRadiusHandle = dataBlock.inputValue(ImplicitSurface::hrbfRadiusAttr, &status); merr("inputValue(hrbfRadiusAttr)");
+    float hrbfRadius = hrbfRadiusHandle.asFloat();
+    bone->set_hrbf_radius(hrbfRadius, boneSkeleton.get());
+
+    // Set how the precomputed grid is stored.  This is used by the next precompute.
+    int gridRes = DagHelpers::readHandle<int>(dataBlock, ImplicitSurface::gridResolution, &status); merr("readHandle(gridResolution)");
+    bool gridHalf = DagHelpers::readHandle<bool>(dataBlock, ImplicitSurface::gridHalfPrecision, &status); merr("readHandle(gridHalfPrecision)");
+    bone->get_primitive().set_grid_res(gridRes);
+    bone->get_primitive().set_host_half(gridHalf);
 
     if(samplePointHandle.elementCount() != sampleNormalHandle.elementCount())
         throw std::runtime_error("Element count mismatch");
@@ -291,6 +360,9 @@ void ImplicitSurface::load_sampleset(MDataBlock &dataBlock)
         // HRBF_env::apply_hrbf_transfos();
         Precomputed_prim::update_device_transformations();
 
+        MDataHandle gridCacheFileHandle = dataBlock.inputValue(ImplicitSurface::gridCacheFile, &status); merr("inputValue(gridCacheFile)");
+        bone->set_grid_cache(gridCacheFileHandle.asString().asChar(), gridCacheKey(inputSample, hrbfRadius, gridRes, gridHalf));
+
         if(bone->get_type() == EBone::HRBF)
             bone->precompute(boneSkeleton.get());
     }
@@ -302,6 +374,9 @@ void ImplicitSurface::load_mesh_geometry(MDataBlock &dataBlock)
     MStatus status = MStatus::kSuccess;
 
     dataBlock.inputValue(ImplicitSurface::sampleSetUpdateAttr, &status); merr("inputValue(sampleSetUpdate)");
+    int resolution = DagHelpers::readHandle<int>(dataBlock, ImplicitSurface::previewResolution, &status); merr("readHandle(previewResolution)");
+    int mode = DagHelpers::readHandle<short>(dataBlock, ImplicitSurface::previewMode, &status); merr("readHandle(previewMode)");
+    float simplification = DagHelpers::readHandle<float>(dataBlock, ImplicitSurface::previewSimplification, &status); merr("readHandle(previewSimplification)");
 
     // Temporarily set the world space transform of the bone to identity, so we can calculate
     // the mesh in object space.  Our transform node will apply the world space transform.
@@ -310,7 +385,16 @@ void ImplicitSurface::load_mesh_geometry(MDataBlock &dataBlock)
 
     meshGeometry = MeshGeom();
     boneSkeleton->update_bones_data();
-    MarchingCubes::compute_surface(meshGeometry, boneSkeleton.get());
+    if(mode == 1)
+    {
+        // Refine the octree until its cells are no bigger than the marching cubes cells.
+        int depth = 1;
+        while((1 << depth) < resolution)
+            depth++;
+        DualContouring::compute_surface(meshGeometry, boneSkeleton.get(), 0.5f, depth, simplification);
+    }
+    else
+        MarchingCubes::compute_surface(meshGeometry, boneSkeleton.get(), 0.5f, resolution);
 
     // Set the transform of the bone back.
     set_world_space(worldSpace);
@@ -364,10 +448,14 @@ void ImplicitSurface::load_world_implicit(const MPlug &plug, MDataBlock &dataBlo
     case 1: jointType = EJoint::Joint_t::BULGE; break;
     case 2: jointType = EJoint::Joint_t::GC_ARC_CIRCLE_TWEAK; break;
     }
-    boneSkeleton->set_joint_blending(bone->get_bone_id(), jointType);
-
     float bulgeStrength = DagHelpers::readHandle<float>(dataBlock, ImplicitSurface::bulgeStrength, &status); merr("readHandle(bulgeStrength)");
-    boneSkeleton->set_joint_bulge_mag(bone->get_bone_id(), bulgeStrength);
+
+    {
+        // Update the skeleton environment once for both settings.
+        Skeleton::Update_scope update_scope(*boneSkeleton);
+        boneSkeleton->set_joint_blending(bone->get_bone_id(), jointType);
+        boneSkeleton->set_joint_bulge_mag(bone->get_bone_id(), bulgeStrength);
+    }
 
     MMatrix worldMatrix = getWorldMatrix(dataBlock, 0);
     Transfo worldMatrixTransfo = DagHelpers::MMatrixToTransfo(worldMatrix);
@@ -27,6 +27,15 @@ public:
     static MTypeId id;
 
     static MObject hrbfRadiusAttr;
+
+    // The number of cells along each axis of the precomputed grid (default GRID_RES), and
+    // whether it's stored in half precision.
+    static MObject gridResolution;
+    static MObject gridHalfPrecision;
+
+    // If set, the precomputed grid is read from this file when it was saved for the same
+    // samples and grid settings, and saved to it otherwise.
+    static MObject gridCacheFile;
     static MObject samplePointAttr;
     static MObject sampleNormalAttr;
 
@@ -59,6 +68,20 @@ public:
 
     // The bulge strength, used only when blendMode is set to BULGE.
     static MObject bulgeStrength;
+
+    // The number of marching cubes grid points along each axis for the preview display
+    // (default 16).
+    static MObject previewResolution;
+
+    // How the preview is computed: marching cubes (0), or dual contouring (1), which keeps
+    // sharp features.  With dual contouring, previewResolution gives the size of the
+    // smallest octree cells.
+    static MObject previewMode;
+
+    // How much the dual contouring preview is simplified: cells are merged while the error
+    // of their vertex stays below this (default 0.05, in squared smallest cells).  0 disables
+    // the simplification.
+    static MObject previewSimplification;
     
 private:
     // compute() implementations:
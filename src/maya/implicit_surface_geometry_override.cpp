@@ -8,6 +8,8 @@
 #include <maya/MShaderManager.h>
 #include <maya/MDrawRegistry.h>
 
+#include <algorithm>
+
 MString ImplicitSurfaceGeometryOverride::drawRegistrantId("implicitSurfaceGeometryOverride");
 MString ImplicitSurfaceGeometryOverride::drawDbClassification("drawdb/geometry/implicitSurface");
 
@@ -55,7 +57,7 @@ void ImplicitSurfaceGeometryOverride::updateRenderItems(const MDagPath &path, MH
     if(!shaderManager)
         return;
 
-    bool enable = !meshGeometry->vertices.empty();
+    bool enable = !meshGeometry->indices.empty();
 
     MHWRender::MRenderItem *wireframeItem = NULL;
     int index = list.indexOf("wireframe");
@@ -87,7 +89,7 @@ void ImplicitSurfaceGeometryOverride::populateGeometry(const MHWRender::MGeometr
 {
     // Calling indexBuffer->acquire(0) causes an error.  We work around this by disabling the
     // render items if we have no data.
-    if(meshGeometry->vertices.empty())
+    if(meshGeometry->indices.empty())
         return;
 
     // Copy the results of MarchingCubes into the output vertex and index buffers.
@@ -125,9 +127,9 @@ void ImplicitSurfaceGeometryOverride::populateGeometry(const MHWRender::MGeometr
         const MHWRender::MRenderItem *item = renderItems.itemAt(index);
         MHWRender::MIndexBuffer *indexBuffer = data.createIndexBuffer(MHWRender::MGeometry::kUnsignedInt32);
 
-        unsigned int *buf = (unsigned int*)indexBuffer->acquire((int) meshGeometry->vertices.size(), true);
-        for(int i = 0; i < (int) meshGeometry->vertices.size(); i++)
-            buf[i] = i;
+        int numIndices = (int) meshGeometry->indices.size();
+        unsigned int *buf = (unsigned int*)indexBuffer->acquire(numIndices, true);
+        std::copy(meshGeometry->indices.begin(), meshGeometry->indices.end(), buf);
         indexBuffer->commit(buf);
         item->associateWithIndexBuffer(indexBuffer);
     }
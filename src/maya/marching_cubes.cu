@@ -2,85 +2,187 @@
 #include "timer.hpp"
 #include "cuda_current_device.hpp"
 #include "skeleton_env_evaluator.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
 
 namespace MarchingCubes
 {
     extern const int edgeTable[256];
     extern const int triTable[256][16];
 
-    struct GridCell {
-        Point_cu p[8];
-        Vec3_cu normal[8];
-        Point_cu c[8];
-        float val[8];
+    // Corners of a cell, in the order used by edgeTable and triTable.
+    const int cornerOffsets[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+        {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1},
+    };
+
+    // The two corners of each edge of a cell.
+    const int edgeCorners[12][2] = {
+        {0, 1}, {1, 2}, {2, 3}, {3, 0},
+        {4, 5}, {5, 6}, {6, 7}, {7, 4},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    };
+
+    // The scalar field sampled on a grid of res^3 points.  Points are stored with
+    // idx = x*res*res + y*res + z.
+    struct Grid {
+        int res;
+        const float *val;
+        const Vec3_cu *grad;
+        Point_cu origin;
+        Point_cu delta;
+        Transfo transfo;
+
+        int index(int x, int y, int z) const { return x*res*res + y*res + z; }
+
+        // (x,y,z) is the grid position, eg. [0,15].  Multiply by delta to scale to the
+        // axis-aligned bounding box, add pmin to offset to the bounding box, and multiply
+        // by _tr to convert to world space.
+        Point_cu position(int x, int y, int z) const {
+            Point_cu p = Point_cu((float) x, (float) y, (float) z)*delta;
+            return transfo * (p + origin);
+        }
+
+        // Gradients point in towards the surface.  Multiply by -1 to get a normal pointing
+        // away from the surface.
+        Vec3_cu normal(int idx) const { return grad[idx] * -1; }
     };
 
-    MeshGeomVertex VertexLerp(const float isoLevel, const GridCell& cell, const int i1, const int i2) {
+    // Each grid edge is owned by its lowest point, and identified by that point's index and
+    // the axis of the edge.
+    int edgeId(const Grid &grid, int x, int y, int z, int axis) { return grid.index(x, y, z)*3 + axis; }
+
+    // Return the global edge ID of edge e of the cell at (x,y,z).
+    int cellEdgeId(const Grid &grid, int x, int y, int z, int e)
+    {
+        const int *c1 = cornerOffsets[edgeCorners[e][0]];
+        const int *c2 = cornerOffsets[edgeCorners[e][1]];
+        int axis = c1[0] != c2[0]? 0: c1[1] != c2[1]? 1: 2;
+        return edgeId(grid,
+            x + std::min(c1[0], c2[0]),
+            y + std::min(c1[1], c2[1]),
+            z + std::min(c1[2], c2[2]), axis);
+    }
+
+    MeshGeomVertex VertexLerp(const float isoLevel, const Grid &grid, int x1, int y1, int z1, int x2, int y2, int z2) {
         // Linearly interpolate the position where an isosurface cuts
-        // an edge between two vertices, each with their own scalar value
+        // an edge between two grid points, each with their own scalar value
+        const int i1 = grid.index(x1, y1, z1);
+        const int i2 = grid.index(x2, y2, z2);
+        const float val1 = grid.val[i1], val2 = grid.val[i2];
+
         MeshGeomVertex res;
-        if(fabsf(isoLevel - cell.val[i1]) < 0.00001f) {
-            res.pos = cell.p[i1];
-            res.col = cell.c[i1];
-            res.normal = cell.normal[i1];
+        res.col = Point_cu(0, 0, 0);
+        if(fabsf(isoLevel - val1) < 0.00001f || fabsf(val1 - val2) < 0.00001f) {
+            res.pos = grid.position(x1, y1, z1);
+            res.normal = grid.normal(i1);
             return res;
         }
-        if(fabsf(isoLevel - cell.val[i2]) < 0.00001f) {
-            res.pos = cell.p[i2];
-            res.col = cell.c[i2];
-            res.normal = cell.normal[i2];
-            return res;
-        }
-    
-        if(fabsf(cell.val[i1] - cell.val[i2]) < 0.00001f) {
-            res.pos = cell.p[i1];
-            res.col = cell.c[i1];
-            res.normal = cell.normal[i1];
+        if(fabsf(isoLevel - val2) < 0.00001f) {
+            res.pos = grid.position(x2, y2, z2);
+            res.normal = grid.normal(i2);
             return res;
         }
 
-        float mu = (isoLevel - cell.val[i1]) / (cell.val[i2] - cell.val[i1]);
+        float mu = (isoLevel - val1) / (val2 - val1);
 
-        res.pos = cell.p[i1] + (cell.p[i2] - cell.p[i1])*mu;
-        res.col = cell.c[i1] + (cell.c[i2] - cell.c[i1])*mu;
-        res.normal = cell.normal[i1] + (cell.normal[i2] - cell.normal[i1])*mu;
+        Point_cu p1 = grid.position(x1, y1, z1);
+        Point_cu p2 = grid.position(x2, y2, z2);
+        res.pos = p1 + (p2 - p1)*mu;
+        res.normal = grid.normal(i1) + (grid.normal(i2) - grid.normal(i1))*mu;
 
         return res;
     }
 
-    void polygonize(const GridCell &grid, MeshGeom &geom, float isoLevel)
+    // Polygonize a grid, appending its vertices and triangles to geom.
+    //
+    // A vertex is created once for each grid edge crossing the surface, and shared by every
+    // triangle using that edge.  Both passes are split into slabs along x and run on the
+    // thread pool.  Each slab writes its results to its own range, so the output is the same
+    // as a serial run.
+    void polygonize(const Grid &grid, MeshGeom &geom, float isoLevel)
     {
-        // Determine the index into the edge table which
-        // tells us which vertices are inside of the surface
-        int cubeIndex = 0;
-        for(int i = 0; i < 8; ++i)
-            if(grid.val[i] < isoLevel) cubeIndex |= 1<<i;
-
-        // Cube is entirely in/out of the surface
-        if(edgeTable[cubeIndex] == 0)
-            return;
+        const int res = grid.res;
+        const int firstVertex = (int) geom.vertices.size();
+
+        // Pass 1: create the vertices of the edges crossing the surface.  First count them
+        // per slab to find where each slab writes its vertices.
+        std::vector<int> edgeVertex(res*res*res*3, -1);
+        std::vector<int> slabVertices(res+1, 0);
+        Thread_pool::get().parallel_for(res, 1, [&](int begin, int end) {
+            for(int x = begin; x < end; ++x) {
+                for(int y = 0; y < res; ++y) {
+                    for(int z = 0; z < res; ++z) {
+                        const bool inside = grid.val[grid.index(x, y, z)] < isoLevel;
+                        const int next[3][3] = { {x+1, y, z}, {x, y+1, z}, {x, y, z+1} };
+                        for(int axis = 0; axis < 3; ++axis)
+                        {
+                            const int *n = next[axis];
+                            if(n[0] >= res || n[1] >= res || n[2] >= res)
+                                continue;
+
+                            if(inside != (grid.val[grid.index(n[0], n[1], n[2])] < isoLevel))
+                                edgeVertex[edgeId(grid, x, y, z, axis)] = slabVertices[x+1]++;
+                        }
+                    }
+                }
+            }
+        });
+
+        for(int x = 0; x < res; ++x)
+            slabVertices[x+1] += slabVertices[x];
+
+        geom.vertices.resize(firstVertex + slabVertices[res]);
+        Thread_pool::get().parallel_for(res, 1, [&](int begin, int end) {
+            for(int x = begin; x < end; ++x) {
+                for(int y = 0; y < res; ++y) {
+                    for(int z = 0; z < res; ++z) {
+                        const int next[3][3] = { {x+1, y, z}, {x, y+1, z}, {x, y, z+1} };
+                        for(int axis = 0; axis < 3; ++axis)
+                        {
+                            int &vertex = edgeVertex[edgeId(grid, x, y, z, axis)];
+                            if(vertex == -1)
+                                continue;
+
+                            const int *n = next[axis];
+                            vertex += firstVertex + slabVertices[x];
+                            geom.vertices[vertex] = VertexLerp(isoLevel, grid, x, y, z, n[0], n[1], n[2]);
+                        }
+                    }
+                }
+            }
+        });
+
+        // Pass 2: create the triangles of each cell.
+        std::vector<std::vector<unsigned int> > slabIndices(res-1);
+        Thread_pool::get().parallel_for(res-1, 1, [&](int begin, int end) {
+            for(int x = begin; x < end; ++x) {
+                std::vector<unsigned int> &indices = slabIndices[x];
+                for(int y = 0; y < res-1; ++y) {
+                    for(int z = 0; z < res-1; ++z) {
+                        // Determine the index into the edge table which
+                        // tells us which vertices are inside of the surface
+                        int cubeIndex = 0;
+                        for(int i = 0; i < 8; ++i)
+                        {
+                            const int *c = cornerOffsets[i];
+                            if(grid.val[grid.index(x+c[0], y+c[1], z+c[2])] < isoLevel) cubeIndex |= 1<<i;
+                        }
+
+                        // Cube is entirely in/out of the surface
+                        if(edgeTable[cubeIndex] == 0)
+                            continue;
+
+                        for(int i = 0; triTable[cubeIndex][i] != -1; ++i)
+                            indices.push_back(edgeVertex[cellEdgeId(grid, x, y, z, triTable[cubeIndex][i])]);
+                    }
+                }
+            }
+        });
 
-        // Find the vertices where the surface intersects the cube
-        MeshGeomVertex vertList[12];
-        if(edgeTable[cubeIndex] & (1<<0))   vertList[0] = VertexLerp(isoLevel, grid, 0, 1);
-        if(edgeTable[cubeIndex] & (1<<1))   vertList[1] = VertexLerp(isoLevel, grid, 1, 2);
-        if(edgeTable[cubeIndex] & (1<<2))   vertList[2] = VertexLerp(isoLevel, grid, 2, 3);
-        if(edgeTable[cubeIndex] & (1<<3))   vertList[3] = VertexLerp(isoLevel, grid, 3, 0);
-        if(edgeTable[cubeIndex] & (1<<4))   vertList[4] = VertexLerp(isoLevel, grid, 4, 5);
-        if(edgeTable[cubeIndex] & (1<<5))   vertList[5] = VertexLerp(isoLevel, grid, 5, 6);
-        if(edgeTable[cubeIndex] & (1<<6))   vertList[6] = VertexLerp(isoLevel, grid, 6, 7);
-        if(edgeTable[cubeIndex] & (1<<7))   vertList[7] = VertexLerp(isoLevel, grid, 7, 4);
-        if(edgeTable[cubeIndex] & (1<<8))   vertList[8] = VertexLerp(isoLevel, grid, 0, 4);
-        if(edgeTable[cubeIndex] & (1<<9))   vertList[9] = VertexLerp(isoLevel, grid, 1, 5);
-        if(edgeTable[cubeIndex] & (1<<10)) vertList[10] = VertexLerp(isoLevel, grid, 2, 6);
-        if(edgeTable[cubeIndex] & (1<<11)) vertList[11] = VertexLerp(isoLevel, grid, 3, 7);
-
-        // Create the triangles.
-        for(int i = 0; triTable[cubeIndex][i] != -1; i += 3) {
-            geom.vertices.push_back(vertList[triTable[cubeIndex][i+0]]);
-            geom.vertices.push_back(vertList[triTable[cubeIndex][i+1]]);
-            geom.vertices.push_back(vertList[triTable[cubeIndex][i+2]]);
-        }
+        for(int x = 0; x < res-1; ++x)
+            geom.indices.insert(geom.indices.end(), slabIndices[x].begin(), slabIndices[x].end());
     }
 
 }
@@ -140,23 +242,12 @@ namespace
 // space.  It's up to the caller to set the world space matrix of the bones for the coordinate
 // space it wants the output to be in.  Surface nodes set the bone's world space matrix to
 // identity, to draw in object space.  Blend nodes leave them alone, to draw in world space.
-void MarchingCubes::compute_surface(MeshGeom &geom, const Skeleton *skel, float isoLevel)
+void MarchingCubes::compute_surface(MeshGeom &geom, const Skeleton *skel, float isoLevel, int gridRes)
 {
     // Get the set of all of the bounding boxes in the skeleton.  These may overlap.
 
-    // set the size of the grid cells, and the amount of cells per side
-    const int gridRes = 16;
-
-    const Vec3i_cu deltas[8] = {
-       Vec3i_cu(0, 0, 0),
-       Vec3i_cu(1, 0, 0),
-       Vec3i_cu(1, 1, 0),
-       Vec3i_cu(0, 1, 0),
-       Vec3i_cu(0, 0, 1),
-       Vec3i_cu(1, 0, 1),
-       Vec3i_cu(1, 1, 1),
-       Vec3i_cu(0, 1, 1),
-    };
+    // set the amount of grid points per side
+    gridRes = std::max(gridRes, 2);
 
     // We have a single surface comprised of any number of bones.  Render the bounding box
     // of each underlying bone.  Note that we only render the skeleton, not the bones.
@@ -188,52 +279,28 @@ void MarchingCubes::compute_surface(MeshGeom &geom, const Skeleton *skel, float
         Point_cu delta = (worldObbox._bb.pmax - worldObbox._bb.pmin).to_point() / gridRes;
 
         // Calculate the iso and normal at each grid position.
-        CudaManagedArray<float> isoBuffer(gridRes*gridRes*gridRes);
-        CudaManagedArray<Vec3_cu> normalBuffer(gridRes*gridRes*gridRes);
+        const int nbPoints = gridRes*gridRes*gridRes;
+        CudaManagedArray<float> isoBuffer(nbPoints);
+        CudaManagedArray<Vec3_cu> normalBuffer(nbPoints);
 
         const int block_size = 512;
-        const int grid_size = (gridRes*gridRes*gridRes) / block_size;
+        const int grid_size = (nbPoints + block_size - 1) / block_size;
         CUDA_CHECK_KERNEL_SIZE(block_size, grid_size);
         compute_marching_cubes_grid<<<grid_size, block_size>>>(skel->get_skel_id(), gridRes, &isoBuffer[0], &normalBuffer[0], worldObbox._bb.pmin, delta, worldObbox._tr);
         // Synchronize, so the results are available in isoBuffer and normalBuffer.
         cudaThreadSynchronize();
         CUDA_CHECK_ERRORS();
 
-        for(int x = 0; x < gridRes-1; ++x) {
-            for(int y = 0; y < gridRes-1; ++y) {
-                for(int z = 0; z < gridRes-1; ++z) {
-                    GridCell cell;
-                    for(int i = 0; i < 8; i++)
-                    {
-                        Vec3i_cu p(x, y, z);
-                        p = p + deltas[i];
-
-                        // (pX,pY,pZ) is the grid position, eg. [0,15].  Multiply by delta to scale to
-                        // the axis-aligned bounding box, add pmin to offset to the bounding box, and
-                        // multiply by _tr to convert to world space.
-                        Point_cu pWorld = Point_cu((float) p.x, (float) p.y, (float) p.z)*delta;
-                        pWorld = pWorld  + worldObbox._bb.pmin;
-                        pWorld = worldObbox._tr * pWorld;
-
-                        cell.p[i] = pWorld;
-
-                        int idx =
-                            p.x*gridRes*gridRes +
-                            p.y*gridRes +
-                            p.z;
-
-                        cell.val[i] = isoBuffer[idx];
-
-                        // Gradients point in towards the surface.  Multiply by -1 to get a normal pointing
-                        // away from the surface.
-                        cell.normal[i] = normalBuffer[idx] * -1;
-                    }
+        Grid grid;
+        grid.res = gridRes;
+        grid.val = &isoBuffer[0];
+        grid.grad = &normalBuffer[0];
+        grid.origin = worldObbox._bb.pmin;
+        grid.delta = delta;
+        grid.transfo = worldObbox._tr;
 
-                    // Generate tris.
-                    polygonize(cell, geom, isoLevel);
-                }
-            }
-        }
+        // Generate tris.
+        polygonize(grid, geom, isoLevel);
     }
 }
 
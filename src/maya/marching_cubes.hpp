@@ -19,12 +19,17 @@ public:
 //    MFloatPointArray positions;
 //    MColorArray colors;
     std::vector<MeshGeomVertex> vertices;
+
+    // Triangle list.  Each three entries index a triangle's vertices.
+    std::vector<unsigned int> indices;
 };
 
 namespace MarchingCubes
 {
     // Compute the geometry to preview the given skeleton, and append it to meshGeom.
-    void compute_surface(MeshGeom &geom, const Skeleton *skel, float isoLevel = 0.5f);
+    // Vertices are shared between adjacent triangles.  Each bone is sampled with a grid
+    // of gridRes^3 points.
+    void compute_surface(MeshGeom &geom, const Skeleton *skel, float isoLevel = 0.5f, int gridRes = 16);
 }
 
 #endif
@@ -453,8 +453,7 @@ void ImplicitCommand::init(MString skinClusterName)
     // Run the sampling for each joint.  The joints are in world space, so the samples will also be in
     // world space.
     SampleSet::SampleSet samples;
-    for(Bone::Id bone_id: skeleton->get_bone_ids())
-        samples.choose_hrbf_samples(mesh.get(), skeleton.get(), vertToBoneInfo, sampleSettings, bone_id);
+    samples.choose_hrbf_samples(mesh.get(), skeleton.get(), vertToBoneInfo, sampleSettings);
 
     // Remove surfaces that didn't find any samples.
     removeEmptySurfaces(loaderSkeleton, samples);
@@ -6,7 +6,7 @@
 #include <sstream>
 #include <cstdlib>
 #include <limits>
-#include <deque>
+#include <algorithm>
 #include <map>
 
 #include "macros.hpp"
@@ -14,6 +14,7 @@
 #include "loader_mesh.hpp"
 #include "timer.hpp"
 #include "std_utils.hpp"
+#include "thread_pool.hpp"
 
 Mesh::Mesh(const Mesh& m) :
     _is_initialized(m._is_initialized),
@@ -326,153 +327,160 @@ std::pair<int, int> Mesh::pair_from_tri(int index_tri, int current_vert)
 
 // -----------------------------------------------------------------------------
 
-bool add_to_ring(std::deque<int>& ring, std::pair<int, int> p)
-{
-    if(ring[ring.size()-1] == p.first)
-    {
-        ring.push_back(p.second);
-        return true;
-    }
-    else if(ring[ring.size()-1] == p.second)
-    {
+namespace {
 
-        ring.push_back(p.first);
-        return true;
-    }
-    else if(ring[0] == p.second)
-    {
-        ring.push_front(p.first);
-        return true;
-    }
-    else if(ring[0] == p.first)
-    {
-        ring.push_front(p.second);
-        return true;
-    }
-    return false;
+/// Try to add the pair 'p' to one end of the ring stored in
+/// ring[first] to ring[last] (included). The ring buffer must have room on
+/// both ends.
+/// @return true if 'p' has been added
+bool add_to_ring(int* ring, int& first, int& last, std::pair<int, int> p)
+{
+    if(ring[last] == p.first)
+        ring[++last] = p.second;
+    else if(ring[last] == p.second)
+        ring[++last] = p.first;
+    else if(ring[first] == p.second)
+        ring[--first] = p.first;
+    else if(ring[first] == p.first)
+        ring[--first] = p.second;
+    else
+        return false;
+    return true;
 }
 
 // -----------------------------------------------------------------------------
 
-/// Add an element to the ring only if it does not alredy exists
-/// @return true if already exists
-bool add_to_ring(std::deque<int>& ring, int neigh)
+/// Add an element at the end of the ring only if it does not alredy exists
+void add_to_ring(int* ring, int first, int& last, int neigh)
 {
-    std::deque<int>::iterator it;
-    for(it = ring.begin(); it != ring.end(); ++it)
-        if(*it == neigh) return true;
+    for(int i = first; i <= last; i++)
+        if(ring[i] == neigh) return;
 
-    ring.push_back( neigh );
-    return false;
+    ring[++last] = neigh;
 }
 
+}// END NAMESPACE ==============================================================
+
 // -----------------------------------------------------------------------------
 
 void Mesh::compute_edges()
 {
-    // Create a list of the tris each vertex is in.
-    std::vector<std::vector<int> > tri_list_per_vert(_nb_vert);
-    for(int i = 0; i < _nb_tri; i++){
-        for(int j = 0; j < 3; j++){
-            int v = _tri[3*i +j ];
-            assert(v>=0);
-            tri_list_per_vert[v].push_back(i);
-        }
-    }
-
     Timer t;
     t.start();
 
-    _is_side.resize(_nb_vert, false);
-    std::vector<std::vector<int> > neighborhood_list(_nb_vert);
-    std::vector<std::pair<int, int> > list_pairs;
-    list_pairs.reserve(16);
+    // List of the tris each vertex is in: tris of the ith vertex are
+    // tri_list[tri_offsets[i]] to tri_list[tri_offsets[i+1]-1] in increasing
+    // order.
+    std::vector<int> tri_offsets(_nb_vert + 1, 0);
+    for(int i = 0; i < _nb_tri*3; i++){
+        assert(_tri[i] >= 0);
+        tri_offsets[_tri[i] + 1]++;
+    }
     for(int i = 0; i < _nb_vert; i++)
+        tri_offsets[i+1] += tri_offsets[i];
+
+    std::vector<int> tri_list(_nb_tri*3);
+    std::vector<int> fill(tri_offsets.begin(), tri_offsets.end() - 1);
+    for(int i = 0; i < _nb_tri*3; i++)
+        tri_list[ fill[_tri[i]]++ ] = i / 3;
+
+    // A ring has at most two neighbours per tri of its vertex, so rings are
+    // first built at 2*tri_offsets[i] in 'rings' and then packed in
+    // '_edge_list'
+    std::vector<int>  rings(_nb_tri*6);
+    std::vector<int>  ring_sizes(_nb_vert, 0);
+    std::vector<char> side    (_nb_vert, 0);
+    std::vector<char> manifold(_nb_vert, 1);
+    Thread_pool::get().parallel_for(_nb_vert, 256, [&](int begin, int end)
     {
-        // We suppose the faces are tris to reserve memory
-        if( _max_faces_per_vertex > 0)
-            neighborhood_list.reserve(_max_faces_per_vertex*3);
-
-        if( is_disconnect(i) ) continue; // TODO should be is_side = true no ?
-
-        list_pairs.clear();
-        // fill pairs with the first ring of neighborhood of quads and triangles
-        for(unsigned int j=0; j<tri_list_per_vert[i].size(); j++)
-            list_pairs.push_back(pair_from_tri(tri_list_per_vert[i][j], i));
-
-        // Try to build the ordered list of the first ring of neighborhood of i
-        std::deque<int> ring;
-        ring.push_back(list_pairs[0].first );
-        ring.push_back(list_pairs[0].second);
-        std::vector<std::pair<int, int> >::iterator it = list_pairs.begin();
-        list_pairs.erase(it);
-        size_t pairs_left = list_pairs.size();
-        bool manifold   = true;
-        while( (pairs_left = list_pairs.size()) != 0)
+        std::vector<std::pair<int, int> > list_pairs;
+        std::vector<int> ring;
+        for(int i = begin; i < end; i++)
         {
-            for(it = list_pairs.begin(); it < list_pairs.end(); ++it)
+            const int nb_pairs = tri_offsets[i+1] - tri_offsets[i];
+            if( is_disconnect(i) || nb_pairs == 0 ) continue; // TODO should be is_side = true no ?
+
+            list_pairs.clear();
+            // fill pairs with the first ring of neighborhood of triangles
+            for(int j = tri_offsets[i]; j < tri_offsets[i+1]; j++)
+                list_pairs.push_back(pair_from_tri(tri_list[j], i));
+
+            // Try to build the ordered list of the first ring of neighborhood of i.
+            // The ring grows on both ends from the middle of its buffer.
+            ring.resize(4*nb_pairs + 2);
+            int first = 2*nb_pairs;
+            int last  = first + 1;
+            ring[first] = list_pairs[0].first;
+            ring[last ] = list_pairs[0].second;
+            list_pairs.erase(list_pairs.begin());
+            size_t pairs_left;
+            while( (pairs_left = list_pairs.size()) != 0)
             {
-                if(add_to_ring(ring, *it))
+                std::vector<std::pair<int, int> >::iterator it;
+                for(it = list_pairs.begin(); it < list_pairs.end(); ++it)
                 {
-                    list_pairs.erase(it);
-                    break;
+                    if(add_to_ring(&ring[0], first, last, *it))
+                    {
+                        list_pairs.erase(it);
+                        break;
+                    }
                 }
-            }
 
-            if(pairs_left == list_pairs.size())
-            {
-                // Not manifold we push neighborhoods of vert 'i'
-                // in a random order
-                add_to_ring(ring, list_pairs[0].first );
-                add_to_ring(ring, list_pairs[0].second);
-                list_pairs.erase(list_pairs.begin());
-                manifold = false;
+                if(pairs_left == list_pairs.size())
+                {
+                    // Not manifold we push neighborhoods of vert 'i'
+                    // in a random order
+                    add_to_ring(&ring[0], first, last, list_pairs[0].first );
+                    add_to_ring(&ring[0], first, last, list_pairs[0].second);
+                    list_pairs.erase(list_pairs.begin());
+                    manifold[i] = 0;
+                }
             }
+
+            if(ring[first] != ring[last])
+                side[i] = 1;
+            else
+                last--;
+
+            ring_sizes[i] = last - first + 1;
+            std::copy(ring.begin() + first, ring.begin() + last + 1, rings.begin() + 2*tri_offsets[i]);
         }
+    });
 
-        if(!manifold)
+    _is_side.assign(_nb_vert, false);
+    for(int i = 0; i < _nb_vert; i++)
+    {
+        if(!manifold[i])
         {
             std::cerr << "WARNING : The mesh is clearly not 2-manifold !\n";
             std::cerr << "Check vertex index : " << i << std::endl;
         }
-
-        if(ring[0] != ring[ring.size()-1]){
-            _is_side[i] = true;
-        }else
-            ring.pop_back();
-
-        neighborhood_list[i].insert(neighborhood_list[i].begin(), ring.begin(), ring.end());
-    }// END FOR( EACH VERTEX )
-
-    load_edges(neighborhood_list);
-
-    std::cout << "Mesh edges computed in: " << t.stop() << " sec" << std::endl;
-}
-
-void Mesh::load_edges(const std::vector<std::vector<int> > &neighborhood_list)
-{
-    assert(neighborhood_list.size() == _nb_vert);
-
-    _nb_edges = 0;
-
-    for(int i = 0; i < _nb_vert; i++)
-        _nb_edges += (int) neighborhood_list[i].size();
+        _is_side[i] = side[i] != 0;
+    }
 
     // Copy results on a more GPU friendly layout for future use
     delete[] _edge_list;
     delete[] _edge_list_offsets;
-    _edge_list = new int[_nb_edges];
     _edge_list_offsets = new int[2*_nb_vert];
 
-    int edge_list_idx = 0;
+    _nb_edges = 0;
     for(int i = 0; i < _nb_vert; i++)
     {
-        int size = (int) neighborhood_list[i].size();
-        _edge_list_offsets[i*2+0] = edge_list_idx;
-        _edge_list_offsets[i*2+1] = size;
-        for(int j = 0; j <  size; j++)
-            _edge_list[edge_list_idx++] = neighborhood_list[i][j];
+        _edge_list_offsets[i*2+0] = _nb_edges;
+        _edge_list_offsets[i*2+1] = ring_sizes[i];
+        _nb_edges += ring_sizes[i];
     }
+
+    _edge_list = new int[_nb_edges];
+    Thread_pool::get().parallel_for(_nb_vert, 1024, [&](int begin, int end)
+    {
+        for(int i = begin; i < end; i++)
+            std::copy(rings.begin() + 2*tri_offsets[i],
+                      rings.begin() + 2*tri_offsets[i] + ring_sizes[i],
+                      _edge_list + _edge_list_offsets[i*2]);
+    });
+
+    std::cout << "Mesh edges computed in: " << t.stop() << " sec" << std::endl;
 }
 
 // -----------------------------------------------------------------------------
@@ -536,3 +544,51 @@ Vec3_cu Mesh::get_mean_normal(int i) const {
     }
     return mean;
 }
+
+// -----------------------------------------------------------------------------
+
+void Mesh::compute_lod_mask(int nb_rings, std::vector<bool>& mask) const
+{
+    mask.assign(_nb_vert, false);
+    if(nb_rings <= 0)
+    {
+        for(int i = 0; i < _nb_vert; i++)
+            mask[i] = !is_disconnect(i);
+        return;
+    }
+
+    // Breadth first search around each picked vertex, 'seed' tells which
+    // search last visited a vertex so that the buffers are never cleared
+    std::vector<bool> covered(_nb_vert, false);
+    std::vector<int>  seed(_nb_vert, -1);
+    std::vector<int>  front, next;
+    for(int i = 0; i < _nb_vert; i++)
+    {
+        if(covered[i] || is_disconnect(i))
+            continue;
+
+        mask[i]    = true;
+        covered[i] = true;
+        seed[i]    = i;
+        front.assign(1, i);
+        for(int r = 0; r < nb_rings && !front.empty(); r++)
+        {
+            next.clear();
+            for(int p : front)
+            {
+                const int dep = get_first_neighbor(p);
+                const int end = dep + get_num_neighbors(p);
+                for(int n = dep; n < end; n++)
+                {
+                    const int j = _edge_list[n];
+                    if(seed[j] == i)
+                        continue;
+                    seed[j]    = i;
+                    covered[j] = true;
+                    next.push_back(j);
+                }
+            }
+            front.swap(next);
+        }
+    }
+}
@@ -182,6 +182,15 @@ public:
     /// Is the ith vertex on the mesh boundary
     bool is_vert_on_side(int i) const { return _is_side[i]; }
 
+    /// Pick a subset of the vertices for a coarse level of detail: picked
+    /// vertices are more than 'nb_rings' edges apart and every connected
+    /// vertex is at most 'nb_rings' edges away from a picked one (greedy
+    /// selection in index order). On a regular grid about 1/(nb_rings+1)² of
+    /// the vertices are picked.
+    /// @param mask : true for the picked vertices, every connected vertex is
+    /// picked when nb_rings <= 0.
+    void compute_lod_mask(int nb_rings, std::vector<bool>& mask) const;
+
 private:
 
     //  ------------------------------------------------------------------------
@@ -199,12 +208,10 @@ private:
     void compute_normals();
 
     /// Compute the list of the mesh edges
-    /// updates 'edge_list' and 'edge_list_offsets'
+    /// updates 'edge_list' and 'edge_list_offsets'. Vertices are processed in
+    /// parallel.
     void compute_edges();
 
-    // Load _edge_list and _edge_list_offsets, given an array of neighbors for each vertex.
-    void load_edges(const std::vector<std::vector<int> > &neighborhood_list);
-
     // Mesh edges computation tool functions.
     //{
     /// given a triangle 'index_tri' and one of its vertex index 'current_vert'
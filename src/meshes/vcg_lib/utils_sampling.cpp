@@ -3,12 +3,14 @@
 #include "utils_sampling.hpp"
 #include "bbox.hpp"
 #include "idx3_cu.hpp"
+#include "thread_pool.hpp"
 #include <assert.h>
 #include <functional>
 #include <vector>
 #include <unordered_map>
 #include <map>
 #include <algorithm>
+#include <random>
 using namespace std;
 
 #ifndef M_PI
@@ -26,13 +28,12 @@ using namespace std;
  *
  * http://research.microsoft.com/pubs/135760/c95-f95_199-a16-paperfinal-v5.pdf
  *
- * That paper targets parallel evaluation.  That's not actually implemented.  Since we don't need a lot
- * of samples, and this is only done at initialization time, it's probably not worthwhile.  However, the
- * algorithm in this paper is simple to implement and doesn't need to be paralellized.
- *
  * This works by doing a naive, dense random point sampling of the mesh to get a set of points, hashing
  * the points on a grid with a resolution of the point size that we want, then dart throwing on the points
  * to select samples.
+ *
+ * As in the paper, the dart throwing goes through the cells in phase groups, running the cells of a group
+ * in parallel.  Random numbers come from a seeded generator, so the samples only depend on the seed.
  */
 namespace 
 {
@@ -45,10 +46,27 @@ float area_of_triangle(const Vec3_cu &a, const Vec3_cu &b, const Vec3_cu &c)
     return sqrtf(p * (p - ab) * (p - bc) * (p - ca));
 }
 
-float random_float(float maximum)
+// Random numbers of a sampling run.  We don't use rand(): the sequence must only depend on
+// the seed, so runs are reproducible even when other threads draw numbers.
+class random_generator
 {
-    return float((double)rand()/(double)(RAND_MAX/maximum));
-}
+public:
+    random_generator(unsigned seed, unsigned stream)
+    {
+        std::seed_seq seq = { seed, stream };
+        engine.seed(seq);
+    }
+
+    // Return a number in [0, maximum).
+    float random_float(float maximum)
+    {
+        // Keep 24 bits, so the conversion to float is exact and we never return 1.
+        return float(engine() >> 8) * (1.f / 16777216.f) * maximum;
+    }
+
+private:
+    std::mt19937 engine;
+};
 
 struct sample_point
 {
@@ -84,86 +102,84 @@ float approximate_geodesic_distance(Point_cu p1, Point_cu p2, Vec3_cu n1, Vec3_c
 }
 
 // Do a simple random sampling of the triangles.  Return the total surface area of the triangles.
+//
+// Samples are drawn in fixed size batches, each with its own random sequence, so the batches
+// run in parallel and the result only depends on the seed.
 float create_raw_samples(int num_samples,
+    unsigned seed,
     const std::vector<Vec3_cu>& verts,
     const std::vector<Vec3_cu>& nors,
     const std::vector<int>& tris,
     vector<sample_point> &samples)
 {
-    // Calculate the area of each triangle.  We'll use this to randomly select triangles with probability proportional
-    // to their area.
-    vector<float> tri_area;
-    for(int tri = 0; tri < tris.size(); tri += 3)
-    {
-        int vert_idx_0 = tris[tri+0];
-        int vert_idx_1 = tris[tri+1];
-        int vert_idx_2 = tris[tri+2];
-        const Vec3_cu &v0 = verts[vert_idx_0];
-        const Vec3_cu &v1 = verts[vert_idx_1];
-        const Vec3_cu &v2 = verts[vert_idx_2];
-        float area = area_of_triangle(v0, v1, v2);
-        tri_area.push_back(area);
-    }
-
-    // Map the sums of the areas to a triangle index.  For example, if we have triangles with areas
-    // 2, 7, 1 and 4, create:
+    // Sum the areas of the triangles.  We'll use this to randomly select triangles with probability
+    // proportional to their area.  For example, if we have triangles with areas 2, 7, 1 and 4, create:
     //
-    // 0: 0
-    // 2: 1
-    // 9: 2
-    // 10: 3
+    // 2, 9, 10, 14
     //
-    // A random number in 0...14 can then be mapped to an index.
-    map<float, int> area_sum_to_index;
+    // A random number in 0...14 can then be mapped to an index by searching the first sum greater
+    // than it.
+    const int num_tris = (int) tris.size() / 3;
+    vector<float> area_sums(num_tris);
     float max_area_sum = 0;
-    for(int i = 0; i < tri_area.size(); ++i)
+    for(int tri = 0; tri < num_tris; ++tri)
     {
-        area_sum_to_index[max_area_sum] = i;
-        max_area_sum += tri_area[i];
+        const Vec3_cu &v0 = verts[tris[tri*3+0]];
+        const Vec3_cu &v1 = verts[tris[tri*3+1]];
+        const Vec3_cu &v2 = verts[tris[tri*3+2]];
+        max_area_sum += area_of_triangle(v0, v1, v2);
+        area_sums[tri] = max_area_sum;
     }
 
-    for(int i = 0; i < num_samples; ++i)
-    {
-        // Select a random triangle.
-        float r = random_float(max_area_sum);
-        auto it = area_sum_to_index.upper_bound(r);
-        assert(it != area_sum_to_index.begin());
-        --it;
-        int tri = it->second;
-
-        // The vertices (and corresponding normals) of the triangle that we've selected:
-        int vert_idx_0 = tris[tri*3+0];
-        int vert_idx_1 = tris[tri*3+1];
-        int vert_idx_2 = tris[tri*3+2];
-        const Vec3_cu &v0 = verts[vert_idx_0];
-        const Vec3_cu &v1 = verts[vert_idx_1];
-        const Vec3_cu &v2 = verts[vert_idx_2];
-        const Vec3_cu &n0 = nors[vert_idx_0];
-        const Vec3_cu &n1 = nors[vert_idx_1];
-        const Vec3_cu &n2 = nors[vert_idx_2];
-
-        // Select a random point on the triangle.
-        float u = random_float(1), v = random_float(1);
-
-        Vec3_cu pos = 
-            v0 * (1 - sqrt(u)) +
-            v1 * (sqrt(u) * (1 - v)) +
-            v2 * (v * sqrt(u));
-
-        // XXX: Is this normal calculation correct?
-        Vec3_cu normal = 
-            n0 * (1 - sqrt(u)) +
-            n1 * (sqrt(u) * (1 - v)) +
-            n2 * (v * sqrt(u));
-        normal.normalize();
-
-        samples.emplace_back();
-        sample_point &p = samples.back();
-        p.cell_id = -1;
-        p.pos = pos.to_point();
-        p.normal = normal;
-        p.tri_id = tri;
-    }
+    const int batch_size = 1024;
+    const int num_batches = (num_samples + batch_size - 1) / batch_size;
+    samples.resize(num_samples);
+    Thread_pool::get().parallel_for(num_batches, 1, [&](int begin, int end) {
+        for(int batch = begin; batch < end; ++batch)
+        {
+            random_generator random(seed, batch);
+            const int last = min(num_samples, (batch+1) * batch_size);
+            for(int i = batch * batch_size; i < last; ++i)
+            {
+                // Select a random triangle.
+                float r = random.random_float(max_area_sum);
+                int tri = int(upper_bound(area_sums.begin(), area_sums.end(), r) - area_sums.begin());
+                tri = min(tri, num_tris - 1);
+
+                // The vertices (and corresponding normals) of the triangle that we've selected:
+                int vert_idx_0 = tris[tri*3+0];
+                int vert_idx_1 = tris[tri*3+1];
+                int vert_idx_2 = tris[tri*3+2];
+                const Vec3_cu &v0 = verts[vert_idx_0];
+                const Vec3_cu &v1 = verts[vert_idx_1];
+                const Vec3_cu &v2 = verts[vert_idx_2];
+                const Vec3_cu &n0 = nors[vert_idx_0];
+                const Vec3_cu &n1 = nors[vert_idx_1];
+                const Vec3_cu &n2 = nors[vert_idx_2];
+
+                // Select a random point on the triangle.
+                float u = random.random_float(1), v = random.random_float(1);
+
+                Vec3_cu pos = 
+                    v0 * (1 - sqrt(u)) +
+                    v1 * (sqrt(u) * (1 - v)) +
+                    v2 * (v * sqrt(u));
+
+                // XXX: Is this normal calculation correct?
+                Vec3_cu normal = 
+                    n0 * (1 - sqrt(u)) +
+                    n1 * (sqrt(u) * (1 - v)) +
+                    n2 * (v * sqrt(u));
+                normal.normalize();
+
+                sample_point &p = samples[i];
+                p.cell_id = -1;
+                p.pos = pos.to_point();
+                p.normal = normal;
+                p.tri_id = tri;
+            }
+        }
+    });
 
     return max_area_sum;
 }
@@ -181,22 +197,31 @@ void poisson_disk_from_samples(float radius,
     const Vec3_cu bbox_size = bbox.lengths();
 
     const float radius_squared = radius*radius;
-    Vec3_cu grid_size = bbox_size / radius;
-    Vec3i_cu grid_size_int(lrintf(grid_size.x), lrintf(grid_size.y), lrintf(grid_size.z));
-    grid_size_int.x = max(grid_size_int.x, 1);
-    grid_size_int.y = max(grid_size_int.y, 1);
-    grid_size_int.z = max(grid_size_int.z, 1);
+
+    // Round the grid size down, so cells are at least radius wide and any sample closer than
+    // radius is in a neighboring cell.  Limit the grid size, so cell IDs fit in an int.
+    const int max_grid_size = 1024;
+    int grid_size_int[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        float grid_size = bbox_size[i] / radius;
+        grid_size_int[i] = grid_size < max_grid_size? max((int) grid_size, 1): max_grid_size;
+    }
 
     // Assign a cell ID to each sample.
     for(auto &p: raw_samples)
     {
-        Vec3i_cu idx = bbox.index_grid_cell(grid_size_int, p.pos);
-        Idx3_cu offset(grid_size_int, idx);
-        p.cell_id = offset.to_linear();
+        int idx[3];
+        for(int i = 0; i < 3; ++i)
+        {
+            float t = bbox_size[i] > 0? (p.pos[i] - bbox.pmin[i]) / bbox_size[i]: 0;
+            idx[i] = min(max((int) floorf(t * grid_size_int[i]), 0), grid_size_int[i] - 1);
+        }
+        p.cell_id = idx[0] + grid_size_int[0] * (idx[1] + grid_size_int[1] * idx[2]);
     }
 
-    // Sort samples by cell ID.
-    sort(raw_samples.begin(), raw_samples.end(), [](const sample_point &lhs, const sample_point &rhs) {
+    // Sort samples by cell ID.  Keep the samples of a cell in the order they were created.
+    stable_sort(raw_samples.begin(), raw_samples.end(), [](const sample_point &lhs, const sample_point &rhs) {
         return lhs.cell_id < rhs.cell_id;
     });
 
@@ -212,115 +237,114 @@ void poisson_disk_from_samples(float radius,
         // Index into raw_samples:
         int first_sample_idx;
         int sample_cnt;
+
+        // Position of the cell in the grid:
+        int idx[3];
     };
 
-    // Map from cell IDs to hash_data.  Each hash_data points to the range in raw_samples corresponding to that cell.
-    // (We could just store the samples in hash_data.  This implementation is an artifact of the reference paper, which
-    // is optimizing for GPU acceleration that we haven't implemented currently.)
-    unordered_map<int, hash_data> cells;
+    // The cells containing samples, ordered by ID, and a map from cell IDs to their index in cells.
+    // Each hash_data points to the range in raw_samples corresponding to that cell.
+    vector<hash_data> cells;
+    unordered_map<int, int> cell_id_to_index;
 
+    for(int i = 0; i < (int) raw_samples.size(); ++i)
     {
-        int last_id = -1;
-        unordered_map<int, hash_data>::iterator last_id_it;
-
-        for(int i = 0; i < raw_samples.size(); ++i)
+        const auto &sample = raw_samples[i];
+        if(!cells.empty() && sample.cell_id == raw_samples[cells.back().first_sample_idx].cell_id)
         {
-            const auto &sample = raw_samples[i];
-            if(sample.cell_id == last_id)
-            {
-                // This sample is in the same cell as the previous, so just increase the count.  Cells are
-                // always contiguous, since we've sorted raw_samples by cell ID.
-                ++last_id_it->second.sample_cnt;
-                continue;
-            }
-
-            // This is a new cell.
-            hash_data data;
-            data.first_sample_idx = i;
-            data.sample_cnt = 1;
-
-            auto result = cells.insert({sample.cell_id, data});
-            last_id = sample.cell_id;
-            last_id_it = result.first;
+            // This sample is in the same cell as the previous, so just increase the count.  Cells are
+            // always contiguous, since we've sorted raw_samples by cell ID.
+            ++cells.back().sample_cnt;
+            continue;
         }
+
+        // This is a new cell.
+        cells.emplace_back();
+        hash_data &data = cells.back();
+        data.first_sample_idx = i;
+        data.sample_cnt = 1;
+        data.idx[0] = sample.cell_id % grid_size_int[0];
+        data.idx[1] = (sample.cell_id / grid_size_int[0]) % grid_size_int[1];
+        data.idx[2] = sample.cell_id / (grid_size_int[0] * grid_size_int[1]);
+        cell_id_to_index[sample.cell_id] = (int) cells.size() - 1;
     }
 
-    // Make a list of offsets to neighboring cell indexes, and to ourself (0).
-    vector<int> neighbor_cell_offsets;
+    // Split the cells into 27 phase groups, by their position modulo 3.  A candidate only reads
+    // its own cell and its neighbors, and only writes to its own cell, so cells in the same phase
+    // never see each other and can be processed in parallel.  Going through the phases in order
+    // gives the same samples whatever the number of threads.
+    vector<int> phases[27];
+    for(int i = 0; i < (int) cells.size(); ++i)
     {
-        Idx3_cu offset(grid_size_int, 0);
-        for(int x = -1; x <= +1; ++x)
-        {
-            for(int y = -1; y <= +1; ++y)
-            {
-                for(int z = -1; z <= +1; ++z)
-                {
-                    offset.set_3d(x, y, z);
-                    neighbor_cell_offsets.push_back(offset.to_linear());
-                }
-            }
-        }
+        const int *idx = cells[i].idx;
+        phases[idx[0]%3 + (idx[1]%3)*3 + (idx[2]%3)*9].push_back(i);
     }
 
     int max_trials = 5;
     for(int trial = 0; trial < max_trials; ++trial)
     {
-        // Create sample points for each entry in cells.
-        for(auto &it: cells)
+        for(const vector<int> &phase: phases)
         {
-            int cell_id = it.first;
-            hash_data &data = it.second;
-
-            // This cell's raw sample points start at first_sample_idx.  On trial 0, try the first one.
-            // On trial 1, try first_sample_idx + 1.
-            int next_sample_idx = data.first_sample_idx + trial;
-            if(trial >= data.sample_cnt)
-            {
-                // There are no more points to try for this cell.
-                continue;
-            }
-            const auto &candidate = raw_samples[next_sample_idx];
-
-            // See if this point conflicts with any other points in this cell, or with any points in
-            // neighboring cells.  Note that it's possible to have more than one point in the same cell.
-            bool conflict = false;
-            for(int neighbor_offset: neighbor_cell_offsets)
-            {
-                int neighbor_cell_id = cell_id + neighbor_offset;
-                const auto &it = cells.find(neighbor_cell_id);
-                if(it == cells.end())
-                    continue;
-
-                const hash_data &neighbor = it->second;
-                for(const auto &sample: neighbor.poisson_samples)
+            Thread_pool::get().parallel_for((int) phase.size(), 16, [&](int begin, int end) {
+                for(int i = begin; i < end; ++i)
                 {
-                    float distance = approximate_geodesic_distance(sample.pos, candidate.pos, sample.normal, candidate.normal);
-                    if(distance < radius_squared)
+                    hash_data &data = cells[phase[i]];
+
+                    // This cell's raw sample points start at first_sample_idx.  On trial 0, try the first one.
+                    // On trial 1, try first_sample_idx + 1.
+                    int next_sample_idx = data.first_sample_idx + trial;
+                    if(trial >= data.sample_cnt)
                     {
-                        // The candidate is too close to this existing sample.
-                        conflict = true;
-                        break;
+                        // There are no more points to try for this cell.
+                        continue;
+                    }
+                    const auto &candidate = raw_samples[next_sample_idx];
+
+                    // See if this point conflicts with any other points in this cell, or with any points in
+                    // neighboring cells.  Note that it's possible to have more than one point in the same cell.
+                    bool conflict = false;
+                    for(int z = data.idx[2]-1; z <= data.idx[2]+1 && !conflict; ++z)
+                    for(int y = data.idx[1]-1; y <= data.idx[1]+1 && !conflict; ++y)
+                    for(int x = data.idx[0]-1; x <= data.idx[0]+1 && !conflict; ++x)
+                    {
+                        if(x < 0 || y < 0 || z < 0 || x >= grid_size_int[0] || y >= grid_size_int[1] || z >= grid_size_int[2])
+                            continue;
+
+                        int neighbor_cell_id = x + grid_size_int[0] * (y + grid_size_int[1] * z);
+                        const auto &it = cell_id_to_index.find(neighbor_cell_id);
+                        if(it == cell_id_to_index.end())
+                            continue;
+
+                        const hash_data &neighbor = cells[it->second];
+                        for(const auto &sample: neighbor.poisson_samples)
+                        {
+                            float distance = approximate_geodesic_distance(sample.pos, candidate.pos, sample.normal, candidate.normal);
+                            if(distance < radius_squared)
+                            {
+                                // The candidate is too close to this existing sample.
+                                conflict = true;
+                                break;
+                            }
+                        }
                     }
-                }
-                if(conflict)
-                    break;
-            }
 
-            if(conflict)
-                continue;
+                    if(conflict)
+                        continue;
 
-            // Store the new sample.
-            data.poisson_samples.emplace_back();
-            poisson_sample &new_sample = data.poisson_samples.back();
-            new_sample.pos = candidate.pos;
-            new_sample.normal = candidate.normal;
+                    // Store the new sample.
+                    data.poisson_samples.emplace_back();
+                    poisson_sample &new_sample = data.poisson_samples.back();
+                    new_sample.pos = candidate.pos;
+                    new_sample.normal = candidate.normal;
+                }
+            });
         }
     }
 
     // Copy the results to the output.
-    for(const auto it: cells)
+    for(const auto &cell: cells)
     {
-        for(const auto &sample: it.second.poisson_samples)
+        for(const auto &sample: cell.poisson_samples)
         {
             samples_pos.push_back(sample.pos.to_vector());
             samples_nor.push_back(sample.normal);
@@ -339,7 +363,8 @@ void poisson_disk(float radius,
                   const std::vector<Vec3_cu>& nors,
                   const std::vector<int>& tris,
                   std::vector<Vec3_cu>& samples_pos,
-                  std::vector<Vec3_cu>& samples_nor)
+                  std::vector<Vec3_cu>& samples_nor,
+                  unsigned seed)
 {
     assert(verts.size() == nors.size());
     assert(verts.size() > 0);
@@ -376,7 +401,7 @@ void poisson_disk(float radius,
     // Create random sample points to sample.  We usually aren't doing very high-resolution sampling,
     // so we don't need a lot.
     vector<sample_point> raw_samples;
-    float surface_area = create_raw_samples(10000, verts, nors, tris, raw_samples);
+    float surface_area = create_raw_samples(10000, seed, verts, nors, tris, raw_samples);
 
     if(radius <= 0)
     {
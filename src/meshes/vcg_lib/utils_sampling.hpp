@@ -20,6 +20,8 @@ namespace Utils_sampling {
 /// @endcode
 /// @param samples_pos : resulting samples positions
 /// @param samples_nors : resulting samples normals associated to samples_pos[]
+/// @param seed : seed of the random sampling, the same seed and inputs give
+/// the same samples
 /// @warning undefined behavior if (radius <= 0 && nb_samples == 0) == true
 void poisson_disk(float radius,
                   int nb_samples,
@@ -27,6 +29,7 @@ void poisson_disk(float radius,
                   const std::vector<Vec3_cu>& nors,
                   const std::vector<int>& tris,
                   std::vector<Vec3_cu>& samples_pos,
-                  std::vector<Vec3_cu>& samples_nor);
+                  std::vector<Vec3_cu>& samples_nor,
+                  unsigned seed = 0);
 
 }// END UTILS_SAMPLING NAMESPACE ===============================================
@@ -0,0 +1,281 @@
+#include "brick_grid.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Single to half precision, rounded to the nearest even
+uint16_t float_to_half(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t e    = (x >> 23) & 0xff;
+    uint32_t       mant = x & 0x7fffff;
+
+    // Infinity and NaN
+    if( e == 0xff )
+        return (uint16_t)(sign | 0x7c00 | (mant != 0 ? 0x200 : 0));
+
+    const int exp = (int)e - 127 + 15;
+    if( exp >= 31 )
+        return (uint16_t)(sign | 0x7c00);
+
+    uint32_t h;
+    int shift;
+    if( exp <= 0 )
+    {
+        // Denormalized half
+        if( exp < -10 )
+            return (uint16_t)sign;
+        mant |= 0x800000;
+        shift = 14 - exp;
+        h = mant >> shift;
+    }
+    else
+    {
+        shift = 13;
+        h = ((uint32_t)exp << 10) | (mant >> shift);
+    }
+
+    const uint32_t rem     = mant & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    // A carry in the exponent gives the right result (up to infinity)
+    if( rem > halfway || (rem == halfway && (h & 1)) )
+        h++;
+
+    return (uint16_t)(sign | h);
+}
+
+// -----------------------------------------------------------------------------
+
+bool equal(const float4& a, const float4& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+}// END NAMESPACE ==============================================================
+
+// -----------------------------------------------------------------------------
+
+Brick_grid::Brick_grid() :
+    _res(0),
+    _nb_bricks(0),
+    _half(false)
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void Brick_grid::begin(int res, bool half)
+{
+    clear();
+    if( res <= 0 )
+        return;
+
+    _res       = res;
+    _half      = half;
+    _nb_bricks = (res + s_brick - 1) / s_brick;
+
+    const int nb = _nb_bricks * _nb_bricks * _nb_bricks;
+    _offsets.  resize(nb, -1);
+    _constants.resize(nb, make_float4(0.f, 0.f, 0.f, 0.f));
+}
+
+// -----------------------------------------------------------------------------
+
+void Brick_grid::add_slab(int bz, const float4* slab)
+{
+    // Bricks overlapping the grid border are padded with the border cells
+    const int nb_slices = std::min(_res - bz * s_brick, (int)s_brick);
+    float4 cells[s_brick_3];
+    for(int by = 0; by < _nb_bricks; by++)
+    for(int bx = 0; bx < _nb_bricks; bx++)
+    {
+        bool constant = true;
+        for(int i = 0; i < s_brick_3; i++)
+        {
+            const int x = std::min(bx * s_brick +  i % s_brick            , _res - 1);
+            const int y = std::min(by * s_brick + (i / s_brick) % s_brick , _res - 1);
+            const int z = std::min(i / (s_brick * s_brick), nb_slices - 1);
+            cells[i] = slab[(z * _res + y) * _res + x];
+            constant = constant && equal(cells[i], cells[0]);
+        }
+
+        const int b = brick_idx(bx, by, bz);
+        _constants[b] = cells[0];
+        if( constant )
+            continue;
+
+        _offsets[b] = (int)(_half ? _pool_half.size() / 4 : _pool.size());
+        if( _half )
+        {
+            for(int i = 0; i < s_brick_3; i++)
+            {
+                _pool_half.push_back( float_to_half(cells[i].x) );
+                _pool_half.push_back( float_to_half(cells[i].y) );
+                _pool_half.push_back( float_to_half(cells[i].z) );
+                _pool_half.push_back( float_to_half(cells[i].w) );
+            }
+        }
+        else
+            _pool.insert(_pool.end(), cells, cells + s_brick_3);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Brick_grid::set_half(bool half)
+{
+    if( _half == half )
+        return;
+
+    _half = half;
+    if( half )
+    {
+        _pool_half.resize(_pool.size() * 4);
+        for(size_t i = 0; i < _pool.size(); i++)
+        {
+            _pool_half[i * 4 + 0] = float_to_half(_pool[i].x);
+            _pool_half[i * 4 + 1] = float_to_half(_pool[i].y);
+            _pool_half[i * 4 + 2] = float_to_half(_pool[i].z);
+            _pool_half[i * 4 + 3] = float_to_half(_pool[i].w);
+        }
+        std::vector<float4>().swap(_pool);
+    }
+    else
+    {
+        _pool.resize(_pool_half.size() / 4);
+        for(size_t i = 0; i < _pool.size(); i++)
+        {
+            const uint16_t* h = &_pool_half[i * 4];
+            _pool[i] = make_float4(Brick_grid_view::half_to_float(h[0]),
+                                   Brick_grid_view::half_to_float(h[1]),
+                                   Brick_grid_view::half_to_float(h[2]),
+                                   Brick_grid_view::half_to_float(h[3]));
+        }
+        std::vector<uint16_t>().swap(_pool_half);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Brick_grid::clear()
+{
+    _res       = 0;
+    _nb_bricks = 0;
+    _half      = false;
+    _offsets.  clear();
+    _constants.clear();
+    _pool.     clear();
+    _pool_half.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+Brick_grid_view Brick_grid::view() const
+{
+    Brick_grid_view v;
+    if( _res == 0 )
+        return v;
+
+    v.res       = _res;
+    v.nb_bricks = _nb_bricks;
+    v.half      = _half;
+    v.nb_cells  = (int)(_half ? _pool_half.size() / 4 : _pool.size());
+    v.offsets   = &_offsets[0];
+    v.constants = &_constants[0];
+    v.pool      = _pool.     empty() ? 0 : &_pool[0];
+    v.pool_half = _pool_half.empty() ? 0 : &_pool_half[0];
+    return v;
+}
+
+// -----------------------------------------------------------------------------
+
+size_t Brick_grid::memory() const
+{
+    return _offsets.  size() * sizeof(int)      +
+           _constants.size() * sizeof(float4)   +
+           _pool.     size() * sizeof(float4)   +
+           _pool_half.size() * sizeof(uint16_t);
+}
+
+// -----------------------------------------------------------------------------
+
+void Brick_grid::write(Cache_file::Writer& w) const
+{
+    const int nb_cells = (int)(_half ? _pool_half.size() / 4 : _pool.size());
+    w.set_param("BRICK_GRID_RES"     , _res     );
+    w.set_param("BRICK_GRID_SIZE"    , s_brick  );
+    w.set_param("BRICK_GRID_HALF"    , _half    );
+    w.set_param("BRICK_GRID_NB_CELLS", nb_cells );
+
+    if( _res == 0 )
+        return;
+
+    w.add_table("brick_offsets"  , &_offsets[0]  , _offsets.size()  );
+    w.add_table("brick_constants", &_constants[0], _constants.size());
+    if( _half && _pool_half.size() > 0 )
+        w.add_table("brick_pool", &_pool_half[0], _pool_half.size());
+    else if( _pool.size() > 0 )
+        w.add_table("brick_pool", &_pool[0], _pool.size());
+}
+
+// -----------------------------------------------------------------------------
+
+bool Brick_grid::read(const Cache_file& file)
+{
+    clear();
+
+    int64_t res, half, nb_cells;
+    if( !file.check_param("BRICK_GRID_SIZE", s_brick)   ||
+        !file.get_param("BRICK_GRID_RES"     , res     ) ||
+        !file.get_param("BRICK_GRID_HALF"    , half    ) ||
+        !file.get_param("BRICK_GRID_NB_CELLS", nb_cells) ||
+        res < 0 || nb_cells < 0 || nb_cells % s_brick_3 != 0 )
+    {
+        return false;
+    }
+
+    if( res == 0 )
+        return true;
+
+    const int nb_bricks = ((int)res + s_brick - 1) / s_brick;
+    const int nb = nb_bricks * nb_bricks * nb_bricks;
+    std::vector<int>      offsets  (nb);
+    std::vector<float4>   constants(nb);
+    std::vector<float4>   pool;
+    std::vector<uint16_t> pool_half;
+
+    bool s = file.read_table("brick_offsets"  , &offsets[0]  , nb);
+    s = s && file.read_table("brick_constants", &constants[0], nb);
+    if( s && nb_cells > 0 )
+    {
+        if( half ){
+            pool_half.resize( (size_t)nb_cells * 4 );
+            s = file.read_table("brick_pool", &pool_half[0], pool_half.size());
+        } else {
+            pool.resize( (size_t)nb_cells );
+            s = file.read_table("brick_pool", &pool[0], pool.size());
+        }
+    }
+
+    for(int b = 0; s && b < nb; b++)
+        s = offsets[b] < 0 || offsets[b] + s_brick_3 <= nb_cells;
+
+    if( !s )
+        return false;
+
+    _res       = (int)res;
+    _nb_bricks = nb_bricks;
+    _half      = half != 0;
+    _offsets.  swap(offsets);
+    _constants.swap(constants);
+    _pool.     swap(pool);
+    _pool_half.swap(pool_half);
+    return true;
+}
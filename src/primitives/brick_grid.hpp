@@ -0,0 +1,202 @@
+#ifndef BRICK_GRID_HPP__
+#define BRICK_GRID_HPP__
+
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include "cuda_compiler_interop.hpp"
+#include "cache_file.hpp"
+
+/**
+ * @struct Brick_grid_view
+ * @brief Pointers to the arrays of a Brick_grid
+ *
+ * The view is a POD which can be copied to device memory: it fetches the
+ * cells of a Brick_grid on host (@see Brick_grid::view()) or of a device copy
+ * of its arrays.
+ */
+struct Brick_grid_view {
+    IF_CUDA_DEVICE_HOST
+    Brick_grid_view() :
+        res(0), nb_bricks(0), nb_cells(0), half(false),
+        offsets(0), constants(0), pool(0), pool_half(0)
+    { }
+
+    int  res;       ///< Number of cells along each axis (0 if the grid is empty)
+    int  nb_bricks; ///< Number of bricks along each axis
+    int  nb_cells;  ///< Number of cells in the pool
+    bool half;      ///< Cells are read from 'pool_half' instead of 'pool'
+
+    const int*      offsets;
+    const float4*   constants;
+    const float4*   pool;
+    const uint16_t* pool_half;
+
+    /// Value of the cell (x, y, z), coordinates are clamped to the grid
+    IF_CUDA_DEVICE_HOST inline
+    float4 fetch(int x, int y, int z) const;
+
+    /// Half to single precision
+    IF_CUDA_DEVICE_HOST static inline
+    float half_to_float(uint16_t h);
+};
+
+/**
+ * @class Brick_grid
+ * @brief Sparse storage of a cubic grid of float4 cells
+ *
+ * The grid is cut into bricks of s_brick³ cells. Bricks where every cell has
+ * the same value (outside the primitive where the potential and gradient are
+ * null, or deep inside where the potential is one) only store this value.
+ * Other bricks store their cells in a pool, either in single or half
+ * precision.
+ *
+ * This is the storage of Precomputed_prim grids. The grid is built one slab
+ * of bricks at a time so the dense grid is never allocated:
+ * @code
+ * Brick_grid grid;
+ * grid.begin(res, true); // compress in fp16
+ * for(int bz = 0; bz < grid.nb_bricks(); bz++)
+ *     grid.add_slab(bz, slab); // res² * s_brick cells
+ * float4 v = grid.fetch(x, y, z);
+ * @endcode
+ */
+class Brick_grid {
+public:
+    /// Side of a brick in cells
+    static const int s_brick = 8;
+
+    Brick_grid();
+
+    /// Start a new grid of res³ cells, bricks are then added with add_slab()
+    /// @param half : store the cells of non constant bricks in half precision
+    void begin(int res, bool half);
+
+    /// Compress the bricks of the slab 'bz', the cells with z in
+    /// [bz * s_brick, (bz+1) * s_brick[. Slabs must be added in order.
+    /// @param slab : res² * s_brick cells, x varies first then y and z.
+    /// Slices past the end of the grid are not read.
+    void add_slab(int bz, const float4* slab);
+
+    /// Convert the pool to half or single precision
+    void set_half(bool half);
+
+    void clear();
+
+    bool empty() const { return _res == 0; }
+
+    /// Number of cells along each axis
+    int res() const { return _res; }
+
+    /// Number of bricks (and slabs) along each axis
+    int nb_bricks() const { return _nb_bricks; }
+
+    bool is_half() const { return _half; }
+
+    /// Value of the cell (x, y, z), coordinates are clamped to the grid
+    float4 fetch(int x, int y, int z) const { return view().fetch(x, y, z); }
+
+    /// Pointers to the arrays of the grid, valid until it is modified
+    Brick_grid_view view() const;
+
+    /// Size of the stored data in bytes
+    size_t memory() const;
+
+    /// @name Serialization
+    /// @{
+    /// Add the grid to 'w', the grid must stay alive until 'w' is saved
+    void write(Cache_file::Writer& w) const;
+
+    /// @return false if 'file' doesn't hold a grid or is corrupted
+    bool read(const Cache_file& file);
+    /// @}
+
+private:
+    int brick_idx(int bx, int by, int bz) const {
+        return (bz * _nb_bricks + by) * _nb_bricks + bx;
+    }
+
+    /// Number of cells in a brick
+    static const int s_brick_3 = s_brick * s_brick * s_brick;
+
+    int  _res;       ///< Number of cells along each axis
+    int  _nb_bricks; ///< Number of bricks along each axis
+    bool _half;      ///< Pool stored in '_pool_half' instead of '_pool'
+
+    /// Offset of the first cell of each brick in the pool or -1 if the brick
+    /// is constant
+    std::vector<int> _offsets;
+    /// Value of each brick when constant
+    std::vector<float4> _constants;
+    /// Cells of the non constant bricks (x varies first inside a brick)
+    std::vector<float4> _pool;
+    /// Same as '_pool' with four halfs per cell
+    std::vector<uint16_t> _pool_half;
+};
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST inline
+float4 Brick_grid_view::fetch(int x, int y, int z) const
+{
+    const int s = Brick_grid::s_brick;
+    x = x < 0 ? 0 : (x >= res ? res - 1 : x);
+    y = y < 0 ? 0 : (y >= res ? res - 1 : y);
+    z = z < 0 ? 0 : (z >= res ? res - 1 : z);
+
+    const int b   = ((z / s) * nb_bricks + (y / s)) * nb_bricks + (x / s);
+    const int off = offsets[b];
+    if( off < 0 )
+        return constants[b];
+
+    const int i = off + ((z % s) * s + (y % s)) * s + (x % s);
+    if( half )
+    {
+        const uint16_t* h = pool_half + i * 4;
+        return make_float4(half_to_float(h[0]), half_to_float(h[1]),
+                           half_to_float(h[2]), half_to_float(h[3]));
+    }
+    return pool[i];
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST inline
+float Brick_grid_view::half_to_float(uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    int            exp  = (h >> 10) & 0x1f;
+    uint32_t       mant = h & 0x3ff;
+
+    uint32_t x;
+    if( exp == 0 )
+    {
+        if( mant == 0 )
+            x = sign;
+        else
+        {
+            // Denormalized half are normalized floats
+            exp = 1;
+            while( !(mant & 0x400) ){
+                mant <<= 1;
+                exp--;
+            }
+            mant &= 0x3ff;
+            x = sign | ((uint32_t)(exp + 127 - 15) << 23) | (mant << 13);
+        }
+    }
+    else if( exp == 31 )
+        x = sign | 0x7f800000 | (mant << 13);
+    else
+        x = sign | ((uint32_t)(exp + 127 - 15) << 23) | (mant << 13);
+
+#ifdef __CUDA_ARCH__
+    return __int_as_float((int)x);
+#else
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+#endif
+}
+
+#endif // BRICK_GRID_HPP__
@@ -54,6 +54,18 @@ void HermiteRBF::set_radius(float r){ HRBF_env::set_inst_radius(_id, r); }
 
 float HermiteRBF::get_radius() const { return HRBF_env::get_inst_radius( _id ); }
 
+void HermiteRBF::set_fit_setup(const HRBF_wrapper::Fit_setup& setup){
+    HRBF_env::set_fit_setup(_id, setup);
+}
+
+HRBF_wrapper::Fit_setup HermiteRBF::get_fit_setup() const {
+    return HRBF_env::get_fit_setup( _id );
+}
+
+void HermiteRBF::set_culling(bool state){ HRBF_env::set_culling(_id, state); }
+
+bool HermiteRBF::get_culling() const { return HRBF_env::get_culling( _id ); }
+
 void HermiteRBF::get_samples(std::vector<Vec3_cu>& list) const {
     HRBF_env::get_samples(_id, list);
 }
@@ -62,6 +74,123 @@ void HermiteRBF::get_normals(std::vector<Vec3_cu>& list) const {
     HRBF_env::get_normals(_id, list);
 }
 
+// -----------------------------------------------------------------------------
+
+#if !defined(__CUDA_ARCH__) && defined(HERMITE_WITH_X3)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HRBF_PACKET_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(HRBF_PACKET_SSE) && defined(__AVX__)
+#define HRBF_LANES_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(HRBF_PACKET_SSE)
+/// SIMD operations used by fngf_global_lanes()
+struct Lanes_sse {
+    typedef __m128 V;
+    enum { SIZE = 4 };
+    static V load (const float* p) { return _mm_loadu_ps(p); }
+    static V set1 (float f)        { return _mm_set1_ps(f); }
+    static V add  (V a, V b)       { return _mm_add_ps(a, b); }
+    static V sub  (V a, V b)       { return _mm_sub_ps(a, b); }
+    static V mul  (V a, V b)       { return _mm_mul_ps(a, b); }
+    static V div  (V a, V b)       { return _mm_div_ps(a, b); }
+    static V sqrt (V a)            { return _mm_sqrt_ps(a); }
+    static V gt   (V a, V b)       { return _mm_cmpgt_ps(a, b); }
+    /// mask ? a : b
+    static V blend(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    static float sum(V a) {
+        float t[SIZE];
+        _mm_storeu_ps(t, a);
+        return (t[0] + t[1]) + (t[2] + t[3]);
+    }
+};
+#endif
+
+#if defined(HRBF_LANES_AVX)
+struct Lanes_avx {
+    typedef __m256 V;
+    enum { SIZE = 8 };
+    static V load (const float* p) { return _mm256_loadu_ps(p); }
+    static V set1 (float f)        { return _mm256_set1_ps(f); }
+    static V add  (V a, V b)       { return _mm256_add_ps(a, b); }
+    static V sub  (V a, V b)       { return _mm256_sub_ps(a, b); }
+    static V mul  (V a, V b)       { return _mm256_mul_ps(a, b); }
+    static V div  (V a, V b)       { return _mm256_div_ps(a, b); }
+    static V sqrt (V a)            { return _mm256_sqrt_ps(a); }
+    static V gt   (V a, V b)       { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static V blend(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+    static float sum(V a) {
+        float t[SIZE];
+        _mm256_storeu_ps(t, a);
+        return ((t[0] + t[1]) + (t[2] + t[3])) + ((t[4] + t[5]) + (t[6] + t[7]));
+    }
+};
+#endif
+
+/// Accumulate in 'ret' and 'grad' the potential of the samples [begin, end)
+/// of HRBF_env::h_soa at 'x', L::SIZE samples at a time
+/// (same as fngf_global() with HERMITE_WITH_X3).
+/// @return index of the first sample not evaluated
+template<class L>
+static int fngf_global_lanes(int begin, int end, const Point_cu& x,
+                             float& ret, Vec3_cu& grad)
+{
+    typedef typename L::V V;
+    const HRBF_env::Soa_samples& s = HRBF_env::h_soa;
+
+    const V zero  = L::set1(0.f);
+    const V one   = L::set1(1.f);
+    const V three = L::set1(3.f);
+    const V eps   = L::set1(1e-10f);
+    const V px = L::set1(x.x), py = L::set1(x.y), pz = L::set1(x.z);
+
+    V f = zero, gx = zero, gy = zero, gz = zero;
+    int i = begin;
+    for(; i + L::SIZE <= end; i += L::SIZE)
+    {
+        const V a  = L::load(&s._alpha[i]);
+        const V bx = L::load(&s._bx[i]);
+        const V by = L::load(&s._by[i]);
+        const V bz = L::load(&s._bz[i]);
+
+        const V dx = L::sub(px, L::load(&s._x[i]));
+        const V dy = L::sub(py, L::load(&s._y[i]));
+        const V dz = L::sub(pz, L::load(&s._z[i]));
+
+        // Same as Vec3_cu::safe_normalize()
+        V l = L::sqrt(L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz)));
+        const V valid = L::gt(l, eps);
+        const V inv_l = L::div(one, L::blend(valid, l, one));
+        const V nx = L::blend(valid, L::mul(dx, inv_l), one );
+        const V ny = L::blend(valid, L::mul(dy, inv_l), zero);
+        const V nz = L::blend(valid, L::mul(dz, inv_l), zero);
+        l = L::blend(valid, l, zero);
+
+        const V _3l     = L::mul(three, l);
+        const V alpha3l = L::mul(a, _3l);
+        const V bDotd3  = L::mul(three, L::add(L::add(L::mul(bx, dx), L::mul(by, dy)), L::mul(bz, dz)));
+
+        gx = L::add(gx, L::add(L::mul(alpha3l, dx), L::add(L::mul(bx, _3l), L::mul(nx, bDotd3))));
+        gy = L::add(gy, L::add(L::mul(alpha3l, dy), L::add(L::mul(by, _3l), L::mul(ny, bDotd3))));
+        gz = L::add(gz, L::add(L::mul(alpha3l, dz), L::add(L::mul(bz, _3l), L::mul(nz, bDotd3))));
+
+        f = L::add(f, L::mul(L::add(L::mul(a, L::mul(l, l)), bDotd3), l));
+    }
+
+    ret  += L::sum(f);
+    grad += Vec3_cu(L::sum(gx), L::sum(gy), L::sum(gz));
+    return i;
+}
+
+#endif // !defined(__CUDA_ARCH__) && defined(HERMITE_WITH_X3)
+
+// -----------------------------------------------------------------------------
+
 IF_CUDA_DEVICE_HOST
 float HermiteRBF::fngf_global(Vec3_cu& grad, const Point_cu& x) const
 {
@@ -72,7 +201,19 @@ float HermiteRBF::fngf_global(Vec3_cu& grad, const Point_cu& x) const
 
     if(size_off.y == 0) return 0.f;
 
-    for(int i = 0; i<size_off.y; i++)
+    int i = 0;
+#if defined(HRBF_PACKET_SSE)
+    // Samples by lanes in the structure of arrays, the remaining ones below
+    const int end = size_off.x + size_off.y;
+    int j = size_off.x;
+    #if defined(HRBF_LANES_AVX)
+    j = fngf_global_lanes<Lanes_avx>(j, end, x, ret, grad);
+    #endif
+    j = fngf_global_lanes<Lanes_sse>(j, end, x, ret, grad);
+    i = j - size_off.x;
+#endif
+
+    for(; i<size_off.y; i++)
     {
         Point_cu  node;
         Vec3_cu beta;
@@ -131,18 +272,171 @@ float HermiteRBF::fngf_global(Vec3_cu& grad, const Point_cu& x) const
     return ret;
 }
 
-IF_CUDA_DEVICE_HOST
-float HermiteRBF::fngf(Vec3_cu& grad, const Point_cu& x) const
+/// Transform the global potential 'f' and its gradient to compact support
+IF_CUDA_DEVICE_HOST static inline
+float global_to_compact(float f, float radius, Vec3_cu& grad)
 {
-    const float ret = fngf_global(grad, x);
 #if defined(POLY_C2)
-    Field::grad_to_compact_poly_c2(ret, HRBF_env::fetch_radius(_id), grad);
-    return Field::to_compact_poly_c2(ret, HRBF_env::fetch_radius(_id));
+    Field::grad_to_compact_poly_c2(f, radius, grad);
+    return Field::to_compact_poly_c2(f, radius);
 #elif defined(TANH_CINF)
-    Field::grad_to_compact_tanh(ret, HRBF_env::fetch_radius(_id), TO_, grad);
-    return Field::to_compact_tanh(ret, HRBF_env::fetch_radius(_id), TO_);
+    Field::grad_to_compact_tanh(f, radius, TO_, grad);
+    return Field::to_compact_tanh(f, radius, TO_);
 #else
-    return ret;
+    return f;
+#endif
+}
+
+#if !defined(__CUDA_ARCH__) && (defined(POLY_C2) || defined(TANH_CINF))
+/// Compact potential at 'x' when it is constant (host only)
+/// @return false if the samples must be evaluated
+static inline
+bool fngf_culled(int id, float& f, Vec3_cu& grad, const Point_cu& x)
+{
+    float f_min, f_max;
+    if( !HRBF_env::fetch_potential_bounds(id, x, f_min, f_max) )
+        return false;
+
+    const float radius = HRBF_env::fetch_radius(id);
+    if( f_min <= radius && f_max >= -radius )
+        return false;
+
+    grad = Vec3_cu(0.f, 0.f, 0.f);
+    f = global_to_compact(f_min > radius ? f_min : f_max, radius, grad);
+    return true;
+}
+#endif
+
+IF_CUDA_DEVICE_HOST
+float HermiteRBF::fngf(Vec3_cu& grad, const Point_cu& x) const
+{
+#if !defined(__CUDA_ARCH__) && (defined(POLY_C2) || defined(TANH_CINF))
+    float f;
+    if( fngf_culled(_id, f, grad, x) )
+        return f;
+#endif
+    const float ret = fngf_global(grad, x);
+    return global_to_compact(ret, HRBF_env::fetch_radius(_id), grad);
+}
+
+// -----------------------------------------------------------------------------
+
+#if !defined(__CUDA_ARCH__)
+
+void HermiteRBF::fngf_packet(float* f, Vec3_cu* gf, const Point_cu* p, int nb_points) const
+{
+#if defined(POLY_C2) || defined(TANH_CINF)
+    if( HRBF_env::h_grids[_id].is_valid() )
+    {
+        // Gather points where the compact potential is not constant
+        const int chunk = 64;
+        Point_cu pts[chunk];
+        float    pf [chunk];
+        Vec3_cu  pgf[chunk];
+        int      idx[chunk];
+        int n = 0;
+        for(int i = 0; i < nb_points; i++)
+        {
+            if( !fngf_culled(_id, f[i], gf[i], p[i]) )
+            {
+                pts[n] = p[i];
+                idx[n] = i;
+                n++;
+            }
+
+            if( n == chunk || (i == nb_points - 1 && n > 0) )
+            {
+                fngf_packet_samples(pf, pgf, pts, n);
+                for(int k = 0; k < n; k++){
+                    f [idx[k]] = pf [k];
+                    gf[idx[k]] = pgf[k];
+                }
+                n = 0;
+            }
+        }
+        return;
+    }
+#endif
+    fngf_packet_samples(f, gf, p, nb_points);
+}
+
+// -----------------------------------------------------------------------------
+
+void HermiteRBF::fngf_packet_samples(float* f, Vec3_cu* gf, const Point_cu* p, int nb_points) const
+{
+    int i = 0;
+#if defined(HRBF_PACKET_SSE)
+    const int2  size_off = HRBF_env::fetch_inst_size_and_offset(_id);
+    const float radius   = HRBF_env::fetch_radius(_id);
+
+    const __m128 zero  = _mm_setzero_ps();
+    const __m128 one   = _mm_set1_ps(1.f);
+    const __m128 three = _mm_set1_ps(3.f);
+    const __m128 eps   = _mm_set1_ps(1e-10f);
+
+    for(; i + 4 <= nb_points; i += 4)
+    {
+        const __m128 px = _mm_setr_ps(p[i].x, p[i+1].x, p[i+2].x, p[i+3].x);
+        const __m128 py = _mm_setr_ps(p[i].y, p[i+1].y, p[i+2].y, p[i+3].y);
+        const __m128 pz = _mm_setr_ps(p[i].z, p[i+1].z, p[i+2].z, p[i+3].z);
+
+        __m128 ret = zero, gx = zero, gy = zero, gz = zero;
+        for(int s = 0; s < size_off.y; s++)
+        {
+            Point_cu node;
+            Vec3_cu  beta;
+            const float alpha = HRBF_env::fetch_weights_point(beta, node, s + size_off.x);
+            const __m128 a  = _mm_set1_ps(alpha);
+            const __m128 bx = _mm_set1_ps(beta.x);
+            const __m128 by = _mm_set1_ps(beta.y);
+            const __m128 bz = _mm_set1_ps(beta.z);
+
+            const __m128 dx = _mm_sub_ps(px, _mm_set1_ps(node.x));
+            const __m128 dy = _mm_sub_ps(py, _mm_set1_ps(node.y));
+            const __m128 dz = _mm_sub_ps(pz, _mm_set1_ps(node.z));
+
+            // Same as Vec3_cu::safe_normalize()
+            __m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                          _mm_mul_ps(dy, dy)),
+                                               _mm_mul_ps(dz, dz)));
+            const __m128 valid = _mm_cmpgt_ps(l, eps);
+            const __m128 inv_l = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, l), _mm_andnot_ps(valid, one)));
+            const __m128 nx = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(dx, inv_l)), _mm_andnot_ps(valid, one));
+            const __m128 ny = _mm_and_ps(valid, _mm_mul_ps(dy, inv_l));
+            const __m128 nz = _mm_and_ps(valid, _mm_mul_ps(dz, inv_l));
+            l = _mm_and_ps(valid, l);
+
+            // thin plates + generalisation (see fngf_global())
+            const __m128 _3l     = _mm_mul_ps(three, l);
+            const __m128 alpha3l = _mm_mul_ps(a, _3l);
+            const __m128 bDotd3  = _mm_mul_ps(three, _mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, dx),
+                                                                           _mm_mul_ps(by, dy)),
+                                                                _mm_mul_ps(bz, dz)));
+
+            gx = _mm_add_ps(gx, _mm_add_ps(_mm_mul_ps(alpha3l, dx), _mm_add_ps(_mm_mul_ps(bx, _3l), _mm_mul_ps(nx, bDotd3))));
+            gy = _mm_add_ps(gy, _mm_add_ps(_mm_mul_ps(alpha3l, dy), _mm_add_ps(_mm_mul_ps(by, _3l), _mm_mul_ps(ny, bDotd3))));
+            gz = _mm_add_ps(gz, _mm_add_ps(_mm_mul_ps(alpha3l, dz), _mm_add_ps(_mm_mul_ps(bz, _3l), _mm_mul_ps(nz, bDotd3))));
+
+            ret = _mm_add_ps(ret, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(a, _mm_mul_ps(l, l)), bDotd3), l));
+        }
+
+        float f4[4], gx4[4], gy4[4], gz4[4];
+        _mm_storeu_ps(f4 , ret);
+        _mm_storeu_ps(gx4, gx );
+        _mm_storeu_ps(gy4, gy );
+        _mm_storeu_ps(gz4, gz );
+        for(int k = 0; k < 4; k++)
+        {
+            gf[i+k] = Vec3_cu(gx4[k], gy4[k], gz4[k]);
+            f [i+k] = global_to_compact(f4[k], radius, gf[i+k]);
+        }
+    }
 #endif
+
+    // Remaining points
+    for(; i < nb_points; i++)
+        f[i] = fngf(gf[i], p[i]);
 }
 
+#endif // !defined(__CUDA_ARCH__)
+
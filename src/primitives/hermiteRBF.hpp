@@ -70,6 +70,18 @@ struct HermiteRBF
 
     float get_radius() const;
 
+    /// Sets the solver used to compute the HRBF weights. Weights are
+    /// re-computed if the setup changes. Default is a single precision LU.
+    void set_fit_setup(const HRBF_wrapper::Fit_setup& setup);
+
+    HRBF_wrapper::Fit_setup get_fit_setup() const;
+
+    /// Enable culling for host evaluation: the samples are skipped where the
+    /// compact potential is constant. @see HRBF_env::set_culling()
+    void set_culling(bool state);
+
+    bool get_culling() const;
+
     void get_samples(std::vector<Vec3_cu>& list) const;
 
     void get_normals(std::vector<Vec3_cu>& list) const;
@@ -83,14 +95,30 @@ struct HermiteRBF
     // =========================================================================
     /// @name Evaluation of the potential and gradient (global support)
     // =========================================================================
+    /// On host samples are read from HRBF_env::h_soa and evaluated by lanes of
+    /// 8 (AVX) or 4 (SSE) when available
     IF_CUDA_DEVICE_HOST
     float fngf_global(Vec3_cu& gf, const Point_cu& p) const;
 
+    // =========================================================================
+    /// @name Host evaluation of several points (compact support)
+    // =========================================================================
+    /// Evaluate the potential and gradient of 'nb_points' points.
+    /// Samples are fetched once for a packet of four points which are
+    /// evaluated together with SSE when available. With culling enabled only
+    /// points where the compact potential is not constant are evaluated.
+    /// @param f : potential at each point
+    /// @param gf : gradient at each point
+    void fngf_packet(float* f, Vec3_cu* gf, const Point_cu* p, int nb_points) const;
+
     /// @return id of the hrbf in HRBF_env namespace @see HRBF_env
     inline int get_id() const { return _id; }
 
 private:
 
+    /// fngf_packet() without culling
+    void fngf_packet_samples(float* f, Vec3_cu* gf, const Point_cu* p, int nb_points) const;
+
     // =========================================================================
     /// @name Attributes
     // =========================================================================
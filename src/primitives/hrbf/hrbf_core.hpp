@@ -6,13 +6,299 @@
 #define HRBF_CORE_HPP__
 
 #include <Eigen/LU>
+#include <Eigen/Cholesky>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "hrbf_data.hpp"
 
 // =============================================================================
 namespace HRBF_wrapper {
 // =============================================================================
 
+/// @brief LDL^T factorization of a symmetric indefinite matrix with
+/// Bunch-Kaufman pivoting: P A P^T = L D L^T where L is unit lower triangular
+/// and D block diagonal with 1x1 and 2x2 blocks.
+///
+/// Eigen's LDLT only handles semi definite matrices. Only the lower triangle
+/// of A is read. Columns are factorized by panels whose updates are delayed
+/// and applied to the trailing matrix with a single triangular product
+/// (same scheme as LAPACK's sytrf).
+template<typename MatrixType>
+class Sym_ldlt
+{
+public:
+    typedef typename MatrixType::Scalar Scalar;
+    typedef Eigen::Matrix<Scalar,Eigen::Dynamic,1> VectorX;
+
+    Sym_ldlt() : _singular(false) {}
+
+    // --------------------------------------------------------------------------
+
+    void compute(const MatrixType& a)
+    {
+        const int n = (int)a.rows();
+        // Bounds the growth of the elements of L
+        const Scalar alpha = (Scalar(1) + std::sqrt(Scalar(17))) / Scalar(8);
+
+        _m = a;
+        _perm.resize(n);
+        for(int i = 0; i < n; ++i) _perm[i] = i;
+        _d.setZero(n);
+        _e.setZero(n);
+        _singular = false;
+
+        // Columns of the panel updated with the previous panel columns (L*D)
+        MatrixType w(n, (int)PANEL_SIZE);
+        int k = 0;
+        while( k < n )
+        {
+            const int k0 = k;
+            int j = 0; // column of the panel
+            // Keep room for a 2x2 pivot unless it's the last panel
+            while( k < n && (j < PANEL_SIZE - 1 || (n - k0 <= PANEL_SIZE && j < PANEL_SIZE)) )
+            {
+                const int r = n - k;
+                updated_col(w, k, k0, j, k, j);
+
+                int kstep = 1, kp = k;
+                const Scalar absakk = std::abs( w(k, j) );
+                Scalar colmax = 0;
+                int imax = k;
+                if( r > 1 ){
+                    colmax = w.col(j).tail(r-1).cwiseAbs().maxCoeff(&imax);
+                    imax += k + 1;
+                }
+
+                if( std::max(absakk, colmax) == Scalar(0) )
+                {
+                    _singular = true;
+                }
+                else if( absakk < alpha * colmax )
+                {
+                    // No room left for the column 'imax' in the panel
+                    if( j + 1 >= PANEL_SIZE ) break;
+
+                    updated_col(w, k, k0, j, imax, j + 1);
+                    Scalar rowmax = 0;
+                    if( imax > k     ) rowmax = w.col(j+1).segment(k, imax-k).cwiseAbs().maxCoeff();
+                    if( imax + 1 < n ) rowmax = std::max(rowmax, w.col(j+1).tail(n-imax-1).cwiseAbs().maxCoeff());
+
+                    if( absakk >= alpha * colmax * (colmax / rowmax) ) {
+                        kp = k;
+                    } else if( std::abs( w(imax, j+1) ) >= alpha * rowmax ) {
+                        kp = imax;
+                        w.col(j).tail(r) = w.col(j+1).tail(r);
+                    } else {
+                        kp = imax;
+                        kstep = 2;
+                    }
+                }
+
+                const int kk = k + kstep - 1;
+                if( kp != kk )
+                {
+                    swap(kk, kp);
+                    w.row(kk).head(j + kstep).swap( w.row(kp).head(j + kstep) );
+                }
+
+                if( kstep == 1 )
+                {
+                    const Scalar d = w(k, j);
+                    _d(k)    = d;
+                    _m(k, k) = d;
+                    if( r > 1 ){
+                        if( d != Scalar(0) ) _m.col(k).tail(r-1) = w.col(j).tail(r-1) / d;
+                        else                 _m.col(k).tail(r-1).setZero();
+                    }
+                }
+                else
+                {
+                    const Scalar a = w(k, j), b = w(k+1, j), c = w(k+1, j+1);
+                    _d(k) = a; _d(k+1) = c; _e(k) = b;
+                    if( r > 2 )
+                    {
+                        const Scalar det = a * c - b * b;
+                        Eigen::Matrix<Scalar,2,2> inv;
+                        inv << c / det, -b / det,
+                              -b / det,  a / det;
+                        _m.block(k+2, k, r-2, 2).noalias() = w.block(k+2, j, r-2, 2) * inv;
+                    }
+                    _m(k+1, k) = 0;
+                }
+                k += kstep;
+                j += kstep;
+            }
+
+            // Apply the panel to the trailing matrix
+            if( k < n && j > 0 )
+            {
+                const int r = n - k;
+                _m.bottomRightCorner(r, r).template triangularView<Eigen::Lower>() -=
+                        _m.block(k, k0, r, j) * w.block(k, 0, r, j).transpose();
+            }
+        }
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Solve A x = b. Singular pivots are skipped (their unknowns are zero).
+    template<class Rhs>
+    typename Rhs::PlainObject solve(const Eigen::MatrixBase<Rhs>& b) const
+    {
+        const int n = (int)_m.rows();
+        typename Rhs::PlainObject y(b.rows(), b.cols());
+        for(int i = 0; i < n; ++i) y.row(i) = b.row(_perm[i]);
+
+        _m.template triangularView<Eigen::UnitLower>().solveInPlace(y);
+
+        for(int k = 0; k < n; )
+        {
+            if( _e(k) != Scalar(0) )
+            {
+                const Scalar a = _d(k), e = _e(k), c = _d(k+1);
+                const Scalar det = a * c - e * e;
+                for(int i = 0; i < y.cols(); ++i)
+                {
+                    const Scalar y0 = y(k, i), y1 = y(k+1, i);
+                    y(k  , i) = (c * y0 - e * y1) / det;
+                    y(k+1, i) = (a * y1 - e * y0) / det;
+                }
+                k += 2;
+            }
+            else
+            {
+                if( _d(k) != Scalar(0) ) y.row(k) /= _d(k);
+                else                     y.row(k).setZero();
+                k += 1;
+            }
+        }
+
+        _m.template triangularView<Eigen::UnitLower>().transpose().solveInPlace(y);
+
+        typename Rhs::PlainObject x(b.rows(), b.cols());
+        for(int i = 0; i < n; ++i) x.row(_perm[i]) = y.row(i);
+        return x;
+    }
+
+    /// Was a null pivot met
+    bool is_singular() const { return _singular; }
+
+private:
+    enum { PANEL_SIZE = 48 };
+
+    // --------------------------------------------------------------------------
+
+    /// Column 'col' of the trailing matrix starting at 'k' updated with the
+    /// 'nb' first columns of the panel starting at 'k0', written in w.col(dst)
+    void updated_col(MatrixType& w, int k, int k0, int nb, int col, int dst) const
+    {
+        const int n = (int)_m.rows();
+        // Lower triangle only: row 'col' then column 'col'
+        w.col(dst).segment(k, col - k) = _m.row(col).segment(k, col - k).transpose();
+        w.col(dst).tail(n - col) = _m.col(col).tail(n - col);
+        if( nb > 0 )
+            w.col(dst).tail(n - k).noalias() -= _m.block(k, k0, n - k, nb) * w.row(col).head(nb).transpose();
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Symmetric swap of rows and columns r < s of the lower triangle, rows
+    /// of L already computed are swapped as well
+    void swap(int r, int s)
+    {
+        const int n = (int)_m.rows();
+        if( s + 1 < n ) _m.col(r).tail(n-s-1).swap( _m.col(s).tail(n-s-1) );
+        for(int i = r + 1; i < s; ++i) std::swap(_m(i, r), _m(s, i));
+        std::swap(_m(r, r), _m(s, s));
+        if( r > 0 ) _m.row(r).head(r).swap( _m.row(s).head(r) );
+        std::swap(_perm[r], _perm[s]);
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Strict lower part holds L
+    MatrixType _m;
+    /// Row i of P A is row _perm[i] of A
+    std::vector<int> _perm;
+    /// Diagonal of D
+    VectorX _d;
+    /// Sub diagonal of D, non zero for the first column of 2x2 blocks
+    VectorX _e;
+    bool _singular;
+};
+
+// =============================================================================
+
+/// @brief Factorization of the hermite system 'D x = f' with the solver of a
+/// Fit_setup.
+///
+/// D is not symmetric: swapping the point and the node flips the sign of the
+/// gradient terms. With J = diag(1, -1, ..., -1) flipping the sign of the
+/// beta unknowns, D J is symmetric (but indefinite) and is what LDL^T
+/// factorizes. Tikhonov regularization adds lambda to the diagonal of D J.
+template<typename _Scalar, int _Dim>
+class HRBF_solver
+{
+public:
+    typedef _Scalar Scalar;
+    enum { Dim = _Dim };
+    typedef Eigen::Matrix<Scalar,Eigen::Dynamic,Eigen::Dynamic> MatrixXX;
+    typedef Eigen::Matrix<Scalar,Dim+1,Dim+1>                   MatrixBB;
+
+    /// Sign flips J of a block of the system
+    static MatrixBB sign_block()
+    {
+        MatrixBB j = MatrixBB::Identity() * Scalar(-1);
+        j(0, 0) = Scalar(1);
+        return j;
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Factorize 'd' (regularization not included), 'd' is used as workspace
+    void compute(MatrixXX& d, const Fit_setup& setup)
+    {
+        _solver = setup.solver;
+        const int n = (int)d.cols();
+        const Scalar lambda = Scalar(setup.lambda);
+        for(int i = 0; i < n; ++i)
+            d(i, i) += (i % (Dim+1)) == 0 ? lambda : -lambda;
+
+        if( _solver == Fit_setup::LDLT )
+        {
+            for(int i = 0; i < n; ++i)
+                if( (i % (Dim+1)) != 0 ) d.col(i) *= Scalar(-1);
+            _ldlt.compute(d);
+        }
+        else
+            _lu.compute(d);
+    }
+
+    // --------------------------------------------------------------------------
+
+    template<class Rhs>
+    typename Rhs::PlainObject solve(const Eigen::MatrixBase<Rhs>& f) const
+    {
+        if( _solver == Fit_setup::LU )
+            return _lu.solve(f);
+
+        typename Rhs::PlainObject x = _ldlt.solve(f);
+        for(int i = 0; i < x.rows(); ++i)
+            if( (i % (Dim+1)) != 0 ) x.row(i) *= Scalar(-1);
+        return x;
+    }
+
+private:
+    Fit_setup::Solver_t           _solver;
+    Eigen::PartialPivLU<MatrixXX> _lu;
+    Sym_ldlt<MatrixXX>            _ldlt;
+};
+
+// =============================================================================
+
 /// @brief fitting surface on a cloud point and evaluating the implicit surface
 /// @tparam _Scalar : a base type float double...
 /// @tparam _Dim : dimension of the ambient space
@@ -30,20 +316,49 @@ public:
     typedef Eigen::Matrix<Scalar,Dim,Eigen::Dynamic>            MatrixDX;
     typedef Eigen::Matrix<Scalar,Eigen::Dynamic,Eigen::Dynamic> MatrixXX;
     typedef Eigen::Matrix<Scalar,Eigen::Dynamic,1>              VectorX;
+    typedef Eigen::Matrix<Scalar,Dim+1,Dim+1>                   MatrixBB;
 
     HRBF_fit() {}
 
     // --------------------------------------------------------------------------
 
+    /// Block of the hermite system linking the constraints (value and
+    /// gradient) at point 'p' to the coefficients (alpha and beta) of the node
+    /// 'c'
+    static MatrixBB system_block(const Vector& p, const Vector& c)
+    {
+        MatrixBB blk;
+        Vector diff = p - c;
+        Scalar l = diff.norm();
+        if( l == 0 ) {
+            blk.setZero();
+        } else {
+            Scalar w    = Rbf::f(l);
+            Scalar dw_l = Rbf::df(l)/l;
+            Scalar ddw  = Rbf::ddf(l);
+            Vector g    = diff * dw_l;
+            blk(0,0) = w;
+            blk.row(0).template segment<Dim>(1) = g.transpose();
+            blk.col(0).template segment<Dim>(1) = g;
+            blk.template block<Dim,Dim>(1,1)    = (ddw - dw_l)/(l*l) * (diff * diff.transpose());
+            blk.template block<Dim,Dim>(1,1).diagonal().array() += dw_l;
+        }
+        return blk;
+    }
+
+    // --------------------------------------------------------------------------
+
     void hermite_fit(const std::vector<Vector>& points,
-                     const std::vector<Vector>& normals)
+                     const std::vector<Vector>& normals,
+                     const Fit_setup& setup = Fit_setup())
     {
-        hermite_fit(points,normals,points);
+        hermite_fit(points,normals,points,setup);
     }
 
     void hermite_fit(const std::vector<Vector>& points,
                      const std::vector<Vector>& normals,
-                     const std::vector<Vector>& nodes)
+                     const std::vector<Vector>& nodes,
+                     const Fit_setup& setup = Fit_setup())
     {
         assert( points.size() == normals.size() );
         int nb_points           = points.size();
@@ -77,26 +392,24 @@ public:
             for(int j = 0; j < nb_nodes; ++j)
             {
                 int jo = (Dim + 1) * j;
-                Vector diff = p - _node_centers.col(j);
-                Scalar l = diff.norm();
-                if( l == 0 ) {
-                    D.template block<Dim+1,Dim+1>(io,jo).setZero();
-                } else {
-                    Scalar w    = Rbf::f(l);
-                    Scalar dw_l = Rbf::df(l)/l;
-                    Scalar ddw  = Rbf::ddf(l);
-                    Vector g    = diff * dw_l;
-                    D(io,jo) = w;
-                    D.row(io).template segment<Dim>(jo+1) = g.transpose();
-                    D.col(jo).template segment<Dim>(io+1) = g;
-                    D.template block<Dim,Dim>(io+1,jo+1)  = (ddw - dw_l)/(l*l) * (diff * diff.transpose());
-                    D.template block<Dim,Dim>(io+1,jo+1).diagonal().array() += dw_l;
-                }
+                D.template block<Dim+1,Dim+1>(io,jo) = system_block(p, _node_centers.col(j));
             }
         }
 
-        if(nb_points == nb_nodes) x = D.lu().solve(f);
-        else                      x = (D.transpose()*D).lu().solve(D.transpose()*f);
+        if(nb_points == nb_nodes)
+        {
+            HRBF_solver<Scalar, Dim> solver;
+            solver.compute(D, setup);
+            x = solver.solve(f);
+        }
+        else
+        {
+            // Least squares: normal equations are symmetric positive
+            MatrixXX N = D.transpose()*D;
+            N.diagonal().array() += Scalar(setup.lambda);
+            if(setup.solver == Fit_setup::LDLT) x = N.ldlt().solve(D.transpose()*f);
+            else                                x = N.lu().solve(D.transpose()*f);
+        }
 
         Eigen::Map< Eigen::Matrix<Scalar,Dim+1,Eigen::Dynamic> > mx( x.data(), Dim + 1, nb_nodes);
 
@@ -167,6 +480,343 @@ public:
 
 }; // END HermiteRbfReconstruction Class =======================================
 
+// =============================================================================
+
+/// @brief Hermite fit keeping the factorization of its system to update the
+/// coefficients cheaply when a few samples are edited.
+///
+/// The system only depends on the sample positions (normals are in the right
+/// hand side). The factorization of the last full fit ("base" system) is
+/// kept. On the next refit samples are matched to the base samples by
+/// position: moved, added and deleted samples are seen as a low rank
+/// modification of the base system which is solved with the
+/// Sherman-Morrison-Woodbury formula. Changing only normals costs a single
+/// solve with the cached factorization.
+///
+/// A full fit is done when too many samples changed or when the corrected
+/// solution is not accurate enough.
+template<typename _Scalar, int _Dim, typename Rbf>
+class HRBF_refit : public HRBF_fit<_Scalar, _Dim, Rbf>
+{
+public:
+    typedef HRBF_fit<_Scalar, _Dim, Rbf> Base;
+    typedef typename Base::Scalar   Scalar;
+    typedef typename Base::Vector   Vector;
+    typedef typename Base::MatrixXX MatrixXX;
+    typedef typename Base::VectorX  VectorX;
+    typedef typename Base::MatrixBB MatrixBB;
+    enum { Dim = _Dim, B = _Dim + 1 };
+
+    HRBF_refit() : _base_residual(0), _nb_full_fits(0) {}
+
+    // --------------------------------------------------------------------------
+
+    /// Fit 'points' and 'normals' reusing the factorization of the previous
+    /// call when possible. Changing the setup triggers a full fit.
+    void hermite_refit(const std::vector<Vector>& points,
+                       const std::vector<Vector>& normals,
+                       const Fit_setup& setup = Fit_setup())
+    {
+        assert( points.size() == normals.size() );
+        std::vector<int> base_idx;
+        const int nb_changes = match_base(points, base_idx);
+
+        const int nb_base = (int)_base_points.size();
+        if( nb_base == 0 || setup != _setup ||
+            nb_changes > std::max(2, nb_base / 16) ||
+            !woodbury_fit(points, normals, base_idx) )
+        {
+            full_fit(points, normals, setup);
+        }
+    }
+
+    /// Number of factorizations computed so far
+    int nb_full_fits() const { return _nb_full_fits; }
+
+private:
+    // --------------------------------------------------------------------------
+    /// @name Tools
+    // --------------------------------------------------------------------------
+
+    /// Lexicographic order of the base points
+    struct Less_point {
+        Less_point(const std::vector<Vector>& pts) : _pts(pts) {}
+        bool operator()(int a, int b) const {
+            for(int k = 0; k < Dim; ++k)
+                if( _pts[a](k) != _pts[b](k) ) return _pts[a](k) < _pts[b](k);
+            return false;
+        }
+        const std::vector<Vector>& _pts;
+    };
+
+    // --------------------------------------------------------------------------
+
+    /// Look up each point in the base samples.
+    /// @param base_idx : index of the base sample at the same position or -1
+    /// @return number of base samples missing plus number of new samples
+    int match_base(const std::vector<Vector>& points, std::vector<int>& base_idx) const
+    {
+        const int nb_base = (int)_base_points.size();
+        base_idx.assign(points.size(), -1);
+        std::vector<char> used(nb_base, 0);
+        int nb_changes = 0;
+        for(unsigned i = 0; i < points.size(); ++i)
+        {
+            // Binary search among the sorted base points
+            int lo = 0, hi = nb_base;
+            while( lo < hi )
+            {
+                const int mid = (lo + hi) / 2;
+                const Vector& q = _base_points[_sorted[mid]];
+                bool less = false;
+                for(int k = 0; k < Dim; ++k)
+                    if( q(k) != points[i](k) ){ less = q(k) < points[i](k); break; }
+                if( less ) lo = mid + 1;
+                else       hi = mid;
+            }
+            // Duplicates are matched in order
+            for(; lo < nb_base && _base_points[_sorted[lo]] == points[i]; ++lo)
+            {
+                if( !used[_sorted[lo]] ){
+                    used[_sorted[lo]] = 1;
+                    base_idx[i] = _sorted[lo];
+                    break;
+                }
+            }
+            nb_changes += base_idx[i] < 0 ? 1 : 0;
+        }
+
+        for(int i = 0; i < nb_base; ++i)
+            nb_changes += used[i] ? 0 : 1;
+        return nb_changes;
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Block of the system including the regularization when 'p' and 'c'
+    /// are the same sample
+    MatrixBB system_block(const Vector& p, const Vector& c, bool same) const
+    {
+        MatrixBB blk = Base::system_block(p, c);
+        if( same )
+            blk += HRBF_solver<Scalar, Dim>::sign_block() * Scalar(_setup.lambda);
+        return blk;
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Factorize the system of 'points' which becomes the new base system
+    void full_fit(const std::vector<Vector>& points,
+                  const std::vector<Vector>& normals,
+                  const Fit_setup& setup)
+    {
+        const int nb_points = (int)points.size();
+        MatrixXX D(B * nb_points, B * nb_points);
+        VectorX  f(B * nb_points);
+        for(int i = 0; i < nb_points; ++i)
+        {
+            f(B*i) = 0;
+            f.template segment<Dim>(B*i + 1) = normals[i];
+            for(int j = 0; j < nb_points; ++j)
+                D.template block<B,B>(B*i, B*j) = Base::system_block(points[i], points[j]);
+        }
+
+        _solver.compute(D, setup);
+        _setup = setup;
+        _nb_full_fits++;
+        _base_points = points;
+        _sorted.resize(nb_points);
+        for(int i = 0; i < nb_points; ++i) _sorted[i] = i;
+        std::sort(_sorted.begin(), _sorted.end(), Less_point(_base_points));
+
+        std::vector<int> ext_idx(nb_points);
+        for(int i = 0; i < nb_points; ++i) ext_idx[i] = i;
+        VectorX x = _solver.solve(f);
+        _base_residual = residual(points, f, x, ext_idx);
+        set_coeffs(points, x, ext_idx);
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// @return relative residual ||Dx - f|| / ||f|| of the system of 'points'
+    /// where 'x' and 'f' are indexed with 'ext_idx'
+    Scalar residual(const std::vector<Vector>& points,
+                    const VectorX& f,
+                    const VectorX& x,
+                    const std::vector<int>& ext_idx) const
+    {
+        const int nb_points = (int)points.size();
+        Scalar res = 0, norm_f = 0;
+        for(int i = 0; i < nb_points; ++i)
+        {
+            Eigen::Matrix<Scalar, B, 1> r = -f.template segment<B>(B*ext_idx[i]);
+            for(int j = 0; j < nb_points; ++j)
+                r += system_block(points[i], points[j], i == j) * x.template segment<B>(B*ext_idx[j]);
+            res    += r.squaredNorm();
+            norm_f += f.template segment<B>(B*ext_idx[i]).squaredNorm();
+        }
+        return norm_f > 0 ? std::sqrt(res / norm_f) : std::sqrt(res);
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Solve the system of 'points' as a low rank modification of the base
+    /// system.
+    ///
+    /// Unknowns are extended to the base samples followed by the new samples.
+    /// The extended system is P + U V^T where P = diag(base system, identity).
+    /// Rows and columns of deleted base samples are replaced by identity so
+    /// their coefficients are zero and don't contribute to the others.
+    /// U V^T is non zero only on the rows and columns of the "touched"
+    /// samples (new or deleted) so its rank is at most 2 * B * nb_touched.
+    /// @return false if the solution is not accurate enough
+    bool woodbury_fit(const std::vector<Vector>& points,
+                      const std::vector<Vector>& normals,
+                      const std::vector<int>& base_idx)
+    {
+        const int nb_points = (int)points.size();
+        const int nb_base   = (int)_base_points.size();
+        const int n0        = B * nb_base;
+
+        // Extended samples
+        std::vector<int>    ext_idx(nb_points);
+        std::vector<Vector> ext_pts(_base_points);
+        std::vector<char>   active(nb_base, 0);
+        for(int i = 0; i < nb_points; ++i)
+        {
+            if( base_idx[i] >= 0 ){
+                ext_idx[i] = base_idx[i];
+                active[base_idx[i]] = 1;
+            } else {
+                ext_idx[i] = (int)ext_pts.size();
+                ext_pts.push_back( points[i] );
+                active.push_back( 1 );
+            }
+        }
+        const int nb_ext = (int)ext_pts.size();
+        const int n      = B * nb_ext;
+
+        std::vector<int> touched;
+        for(int e = 0; e < nb_ext; ++e)
+            if( e >= nb_base || !active[e] ) touched.push_back(e);
+        const int m = B * (int)touched.size();
+
+        VectorX f = VectorX::Zero(n);
+        for(int i = 0; i < nb_points; ++i)
+            f.template segment<Dim>(B*ext_idx[i] + 1) = normals[i];
+
+        VectorX y = f;
+        y.head(n0) = _solver.solve( f.head(n0) );
+
+        if( m == 0 ){
+            // Only normals changed
+            set_coeffs(points, y, ext_idx);
+            return true;
+        }
+
+        // R = touched rows of U V^T, C = touched columns on the other rows
+        MatrixXX R = MatrixXX::Zero(m, n);
+        MatrixXX C = MatrixXX::Zero(n0, m);
+        for(unsigned t = 0; t < touched.size(); ++t)
+        {
+            const int e = touched[t];
+            if( e < nb_base )
+            {
+                // Deleted: identity instead of the base system rows/columns
+                for(int c = 0; c < nb_base; ++c)
+                    R.template block<B,B>(B*t, B*c) = -system_block(ext_pts[e], ext_pts[c], c == e);
+                R.template block<B,B>(B*t, B*e) += MatrixBB::Identity();
+                for(int r = 0; r < nb_base; ++r)
+                    if( active[r] )
+                        C.template block<B,B>(B*r, B*t) = -Base::system_block(ext_pts[r], ext_pts[e]);
+            }
+            else
+            {
+                // New: actual system rows/columns instead of identity
+                for(int c = 0; c < nb_ext; ++c)
+                    if( active[c] )
+                        R.template block<B,B>(B*t, B*c) = system_block(ext_pts[e], ext_pts[c], c == e);
+                R.template block<B,B>(B*t, B*e) -= MatrixBB::Identity();
+                for(int r = 0; r < nb_base; ++r)
+                    if( active[r] )
+                        C.template block<B,B>(B*r, B*t) = Base::system_block(ext_pts[r], ext_pts[e]);
+            }
+        }
+
+        // Z = P^-1 U with U = [I_T, C]
+        MatrixXX Z = MatrixXX::Zero(n, 2*m);
+        {
+            MatrixXX rhs = MatrixXX::Zero(n0, 2*m);
+            for(unsigned t = 0; t < touched.size(); ++t)
+            {
+                const int e = touched[t];
+                if( e < nb_base ) rhs.block(B*e, B*t, B, B).setIdentity();
+                else              Z.block(B*e, B*t, B, B).setIdentity();
+            }
+            rhs.rightCols(m) = C;
+            Z.topRows(n0) = _solver.solve( rhs );
+        }
+
+        // Capacitance matrix K = I + V^T Z with V^T = [R; I_T^T]
+        MatrixXX K = MatrixXX::Identity(2*m, 2*m);
+        VectorX  w(2*m);
+        K.topRows(m) += R * Z;
+        w.head(m) = R * y;
+        for(unsigned t = 0; t < touched.size(); ++t)
+        {
+            const int e = touched[t];
+            K.block(m + B*t, 0, B, 2*m) += Z.block(B*e, 0, B, 2*m);
+            w.segment(m + B*t, B) = y.segment(B*e, B);
+        }
+
+        VectorX x = y - Z * K.lu().solve(w);
+
+        // The corrected solution must be about as accurate as a full fit
+        const Scalar res = residual(points, f, x, ext_idx);
+        if( !(res <= Scalar(4) * _base_residual + Scalar(1e-5)) )
+            return false;
+
+        set_coeffs(points, x, ext_idx);
+        return true;
+    }
+
+    // --------------------------------------------------------------------------
+
+    /// Copy the coefficients of each point from the (extended) solution 'x'
+    void set_coeffs(const std::vector<Vector>& points,
+                    const VectorX& x,
+                    const std::vector<int>& ext_idx)
+    {
+        const int nb_points = (int)points.size();
+        this->_node_centers.resize(Dim, nb_points);
+        this->_betas.       resize(Dim, nb_points);
+        this->_alphas.      resize(nb_points);
+        for(int i = 0; i < nb_points; ++i)
+        {
+            const int xo = B * ext_idx[i];
+            this->_node_centers.col(i) = points[i];
+            this->_alphas(i)           = x(xo);
+            this->_betas.col(i)        = x.template segment<Dim>(xo + 1);
+        }
+    }
+
+    // --------------------------------------------------------------------------
+    /// @name Attributes
+    // --------------------------------------------------------------------------
+
+    /// Factorization of the base system
+    HRBF_solver<Scalar, Dim> _solver;
+    /// Setup of the base system
+    Fit_setup _setup;
+    /// Samples positions of the base system
+    std::vector<Vector> _base_points;
+    /// Indices of _base_points in lexicographic order
+    std::vector<int> _sorted;
+    /// Relative residual of the base system solution
+    Scalar _base_residual;
+    int _nb_full_fits;
+};
+
 }// END RBFWrapper =============================================================
 
 #endif // HRBF_CORE_HPP__
@@ -13,6 +13,35 @@
 namespace HRBF_wrapper {
 // =============================================================================
 
+    /// Settings of the linear system solved to compute the hrbf coeffs.
+    struct Fit_setup {
+        enum Solver_t {
+            /// LU with partial pivoting of the hermite system
+            LU,
+            /// LDL^T with Bunch-Kaufman pivoting of the symmetrized hermite
+            /// system. About half the flops of LU.
+            LDLT
+        };
+
+        Fit_setup() : solver(LU), use_double(false), lambda(0.f) { }
+
+        bool operator==(const Fit_setup& s) const {
+            return solver == s.solver && use_double == s.use_double && lambda == s.lambda;
+        }
+
+        bool operator!=(const Fit_setup& s) const { return !(*this == s); }
+
+        Solver_t solver;
+        /// Assemble and factorize the system in double precision. Coeffs are
+        /// still stored in single precision.
+        bool use_double;
+        /// Tikhonov regularization added to the diagonal of the system.
+        /// Zero interpolates the samples exactly, small positive values
+        /// smooth the surface and keep coefficients bounded when samples are
+        /// clustered.
+        float lambda;
+    };
+
     /// HermiteRbfReconstruction data wrapper in order to store RBF coeffs
     ///	for post evaluation of the potential field
     struct HRBF_coeffs {
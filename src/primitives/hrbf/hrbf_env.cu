@@ -33,9 +33,26 @@ HDA_float hd_radius;
 /// Transformations associated to each HRBF instances
 HD_Array<Transfo> hd_transfo;
 
-/// Maps elements of d_init_alpha_beta, d_init_points, etc.  to transformations
-/// in hd_transfo
-DA_int d_map_transfos;
+/// Instances to transform at the next apply_hrbf_transfos() (transformation,
+/// samples or weights changed)
+HA_bool h_to_transform;
+
+/// Instances whose animated points and weights in the host side of hd_points
+/// and hd_alphas_betas are older than the device side
+HA_bool h_host_outdated;
+
+/// Number of instances tagged in h_host_outdated
+int nb_host_outdated = 0;
+
+/// Solver used to compute the weights of each HRBF instances
+Host::Array<HRBF_wrapper::Fit_setup> h_fit_setup;
+
+/// Instances evaluated on host with a culling grid (@see set_culling())
+HA_bool h_culling;
+
+std::vector<HRBF_grid> h_grids;
+
+Soa_samples h_soa;
 
 int nb_hrbf_instance = 0;
 
@@ -47,6 +64,39 @@ texture<float, 1, cudaReadModeElementType> tex_radius;
 /// Are textures currently binded with arrays
 bool binded = false;
 
+// -----------------------------------------------------------------------------
+
+/// Private function
+/// Copy the host side of hd_points and hd_alphas_betas from 'start' to
+/// 'start + nb' in h_soa. h_soa is resized to hd_points.size()
+static void update_soa(int start, int nb)
+{
+    const int size = hd_points.size();
+    assert( hd_alphas_betas.size() == size );
+    assert( start + nb <= size );
+
+    h_soa._x.    resize(size);
+    h_soa._y.    resize(size);
+    h_soa._z.    resize(size);
+    h_soa._alpha.resize(size);
+    h_soa._bx.   resize(size);
+    h_soa._by.   resize(size);
+    h_soa._bz.   resize(size);
+
+    for(int i = start; i < start + nb; i++)
+    {
+        const float4 p  = hd_points      [i];
+        const float4 ab = hd_alphas_betas[i];
+        h_soa._x    [i] = p.x;
+        h_soa._y    [i] = p.y;
+        h_soa._z    [i] = p.z;
+        h_soa._alpha[i] = ab.w;
+        h_soa._bx   [i] = ab.x;
+        h_soa._by   [i] = ab.y;
+        h_soa._bz   [i] = ab.z;
+    }
+}
+
 
 static void setup_tex()
 {
@@ -98,6 +148,7 @@ void unbind()
 void clean_env()
 {
     HRBF_env::unbind();
+    HRBF_wrapper::release_all_refits();
     nb_hrbf_instance = 0;
     hd_points.erase();
     hd_points.update_device_mem();
@@ -112,7 +163,13 @@ void clean_env()
     hd_radius.update_device_mem();
     hd_transfo.erase();
     hd_transfo.update_device_mem();
-    d_map_transfos.erase();
+    h_fit_setup.erase();
+    h_to_transform.erase();
+    h_host_outdated.erase();
+    nb_host_outdated = 0;
+    h_culling.erase();
+    h_grids.clear();
+    update_soa(0, 0);
 }
 
 // -----------------------------------------------------------------------------
@@ -176,6 +233,8 @@ void get_anim_samples(int hrbf_id, std::vector<Point_cu>& samp_list)
     assert( hrbf_id >= 0 );
     assert( h_offset[hrbf_id].x >= 0 );
 
+    sync_host_mem(hrbf_id);
+
     int inst_size = h_offset[hrbf_id].y;
     samp_list.resize(inst_size);
     if(inst_size > 0)
@@ -206,6 +265,8 @@ void get_anim_weights(int hrbf_id, std::vector<float4>& weights_list)
     assert( hrbf_id >= 0 );
     assert( h_offset[hrbf_id].x >= 0 );
 
+    sync_host_mem(hrbf_id);
+
     int inst_size = h_offset[hrbf_id].y;
     weights_list.resize(inst_size);
     if(inst_size > 0)
@@ -321,6 +382,26 @@ float get_inst_radius(int hrbf_id)
 
 // -----------------------------------------------------------------------------
 
+HRBF_wrapper::Fit_setup get_fit_setup(int hrbf_id)
+{
+    assert(hrbf_id < h_offset.size());
+    assert(hrbf_id >= 0);
+    assert( h_offset[hrbf_id].x >= 0 );
+    return h_fit_setup[hrbf_id];
+}
+
+// -----------------------------------------------------------------------------
+
+bool get_culling(int hrbf_id)
+{
+    assert(hrbf_id < h_offset.size());
+    assert(hrbf_id >= 0);
+    assert( h_offset[hrbf_id].x >= 0 );
+    return h_culling[hrbf_id];
+}
+
+// -----------------------------------------------------------------------------
+
 Transfo get_transfo(int hrbf_id)
 {
     assert(hrbf_id < h_offset.size());
@@ -377,15 +458,24 @@ static void add_instance_memory()
     assert(d_offset.  size() == h_offset.size());
 
     const int size = h_offset.size() + 1;
-    h_offset.  realloc( size );
-    d_offset.  realloc( size );
-    hd_radius. realloc( size );
-    hd_transfo.realloc( size );
+    h_offset.   realloc( size );
+    d_offset.   realloc( size );
+    hd_radius.  realloc( size );
+    hd_transfo. realloc( size );
+    h_fit_setup.realloc( size );
+    h_to_transform. realloc( size );
+    h_host_outdated.realloc( size );
+    h_culling.      realloc( size );
+    h_grids.        resize ( size );
 
     h_offset[size - 1] = make_int2(0, 0);
     d_offset.set(size - 1, make_int2(0, 0));
-    hd_radius [size - 1] = 5.f;
-    hd_transfo[size - 1] = Transfo::identity();
+    hd_radius  [size - 1] = 5.f;
+    hd_transfo [size - 1] = Transfo::identity();
+    h_fit_setup[size - 1] = HRBF_wrapper::Fit_setup();
+    h_to_transform [size - 1] = false;
+    h_host_outdated[size - 1] = false;
+    h_culling      [size - 1] = false;
 
     hd_radius. update_device_mem();
     hd_transfo.update_device_mem();
@@ -402,10 +492,15 @@ static void erase_instance_memory()
     assert(hd_radius.size() == h_offset.size());
     assert(d_offset. size() == h_offset.size());
 
-    h_offset.  realloc(h_offset.  size() - 1);
-    d_offset.  realloc(d_offset.  size() - 1);
-    hd_radius. realloc(hd_radius. size() - 1);
-    hd_transfo.realloc(hd_transfo.size() - 1);
+    h_offset.   realloc(h_offset.   size() - 1);
+    d_offset.   realloc(d_offset.   size() - 1);
+    hd_radius.  realloc(hd_radius.  size() - 1);
+    hd_transfo. realloc(hd_transfo. size() - 1);
+    h_fit_setup.realloc(h_fit_setup.size() - 1);
+    h_to_transform. realloc(h_to_transform. size() - 1);
+    h_host_outdated.realloc(h_host_outdated.size() - 1);
+    h_culling.      realloc(h_culling.      size() - 1);
+    h_grids.        resize (h_grids.size() - 1);
 
     hd_radius.update_device_mem();
     hd_transfo.update_device_mem();
@@ -430,6 +525,11 @@ int new_instance()
         add_instance_memory();
 
     update_offset(idx, 0);
+    h_fit_setup    [idx] = HRBF_wrapper::Fit_setup();
+    h_to_transform [idx] = false;
+    h_host_outdated[idx] = false;
+    h_culling      [idx] = false;
+    h_grids        [idx] = HRBF_grid();
 
     nb_hrbf_instance++;
 
@@ -448,6 +548,11 @@ void delete_instance(int hrbf_id)
     assert(nb_hrbf_instance > 0);
     HRBF_env::unbind();
 
+    // Host memory is uploaded to the device after erasing
+    sync_host_mem();
+    h_to_transform[hrbf_id] = false;
+    h_grids[hrbf_id].clear();
+
     int inst_size = get_instance_size(hrbf_id);
 
     if(inst_size > 0)
@@ -457,13 +562,13 @@ void delete_instance(int hrbf_id)
         assert(start >= 0);
         d_init_points.    erase(start, end);
         d_init_alpha_beta.erase(start, end);
-        d_map_transfos.   erase(start, end);
         h_normals.        erase(start, end);
         hd_points.        erase(start, end);
         hd_alphas_betas.  erase(start, end);
 
         hd_points.update_device_mem();
         hd_alphas_betas.update_device_mem();
+        update_soa(0, hd_points.size());
     }
 
     // Compute the new offsets
@@ -484,6 +589,7 @@ void delete_instance(int hrbf_id)
     }
 
     nb_hrbf_instance--;
+    HRBF_wrapper::release_refit(hrbf_id);
 
     HRBF_env::bind();
 }
@@ -501,6 +607,8 @@ void reset_instance(int hrbf_id)
     HRBF_env::unbind();
     float radius = hd_radius[hrbf_id];
     Transfo tr = get_transfo(hrbf_id);
+    HRBF_wrapper::Fit_setup setup = h_fit_setup[hrbf_id];
+    bool culling = h_culling[hrbf_id];
     HRBF_env::bind();
 
     delete_instance(hrbf_id);
@@ -513,6 +621,8 @@ void reset_instance(int hrbf_id)
     update_offset(hrbf_id, 0);
     hd_radius.set_hd(hrbf_id, radius);
     set_transfo( hrbf_id, tr);
+    h_fit_setup[hrbf_id] = setup;
+    h_culling  [hrbf_id] = culling;
     nb_hrbf_instance++;
     HRBF_env::bind();
 }
@@ -524,6 +634,9 @@ void reset_instance(int hrbf_id)
 /// change/delete/add a sample.
 /// the function is design to facilitate updates of HRBF_Env global variables
 /// @warning don't forget to unbind array to textures before calling this
+/// @param hrbf_id instance the samples belong to. The factorization of its
+/// system is kept so that editing a few samples is cheap
+/// (@see HRBF_wrapper::hermite_refit())
 /// @param h_normals array in host memory
 /// (parameter is likely to be HRBF_Env::h_normals.ptr()+offset)
 /// @param d_points  array in device memory most likely
@@ -531,7 +644,8 @@ void reset_instance(int hrbf_id)
 /// @param d_alphas_betas array in device memory
 /// (parameter is likely to be HRBF_Env::d_init_alpha_beta.ptr()+offset)
 /// @param nb_points size of the arrays
-static void update_coeff(const Vec3_cu* h_normals,
+static void update_coeff(int hrbf_id,
+                         const Vec3_cu* h_normals,
                          const float4* d_points,
                          float4* d_alphas_betas,
                          int nb_points)
@@ -550,7 +664,8 @@ static void update_coeff(const Vec3_cu* h_normals,
     }
 
     HRBF_coeffs coeffs;
-    hermite_fit(vertices.ptr(), normals.ptr(), nb_points, coeffs);
+    hermite_refit(hrbf_id, vertices.ptr(), normals.ptr(), nb_points, coeffs,
+                  h_fit_setup[hrbf_id]);
     // updates weights with the newly computed weights
     HA_float4 h_alpha_beta(nb_points);
     for(int i=0; i<nb_points; i++){
@@ -563,16 +678,31 @@ static void update_coeff(const Vec3_cu* h_normals,
 
 // -----------------------------------------------------------------------------
 
+/// Private function
+/// Tag the host side of the animated points and weights of 'hrbf_id' as
+/// older than the device side @see sync_host_mem()
+static void set_host_outdated(int hrbf_id)
+{
+    if( h_host_outdated[hrbf_id] ) return;
+    h_host_outdated[hrbf_id] = true;
+    nb_host_outdated++;
+}
+
+// -----------------------------------------------------------------------------
+
 static void update_anim_alpha_betas(int hrbf_id)
 {
     const int offset = h_offset[hrbf_id].x;
     const int size   = get_instance_size(hrbf_id);
 
-    mem_cpy_dth(hd_alphas_betas.ptr()+offset,
+    mem_cpy_dtd(hd_alphas_betas.d_ptr()+offset,
                 d_init_alpha_beta.ptr()+offset,
                 size);
 
-    hd_alphas_betas.update_device_mem();
+    set_host_outdated(hrbf_id);
+    // Weights are to be transformed again
+    h_to_transform[hrbf_id] = true;
+    h_grids[hrbf_id].clear();
 }
 
 // -----------------------------------------------------------------------------
@@ -596,8 +726,10 @@ void set_sample(int hrbf_id,
     int    idx    = sample_index+offset;
     d_init_points.set(idx, fpoint);
     hd_points.set_hd(idx, fpoint);
+    update_soa(idx, 1);
     // re-compute the weights
-    update_coeff(h_normals.ptr()+offset,
+    update_coeff(hrbf_id,
+                 h_normals.ptr()+offset,
                  d_init_points.ptr()+offset,
                  d_init_alpha_beta.ptr()+offset,
                  inst_size);
@@ -626,7 +758,8 @@ void set_sample_normal(int hrbf_id,
     int idx = sample_index+offset;
     h_normals[idx] = n;
     // re-compute the weights
-    update_coeff(h_normals.ptr()+offset,
+    update_coeff(hrbf_id,
+                 h_normals.ptr()+offset,
                  d_init_points.ptr()+offset,
                  d_init_alpha_beta.ptr()+offset,
                  inst_size);
@@ -638,6 +771,50 @@ void set_sample_normal(int hrbf_id,
 
 // -----------------------------------------------------------------------------
 
+void set_fit_setup(int hrbf_id, const HRBF_wrapper::Fit_setup& setup)
+{
+    assert(hrbf_id < h_offset.size());
+    assert(hrbf_id >= 0);
+    assert( h_offset[hrbf_id].x >= 0 );
+
+    if( h_fit_setup[hrbf_id] == setup )
+        return;
+
+    HRBF_env::unbind();
+    h_fit_setup[hrbf_id] = setup;
+
+    const int inst_size = get_instance_size(hrbf_id);
+    const int offset    = h_offset[hrbf_id].x;
+    if( inst_size > 0 )
+    {
+        // re-compute the weights
+        update_coeff(hrbf_id,
+                     h_normals.ptr()+offset,
+                     d_init_points.ptr()+offset,
+                     d_init_alpha_beta.ptr()+offset,
+                     inst_size);
+
+        update_anim_alpha_betas(hrbf_id);
+    }
+    HRBF_env::bind();
+}
+
+// -----------------------------------------------------------------------------
+
+void set_culling(int hrbf_id, bool state)
+{
+    assert(hrbf_id < h_offset.size());
+    assert(hrbf_id >= 0);
+    assert( h_offset[hrbf_id].x >= 0 );
+
+    h_culling[hrbf_id] = state;
+    h_grids[hrbf_id].clear();
+    // Builds the grid
+    if( state ) sync_host_mem(hrbf_id);
+}
+
+// -----------------------------------------------------------------------------
+
 void set_inst_radius(int hrbf_id, float radius)
 {
     assert(hrbf_id < h_offset.size());
@@ -647,6 +824,10 @@ void set_inst_radius(int hrbf_id, float radius)
     HRBF_env::unbind();
     hd_radius.set_hd(hrbf_id, radius);
     HRBF_env::bind();
+
+    // The grid extent depends on the radius
+    h_grids[hrbf_id].clear();
+    sync_host_mem(hrbf_id);
 }
 
 // -----------------------------------------------------------------------------
@@ -660,6 +841,7 @@ void set_transfo(int hrbf_id, const Transfo& tr)
 
     //HRBF_env::unbind();
     hd_transfo[hrbf_id] = tr;
+    h_to_transform[hrbf_id] = true;
     // will be done with apply_hrbf_transfos() :
     //hd_transfo.device_array().set(hrbf_id, tr);
     //HRBF_env::bind();
@@ -669,8 +851,78 @@ void set_transfo(int hrbf_id, const Transfo& tr)
 
 void apply_hrbf_transfos()
 {
+    std::vector<int> ids;
+    for(int i = 0; i < h_to_transform.size(); i++)
+    {
+        if( !h_to_transform[i] ) continue;
+        h_to_transform[i] = false;
+        if( h_offset[i].x < 0 || h_offset[i].y == 0 ) continue;
+
+        ids.push_back( i );
+        set_host_outdated( i );
+        h_grids[i].set_transfo( hd_transfo[i] );
+    }
+
+    if( ids.size() == 0 ) return;
+
     hd_transfo.update_device_mem();
-    HRBF_kernels::hrbf_transform(hd_transfo.device_array(), d_map_transfos);
+    HRBF_kernels::hrbf_transform(ids, hd_transfo.device_array());
+}
+
+// -----------------------------------------------------------------------------
+
+/// Private function
+/// Build the culling grid of 'hrbf_id' from the animated points and weights
+/// in host memory
+static void build_grid(int hrbf_id)
+{
+    const int2 off = h_offset[hrbf_id];
+
+    std::vector<Point_cu> nodes (off.y);
+    std::vector<Vec3_cu>  betas (off.y);
+    std::vector<float>    alphas(off.y);
+    for(int i = 0; i < off.y; i++)
+        alphas[i] = fetch_weights_point(betas[i], nodes[i], off.x + i);
+
+    h_grids[hrbf_id].build(nodes.data(), betas.data(), alphas.data(), off.y, hd_radius[hrbf_id]);
+}
+
+// -----------------------------------------------------------------------------
+
+void sync_host_mem(int hrbf_id)
+{
+    assert(hrbf_id < h_offset.size());
+    assert(hrbf_id >= 0);
+
+    if( h_host_outdated[hrbf_id] )
+    {
+        const int2 off = h_offset[hrbf_id];
+        if( off.x >= 0 && off.y > 0 )
+        {
+            hd_points.      update_host_mem(off.x, off.y);
+            hd_alphas_betas.update_host_mem(off.x, off.y);
+            update_soa(off.x, off.y);
+        }
+        h_host_outdated[hrbf_id] = false;
+        nb_host_outdated--;
+    }
+
+    // Host memory is up to date unless the instance changed since the last
+    // apply_hrbf_transfos()
+    if( h_culling[hrbf_id] && !h_to_transform[hrbf_id] && !h_grids[hrbf_id].is_valid() )
+        build_grid( hrbf_id );
+}
+
+// -----------------------------------------------------------------------------
+
+void sync_host_mem()
+{
+    if( nb_host_outdated == 0 ) return;
+
+    for(int i = 0; i < h_host_outdated.size(); i++)
+        sync_host_mem( i );
+
+    assert( nb_host_outdated == 0 );
 }
 
 // -----------------------------------------------------------------------------
@@ -684,6 +936,10 @@ void delete_samples(int hrbf_id, const std::vector<int>& samples_idx)
 
     HRBF_env::unbind();
 
+    // Host memory is uploaded to the device after erasing
+    sync_host_mem();
+    h_grids[hrbf_id].clear();
+
     int size_inst = get_instance_size(hrbf_id);
     if( size_inst < 1 ){
         std::cerr << "There is no samples to delete";
@@ -701,18 +957,19 @@ void delete_samples(int hrbf_id, const std::vector<int>& samples_idx)
         int idx = samples_idx[i];
         d_init_points.    erase(idx + offset);
         d_init_alpha_beta.erase(idx + offset);
-        d_map_transfos.   erase(idx + offset);
         h_normals.        erase(idx + offset);
         hd_points.        erase(idx + offset);
         hd_alphas_betas.  erase(idx + offset);
         hd_alphas_betas.update_device_mem();
         hd_points.      update_device_mem();
     }
+    update_soa(0, hd_points.size());
 
     // Compute new offsets
     update_offset(hrbf_id, size_inst - samples_idx.size());
 
-    update_coeff(h_normals.ptr()+offset,
+    update_coeff(hrbf_id,
+                 h_normals.ptr()+offset,
                  d_init_points.ptr()+offset,
                  d_init_alpha_beta.ptr()+offset,
                  get_instance_size(hrbf_id));
@@ -750,6 +1007,11 @@ int add_samples(int hrbf_id,
 
     HRBF_env::unbind();
 
+    // Host memory is uploaded to the device after inserting
+    sync_host_mem();
+    h_to_transform[hrbf_id] = true;
+    h_grids[hrbf_id].clear();
+
     // add sample
     HA_float4 ha_points( points.size() );
     for(unsigned i = 0; i < points.size(); i++){
@@ -763,11 +1025,9 @@ int add_samples(int hrbf_id,
     d_init_points. insert(offset, ha_points);
     hd_points.     insert(offset, ha_points);
     h_normals.     insert(offset, normals  );
-    d_map_transfos.insert(offset, std::vector<int>(points.size(), hrbf_id) );
     hd_points.update_device_mem();
     assert( h_normals.     size() == hd_points.    size() );
     assert( d_init_points. size() == hd_points.    size() );
-    assert( d_map_transfos.size() == d_init_points.size() );
 
     // Compute new offsets
     update_offset(hrbf_id, inst_size+points.size());
@@ -779,7 +1039,8 @@ int add_samples(int hrbf_id,
         d_init_alpha_beta.insert(offset, ha_points/*insert dummy data*/ );
         hd_alphas_betas  .insert(offset, ha_points/*insert dummy data*/ );
 
-        update_coeff(h_normals.ptr()+offset,
+        update_coeff(hrbf_id,
+                     h_normals.ptr()+offset,
                      d_init_points.ptr()+offset,
                      d_init_alpha_beta.ptr()+offset,
                      get_instance_size(hrbf_id));
@@ -792,6 +1053,7 @@ int add_samples(int hrbf_id,
         hd_alphas_betas  .insert(offset, weights );
         hd_alphas_betas.update_device_mem();
     }
+    update_soa(0, hd_points.size());
 
     HRBF_env::bind();
 
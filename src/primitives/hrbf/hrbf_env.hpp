@@ -5,6 +5,8 @@
 
 #include "cuda_utils.hpp"
 #include "transfo.hpp"
+#include "hrbf_data.hpp"
+#include "hrbf_grid.hpp"
 
 // -----------------------------------------------------------------------------
 
@@ -46,6 +48,8 @@ namespace HRBF_env{
 /// Animated points and weights.
 /// These arrays represents the mesh when animated
 /// There are computed by the function rbf_transform()
+/// @warning the host side is only updated on demand, call sync_host_mem()
+/// before reading it
 #if !defined(NO_CUDA)
 extern Cuda_utils::HDA_float4 hd_points;
 /// First three floats represents the beta vector, last float is the alpha scalar
@@ -73,6 +77,22 @@ extern Cuda_utils::HA_Vec3_cu h_normals;
 extern Cuda_utils::HDA_float hd_radius;
 #endif
 
+/// Host side of hd_points and hd_alphas_betas as a structure of arrays so
+/// that host evaluation can process samples in SIMD lanes. Indices are the
+/// same as hd_points, arrays are updated with the host side of hd_points
+/// (@see sync_host_mem())
+struct Soa_samples {
+    std::vector<float> _x, _y, _z;    ///< animated points
+    std::vector<float> _alpha;
+    std::vector<float> _bx, _by, _bz; ///< animated beta weights
+};
+
+extern Soa_samples h_soa;
+
+/// Grids of the instances evaluated with culling on host.
+/// Grids of the other instances are never valid @see set_culling()
+extern std::vector<HRBF_grid> h_grids;
+
 // -----------------------------------------------------------------------------
 
 void bind();
@@ -147,6 +167,17 @@ void set_sample_normal(int hrbf_id,
                        int sample_index,
                        const Vec3_cu& n);
 
+/// Set the solver used to compute the weights of the ith instance.
+/// Weights are re-computed if the setup changes.
+/// @see HRBF_wrapper::Fit_setup
+void set_fit_setup(int hrbf_id, const HRBF_wrapper::Fit_setup& setup);
+
+/// Enable host evaluation of the ith instance with a culling grid: the
+/// samples are skipped where the compact potential is constant.
+/// Disabled by default as small features of the potential may be missed
+/// @see HRBF_grid
+void set_culling(int hrbf_id, bool state);
+
 /// Set the radius of the ith instance for going to global to compact support
 void set_inst_radius(int hrbf_id, float radius);
 
@@ -156,11 +187,20 @@ void set_inst_radius(int hrbf_id, float radius);
 /// when all transformations are sets
 void set_transfo(int hrbf_id, const Transfo& tr);
 
-/// Apply HRBF transformations defined with set_transfo(); to every hrbf
-/// instances
-// TODO: only apply transformations to a specific HRBF
+/// Apply HRBF transformations defined with set_transfo(). Only instances
+/// whose transformation, samples or weights changed since the last call are
+/// transformed. Results stay in device memory (@see sync_host_mem())
 void apply_hrbf_transfos();
 
+/// Copy back to host memory the animated points and weights of every
+/// instances transformed since the last call. Host evaluation of the hrbfs
+/// (fetch_xxx() functions outside kernels) reads host memory and must call
+/// this first.
+void sync_host_mem();
+
+/// Same as sync_host_mem() for a single instance
+void sync_host_mem(int hrbf_id);
+
 //------------------------------------------------------------------------------
 /// @name Getters
 //------------------------------------------------------------------------------
@@ -221,6 +261,12 @@ float get_inst_radius(int hrbf_id);
 /// Get transformations of the ith instance
 Transfo get_transfo(int hrbf_id);
 
+/// Get the solver used to compute the weights of the ith instance
+HRBF_wrapper::Fit_setup get_fit_setup(int hrbf_id);
+
+/// Whether the ith instance is evaluated with a culling grid on host
+bool get_culling(int hrbf_id);
+
 
 /// @return the instance radius to transform from global to compact support
 IF_CUDA_DEVICE_HOST static inline
@@ -241,6 +287,17 @@ float fetch_weights_point(Vec3_cu& beta,
                           Point_cu& point,
                           int raw_idx);
 
+#if !defined(__CUDA_ARCH__)
+/// Bounds of the global potential of an instance at 'p' (host only)
+/// @return false if the instance has no valid culling grid or 'p' is outside
+/// the grid @see set_culling()
+static inline
+bool fetch_potential_bounds(int id_instance,
+                            const Point_cu& p,
+                            float& f_min,
+                            float& f_max);
+#endif
+
 }// END HRBF_ENV NAMESPACE =====================================================
 
 #if !defined(NO_CUDA)
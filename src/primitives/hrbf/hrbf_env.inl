@@ -73,6 +73,19 @@ float fetch_weights_point(Vec3_cu& beta,
     return tmp.w;
 }
 
+// -----------------------------------------------------------------------------
+
+#if !defined(__CUDA_ARCH__)
+static inline
+bool fetch_potential_bounds(int id_instance,
+                            const Point_cu& p,
+                            float& f_min,
+                            float& f_max)
+{
+    return h_grids[id_instance].bounds(p, f_min, f_max);
+}
+#endif
+
 }// END HRBF_ENV NAMESPACE =====================================================
 
 #endif // HRBF_ENV_TEX_HPP__
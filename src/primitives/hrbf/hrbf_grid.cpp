@@ -0,0 +1,197 @@
+#include "hrbf_grid.hpp"
+
+#include "hrbf_setup.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Size of the cells relatively to the compact radius
+const float CELL_FACTOR = 0.25f;
+
+/// The grid covers the samples bbox enlarged by this times the radius
+const float MARGIN_FACTOR = 1.5f;
+
+/// Maximal number of cells along an axis
+const int MAX_RES = 32;
+
+/// Over estimation of the gradient norm inside a cell
+const float GRAD_SAFETY = 1.25f;
+
+// -----------------------------------------------------------------------------
+
+/// Global potential and gradient norm of the samples at 'x'
+/// (same as HermiteRBF::fngf_global() on host data)
+float eval(const Point_cu& x,
+           const Point_cu* nodes,
+           const Vec3_cu* betas,
+           const float* alphas,
+           int nb_samples,
+           float& grad_norm)
+{
+    typedef HRBF_wrapper::PHI_TYPE Phi;
+
+    float ret = 0.f;
+    Vec3_cu grad(0.f, 0.f, 0.f);
+    for(int i = 0; i < nb_samples; i++)
+    {
+        const Vec3_cu diff = x - nodes[i];
+        Vec3_cu diffNormalized = diff;
+        const float l = diffNormalized.safe_normalize();
+
+        if( l > 0.00001f )
+        {
+            const float dphi    = Phi::df(l);
+            const float ddphi   = Phi::ddf(l);
+            const float bDotd_l = betas[i].dot(diff) / l;
+
+            grad += diffNormalized * (alphas[i] * dphi);
+            grad += (diffNormalized * ddphi - diff * (dphi / (l * l))) * bDotd_l;
+            grad += betas[i] * (dphi / l);
+
+            ret += alphas[i] * Phi::f(l) + bDotd_l * dphi;
+        }
+    }
+    grad_norm = grad.norm();
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+
+bool is_rigid(const Transfo& tr)
+{
+    const float eps = 0.001f;
+    return tr.is_frame_ortho(eps) &&
+           fabsf(tr.x().norm() - 1.f) < eps &&
+           fabsf(tr.y().norm() - 1.f) < eps &&
+           fabsf(tr.z().norm() - 1.f) < eps;
+}
+
+}// END NAMESPACE ==============================================================
+
+// -----------------------------------------------------------------------------
+
+HRBF_grid::HRBF_grid() :
+    _valid(false),
+    _tr(Transfo::identity()),
+    _build_tr(Transfo::identity()),
+    _to_grid(Transfo::identity())
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void HRBF_grid::build(const Point_cu* nodes,
+                      const Vec3_cu* betas,
+                      const float* alphas,
+                      int nb_samples,
+                      float radius)
+{
+    clear();
+    if( nb_samples == 0 || radius <= 0.f )
+        return;
+
+    BBox_cu bb;
+    for(int i = 0; i < nb_samples; i++)
+        bb.add_point( nodes[i] );
+
+    const Vec3_cu margin = Vec3_cu(1.f, 1.f, 1.f) * (radius * MARGIN_FACTOR);
+    _bbox = BBox_cu(bb.pmin - margin, bb.pmax + margin);
+
+    const Vec3_cu len = _bbox.lengths();
+    const float cell  = radius * CELL_FACTOR;
+    _res.x = std::max(1, std::min(MAX_RES, (int)ceilf(len.x / cell)));
+    _res.y = std::max(1, std::min(MAX_RES, (int)ceilf(len.y / cell)));
+    _res.z = std::max(1, std::min(MAX_RES, (int)ceilf(len.z / cell)));
+    _cell_len = Vec3_cu(len.x / _res.x, len.y / _res.y, len.z / _res.z);
+
+    // Potential and gradient norm at the cells centers
+    const int nb_cells = _res.x * _res.y * _res.z;
+    std::vector<float> f   (nb_cells);
+    std::vector<float> grad(nb_cells);
+    Thread_pool::get().parallel_for(nb_cells, 16, [&](int begin, int end){
+        for(int i = begin; i < end; i++)
+        {
+            const int x = i % _res.x;
+            const int y = (i / _res.x) % _res.y;
+            const int z = i / (_res.x * _res.y);
+            const Vec3_cu off((x + 0.5f) * _cell_len.x,
+                              (y + 0.5f) * _cell_len.y,
+                              (z + 0.5f) * _cell_len.z);
+            f[i] = eval(_bbox.pmin + off, nodes, betas, alphas, nb_samples, grad[i]);
+        }
+    });
+
+    // Every point of a cell is at most half a diagonal away from the center.
+    // The gradient norm inside the cell is estimated with the neighbor cells.
+    const float half_diag = _cell_len.norm() * 0.5f;
+    _cells.resize(nb_cells);
+    for(int z = 0; z < _res.z; z++)
+    for(int y = 0; y < _res.y; y++)
+    for(int x = 0; x < _res.x; x++)
+    {
+        float g = 0.f;
+        for(int k = std::max(0, z-1); k <= std::min(_res.z-1, z+1); k++)
+        for(int j = std::max(0, y-1); j <= std::min(_res.y-1, y+1); j++)
+        for(int i = std::max(0, x-1); i <= std::min(_res.x-1, x+1); i++)
+            g = std::max(g, grad[cell_idx(i, j, k)]);
+
+        const int   idx = cell_idx(x, y, z);
+        const float d   = GRAD_SAFETY * g * half_diag;
+        _cells[idx]._f_min = f[idx] - d;
+        _cells[idx]._f_max = f[idx] + d;
+    }
+
+    _build_tr = _tr;
+    _to_grid  = Transfo::identity();
+    _valid    = true;
+}
+
+// -----------------------------------------------------------------------------
+
+void HRBF_grid::set_transfo(const Transfo& tr)
+{
+    _tr = tr;
+    if( !_valid )
+        return;
+
+    const Transfo to_grid = _build_tr * tr.fast_invert();
+    if( is_rigid(to_grid) )
+        _to_grid = to_grid;
+    else
+        clear();
+}
+
+// -----------------------------------------------------------------------------
+
+void HRBF_grid::clear()
+{
+    _valid = false;
+    _cells.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+bool HRBF_grid::bounds(const Point_cu& p, float& f_min, float& f_max) const
+{
+    if( !_valid )
+        return false;
+
+    const Point_cu q = _to_grid * p;
+    if( !_bbox.inside(q) )
+        return false;
+
+    const Vec3_cu off = q - _bbox.pmin;
+    const int x = std::min(_res.x - 1, (int)(off.x / _cell_len.x));
+    const int y = std::min(_res.y - 1, (int)(off.y / _cell_len.y));
+    const int z = std::min(_res.z - 1, (int)(off.z / _cell_len.z));
+
+    const Cell& c = _cells[cell_idx(x, y, z)];
+    f_min = c._f_min;
+    f_max = c._f_max;
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef HRBF_GRID_HPP__
+#define HRBF_GRID_HPP__
+
+#include <vector>
+#include "bbox.hpp"
+#include "point_cu.hpp"
+#include "vec3_cu.hpp"
+#include "vec3i_cu.hpp"
+#include "transfo.hpp"
+
+/**
+ * @class HRBF_grid
+ * @brief Uniform grid over an HRBF instance telling where its compact
+ * potential is constant.
+ *
+ * The global potential of an HRBF is a sum of r^3 kernels which grow with the
+ * distance: every sample contributes to every point and far samples can't be
+ * truncated. However where the global potential is above the compact radius
+ * (resp. below minus the radius) the compact potential is 0 (resp. 1) with a
+ * null gradient and the samples don't need to be visited.
+ *
+ * Each cell stores an interval of the global potential estimated from its
+ * value at the cell center and the gradient norms of the neighbor cells.
+ * This is a heuristic: features of the potential smaller than a cell (noisy
+ * and dense samples for instance) can be missed, the grid is therefore
+ * optional (@see HRBF_env::set_culling()).
+ *
+ * The grid is built in the frame of the animated samples at build time. The
+ * potential being invariant under rigid transformations, only the mapping to
+ * the grid is updated when the instance moves:
+ * @code
+ * HRBF_grid grid;
+ * grid.set_transfo( tr );
+ * grid.build(nodes, betas, alphas, nb_samples, radius);
+ * ...
+ * grid.set_transfo( new_tr ); // Instance moved
+ * float f_min, f_max;
+ * if( grid.bounds(p, f_min, f_max) && f_min > radius )
+ *     // compact potential at 'p' is 0
+ * @endcode
+ */
+class HRBF_grid {
+public:
+    HRBF_grid();
+
+    /// Compute the potential bounds of the cells.
+    /// @param nodes, betas, alphas : samples and weights of the instance
+    /// animated with the last transformation given to set_transfo()
+    /// @param radius : radius of the compact support. Defines the extent and
+    /// resolution of the grid, bounds stay valid if the radius changes.
+    void build(const Point_cu* nodes,
+               const Vec3_cu* betas,
+               const float* alphas,
+               int nb_samples,
+               float radius);
+
+    /// Set the transformation of the instance. The grid is invalidated when
+    /// the transformation relative to the one used at build time is not rigid
+    void set_transfo(const Transfo& tr);
+
+    /// Invalidate the grid until the next build()
+    void clear();
+
+    /// Whether bounds() can be used
+    bool is_valid() const { return _valid; }
+
+    /// Bounds of the global potential at 'p'
+    /// @return false if the grid is not valid or 'p' is outside the grid
+    bool bounds(const Point_cu& p, float& f_min, float& f_max) const;
+
+private:
+    //--------------------------------------------------------------------------
+    /// @name Class tools
+    //--------------------------------------------------------------------------
+
+    struct Cell {
+        float _f_min;
+        float _f_max;
+    };
+
+    int cell_idx(int x, int y, int z) const { return (z * _res.y + y) * _res.x + x; }
+
+    //--------------------------------------------------------------------------
+    /// @name Attributes
+    //--------------------------------------------------------------------------
+
+    bool _valid;
+    std::vector<Cell> _cells;
+    Vec3i_cu _res;      ///< number of cells along each axis
+    BBox_cu  _bbox;     ///< extent of the grid in the build frame
+    Vec3_cu  _cell_len; ///< size of a cell along each axis
+    Transfo  _tr;       ///< current transformation of the instance
+    Transfo  _build_tr; ///< transformation of the instance at build time
+    Transfo  _to_grid;  ///< current instance frame to build frame
+};
+
+#endif // HRBF_GRID_HPP__
@@ -1,27 +1,47 @@
 #include "hrbf_kernels.hpp"
 #include "hrbf_env.hpp"
 
+#include <cassert>
 #include <iostream>
 
 // =============================================================================
 namespace HRBF_kernels{
 // =============================================================================
 
+/// Samples of the instances to transform, see hrbf_transform()
+/// x: index of the first thread, y: offset of the first sample, z: hrbf id
+static Cuda_utils::Device::Array<int4> d_chunks;
+
+// -----------------------------------------------------------------------------
+
+/// Transform the samples of 'nb_chunks' instances with 'nb_verts' samples in
+/// total. Threads of an instance are consecutive (@see d_chunks).
 __global__
 void hrbf_transform_ker(const int nb_verts,
+                        const int nb_chunks,
+                        const int4* chunks,
                         const float4* in_vertices,
                         const float4* in_alpha_beta,
-                        const int* map_transfos,
                         const Transfo* transfos,
                         float4* out_vertices,
                         float4* out_alpha_beta)
 {
-    const int p = blockIdx.x * blockDim.x + threadIdx.x;
+    const int t = blockIdx.x * blockDim.x + threadIdx.x;
 
-    if(p < nb_verts)
+    if(t < nb_verts)
     {
-        const int tr_index = map_transfos[p];
-        const Transfo tr = transfos[tr_index];
+        // Last chunk starting before t
+        int lo = 0, hi = nb_chunks - 1;
+        while(lo < hi)
+        {
+            const int mid = (lo + hi + 1) / 2;
+            if(chunks[mid].x <= t) lo = mid;
+            else                   hi = mid - 1;
+        }
+        const int4 chunk = chunks[lo];
+        const int  p     = chunk.y + (t - chunk.x);
+
+        const Transfo tr = transfos[chunk.z];
 
         const float4  tmp    = in_alpha_beta[p];
         const Vec3_cu beta   = Vec3_cu(tmp.x, tmp.y, tmp.z);
@@ -39,33 +59,43 @@ void hrbf_transform_ker(const int nb_verts,
 
 // -----------------------------------------------------------------------------
 
-/// Transform each vertex of each rbf primitive
-/// @param d_transform Map for a bone parent index its rigid transformation
-/// (tab[parent[ith_bone]] = ith_bone_transformation)
-void hrbf_transform(const Cuda_utils::Device::Array<Transfo>& d_transform,
-                    const Cuda_utils::DA_int& d_map_transfos)
+void hrbf_transform(const std::vector<int>& ids,
+                    const Cuda_utils::Device::Array<Transfo>& d_transform)
 {
     if(HRBF_env::d_init_points.size() == 0) return;
 
+    // Threads ranges of each instance
+    Cuda_utils::Host::Array<int4> h_chunks( (int)ids.size() );
+    int nb_verts = 0;
+    for(unsigned i = 0; i < ids.size(); i++)
+    {
+        const int2 off = HRBF_env::h_offset[ ids[i] ];
+        assert(off.x >= 0);
+        h_chunks[i] = make_int4(nb_verts, off.x, ids[i], 0);
+        nb_verts += off.y;
+    }
+    if(nb_verts == 0) return;
+
+    if(d_chunks.size() < h_chunks.size())
+        d_chunks.malloc( h_chunks.size() );
+    d_chunks.copy_from( h_chunks );
+
     const int block_size = 16;
-    const int grid_size  =
-            (HRBF_env::d_init_points.size() + block_size - 1) / block_size;
+    const int grid_size  = (nb_verts + block_size - 1) / block_size;
 
     HRBF_env::unbind();
 
     hrbf_transform_ker
             <<<grid_size, block_size >>>
-            (HRBF_env::d_init_points.size(),
+            (nb_verts,
+             (int)ids.size(),
+             d_chunks.ptr(),
              HRBF_env::d_init_points.ptr(),
              HRBF_env::d_init_alpha_beta.ptr(),
-             d_map_transfos.ptr(),
              d_transform.ptr(),
              HRBF_env::hd_points.d_ptr(),
              HRBF_env::hd_alphas_betas.d_ptr());
 
-    HRBF_env::hd_points.update_host_mem();
-    HRBF_env::hd_alphas_betas.update_host_mem();
-
     CUDA_CHECK_ERRORS();
 
     HRBF_env::bind();
@@ -4,18 +4,20 @@
 #include "cuda_utils.hpp"
 #include "transfo.hpp"
 
+#include <vector>
+
 // =============================================================================
 namespace HRBF_kernels{
 // =============================================================================
 
-/// Transform each vertex of each rbf primitive
+/// Transform the samples and weights of some rbf primitives.
+/// Only the device side of HRBF_env::hd_points and HRBF_env::hd_alphas_betas
+/// is updated.
+/// @param ids : ids of the HRBF instances to transform
 /// @param d_transform : transformations associated to each HRBF instances
 /// d_transform[hrbf_id] = transfo_instance
-/// @param d_map_transfos : Mapping of hrbf points with their transformations
-/// in d_transform.
-/// d_map_transfos[hrbf_id_offset + sample_idx] = d_transfo[hrbf_id]
-void hrbf_transform(const Cuda_utils::Device::Array<Transfo>& d_transform,
-                    const Cuda_utils::DA_int& d_map_transfos);
+void hrbf_transform(const std::vector<int>& ids,
+                    const Cuda_utils::Device::Array<Transfo>& d_transform);
 
 }// END HRBF_ENV NAMESPACE =====================================================
 
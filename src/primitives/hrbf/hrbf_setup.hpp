@@ -16,12 +16,18 @@ namespace HRBF_wrapper {
 //#define HERMITE_WITH_THIN_PLATES 1
 
    // Change type in order to use another phi_function from rbf_phi_funcs.hpp :
+   /// Phi function for a given scalar type (fits can be done in double)
+   template<typename Scalar>
+   struct Phi {
 #if defined(HERMITE_WITH_X3)
-   typedef Rbf_pow3<float> PHI_TYPE;
+       typedef Rbf_pow3<Scalar> type;
 #elif defined(HERMITE_WITH_THIN_PLATES)
-   typedef Rbf_thin_plate<float> PHI_TYPE;
-   //typedef Rbf_x_sqrt_x<float> PHI_TYPE;
+       typedef Rbf_thin_plate<Scalar> type;
+       //typedef Rbf_x_sqrt_x<Scalar> type;
 #endif
+   };
+
+   typedef Phi<float>::type PHI_TYPE;
 
 }// END RBf_wrapper ============================================================
 
@@ -4,14 +4,33 @@
 
 #include "hrbf_core.hpp" ///< This file must be compile with gcc
 
+#include <list>
+
 // =============================================================================
 namespace HRBF_wrapper {
 // =============================================================================
 
 typedef HRBF_fit< float, 3, PHI_TYPE> HRBF_3f;
+typedef HRBF_refit< float , 3, PHI_TYPE         > HRBF_3f_refit;
+typedef HRBF_refit< double, 3, Phi<double>::type> HRBF_3d_refit;
 
 HRBF_3f* g_hrbf = 0;
 
+/// Number of factorizations kept by hermite_refit(). Each one takes
+/// (4*nb_samples)^2 floats (or doubles).
+const unsigned NB_REFITS_KEPT = 4;
+
+/// Factorization kept for an instance. Only one of the two is allocated
+/// depending on Fit_setup::use_double
+struct Refit {
+    int            _key;
+    HRBF_3f_refit* _f;
+    HRBF_3d_refit* _d;
+};
+
+/// Instances refitted with hermite_refit(), most recently used first
+std::list<Refit> g_refits;
+
 typedef HRBF_3f::MatrixDD MatrixDD;
 typedef HRBF_3f::Vector   Vector;
 typedef HRBF_3f::MatrixXX MatrixDX;
@@ -22,7 +41,8 @@ typedef HRBF_3f::VectorX  VectorX;
 
 /// convert a MatrixDX into a newly allocated Vec3_cu array of
 /// size MatriDX.cols()
-static void matrixDX_to_Vec3_cu_array(const MatrixDX& mat, Vec3_cu*& vec)
+template<class Mat>
+static void matrixDX_to_Vec3_cu_array(const Mat& mat, Vec3_cu*& vec)
 {
     int nb_col = (int) mat.cols();
     vec        = new Vec3_cu[nb_col];
@@ -36,15 +56,71 @@ static void matrixDX_to_Vec3_cu_array(const MatrixDX& mat, Vec3_cu*& vec)
 
 // -----------------------------------------------------------------------------
 
-/// Convert an VectorX of base type Scalar into a newly allocated
-/// array of size VectorX.rows()
-template<class Scalar>
-void vectorX_to_array(const VectorX& vec, Scalar*& tab)
+/// Convert an VectorX into a newly allocated array of base type Scalar
+/// of size VectorX.rows()
+template<class Scalar, class Vec>
+void vectorX_to_array(const Vec& vec, Scalar*& tab)
 {
     int nb_row = (int) vec.rows();
     tab        = new Scalar[nb_row];
     for(int i = 0; i < nb_row; i++)
-        tab[i] = vec(i);
+        tab[i] = (Scalar) vec(i);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Fill 'res' with the coefficients of 'hrbf'
+template<class Fit>
+static void copy_coeffs(const Fit& hrbf,
+                        const Vec3_cu* normals,
+                        int size,
+                        HRBF_coeffs& res)
+{
+    res.size = (int) hrbf._node_centers.cols();
+    vectorX_to_array<float>  (hrbf._alphas,       res.alphas      );
+    matrixDX_to_Vec3_cu_array(hrbf._betas,        res.betas       );
+    matrixDX_to_Vec3_cu_array(hrbf._node_centers, res.nodeCenters );
+    res.normals = new Vec3_cu[size];
+    memcpy(res.normals, normals, size*sizeof(Vec3_cu));
+}
+
+// -----------------------------------------------------------------------------
+
+/// Convert an array of Vec3_cu to Eigen vectors of 'Fit'
+template<class Fit>
+static void to_vectors(const Vec3_cu* vec,
+                       int size,
+                       std::vector<typename Fit::Vector>& res)
+{
+    typedef typename Fit::Vector Vec;
+    typedef typename Fit::Scalar Real;
+    res.resize(size);
+    for(int i = 0; i < size; i++)
+        res[i] = Vec((Real)vec[i].x, (Real)vec[i].y, (Real)vec[i].z);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Refit 'hrbf' (allocated if null) and fill 'res' with its coefficients
+template<class Fit>
+static void refit(Fit*& hrbf,
+                  const Vec3_cu* points,
+                  const Vec3_cu* normals,
+                  int size,
+                  const Fit_setup& setup,
+                  HRBF_coeffs& res)
+{
+    if( hrbf == 0 ) hrbf = new Fit();
+
+    std::vector<typename Fit::Vector> vec_points, vec_normals;
+    to_vectors<Fit>(points , size, vec_points );
+    to_vectors<Fit>(normals, size, vec_normals);
+
+    // Compute coeffs :
+    hrbf->hermite_refit(vec_points, vec_normals, setup);
+
+    // return Coeffs :
+    copy_coeffs(*hrbf, normals, size, res);
 }
 
 // End  Wrapper Tools ----------------------------------------------------------
@@ -52,8 +128,21 @@ void vectorX_to_array(const VectorX& vec, Scalar*& tab)
 void hermite_fit(const Vec3_cu* points,
                  const Vec3_cu* normals,
                  int size,
-                 HRBF_coeffs& res)
+                 HRBF_coeffs& res,
+                 const Fit_setup& setup)
 {
+    if( setup.use_double )
+    {
+        typedef HRBF_fit< double, 3, Phi<double>::type> HRBF_3d;
+        HRBF_3d hrbf;
+        std::vector<HRBF_3d::Vector> vec_points, vec_normals;
+        to_vectors<HRBF_3d>(points , size, vec_points );
+        to_vectors<HRBF_3d>(normals, size, vec_normals);
+        hrbf.hermite_fit(vec_points, vec_normals, setup);
+        copy_coeffs(hrbf, normals, size, res);
+        return;
+    }
+
     delete g_hrbf;
     g_hrbf = new HRBF_fit< float, 3, PHI_TYPE>();
 
@@ -65,15 +154,77 @@ void hermite_fit(const Vec3_cu* points,
     }
 
     // Compute coeffs :
-    g_hrbf->hermite_fit(vec_points, vec_normals);
+    g_hrbf->hermite_fit(vec_points, vec_normals, setup);
 
     // return Coeffs :
-    res.size = (int) g_hrbf->_node_centers.cols();
-    vectorX_to_array<float>  (g_hrbf->_alphas,       res.alphas      );
-    matrixDX_to_Vec3_cu_array(g_hrbf->_betas,        res.betas       );
-    matrixDX_to_Vec3_cu_array(g_hrbf->_node_centers, res.nodeCenters );
-    res.normals = new Vec3_cu[size];
-    memcpy(res.normals, normals, size*sizeof(Vec3_cu));
+    copy_coeffs(*g_hrbf, normals, size, res);
+}
+
+// -----------------------------------------------------------------------------
+
+void hermite_refit(int key,
+                   const Vec3_cu* points,
+                   const Vec3_cu* normals,
+                   int size,
+                   HRBF_coeffs& res,
+                   const Fit_setup& setup)
+{
+    // Look up the instance and move it to the front
+    Refit entry = {key, 0, 0};
+    std::list<Refit>::iterator it = g_refits.begin();
+    for(; it != g_refits.end(); ++it)
+    {
+        if( it->_key == key ){
+            entry = *it;
+            g_refits.erase(it);
+            break;
+        }
+    }
+
+    if( entry._f == 0 && entry._d == 0 && g_refits.size() >= NB_REFITS_KEPT )
+    {
+        delete g_refits.back()._f;
+        delete g_refits.back()._d;
+        g_refits.pop_back();
+    }
+
+    // Precision changed: the other factorization is useless
+    if( setup.use_double ){ delete entry._f; entry._f = 0; }
+    else                  { delete entry._d; entry._d = 0; }
+
+    g_refits.push_front( entry );
+    Refit& front = g_refits.front();
+    if( setup.use_double ) refit(front._d, points, normals, size, setup, res);
+    else                   refit(front._f, points, normals, size, setup, res);
+}
+
+// -----------------------------------------------------------------------------
+
+void release_refit(int key)
+{
+    std::list<Refit>::iterator it = g_refits.begin();
+    for(; it != g_refits.end(); ++it)
+    {
+        if( it->_key == key ){
+            delete it->_f;
+            delete it->_d;
+            g_refits.erase(it);
+            return;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void release_all_refits()
+{
+    std::list<Refit>::iterator it = g_refits.begin();
+    for(; it != g_refits.end(); ++it)
+    {
+        delete it->_f;
+        delete it->_d;
+    }
+    g_refits.clear();
 }
 
 }// END RBFWrapper =============================================================
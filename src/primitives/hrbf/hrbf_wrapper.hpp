@@ -25,10 +25,30 @@ namespace HRBF_wrapper {
 
 /// Compute Hermite RBF coeffs with the given points and normals
 /// @param res : result of the fit with the computed coeficients
+/// @param setup : solver, precision and regularization of the fit
 void hermite_fit(const Vec3_cu* points,
                  const Vec3_cu* normals,
                  int size,
-                 HRBF_coeffs& res);
+                 HRBF_coeffs& res,
+                 const Fit_setup& setup = Fit_setup());
+
+/// Same as hermite_fit() but the factorization of the system is kept for the
+/// hrbf instance 'key': when only a few samples have been moved, added or
+/// deleted since the last call the coefficients are updated without solving
+/// the whole system again. Factorizations of the last few instances
+/// refitted are kept. Changing 'setup' triggers a full fit.
+void hermite_refit(int key,
+                   const Vec3_cu* points,
+                   const Vec3_cu* normals,
+                   int size,
+                   HRBF_coeffs& res,
+                   const Fit_setup& setup = Fit_setup());
+
+/// Forget the factorization kept by hermite_refit() for 'key'
+void release_refit(int key);
+
+/// Forget every factorizations kept by hermite_refit()
+void release_all_refits();
 
 }// END RBF_WRAPPER ============================================================
 
@@ -5,6 +5,7 @@
 #include "bbox.hpp"
 #include "animesh_kers.hpp"
 #include "precomputed_prim_constants.hpp"
+#include "brick_grid.hpp"
 #include "point_cu.hpp"
 #include "skeleton_env_type.hpp"
 
@@ -18,12 +19,25 @@
 
 #include "blending_env.hpp"
 #include "skeleton_env.hpp"
+#include "cache_file.hpp"
+#include "thread_pool.hpp"
 
+#include <algorithm>
 #include <deque>
 #include <iostream>
+#include <vector>
 
 using namespace Cuda_utils;
 
+/// Device copy of the arrays of a Brick_grid
+struct Device_bricks
+{
+    Device::Array<int>      offsets;
+    Device::Array<float4>   constants;
+    Device::Array<float4>   pool;
+    Device::Array<uint16_t> pool_half;
+};
+
 // All info for the object is stored here, instead of in the class itself, so the object
 // remains just a single ID.  This is needed because other parts of the code expect to be
 // able to store a Precomputed_prim in a texture, and it allows accessing the same data
@@ -32,14 +46,22 @@ struct PrecomputedInfo
 {
     __host__ PrecomputedInfo():
         id(-1),
-        tex_grid(0),
-        d_grid(NULL)
+        res(GRID_RES),
+        fill_res(GRID_RES),
+        h_grid(NULL),
+        d_grid(NULL),
+        host_tricubic(false),
+        host_half(false)
     {
     }
     int id;
 
-    /// First float is the potential last three floats the gradient
-    cudaTextureObject_t tex_grid;
+    /// Number of cells of the grid along each axis. This is the resolution of
+    /// the filled grid 'grid_transform' maps to, only changed with the grid.
+    int res;
+
+    /// Resolution requested with set_grid_res(), used by the next fill
+    int fill_res;
 
     // Transformation associated to a grid in initial position.
     // point_in_grid_space = h_grid_transform[i] * point_in_world_space;
@@ -53,7 +75,21 @@ struct PrecomputedInfo
     /// grid_transfo_buffer = grid_transform * user_transform
     Transfo grid_transfo_buffer;
 
-    Device::CuArray<float4> *d_grid;
+    /// The grid, three first floats are the gradient and the last one the
+    /// potential. Only the bricks which are not constant are stored.
+    Brick_grid *h_grid;
+
+    /// Device copy of the arrays of 'h_grid'
+    Device_bricks *d_grid;
+
+    /// 'h_grid' with the pointers of 'd_grid', fetched by the kernels
+    Brick_grid_view d_view;
+
+    /// Reconstruction of the host evaluation: tricubic or trilinear
+    bool host_tricubic;
+
+    /// Store 'h_grid' and 'd_grid' in half precision
+    bool host_half;
 };
 
 std::vector<PrecomputedInfo> h_precomputed_info;
@@ -84,13 +120,12 @@ static Transfo world_coord_to_grid(const OBBox_cu& obbox, int res)
 }
 
 
-// We only ever need one of these at a time, so use a surface instead of a surface object.
-surface<void, cudaSurfaceType3D> fill_surface;
-
+/// Fill the slab of 'grid_res'² * Brick_grid::s_brick cells starting at 'org'
 /// @warning bone_id in device mem ! not the same as Skeleton class
 /// @see Skeleton_Env::get_idx_device_bone()
 __global__ static
-void fill_grid_kernel(int grid_size,
+void fill_grid_kernel(float4* out,
+                      int grid_size,
                       Skeleton_env::DBone_id bone_id,
                       float3 steps,
                       int grid_res,
@@ -113,58 +148,31 @@ void fill_grid_kernel(int grid_size,
         float pot = hrbf.fngf(gf, transfo * p);
         pot = pot < 0.00001f ? 0.f  : pot;
 
-        float4 element = make_float4(gf.x, gf.y, gf.z, pot);
-        surf3Dwrite(element, fill_surface, x*sizeof(float4), y, z, cudaBoundaryModeTrap);
+        out[idx] = make_float4(gf.x, gf.y, gf.z, pot);
     }
 }
 
-/// Filling a 3D grid with an hrbf primitive
-/// @param bone_id bone to fill the grid with. Be aware that this id is not
-/// the same as bone ids in Skeleton class. use Skeleton_Env::get_idx_device_bone()
-/// to convert Skeleton's ids to device ids;
-/// @param steps is the (x, y, z) length of each grid cell
-/// @param grid_res is the number of cells in the (x, y, z) directions
-/// @param org is the 3D coordinates of the origine of the grid.
-/// @param transfo the transformation apllied to the implicit primitive which is
-/// evaluated
-/// @param d_out_grid the linear array to store the grid into.
-/// @warning bone_id is the id in device memory ! It is not the same as the one
-/// in Skeleton class use Skeleton_Env::get_idx_device_bone()
-/// @see Skeleton_Env::get_idx_device_bone()
-void fill_grid_with_fngf(PrecomputedInfo &info,
-                         Skeleton_env::DBone_id device_bone_id,
-                         float3 steps,
-                         int grid_res,
-                         Point_cu org,
-                         Transfo transfo,
-                         int grids,
-                         int blocks)
-{
-    cudaBindSurfaceToArray(fill_surface, info.d_grid->getCudaArray());
-    CUDA_CHECK_ERRORS();
-
-    fill_grid_kernel<<<grids, blocks>>>
-    (info.d_grid->size(), device_bone_id, steps, grid_res, org, transfo);
-    CUDA_CHECK_ERRORS();
-}
-
-static void fill_grid(PrecomputedInfo &info,
+/// Filling a 3D grid with an hrbf primitive. The grid is evaluated one slab
+/// of bricks at a time and compressed on the fly, so the dense grid is never
+/// allocated.
+/// @param grid : compressed grid of resolution 'res'
+/// @param half : compress 'grid' in half precision
+static void fill_grid(Brick_grid& grid,
+                      bool half,
                       Bone::Id bone_id,
                       Skeleton_env::Skel_id skel_id,
                       const OBBox_cu& obbox,
                       int res)
 {
-    assert(GRID_RES_3 == info.d_grid->size());
-
     Vec3_cu lengths = obbox._bb.lengths();
     float3  steps = {lengths.x / (float)res,
                      lengths.y / (float)res,
                      lengths.z / (float)res};
 
-    
+    const int slab_size = res * res * Brick_grid::s_brick;
     const int ker_block_size = 64;
     const int ker_grid_size  =
-            (info.d_grid->size() + ker_block_size - 1) / ker_block_size;
+            (slab_size + ker_block_size - 1) / ker_block_size;
 
 
     if(ker_grid_size > 65535){
@@ -174,46 +182,256 @@ static void fill_grid(PrecomputedInfo &info,
 
     Skeleton_env::DBone_id device_bone_id = Skeleton_env::bone_hidx_to_didx(skel_id, bone_id);
 
-    fill_grid_with_fngf(info,
-                        device_bone_id,
-                        steps,
-                        res,
-                        obbox._bb.pmin,
-                        obbox._tr,
-                        ker_grid_size,
-                        ker_block_size);
+    Device::Array<float4> d_slab(slab_size);
+    Host::Array<float4>   h_slab(slab_size);
+    grid.begin(res, half);
+    for(int bz = 0; bz < grid.nb_bricks(); bz++)
+    {
+        Point_cu org = obbox._bb.pmin + Vec3_cu(0.f, 0.f, steps.z * (float)(bz * Brick_grid::s_brick));
+        fill_grid_kernel<<<ker_grid_size, ker_block_size>>>
+        (d_slab.ptr(), slab_size, device_bone_id, steps, res, org, obbox._tr);
+        CUDA_CHECK_ERRORS();
 
-    CUDA_CHECK_ERRORS();
+        h_slab.copy_from(d_slab);
+        grid.add_slab(bz, h_slab.ptr());
+    }
 }
 
-__device__
-float fetch_potential(const PrecomputedInfo &info, const Point_cu& p)
+// -----------------------------------------------------------------------------
+
+/// Host version of fill_grid(): fill 'grid' with the potential of 'hrbf'.
+/// Rows of a slab are shared among the threads and evaluated at once with
+/// HermiteRBF::fngf_packet()
+static void fill_host_grid(Brick_grid& grid,
+                           bool half,
+                           const HermiteRBF& hrbf,
+                           const OBBox_cu& obbox,
+                           int res)
 {
-    Point_cu  r = info.grid_transfo_buffer * p;
+    Vec3_cu lengths = obbox._bb.lengths();
+    Vec3_cu steps(lengths.x / (float)res,
+                  lengths.y / (float)res,
+                  lengths.z / (float)res);
 
-//    if( is_in_grid(r) )
-//    {
-//        float4 res = tex3D(tex_grid, r.x, r.y, r.z);
-//        return res.x;
-//    }
+    HRBF_env::sync_host_mem( hrbf.get_id() );
 
-    return 0.f;
+    std::vector<float4> slab(res * res * Brick_grid::s_brick);
+    grid.begin(res, half);
+    for(int bz = 0; bz < grid.nb_bricks(); bz++)
+    {
+        const int z0 = bz * Brick_grid::s_brick;
+        const int nb_rows = std::min(res - z0, (int)Brick_grid::s_brick) * res;
+        Thread_pool::get().parallel_for(nb_rows, 1, [&](int begin, int end){
+            const int nb = (end - begin) * res;
+            std::vector<Point_cu> pts(nb);
+            std::vector<float>    pot(nb);
+            std::vector<Vec3_cu>  gf (nb);
+            for(int i = 0; i < nb; i++)
+            {
+                const int row = begin + i / res;
+                Vec3_cu off(steps.x * (i % res), steps.y * (row % res), steps.z * (z0 + row / res));
+                pts[i] = obbox._tr * (obbox._bb.pmin + off);
+            }
+
+            hrbf.fngf_packet(&pot[0], &gf[0], &pts[0], nb);
+
+            float4* out = &slab[begin * res];
+            for(int i = 0; i < nb; i++)
+            {
+                float f = pot[i] < 0.00001f ? 0.f  : pot[i];
+                out[i] = make_float4(gf[i].x, gf[i].y, gf[i].z, f);
+            }
+        });
+        grid.add_slab(bz, &slab[0]);
+    }
 }
 
 // -----------------------------------------------------------------------------
 
-__device__
-Vec3_cu fetch_gradient(const PrecomputedInfo &info, const Point_cu& p)
+/// Free the device copy of the grid
+static void free_grid(PrecomputedInfo &info)
 {
-    Point_cu  r = info.grid_transfo_buffer * p;
+    delete info.d_grid;
+    info.d_grid = NULL;
+    info.d_view = Brick_grid_view();
+}
 
-//    if( is_in_grid(r) )
-//    {
-//        float4 res = tex3D(tex_grid, r.x, r.y, r.z);
-//        return Vec3_cu(res.y, res.z, res.w);
-//    }
+// -----------------------------------------------------------------------------
 
-    return Vec3_cu(0.f, 0.f, 0.f);
+/// Copy 'nb' elements of 'h' to 'd'
+/// @return the device pointer or NULL when 'nb' is zero
+template <class T>
+static const T* upload_array(Device::Array<T>& d, const T* h, int nb)
+{
+    if(nb == 0)
+    {
+        d.erase();
+        return NULL;
+    }
+    d.malloc(nb);
+    CUDA_SAFE_CALL(cudaMemcpy(d.ptr(), h, nb * sizeof(T), cudaMemcpyHostToDevice));
+    return d.ptr();
+}
+
+// -----------------------------------------------------------------------------
+
+/// Copy the host grid to the device and point 'info.d_view' to it
+static void upload_grid(PrecomputedInfo &info)
+{
+    const Brick_grid_view h = info.h_grid->view();
+    if(info.d_grid == NULL)
+        info.d_grid = new Device_bricks();
+
+    Device_bricks &d = *info.d_grid;
+    const int nb = h.nb_bricks * h.nb_bricks * h.nb_bricks;
+    const int nb_pool = h.half ? 0 : h.nb_cells;
+    const int nb_half = h.half ? h.nb_cells * 4 : 0;
+
+    Brick_grid_view v = h;
+    v.offsets   = upload_array(d.offsets  , h.offsets  , nb     );
+    v.constants = upload_array(d.constants, h.constants, nb     );
+    v.pool      = upload_array(d.pool     , h.pool     , nb_pool);
+    v.pool_half = upload_array(d.pool_half, h.pool_half, nb_half);
+    info.d_view = v;
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST static inline
+bool is_in_grid(const Point_cu& pt, int grid_res)
+{
+    const float res = (float)grid_res;
+
+    return pt.x >= 0.5f       && pt.y >= 0.5f       && pt.z >= 0.5f &&
+           pt.x <  res - 0.5f && pt.y <  res - 0.5f && pt.z <  res - 0.5f;
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST static inline
+void add_weighted(float4& acc, const float4& v, float w)
+{
+    acc.x += v.x * w;
+    acc.y += v.y * w;
+    acc.z += v.z * w;
+    acc.w += v.w * w;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Catmull-Rom weights of the cells (i-1, i, i+1, i+2) for a point at 't'
+/// between the cells i and i+1
+static inline
+void catmull_rom_weights(float t, float w[4])
+{
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    w[0] = 0.5f * (-t3 + 2.f * t2 - t);
+    w[1] = 0.5f * (3.f * t3 - 5.f * t2 + 2.f);
+    w[2] = 0.5f * (-3.f * t3 + 4.f * t2 + t);
+    w[3] = 0.5f * (t3 - t2);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Trilinear interpolation of the cells of 'grid' at 'r'
+/// (same as tex3D() with cudaFilterModeLinear)
+/// @param r : point in grid coordinates (cell centers are at i + 0.5)
+IF_CUDA_DEVICE_HOST static inline
+float4 fetch_trilinear(const Brick_grid_view& grid, const Point_cu& r)
+{
+    const float x = r.x - 0.5f;
+    const float y = r.y - 0.5f;
+    const float z = r.z - 0.5f;
+    const int ix = (int)floorf(x);
+    const int iy = (int)floorf(y);
+    const int iz = (int)floorf(z);
+    const float wx[2] = {1.f - (x - (float)ix), x - (float)ix};
+    const float wy[2] = {1.f - (y - (float)iy), y - (float)iy};
+    const float wz[2] = {1.f - (z - (float)iz), z - (float)iz};
+
+    float4 res = make_float4(0.f, 0.f, 0.f, 0.f);
+    for(int k = 0; k < 2; k++)
+        for(int j = 0; j < 2; j++)
+            for(int i = 0; i < 2; i++)
+            {
+                const float w = wx[i] * wy[j] * wz[k];
+                add_weighted(res, grid.fetch(ix+i, iy+j, iz+k), w);
+            }
+    return res;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Catmull-Rom counterpart of fetch_trilinear(), 64 cells are fetched
+static
+float4 fetch_tricubic(const Brick_grid_view& grid, const Point_cu& r)
+{
+    const float x = r.x - 0.5f;
+    const float y = r.y - 0.5f;
+    const float z = r.z - 0.5f;
+    const int ix = (int)floorf(x);
+    const int iy = (int)floorf(y);
+    const int iz = (int)floorf(z);
+
+    float wx[4], wy[4], wz[4];
+    catmull_rom_weights(x - (float)ix, wx);
+    catmull_rom_weights(y - (float)iy, wy);
+    catmull_rom_weights(z - (float)iz, wz);
+
+    float4 res = make_float4(0.f, 0.f, 0.f, 0.f);
+    for(int k = 0; k < 4; k++)
+        for(int j = 0; j < 4; j++)
+        {
+            const float wyz = wy[j] * wz[k];
+            for(int i = 0; i < 4; i++)
+            {
+                const float4 v = grid.fetch(ix+i-1, iy+j-1, iz+k-1);
+                add_weighted(res, v, wx[i] * wyz);
+            }
+        }
+    return res;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Fetch the grid at 'r' in grid coordinates
+/// @return (gradient, potential) or zeros outside the grid
+IF_CUDA_DEVICE_HOST static inline
+float4 fetch_grid(const PrecomputedInfo &info, const Point_cu& r)
+{
+    if( !is_in_grid( r, info.res ) )
+        return make_float4(0.f, 0.f, 0.f, 0.f);
+
+    #ifdef __CUDA_ARCH__
+    if( info.d_view.res == 0 )
+        return make_float4(0.f, 0.f, 0.f, 0.f);
+    return fetch_trilinear(info.d_view, r);
+    #else
+    if( info.h_grid == NULL || info.h_grid->empty() )
+        return make_float4(0.f, 0.f, 0.f, 0.f);
+    const Brick_grid_view grid = info.h_grid->view();
+    return info.host_tricubic ? fetch_tricubic(grid, r) : fetch_trilinear(grid, r);
+    #endif
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST static inline
+float fetch_potential(const PrecomputedInfo &info, const Point_cu& p)
+{
+    Point_cu r = info.grid_transfo_buffer * p;
+    return fetch_grid(info, r).w;
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST static inline
+Vec3_cu fetch_gradient(const PrecomputedInfo &info, const Point_cu& p)
+{
+    Point_cu r = info.grid_transfo_buffer * p;
+    float4 res = fetch_grid(info, r);
+    return info.user_transform * Vec3_cu(res.x, res.y, res.z);
 }
 
 }
@@ -257,6 +475,10 @@ void Precomputed_prim::initialize()
 
     info.id = _id;
     info.user_transform = Transfo::identity();
+    info.res = GRID_RES;
+    info.fill_res = GRID_RES;
+    info.host_tricubic = false;
+    info.host_half = false;
 
     update_device(_id);
 }
@@ -311,15 +533,10 @@ void Precomputed_prim::clear() {
     using namespace Precomputed_env;
 
     PrecomputedInfo &info = get_info();
-    if(info.tex_grid != 0)
-    {
-        cudaDestroyTextureObject(info.tex_grid);
-        CUDA_CHECK_ERRORS();
-    }
-    info.tex_grid = 0;
+    free_grid(info);
 
-    delete info.d_grid;
-    info.d_grid = NULL;
+    delete info.h_grid;
+    info.h_grid = NULL;
 
     info.id = -1;
     int old_id = _id;
@@ -336,32 +553,9 @@ void Precomputed_prim::fill_grid_with(Skeleton_env::Skel_id skel_id, const Bone*
     using namespace Precomputed_env;
 
     PrecomputedInfo &info = get_info();
-
-    // Allocate the grid texture, if we haven't done it yet.
-    if(info.d_grid == NULL)
-    {
-        info.d_grid = new Device::CuArray<float4>();
-        info.d_grid->set_cuda_flags(cudaArraySurfaceLoadStore);
-        info.d_grid->malloc(GRID_RES, GRID_RES, GRID_RES);
-
-        {
-            cudaResourceDesc resDesc;
-            memset(&resDesc, 0, sizeof(resDesc));
-            resDesc.resType = cudaResourceTypeArray;
-            resDesc.res.array.array = info.d_grid->getCudaArray();
-
-            cudaTextureDesc tex;
-            memset(&tex, 0, sizeof(tex));
-            tex.normalizedCoords = false;
-            tex.filterMode = cudaFilterModeLinear;
-            tex.addressMode[0] = cudaAddressModeBorder;
-            tex.addressMode[1] = cudaAddressModeBorder;
-            tex.addressMode[2] = cudaAddressModeBorder;
-
-            cudaCreateTextureObject(&info.tex_grid, &resDesc, &tex, NULL);
-            CUDA_CHECK_ERRORS();
-        }
-    }
+    const int res = info.fill_res;
+    if(info.h_grid == NULL)
+        info.h_grid = new Brick_grid();
 
     // Get the bounding box of the bone that we'll cache.  The bone's coordinate space is always
     // set to identity when we're called, so we cache in object space.
@@ -369,15 +563,151 @@ void Precomputed_prim::fill_grid_with(Skeleton_env::Skel_id skel_id, const Bone*
     OBBox_cu obbox = bone->get_obbox(false, false);
 
     // Compute the primive's grid
-    fill_grid(info, bone_id, skel_id, obbox, GRID_RES);
+    fill_grid(*info.h_grid, info.host_half, bone_id, skel_id, obbox, res);
+    upload_grid(info);
 
     // Adding the transformation to evaluate the grid
-    info.grid_transform = world_coord_to_grid(obbox, GRID_RES);
+    info.grid_transform = world_coord_to_grid(obbox, res);
+    info.res = res;
 
     update_device(_id);
 }
 
-__device__
+// -----------------------------------------------------------------------------
+
+void Precomputed_prim::fill_grid_with_host(const Bone* bone)
+{
+    using namespace Precomputed_env;
+
+    PrecomputedInfo &info = get_info();
+    const int res = info.fill_res;
+    if(info.h_grid == NULL)
+        info.h_grid = new Brick_grid();
+
+    // Same as fill_grid_with() the bone is in object space
+    OBBox_cu obbox = bone->get_obbox(false, false);
+
+    fill_host_grid(*info.h_grid, info.host_half, bone->get_hrbf(), obbox, res);
+    upload_grid(info);
+
+    info.grid_transform = world_coord_to_grid(obbox, res);
+    info.res = res;
+
+    update_device(_id);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Precomputed_prim::save_grid(const std::string& path, int64_t key) const
+{
+    const PrecomputedInfo &info = get_info();
+    if(info.h_grid == NULL || info.h_grid->empty())
+        return false;
+
+    Cache_file::Writer w;
+    w.set_param("GRID_KEY", key);
+    w.add_table("grid_transform", info.grid_transform.m, 16);
+    info.h_grid->write(w);
+    return w.save(path);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Precomputed_prim::load_grid(const std::string& path, int64_t key)
+{
+    using namespace Precomputed_env;
+
+    // A grid of something else isn't an error, the caller fills the grid
+    Cache_file file;
+    if( !file.open(path) || !file.check_param("GRID_KEY", key) )
+        return false;
+
+    Brick_grid grid;
+    float tr[16];
+    if( !file.read_table("grid_transform", tr, 16) || !grid.read(file) || grid.res() < 2 ){
+        std::cerr << "Grid " << path << " is not a valid grid file" << std::endl;
+        return false;
+    }
+
+    PrecomputedInfo &info = get_info();
+    if(info.h_grid == NULL)
+        info.h_grid = new Brick_grid();
+
+    // The file decides of the precision
+    *info.h_grid = grid;
+    info.host_half = grid.is_half();
+    upload_grid(info);
+
+    std::copy(tr, tr + 16, info.grid_transform.m);
+    info.res = grid.res();
+    // Keep the user transformation set before loading
+    info.grid_transfo_buffer = info.grid_transform * info.user_transform.fast_invert();
+
+    update_device(_id);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Precomputed_prim::set_grid_res(int res)
+{
+    assert(res >= 2);
+    // The filled grid is left untouched until the next fill
+    get_info().fill_res = res;
+}
+
+// -----------------------------------------------------------------------------
+
+int Precomputed_prim::get_grid_res() const
+{
+    return get_info().fill_res;
+}
+
+// -----------------------------------------------------------------------------
+
+void Precomputed_prim::set_host_half(bool state)
+{
+    using namespace Precomputed_env;
+
+    PrecomputedInfo &info = get_info();
+    if(info.host_half == state)
+        return;
+
+    info.host_half = state;
+
+    // Convert the current grid
+    if(info.h_grid != NULL && !info.h_grid->empty())
+    {
+        info.h_grid->set_half(state);
+        upload_grid(info);
+        update_device(_id);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+bool Precomputed_prim::get_host_half() const
+{
+    return get_info().host_half;
+}
+
+// -----------------------------------------------------------------------------
+
+void Precomputed_prim::set_host_tricubic(bool state)
+{
+    get_info().host_tricubic = state;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Precomputed_prim::get_host_tricubic() const
+{
+    return get_info().host_tricubic;
+}
+
+// -----------------------------------------------------------------------------
+
+IF_CUDA_DEVICE_HOST
 float Precomputed_prim::f(const Point_cu& x) const
 {
     using namespace Precomputed_env;
@@ -388,7 +718,7 @@ float Precomputed_prim::f(const Point_cu& x) const
 
 // -----------------------------------------------------------------------------
 
-__device__
+IF_CUDA_DEVICE_HOST
 Vec3_cu Precomputed_prim::gf(const Point_cu& x) const
 {
     using namespace Precomputed_env;
@@ -398,16 +728,8 @@ Vec3_cu Precomputed_prim::gf(const Point_cu& x) const
 }
 
 // -----------------------------------------------------------------------------
-__device__
-bool is_in_grid(const Point_cu& pt)
-{
-    const float res = (float)GRID_RES;
 
-    return pt.x >= 0.5        && pt.y >= 0.5f       && pt.z >= 0.5f &&
-           pt.x <  res - 0.5f && pt.y <  res - 0.5f && pt.z <  res - 0.5f;
-}
-
-__device__
+IF_CUDA_DEVICE_HOST
 float Precomputed_prim::fngf(Vec3_cu& grad, const Point_cu& p) const
 {
     using namespace Precomputed_env;
@@ -415,15 +737,7 @@ float Precomputed_prim::fngf(Vec3_cu& grad, const Point_cu& p) const
     const PrecomputedInfo &info = get_info();
     Point_cu  r = info.grid_transfo_buffer * p;
 
-    // XXX: Can we avoid needing to check this using texture borders, since each grid is now in
-    // a separate texture?
-    if( !is_in_grid( r ) )
-    {
-        grad = Vec3_cu(0.f, 0.f, 0.f);
-        return 0.f;
-    }
-
-    float4 res = tex3D<float4>(info.tex_grid, r.x, r.y, r.z);
+    float4 res = fetch_grid(info, r);
     grad.x = res.x;
     grad.y = res.y;
     grad.z = res.z;
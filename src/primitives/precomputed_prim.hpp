@@ -2,6 +2,8 @@
 #define PRECOMPUTED_PRIM_HPP__
 
 #include <cassert>
+#include <string>
+#include <stdint.h>
 #include "vec3_cu.hpp"
 #include "point_cu.hpp"
 #include "cuda_utils.hpp"
@@ -16,8 +18,10 @@ class Bone;
 /** @namespace Precomputed_env
     @brief Environment storing 3D grids representing implicit primitives
 
-    Precomputed_Env provides a way to store in Cuda textures 3d grids and
-    fetch them with trilinear interpolation
+    Precomputed_Env provides a way to store 3d grids and fetch them with
+    trilinear interpolation. Grids are stored in sparse bricks
+    (@see Brick_grid) on host and device, so they can also be evaluated
+    without the GPU (trilinear or tricubic interpolation).
 
     How to upload one primitive and transform it:
     @code
@@ -25,6 +29,8 @@ class Bone;
     // init the 3d grid potential and gradient with a implicit bone
     Precomputed_prim.initialize();
     Precomputed_prim.fill_grid_with(skel_id, bone);
+    // or on host: Precomputed_prim.fill_grid_with_host(bone);
+    // or from a file: Precomputed_prim.load_grid(path);
     // Apply a global transformation to the 3d grid
     prim.set_transform(tr);
     prim.set_transform(tr);
@@ -52,6 +58,39 @@ struct Precomputed_prim {
     __host__
     void fill_grid_with(Skeleton_env::Skel_id skel_id, const Bone* bone);
 
+    /// Same as fill_grid_with() but the grid is computed on host with the
+    /// bone's HRBF, rows are shared among the threads of the Thread_pool.
+    /// The grid is then uploaded to the device.
+    void fill_grid_with_host(const Bone* bone);
+
+    /// Save the grid and the transformation to evaluate it to 'path'
+    /// (@see Cache_file). This allows to fill grids once offline.
+    /// @param key : identifies what the grid was filled with (e.g. a hash of
+    /// the HRBF samples), load_grid() only accepts files with the same key
+    /// @return false if the grid is not filled or the file can't be written
+    bool save_grid(const std::string& path, int64_t key = 0) const;
+
+    /// Load a grid written by save_grid() instead of filling it. The
+    /// resolution and host precision are the ones of the file.
+    /// @return false if the file doesn't exist, is corrupted or was saved
+    /// with another key
+    bool load_grid(const std::string& path, int64_t key = 0);
+
+    /// Sets the number of cells along each axis used by the next fill.
+    /// Defaults to GRID_RES, small bones can use coarser grids. The current
+    /// grid is still evaluated at its own resolution until it is refilled.
+    void set_grid_res(int res);
+
+    /// @return the resolution set by set_grid_res()
+    int get_grid_res() const;
+
+    /// Store the grid (on host, device and in saved files) in half precision.
+    /// Either way only the bricks of the grid which are not constant are
+    /// stored (@see Brick_grid). The current grid is converted.
+    void set_host_half(bool state);
+
+    bool get_host_half() const;
+
     /// In order to animate the precomputed primitives one as to set the
     /// transformations applied to each primitive.
     /// @warning One must call update_device_transformations() setting all the
@@ -70,17 +109,24 @@ struct Precomputed_prim {
     /// @see set_transform()
     static void update_device_transformations();
 
-#if !defined(NO_CUDA)
+    /// Sets the reconstruction used when evaluating the grid on host.
+    /// Trilinear by default (same as the device texture fetch), tricubic
+    /// (Catmull-Rom) is smoother but fetches 64 cells instead of 8.
+    void set_host_tricubic(bool state);
+
+    bool get_host_tricubic() const;
+
     /// @name Evaluation of the potential and gradient
+    /// On host the evaluation is done on the bricks filled by
+    /// fill_grid_with(), on device on their copy
     /// @{
-    __device__
+    IF_CUDA_DEVICE_HOST
     float f(const Point_cu& p) const;
-    __device__
+    IF_CUDA_DEVICE_HOST
     Vec3_cu gf(const Point_cu& p) const;
-    __device__
+    IF_CUDA_DEVICE_HOST
     float fngf (Vec3_cu& gf, const Point_cu& p) const;
     /// @}
-#endif
 
 private:
     static void update_device(int _id);
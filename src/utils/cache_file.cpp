@@ -0,0 +1,379 @@
+#include "cache_file.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Length of the names of tables and parameters (null terminated)
+const int NAME_LEN = 32;
+
+/// Tables start on multiples of this so they can be read in place
+const uint64_t TABLE_ALIGN = 64;
+
+const char     MAGIC[8]   = {'I', 'B', 'L', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t ENDIANNESS = 0x01020304;
+
+struct Header {
+    char     _magic[8];
+    uint32_t _version;
+    uint32_t _endianness;
+    uint32_t _nb_params;
+    uint32_t _nb_tables;
+    uint64_t _file_size;
+    /// crc of the header (with _crc = 0) and of the entries that follow
+    uint32_t _crc;
+    uint32_t _pad;
+};
+
+struct Param_entry {
+    char    _name[NAME_LEN];
+    int64_t _value;
+};
+
+struct Table_entry {
+    char     _name[NAME_LEN];
+    uint64_t _offset; ///< from the beginning of the file
+    uint64_t _size;   ///< in bytes
+    uint32_t _elt_size;
+    uint32_t _crc;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Lookup table of the CRC32 (IEEE) polynomial
+struct Crc_table {
+    Crc_table(){
+        for(uint32_t i = 0; i < 256; ++i){
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            _vals[i] = c;
+        }
+    }
+    uint32_t _vals[256];
+};
+
+// -----------------------------------------------------------------------------
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0)
+{
+    static const Crc_table table;
+
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i)
+        crc = table._vals[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// -----------------------------------------------------------------------------
+
+void copy_name(char* dst, const std::string& name)
+{
+    assert(name.size() < (unsigned)NAME_LEN);
+    std::memset(dst, 0, NAME_LEN);
+    std::strncpy(dst, name.c_str(), NAME_LEN-1);
+}
+
+// -----------------------------------------------------------------------------
+
+uint64_t align(uint64_t offset)
+{
+    return (offset + TABLE_ALIGN - 1) / TABLE_ALIGN * TABLE_ALIGN;
+}
+
+}// END NAMESPACE ==============================================================
+
+// -----------------------------------------------------------------------------
+
+void Cache_file::Writer::set_param(const std::string& name, int64_t value)
+{
+    for(unsigned i = 0; i < _params.size(); ++i){
+        if( _params[i].first == name ){
+            _params[i].second = value;
+            return;
+        }
+    }
+    _params.push_back( std::make_pair(name, value) );
+}
+
+// -----------------------------------------------------------------------------
+
+void Cache_file::Writer::add_raw_table(const std::string& name,
+                                       const void* data,
+                                       size_t size,
+                                       size_t elt_size)
+{
+    Table t;
+    t._name     = name;
+    t._data     = data;
+    t._size     = size;
+    t._elt_size = (uint32_t)elt_size;
+    _tables.push_back( t );
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cache_file::Writer::save(const std::string& path) const
+{
+    std::vector<Param_entry> params( _params.size() );
+    for(unsigned i = 0; i < _params.size(); ++i){
+        copy_name(params[i]._name, _params[i].first);
+        params[i]._value = _params[i].second;
+    }
+
+    uint64_t offset = sizeof(Header) +
+                      sizeof(Param_entry) * params.size() +
+                      sizeof(Table_entry) * _tables.size();
+
+    std::vector<Table_entry> tables( _tables.size() );
+    for(unsigned i = 0; i < _tables.size(); ++i)
+    {
+        offset = align(offset);
+        copy_name(tables[i]._name, _tables[i]._name);
+        tables[i]._offset   = offset;
+        tables[i]._size     = _tables[i]._size;
+        tables[i]._elt_size = _tables[i]._elt_size;
+        tables[i]._crc      = crc32(_tables[i]._data, (size_t)_tables[i]._size);
+        offset += _tables[i]._size;
+    }
+
+    Header h;
+    std::memcpy(h._magic, MAGIC, sizeof(MAGIC));
+    h._version    = s_version;
+    h._endianness = ENDIANNESS;
+    h._nb_params  = (uint32_t)params.size();
+    h._nb_tables  = (uint32_t)tables.size();
+    h._file_size  = offset;
+    h._crc        = 0;
+    h._pad        = 0;
+
+    uint32_t crc = crc32(&h, sizeof(Header));
+    if( params.size() > 0 ) crc = crc32(params.data(), sizeof(Param_entry) * params.size(), crc);
+    if( tables.size() > 0 ) crc = crc32(tables.data(), sizeof(Table_entry) * tables.size(), crc);
+    h._crc = crc;
+
+    std::ofstream ostream(path.c_str(), std::ios::trunc | std::ios::out | std::ios::binary);
+    if( !ostream.is_open() )
+        return false;
+
+    ostream.write((const char*)&h, sizeof(Header));
+    if( params.size() > 0 ) ostream.write((const char*)params.data(), sizeof(Param_entry) * params.size());
+    if( tables.size() > 0 ) ostream.write((const char*)tables.data(), sizeof(Table_entry) * tables.size());
+
+    const char zeros[TABLE_ALIGN] = {};
+    uint64_t pos = sizeof(Header) +
+                   sizeof(Param_entry) * params.size() +
+                   sizeof(Table_entry) * tables.size();
+    for(unsigned i = 0; i < tables.size(); ++i)
+    {
+        ostream.write(zeros, (std::streamsize)(tables[i]._offset - pos));
+        ostream.write((const char*)_tables[i]._data, (std::streamsize)tables[i]._size);
+        pos = tables[i]._offset + tables[i]._size;
+    }
+
+    bool ok = ostream.good();
+    ostream.close();
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+Cache_file::Cache_file() :
+    _data(0),
+    _size(0)
+#if defined(WIN32)
+    , _file(0)
+    , _mapping(0)
+#endif
+{
+}
+
+// -----------------------------------------------------------------------------
+
+Cache_file::~Cache_file()
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cache_file::open(const std::string& path)
+{
+    close();
+
+#if defined(WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(Header) ){
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if( mapping == 0 ){
+        CloseHandle(file);
+        return false;
+    }
+
+    _data    = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    _size    = (size_t)size.QuadPart;
+    _file    = file;
+    _mapping = mapping;
+    if( _data == 0 ){
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header) ){
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid once the descriptor is closed
+    ::close(fd);
+    if( ptr == MAP_FAILED )
+        return false;
+
+    _data = (const char*)ptr;
+    _size = (size_t)st.st_size;
+#endif
+
+    // Check the header
+    Header h;
+    std::memcpy(&h, _data, sizeof(Header));
+    bool valid = std::memcmp(h._magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 h._version    == s_version  &&
+                 h._endianness == ENDIANNESS &&
+                 h._file_size  == _size;
+
+    const size_t entries_size = sizeof(Param_entry) * (size_t)h._nb_params +
+                                sizeof(Table_entry) * (size_t)h._nb_tables;
+
+    valid = valid && sizeof(Header) + entries_size <= _size;
+    if( valid )
+    {
+        const uint32_t crc = h._crc;
+        h._crc = 0;
+        uint32_t c = crc32(&h, sizeof(Header));
+        c = crc32(_data + sizeof(Header), entries_size, c);
+        valid = c == crc;
+    }
+
+    if( !valid ){
+        std::cerr << "Invalid or outdated cache file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    _checked.assign(h._nb_tables, false);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Cache_file::close()
+{
+#if defined(WIN32)
+    if( _data    != 0 ) UnmapViewOfFile(_data);
+    if( _mapping != 0 ) CloseHandle((HANDLE)_mapping);
+    if( _file    != 0 ) CloseHandle((HANDLE)_file);
+    _file    = 0;
+    _mapping = 0;
+#else
+    if( _data != 0 ) munmap((void*)_data, _size);
+#endif
+    _data = 0;
+    _size = 0;
+    _checked.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cache_file::check_param(const std::string& name, int64_t value) const
+{
+    int64_t v;
+    return get_param(name, v) && v == value;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cache_file::get_param(const std::string& name, int64_t& value) const
+{
+    if( !is_open() )
+        return false;
+
+    const Header* h = (const Header*)_data;
+    const Param_entry* params = (const Param_entry*)(_data + sizeof(Header));
+    for(uint32_t i = 0; i < h->_nb_params; ++i)
+    {
+        if( std::strncmp(params[i]._name, name.c_str(), NAME_LEN) == 0 ){
+            value = params[i]._value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+const void* Cache_file::raw_table(const std::string& name,
+                                  size_t size,
+                                  size_t elt_size) const
+{
+    if( !is_open() )
+        return 0;
+
+    const Header* h = (const Header*)_data;
+    const Table_entry* tables = (const Table_entry*)(_data + sizeof(Header) +
+                                                     sizeof(Param_entry) * h->_nb_params);
+
+    for(uint32_t i = 0; i < h->_nb_tables; ++i)
+    {
+        const Table_entry& t = tables[i];
+        if( std::strncmp(t._name, name.c_str(), NAME_LEN) != 0 )
+            continue;
+
+        if( t._size != size || t._elt_size != elt_size ||
+            t._offset + t._size > _size )
+        {
+            return 0;
+        }
+
+        const char* data = _data + t._offset;
+        if( !_checked[i] )
+        {
+            if( crc32(data, (size_t)t._size) != t._crc ){
+                std::cerr << "Corrupted cache table: " << name << std::endl;
+                return 0;
+            }
+            _checked[i] = true;
+        }
+        return data;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#ifndef CACHE_FILE_HPP__
+#define CACHE_FILE_HPP__
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @class Cache_file
+ * @brief Single file container for precomputed tables, read through a memory
+ * mapping.
+ *
+ * A cache file holds a header, a list of named integer parameters (the
+ * sampling resolutions the tables were computed with) and a list of named
+ * binary tables. The header stores a version number and an endianness marker
+ * and is protected by a CRC32, each table has its own CRC32.
+ *
+ * Opening a file only maps it and validates the header. Tables are checked
+ * against their CRC the first time they are accessed and are then read
+ * directly from the mapping:
+ * @code
+ * Cache_file::Writer w;
+ * w.set_param("NB_SAMPLES", NB_SAMPLES);
+ * w.add_table("vals", vals, len);
+ * w.save(path);
+ * ...
+ * Cache_file f;
+ * if( f.open(path) && f.check_param("NB_SAMPLES", NB_SAMPLES) )
+ * {
+ *     const float* vals = f.table<float>("vals", len);
+ *     if( vals != 0 ) ...
+ * }
+ * @endcode
+ * @warning Pointers returned by table() are invalidated by close(), open()
+ * and the destructor.
+ */
+class Cache_file {
+public:
+    /// Incremented each time the layout of the file changes
+    static const uint32_t s_version = 1;
+
+    // -------------------------------------------------------------------------
+    /// @name Writing
+    // -------------------------------------------------------------------------
+
+    /// Gathers parameters and tables then writes them in one go.
+    /// Table data is not copied and must stay alive until save().
+    class Writer {
+    public:
+        void set_param(const std::string& name, int64_t value);
+
+        template<class T>
+        void add_table(const std::string& name, const T* data, size_t nb_elt){
+            add_raw_table(name, data, nb_elt * sizeof(T), sizeof(T));
+        }
+
+        /// @return whether the file has been written or not
+        bool save(const std::string& path) const;
+
+    private:
+        void add_raw_table(const std::string& name,
+                           const void* data,
+                           size_t size,
+                           size_t elt_size);
+
+        struct Table {
+            std::string _name;
+            const void* _data;
+            uint64_t    _size;
+            uint32_t    _elt_size;
+        };
+
+        std::vector< std::pair<std::string, int64_t> > _params;
+        std::vector<Table> _tables;
+    };
+
+    // -------------------------------------------------------------------------
+    /// @name Reading
+    // -------------------------------------------------------------------------
+
+    Cache_file();
+    ~Cache_file();
+
+    /// Map the file and check its header (magic, version, endianness, crc)
+    /// @return false if the file doesn't exist or is not a valid cache file
+    bool open(const std::string& path);
+
+    /// Unmap the file
+    void close();
+
+    bool is_open() const { return _data != 0; }
+
+    /// @return true if the parameter 'name' exists and equals 'value'.
+    /// Stale caches are detected this way.
+    bool check_param(const std::string& name, int64_t value) const;
+
+    /// Fetch the parameter 'name'
+    /// @return false if the parameter doesn't exist
+    bool get_param(const std::string& name, int64_t& value) const;
+
+    /// @return a pointer to the table 'name' inside the mapping or 0 if the
+    /// table doesn't exist, doesn't have 'nb_elt' elements of type T or is
+    /// corrupted.
+    template<class T>
+    const T* table(const std::string& name, size_t nb_elt) const {
+        return (const T*)raw_table(name, nb_elt * sizeof(T), sizeof(T));
+    }
+
+    /// Copy the table 'name' to 'dst'
+    /// @return false if the table is not available (@see table())
+    template<class T>
+    bool read_table(const std::string& name, T* dst, size_t nb_elt) const;
+
+private:
+    Cache_file(const Cache_file&);
+    Cache_file& operator=(const Cache_file&);
+
+    const void* raw_table(const std::string& name,
+                          size_t size,
+                          size_t elt_size) const;
+
+    /// Start of the mapping
+    const char* _data;
+    /// Size in bytes of the mapping
+    size_t _size;
+    /// Tables whose crc has already been checked
+    mutable std::vector<bool> _checked;
+
+#if defined(WIN32)
+    void* _file;
+    void* _mapping;
+#endif
+};
+
+// -----------------------------------------------------------------------------
+
+template<class T>
+bool Cache_file::read_table(const std::string& name, T* dst, size_t nb_elt) const
+{
+    const T* src = table<T>(name, nb_elt);
+    if( src == 0 )
+        return false;
+
+    std::copy(src, src + nb_elt, dst);
+    return true;
+}
+
+#endif // CACHE_FILE_HPP__
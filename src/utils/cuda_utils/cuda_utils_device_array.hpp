@@ -273,6 +273,12 @@ struct CuArray : Cuda_utils::Common::Array<T>{
     template <class B>
     inline int copy_from(B* d_a, int size);
 
+    /// Download the CuArray to host memory
+    /// @param h_a : host array of the same size in bytes than the CuArray
+    /// @return 0 if succeeded
+    template <class B, bool pg_lk>
+    inline int copy_to(Cuda_utils::Host::ArrayTemplate<B, pg_lk>& h_a) const;
+
     inline cudaExtent get_extent() const { return array_extent; }
     inline int size() const { return array_extent.width * array_extent.height * array_extent.depth; }
 
@@ -984,5 +990,30 @@ copy_from(B* d_a, int size)
 
 // -----------------------------------------------------------------------------
 
+template <class T>
+template <class B, bool pg_lk>
+inline int Cuda_utils::Device::CuArray<T>::
+
+copy_to(Cuda_utils::Host::ArrayTemplate<B, pg_lk>& h_a) const
+{
+    assert(CCA::nb_elt * sizeof(T) == h_a.size() * sizeof(B));
+    if((state & CCA::IS_ALLOCATED) && h_a.size() > 0)
+    {
+        cudaMemcpy3DParms copyParams = {0};
+        copyParams.srcArray = data;
+        copyParams.dstPtr   = make_cudaPitchedPtr(reinterpret_cast<void*>(h_a.ptr()),
+                                                  array_extent.width*sizeof(T),
+                                                  array_extent.width,
+                                                  array_extent.height);
+        copyParams.extent   = array_extent;
+        copyParams.kind     = cudaMemcpyDeviceToHost;
+        CUDA_SAFE_CALL(cudaMemcpy3D(&copyParams));
+        return 0;
+    }
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+
 
 #endif // DEVICE_ARRAY_HPP__
@@ -0,0 +1,141 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// -----------------------------------------------------------------------------
+
+Thread_pool::Thread_pool(int nb_threads) :
+    _busy(false),
+    _job(0),
+    _job_gen(0),
+    _quit(false)
+{
+    if(nb_threads < 0)
+        nb_threads = (int)std::thread::hardware_concurrency();
+
+    // The calling thread always takes part in the job
+    for(int i = 1; i < nb_threads; ++i)
+        _workers.push_back( std::thread(&Thread_pool::worker_loop, this) );
+}
+
+// -----------------------------------------------------------------------------
+
+Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake_cond.notify_all();
+
+    for(unsigned i = 0; i < _workers.size(); ++i)
+        _workers[i].join();
+}
+
+// -----------------------------------------------------------------------------
+
+Thread_pool& Thread_pool::get()
+{
+    static Thread_pool pool;
+    return pool;
+}
+
+// -----------------------------------------------------------------------------
+
+int Thread_pool::run_chunks(Job& job)
+{
+    int nb_done = 0;
+    int chunk;
+    while( (chunk = job.next_chunk++) < job.nb_chunks )
+    {
+        const int begin = chunk * job.grain;
+        const int end   = std::min(begin + job.grain, job.size);
+        (*job.fun)(begin, end);
+        nb_done++;
+    }
+    return nb_done;
+}
+
+// -----------------------------------------------------------------------------
+
+void Thread_pool::worker_loop()
+{
+    unsigned seen_gen = 0;
+    while( true )
+    {
+        Job* job = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while( !_quit && seen_gen == _job_gen )
+                _wake_cond.wait(lock);
+
+            if( _quit ) return;
+
+            seen_gen = _job_gen;
+            job = _job;
+            // The job may already be over when we wake up late
+            if( job == 0 ) continue;
+            job->nb_active++;
+        }
+
+        int nb_done = run_chunks( *job );
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            job->nb_active--;
+            job->nb_chunks_done += nb_done;
+            if(job->nb_active == 0 && job->nb_chunks_done == job->nb_chunks)
+                _done_cond.notify_all();
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Thread_pool::parallel_for(int size,
+                               int grain,
+                               const std::function<void (int, int)>& fun)
+{
+    if(size <= 0) return;
+    grain = std::max(grain, 1);
+
+    const int nb_chunks = (size + grain - 1) / grain;
+
+    bool idle = false;
+    if( _workers.size() == 0 || nb_chunks == 1 ||
+        !_busy.compare_exchange_strong(idle, true) )
+    {
+        // Nested call or another job is running: no need to wait for it
+        fun(0, size);
+        return;
+    }
+
+    Job job;
+    job.fun            = &fun;
+    job.size           = size;
+    job.grain          = grain;
+    job.nb_chunks      = nb_chunks;
+    job.next_chunk     = 0;
+    job.nb_chunks_done = 0;
+    job.nb_active      = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _job_gen++;
+    }
+    _wake_cond.notify_all();
+
+    int nb_done = run_chunks( job );
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    job.nb_chunks_done += nb_done;
+    while( job.nb_active > 0 || job.nb_chunks_done < job.nb_chunks )
+        _done_cond.wait(lock);
+
+    assert(job.nb_chunks_done == job.nb_chunks);
+    _job = 0;
+    lock.unlock();
+    _busy = false;
+}
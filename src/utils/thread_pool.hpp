@@ -0,0 +1,86 @@
+#ifndef THREAD_POOL_HPP__
+#define THREAD_POOL_HPP__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/** @class Thread_pool
+    @brief Fixed set of worker threads to run data parallel loops on the host
+
+    Workers are created once and sleep between jobs so that the host
+    evaluators (skeleton potential, animesh fitting etc.) can split every call
+    without paying for thread creation.
+
+    usage:
+    @code
+    Thread_pool& pool = Thread_pool::get();
+    pool.parallel_for(nb_points, 256, [&](int begin, int end){
+        for(int i = begin; i < end; ++i)
+            out[i] = eval( in[i] );
+    });
+    @endcode
+
+    @note parallel_for() is blocking and the calling thread takes part in the
+    job. When a job is already running (nested call from a task or concurrent
+    callers) the loop is executed sequentially by the caller.
+*/
+class Thread_pool {
+public:
+    /// @param nb_threads : number of threads taking part in a job (including
+    /// the calling thread). When negative we use the number of hardware
+    /// threads.
+    Thread_pool(int nb_threads = -1);
+
+    ~Thread_pool();
+
+    /// Call 'fun(begin, end)' over sub-ranges of [0 size) of at most
+    /// 'grain' elements and wait for every sub-range to be processed.
+    void parallel_for(int size, int grain, const std::function<void (int, int)>& fun);
+
+    /// Number of threads taking part in a job (workers plus caller)
+    int nb_threads() const { return (int)_workers.size() + 1; }
+
+    /// The pool shared by the host side evaluators
+    static Thread_pool& get();
+
+private:
+    Thread_pool(const Thread_pool&);
+    Thread_pool& operator=(const Thread_pool&);
+
+    /// State of a parallel_for() call shared with the workers
+    struct Job {
+        const std::function<void (int, int)>* fun;
+        int size;
+        int grain;
+        int nb_chunks;
+        std::atomic<int> next_chunk;
+        int nb_chunks_done; ///< protected by _mutex
+        int nb_active;      ///< workers currently inside the job (_mutex)
+    };
+
+    void worker_loop();
+
+    /// Process chunks of 'job' until there is none left
+    /// @return the number of chunks processed
+    static int run_chunks(Job& job);
+
+    std::vector<std::thread> _workers;
+
+    /// Only one job at a time, other callers fall back to sequential loops
+    std::atomic<bool> _busy;
+
+    std::mutex              _mutex;
+    std::condition_variable _wake_cond;
+    std::condition_variable _done_cond;
+    Job*     _job;     ///< current job or null (_mutex)
+    /// incremented for each new job so that sleeping workers know they have
+    /// to wake up
+    unsigned _job_gen;
+    bool     _quit;
+};
+
+#endif // THREAD_POOL_HPP__